@@ -1,5 +1,6 @@
 #include "ad/ag_all.hpp"
 #include <cassert>
+#include <iostream>
 #include <vector> // Required for shape comparison
 
 using namespace ag;
@@ -19,6 +20,31 @@ int main() {
   auto expected_shape = std::vector<int64_t>{4, 2};
   assert(nmm->value.shape().dims == expected_shape);
 
+  // --- Shape / layout: split a fused QKV projection, then concat it back ---
+  Tensor qkv0 = Tensor::randn(Shape{{2, 3, 12}}, TensorOptions().with_req_grad(true));
+  Value qkv = make_tensor(qkv0);
+  std::vector<Value> parts = split(qkv, -1, {4, 4, 4});
+  assert(parts.size() == 3 && parts[1].shape() == (std::vector<int64_t>{2, 3, 4}));
+  for (int64_t b = 0; b < 2; ++b)
+    for (int64_t t = 0; t < 3; ++t)
+      for (int64_t d = 0; d < 4; ++d)
+        assert(parts[1].val().data<float>()[(b * 3 + t) * 4 + d] == qkv0.data<float>()[(b * 3 + t) * 12 + 4 + d]);
+
+  Value joined = concat({parts[2], parts[0], parts[1]}, 2);
+  Value row = select(joined, 1, 2);  // [2, 12]
+  assert(row.shape() == (std::vector<int64_t>{2, 12}));
+  backward(sum(row * 3.0f));
+  // Only t == 2 received gradient, scattered back through concat and split.
+  for (int64_t i = 0; i < qkv0.numel(); ++i) {
+    const int64_t t = (i / 12) % 3;
+    assert(qkv.grad().data<float>()[i] == (t == 2 ? 3.0f : 0.0f));
+  }
+
+  Value r = reshape(make_tensor(qkv0), {6, -1});
+  assert(r.shape() == (std::vector<int64_t>{6, 12}));
+  Value e = expand(make_tensor(Tensor::randn(Shape{{3, 1}}, TensorOptions())), {2, 3, 5});
+  assert(e.shape() == (std::vector<int64_t>{2, 3, 5}));
+
   std::cout << "[OK] test_nodeops passed." << std::endl;
   
   return 0;
@@ -5,6 +5,7 @@
 #include "ad/autodiff/autodiff.hpp"
 #include "ad/utils/debug.hpp"   
 #include "ad/runtime/cuda_graphs.hpp"
+#include "ad/runtime/kv_cache.hpp"
 #include "nn/nn.hpp"
 #include "ad/ops/kernels_api.hpp"
 #include <cuda_runtime.h>
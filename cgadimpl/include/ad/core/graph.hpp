@@ -31,6 +31,12 @@ struct Node : std::enable_shared_from_this<Node> {
     std::vector<std::shared_ptr<Node>> inputs;
     std::vector<Value> saved_inputs;
     std::vector<std::shared_ptr<Tensor>> tape;
+
+    // Row-sparse gradient (embedding tables): row i of sparse_grad [R, D] adds
+    // to row sparse_rows[i] of this node. Kept apart from the dense grad so a
+    // [V, D] table only pays for the rows a batch touched.
+    std::vector<int64_t> sparse_rows;
+    Tensor sparse_grad;
     
     // Checkpointing
     std::vector<uint8_t> saved_rng_blob;
@@ -36,13 +36,202 @@ typedef void (*ag_exp_fn)(const float* x, float* y, int64_t n);
 typedef void (*ag_log_fn)(const float* x, float* y, int64_t n);
 typedef void (*ag_sqrt_fn) (const float* x, float* y, int64_t n);
 typedef void (*ag_pow_fn) (const float* x, float* y, int64_t n, float exponent);
+// Y = X @ W + b with W: [In,Out] (row-major, the transpose of nn::Linear's
+// weight). linear_dW/linear_dX below share this layout; linear_bwd does not.
 typedef void (*ag_linear_fn)(const float* X,const float* W,const float* b,float* Y,int B,int In,int Out);
 // CPU function table (can be partially filled; nulls mean "not provided")
 typedef void (*elem_bwd_fn)(const float*, const float*, float*, int64_t);
 typedef void (*elem_bwd_alpha_fn)(const float*, const float*, float*, int64_t, float);
+// dW[In,Out] = X^T @ dY and dX = dY @ W^T, W: [In,Out] as in ag_linear_fn.
 typedef void (*ag_linear_dW_fn)(const float* X, const float* dY, float* dW, int B, int In, int Out);
 typedef void (*ag_linear_dX_fn)(const float* dY, const float* W, float* dX, int B, int In, int Out);
 typedef void (*ag_linear_db_fn)(const float* dY, float* db, int B, int Out);
+// Fused LM head: linear (W is [V,D]) + cross-entropy over class-index targets,
+// streamed over vocabulary chunks. Forward writes per-row logsumexp (and loss);
+// backward recomputes each chunk of logits from the saved logsumexp.
+typedef void (*ag_linear_xent_fwd_fn)(const float* H, const float* W, const float* b,
+                                      const int64_t* targets, float* lse, float* loss,
+                                      int N, int D, int V, int chunk);
+typedef void (*ag_linear_xent_bwd_fn)(const float* H, const float* W, const float* b,
+                                      const int64_t* targets, const float* lse, float scale,
+                                      float* dH, float* dW, float* db,
+                                      int N, int D, int V, int chunk);
+// Row-wise normalization over the last axis of x viewed as [rows, cols].
+// Forward saves only per-row mean/rstd; gamma/beta (length cols) may be null.
+typedef void (*ag_layernorm_fwd_fn)(const float* x, const float* gamma, const float* beta,
+                                    float* y, float* mean, float* rstd,
+                                    int64_t rows, int64_t cols, float eps);
+typedef void (*ag_layernorm_bwd_fn)(const float* x, const float* dy, const float* gamma,
+                                    const float* mean, const float* rstd,
+                                    float* dx, float* dgamma, float* dbeta,
+                                    int64_t rows, int64_t cols);
+typedef void (*ag_rmsnorm_fwd_fn)(const float* x, const float* gamma, float* y, float* rstd,
+                                  int64_t rows, int64_t cols, float eps);
+typedef void (*ag_rmsnorm_bwd_fn)(const float* x, const float* dy, const float* gamma,
+                                  const float* rstd, float* dx, float* dgamma,
+                                  int64_t rows, int64_t cols);
+// Fused linear + activation, Y = act(X @ W^T + b) with W: [Out,In].
+typedef enum ag_activation {
+  AG_ACT_NONE = 0,
+  AG_ACT_RELU = 1,
+  AG_ACT_GELU = 2,   // tanh approximation
+  AG_ACT_SILU = 3
+} ag_activation;
+// Z (pre-activation) may be null when the caller does not need it.
+typedef void (*ag_linear_act_fwd_fn)(const float* X, const float* W, const float* b,
+                                     float* Y, float* Z, int B, int In, int Out, int act);
+// S is what the forward saved: Z for GELU/SiLU, Y or Z for ReLU.
+typedef void (*ag_linear_act_bwd_fn)(const float* X, const float* W, const float* S,
+                                     const float* dY, float* dX, float* dW, float* db,
+                                     int B, int In, int Out, int act);
+// Backward of the plain Y = X @ W^T + b in one pass over dY: dX = dY @ W,
+// dW = dY^T @ X and db = the column sums of dY. Note W and dW are [Out,In]
+// (the graph / nn::Linear layout), NOT the [In,Out] of linear/linear_dW/
+// linear_dX. dX, dW and db are overwritten and may be null.
+typedef void (*ag_linear_bwd_fn)(const float* X, const float* W, const float* dY,
+                                 float* dX, float* dW, float* db, int B, int In, int Out);
+// SwiGLU FFN, Y = silu(X @ Wg^T + bg) * (X @ Wu^T + bu). X: [B,In], Wg/Wu: [H,In],
+// bg/bu: [H] (nullable), Y: [B,H]. G and U (nullable in the forward) receive the
+// gate and up pre-activations, which the backward needs. Gradients are
+// overwritten; any of them may be null.
+typedef void (*ag_swiglu_fwd_fn)(const float* X, const float* Wg, const float* bg,
+                                 const float* Wu, const float* bu, float* Y, float* G, float* U,
+                                 int B, int In, int H);
+typedef void (*ag_swiglu_bwd_fn)(const float* X, const float* Wg, const float* Wu,
+                                 const float* G, const float* U, const float* dY,
+                                 float* dX, float* dWg, float* dbg, float* dWu, float* dbu,
+                                 int B, int In, int H);
+// Rotary positional embedding, rotate-half pairing. X, Y: [N,H,D] (Y may alias
+// X), pos: [N], cos_t/sin_t: [max_pos, D/2] angle tables. inverse != 0 applies
+// the opposite rotation, which is also the backward.
+typedef void (*ag_rope_fn)(const float* X, float* Y, const float* cos_t, const float* sin_t,
+                           const int* pos, int N, int H, int D, int inverse);
+// Embedding lookup. W: [V,D], idx: [N]. offsets == NULL: Y [N,D] = W[idx].
+// offsets [B+1]: embedding bag, Y [B,D] = sum (mean if mean != 0) of the rows
+// idx[offsets[b] .. offsets[b+1]). The backward returns a row-sparse gradient:
+// R distinct ids in rows[0..R), ascending, with their summed gradients in dW
+// [R,D]; rows and dW need room for N entries.
+typedef void (*ag_embedding_fwd_fn)(const float* W, const int* idx, const int* offsets, float* Y,
+                                    int N, int B, int D, int mean);
+typedef int (*ag_embedding_bwd_fn)(const int* idx, const int* offsets, const float* dY, int* rows, float* dW,
+                                   int N, int B, int D, int mean);
+// General matmul with transposed operands read in place: C [M,N] = op(A) @
+// op(B), where A is stored [M,K] (or [K,M] when trans_a) and B is stored [K,N]
+// (or [N,K] when trans_b), all row-major.
+typedef void (*ag_gemm_fn)(const float* A, const float* B, float* C, int M, int K, int N,
+                           int trans_a, int trans_b);
+// Broadcasting binary ops. The output is viewed as [rows, cols] and each
+// operand is full, a row vector (cols values, repeated down the rows), a
+// column vector (rows values, repeated across the columns) or a scalar.
+typedef enum ag_binary_op {
+  AG_BIN_ADD = 0,
+  AG_BIN_SUB = 1,
+  AG_BIN_MUL = 2,
+  AG_BIN_DIV = 3
+} ag_binary_op;
+typedef enum ag_bcast {
+  AG_BCAST_FULL = 0,
+  AG_BCAST_ROW = 1,
+  AG_BCAST_COL = 2,
+  AG_BCAST_SCALAR = 3
+} ag_bcast;
+// C = A op B, or C += A op B when accumulate.
+typedef void (*ag_binary_bcast_fn)(int op, const float* A, int a_bcast, const float* B, int b_bcast,
+                                   float* C, int64_t rows, int64_t cols, int accumulate);
+// Gradient side: out (+)= alpha * (G op M) summed over the axes out is
+// broadcast along (out_bcast). G is full; M (nullable = G alone) is per m_bcast.
+typedef void (*ag_binary_reduce_fn)(int op, const float* G, const float* M, int m_bcast, float alpha,
+                                    float* out, int out_bcast, int64_t rows, int64_t cols, int accumulate);
+// Reductions over the middle axis of x viewed as [outer, n, inner]: y[o, i] =
+// op over k of x[o, k, i]. inner = 1 reduces the last axis, outer = inner = 1
+// all elements; y has outer * inner entries.
+typedef enum ag_reduce_op {
+  AG_REDUCE_SUM = 0,
+  AG_REDUCE_MAX = 1,
+  AG_REDUCE_MEAN = 2,
+  AG_REDUCE_SUMSQ = 3   // sum of squares
+} ag_reduce_op;
+typedef void (*ag_reduce_fn)(int op, const float* x, float* y, int64_t outer, int64_t n, int64_t inner);
+// ReLU / LeakyReLU that also emit the sign pattern as a packed bitmask: bit
+// (i & 7) of mask[i >> 3] is set where x[i] > 0, so mask needs (n + 7) / 8
+// bytes. The backward reads only that mask, never x: dX = dY where the bit is
+// set, else 0 (ReLU) or alpha * dY (LeakyReLU).
+typedef void (*ag_relu_fwd_mask_fn)(const float* x, float* y, unsigned char* mask, int64_t n);
+typedef void (*ag_leakyrelu_fwd_mask_fn)(const float* x, float* y, unsigned char* mask, int64_t n, float alpha);
+typedef void (*ag_relu_bwd_mask_fn)(const unsigned char* mask, const float* dY, float* dX, int64_t n);
+typedef void (*ag_leakyrelu_bwd_mask_fn)(const unsigned char* mask, const float* dY, float* dX, int64_t n, float alpha);
+// Mamba selective scan, h_t = exp(a_t) * h_{t-1} + b_t x_t, y_t = c_t . h_t + d x_t.
+// x, a: [Bt,T,D]; b, c: [Bt,T,N]; d: [D] (nullable). Time is split into chunks
+// of `chunk` steps; hb [Bt, ceil(T/chunk), D, N] holds the state entering each
+// chunk and is the only thing the backward needs besides the inputs.
+typedef void (*ag_ssm_scan_fwd_fn)(const float* x, const float* a, const float* b, const float* c,
+                                   const float* d, float* y, float* hb,
+                                   int Bt, int T, int D, int N, int chunk);
+typedef void (*ag_ssm_scan_bwd_fn)(const float* x, const float* a, const float* b, const float* c,
+                                   const float* d, const float* hb, const float* gy,
+                                   float* dx, float* da, float* db, float* dc, float* dd,
+                                   int Bt, int T, int D, int N, int chunk);
+// Mixture of Experts FFN with top-k routing. X: [T,D], Wg: [E,D], W1: [E,H,D],
+// b1: [E,H], W2: [E,D,H], b2: [E,D] (biases nullable). The forward fills
+// route/gate [T,k] (route = expert id, or -(id+1) when dropped by capacity)
+// and Z1 [T*k,H], the hidden pre-activation in expert-bucket order; the
+// backward rebuilds the token permutation from route. capacity <= 0 = unbounded.
+typedef void (*ag_moe_fwd_fn)(const float* X, const float* Wg, const float* W1, const float* b1,
+                              const float* W2, const float* b2, float* Y,
+                              float* route, float* gate, float* Z1,
+                              int T, int D, int H, int E, int k, int capacity, int act);
+typedef void (*ag_moe_bwd_fn)(const float* X, const float* Wg, const float* W1, const float* b1,
+                              const float* W2, const float* b2,
+                              const float* route, const float* gate, const float* Z1, const float* gy,
+                              float* dX, float* dWg, float* dW1, float* db1, float* dW2, float* db2,
+                              int T, int D, int H, int E, int k, int act);
+// Which (query, key) pairs attention may score; query t of T sits at key
+// position p = t + S - T. causal: keys j <= p. window > 0: keys j > p - window
+// (the `window` most recent). layout (nullable, with block > 0): row-major
+// [ceil(T/block), ceil(S/block)] bytes, zero = that block x block tile is
+// masked. Conditions combine, and tiles they rule out entirely are skipped.
+// alibi (nullable): per-head slopes [H]; -slope[h] * |p - j| is added to the
+// scores inside the kernel.
+typedef struct ag_attn_mask {
+  int causal;
+  int window;
+  int block;
+  const unsigned char* layout;
+  const float* alibi;
+} ag_attn_mask;
+// Multi-head attention over batched heads. Q: [B,T,H,D], K/V: [B,S,Hkv,D] with
+// H % Hkv == 0 (GQA/MQA share a kv head across H/Hkv query heads), O: [B,T,H,D].
+// L [B,H,T] receives the row logsumexp of the scaled scores, which is all the
+// backward needs to recompute probabilities. mask == NULL is dense attention.
+// dQ, dK, dV are overwritten and may be null.
+typedef void (*ag_mha_fwd_fn)(const float* Q, const float* K, const float* V, float* O, float* L,
+                              int B, int T, int S, int H, int Hkv, int D, float scale,
+                              const ag_attn_mask* mask);
+typedef void (*ag_mha_bwd_fn)(const float* Q, const float* K, const float* V, const float* O,
+                              const float* L, const float* dO, float* dQ, float* dK, float* dV,
+                              int B, int T, int S, int H, int Hkv, int D, float scale,
+                              const ag_attn_mask* mask);
+// The same attention over a packed batch of variable-length sequences, with no
+// padding stored. Q/O: [Nq,H,D] and K/V: [Nk,Hkv,D] hold the sequences back to
+// back; sequence b owns query rows [cu_q[b], cu_q[b+1]) and key rows
+// [cu_k[b], cu_k[b+1]), and only attends within itself. L: [H * Nq], with
+// sequence b's [H, T_b] block at offset H * cu_q[b]. The mask's causal, window
+// and alibi fields apply per sequence; block-sparse layouts are not used.
+typedef void (*ag_mha_varlen_fwd_fn)(const float* Q, const float* K, const float* V, float* O, float* L,
+                                     const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                                     float scale, const ag_attn_mask* mask);
+typedef void (*ag_mha_varlen_bwd_fn)(const float* Q, const float* K, const float* V, const float* O,
+                                     const float* L, const float* dO, float* dQ, float* dK, float* dV,
+                                     const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                                     float scale, const ag_attn_mask* mask);
+// Attention over a paged KV cache. Kc/Vc: [num_blocks, block_size, Hkv, D] page
+// pool; sequence b uses pages block_tables[b * max_blocks + i] and holds
+// ctx_lens[b] tokens, the last T of which are its queries Q [B,T,H,D].
+// O: [B,T,H,D]. Inference only; the mask's layout is ignored.
+typedef void (*ag_paged_attn_fwd_fn)(const float* Q, const float* Kc, const float* Vc,
+                                     const int* block_tables, const int* ctx_lens, float* O,
+                                     int B, int T, int H, int Hkv, int D, int block_size, int max_blocks,
+                                     float scale, const ag_attn_mask* mask);
 
 
 void leakyrelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n, float alpha);
@@ -61,13 +250,15 @@ void linear_db_impl_optimized(const float* dY, float* db, int B, int Out);
 void relu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n);
 
 
-// CPU function table (can be partially filled; nulls mean "not provided")
+// CPU function table (can be partially filled; nulls mean "not provided").
+// Frozen: v1 has no size field, so appending to it would break plugins and
+// hosts built against an older header. New entries go in ag_cpu_v2.
 struct ag_cpu_v1 {
   uint32_t abi_version;   // must be AG_KERNELS_ABI_V1
-  ag_add_fn    add; // to be added
-  ag_sub_fn    sub; // to be added
-  ag_mul_fn    mul; // to be added
-  ag_div_fn    div; // to be added
+  ag_add_fn    add;
+  ag_sub_fn    sub;
+  ag_mul_fn    mul;
+  ag_div_fn    div;
 
   ag_relu_fn   relu; 
   ag_matmul_fn matmul; 
@@ -103,6 +294,155 @@ struct ag_cpu_v1 {
 
 AG_EXPORT int ag_get_cpu_kernels_v1(struct ag_cpu_v1* out);
 
+// ---------- ABI v2: tensor descriptors and caller workspace ----------
+// v2 kernels take tensors as descriptors instead of contiguous float buffers,
+// so strided views (transposes, slices, broadcasts) and 16-bit floats are
+// read and written in place. Plugins may export it next to v1; loaders that
+// find no ag_get_cpu_kernels_v2 keep using v1 alone.
+static const uint32_t AG_KERNELS_ABI_V2 = 2;
+
+typedef enum ag_dtype {
+  AG_DTYPE_F32 = 0,
+  AG_DTYPE_F16 = 1,    // IEEE half
+  AG_DTYPE_BF16 = 2
+} ag_dtype;
+
+#define AG_DESC_MAX_DIMS 8
+// data points at element (0, ..., 0); strides are in elements and may be 0,
+// which repeats that dim (how binary operands express broadcasting). 16-bit
+// operands are computed in float32 and rounded to nearest even on store.
+typedef struct ag_tensor_desc {
+  void* data;
+  int32_t dtype;       // ag_dtype
+  int32_t ndim;        // 0 .. AG_DESC_MAX_DIMS; 0 is a scalar
+  int64_t shape[AG_DESC_MAX_DIMS];
+  int64_t strides[AG_DESC_MAX_DIMS];
+} ag_tensor_desc;
+
+// Scratch memory owned by the caller, for kernels that convert or re-lay out
+// operands. v2 kernels return 0 on success, a positive byte count when the
+// workspace is smaller than that (nothing is written; call again with at
+// least that much; bytes = 0 is a size query), or AG_V2_UNSUPPORTED when the
+// descriptors are outside what the kernel handles, so the caller falls back.
+typedef struct ag_workspace {
+  void* ptr;
+  int64_t bytes;
+} ag_workspace;
+static const int64_t AG_V2_UNSUPPORTED = -1;
+
+typedef enum ag_unary_op {
+  AG_UNARY_COPY = 0,   // copy / cast / make contiguous
+  AG_UNARY_RELU = 1,
+  AG_UNARY_LEAKYRELU = 2,
+  AG_UNARY_GELU = 3,   // tanh approximation
+  AG_UNARY_SILU = 4,
+  AG_UNARY_SIGMOID = 5,
+  AG_UNARY_TANH = 6,
+  AG_UNARY_EXP = 7,
+  AG_UNARY_SQRT = 8
+} ag_unary_op;
+// y = op(x), same shape; alpha is the LeakyReLU slope.
+typedef int64_t (*ag_unary_v2_fn)(int op, const ag_tensor_desc* x, const ag_tensor_desc* y,
+                                  float alpha, ag_workspace ws);
+// c = a op b (ag_binary_op), or c += a op b when accumulate. a and b have c's
+// shape; broadcast dims have stride 0.
+typedef int64_t (*ag_binary_v2_fn)(int op, const ag_tensor_desc* a, const ag_tensor_desc* b,
+                                   const ag_tensor_desc* c, int accumulate, ag_workspace ws);
+// c [M,N] = a [M,K] @ b [K,N], or c += when accumulate. Any 2D strides, so a
+// transposed view is passed as its descriptor with the two dims swapped.
+typedef int64_t (*ag_gemm_v2_fn)(const ag_tensor_desc* a, const ag_tensor_desc* b,
+                                 const ag_tensor_desc* c, int accumulate, ag_workspace ws);
+
+// The caller zeroes the table and sets struct_size to the size it was built
+// with; the plugin fills only the fields that fit and writes back how many
+// bytes it filled, so either side may be newer. Fields are only ever
+// appended. Past the descriptor kernels, v2 carries the float32 kernels that
+// came after v1 was frozen, with the same signatures they would have had there.
+struct ag_cpu_v2 {
+  uint32_t abi_version;   // must be AG_KERNELS_ABI_V2
+  uint32_t struct_size;
+  ag_unary_v2_fn  unary;
+  ag_binary_v2_fn binary;
+  ag_gemm_v2_fn   gemm;
+  // fused linear + cross-entropy
+  ag_linear_xent_fwd_fn linear_xent_fwd;
+  ag_linear_xent_bwd_fn linear_xent_bwd;
+  // layernorm / rmsnorm
+  ag_layernorm_fwd_fn layernorm_fwd;
+  ag_layernorm_bwd_fn layernorm_bwd;
+  ag_rmsnorm_fwd_fn   rmsnorm_fwd;
+  ag_rmsnorm_bwd_fn   rmsnorm_bwd;
+  // fused linear + activation
+  ag_linear_act_fwd_fn linear_act_fwd;
+  ag_linear_act_bwd_fn linear_act_bwd;
+  // selective scan (Mamba SSM)
+  ag_ssm_scan_fwd_fn ssm_scan_fwd;
+  ag_ssm_scan_bwd_fn ssm_scan_bwd;
+  // mixture of experts
+  ag_moe_fwd_fn moe_fwd;
+  ag_moe_bwd_fn moe_bwd;
+  // multi-head attention
+  ag_mha_fwd_fn mha_fwd;
+  ag_mha_bwd_fn mha_bwd;
+  ag_paged_attn_fwd_fn paged_attn_fwd;
+  // fused SwiGLU FFN
+  ag_swiglu_fwd_fn swiglu_fwd;
+  ag_swiglu_bwd_fn swiglu_bwd;
+  // attention over packed variable-length batches
+  ag_mha_varlen_fwd_fn mha_varlen_fwd;
+  ag_mha_varlen_bwd_fn mha_varlen_bwd;
+  // rotary positional embedding
+  ag_rope_fn rope;
+  // embedding lookup / bag with row-sparse gradients
+  ag_embedding_fwd_fn embedding_fwd;
+  ag_embedding_bwd_fn embedding_bwd;
+  // ReLU / LeakyReLU with 1-bit saved masks
+  ag_relu_fwd_mask_fn relu_fwd_mask;
+  ag_leakyrelu_fwd_mask_fn leakyrelu_fwd_mask;
+  ag_relu_bwd_mask_fn relu_bwd_mask;
+  ag_leakyrelu_bwd_mask_fn leakyrelu_bwd_mask;
+  // matmul with NN / NT / TN / TT operand layouts
+  ag_gemm_fn gemm_f32;
+  // add / sub / mul / div with row, column and scalar broadcasting
+  ag_binary_bcast_fn binary_bcast;
+  ag_binary_reduce_fn binary_reduce;
+  // sum / max / mean / sum of squares over one axis run or all elements
+  ag_reduce_fn reduce;
+  // Accumulating variants of the backward kernels: same signatures, but the
+  // gradients are added to the outputs (dX += ..., GEMM beta = 1) instead of
+  // overwriting them, so a VJP can pass the parent's grad buffer directly.
+  elem_bwd_fn relu_bwd_acc;
+  elem_bwd_alpha_fn leakyrelu_bwd_acc;
+  elem_bwd_fn sigmoid_bwd_from_s_acc;
+  elem_bwd_fn tanh_bwd_from_t_acc;
+  elem_bwd_fn gelu_bwd_acc;
+  elem_bwd_fn softplus_bwd_acc;
+  elem_bwd_fn exp_bwd_from_y_acc;
+  elem_bwd_fn log_bwd_acc;
+  elem_bwd_fn sqrt_bwd_from_y_acc;
+  ag_relu_bwd_mask_fn relu_bwd_mask_acc;
+  ag_leakyrelu_bwd_mask_fn leakyrelu_bwd_mask_acc;
+  void (*matmul_bwd_dA_acc)(const float*, const float*, float*, int M, int K, int N);
+  void (*matmul_bwd_dB_acc)(const float*, const float*, float*, int M, int K, int N);
+  ag_linear_dW_fn linear_dW_acc;
+  ag_linear_dX_fn linear_dX_acc;
+  ag_linear_db_fn linear_db_acc;
+  ag_gemm_fn gemm_f32_acc;
+  ag_linear_xent_bwd_fn linear_xent_bwd_acc;
+  ag_layernorm_bwd_fn layernorm_bwd_acc;
+  ag_rmsnorm_bwd_fn rmsnorm_bwd_acc;
+  ag_linear_act_bwd_fn linear_act_bwd_acc;
+  ag_swiglu_bwd_fn swiglu_bwd_acc;
+  ag_ssm_scan_bwd_fn ssm_scan_bwd_acc;
+  ag_moe_bwd_fn moe_bwd_acc;
+  ag_mha_bwd_fn mha_bwd_acc;
+  ag_mha_varlen_bwd_fn mha_varlen_bwd_acc;
+  ag_linear_bwd_fn linear_bwd;
+  ag_linear_bwd_fn linear_bwd_acc;
+};
+
+AG_EXPORT int ag_get_cpu_kernels_v2(struct ag_cpu_v2* out);
+
 // ---- NEW: CUDA function pointer types (accept a stream) ----
 // Avoid pulling in CUDA headers here: just forward-declare the opaque type.
 typedef struct CUstream_st* ag_cuda_stream_t;
@@ -160,10 +500,10 @@ namespace ag::kernels {
 // CPU registry (yours – unchanged)
 struct Cpu {
   // Forward
-  ag_add_fn    add    = nullptr; // to be added
-  ag_sub_fn    sub    = nullptr; // to be added
-  ag_mul_fn    mul    = nullptr; // to be added
-  ag_div_fn    div    = nullptr; // to be added
+  ag_add_fn    add    = nullptr;
+  ag_sub_fn    sub    = nullptr;
+  ag_mul_fn    mul    = nullptr;
+  ag_div_fn    div    = nullptr;
 
   ag_relu_fn   relu   = nullptr;
   ag_matmul_fn matmul = nullptr;
@@ -195,6 +535,83 @@ struct Cpu {
   ag_linear_dW_fn linear_dW = nullptr;
   ag_linear_dX_fn linear_dX = nullptr;
   ag_linear_db_fn linear_db = nullptr;
+  // fused linear + cross-entropy
+  ag_linear_xent_fwd_fn linear_xent_fwd = nullptr;
+  ag_linear_xent_bwd_fn linear_xent_bwd = nullptr;
+  // layernorm / rmsnorm
+  ag_layernorm_fwd_fn layernorm_fwd = nullptr;
+  ag_layernorm_bwd_fn layernorm_bwd = nullptr;
+  ag_rmsnorm_fwd_fn   rmsnorm_fwd   = nullptr;
+  ag_rmsnorm_bwd_fn   rmsnorm_bwd   = nullptr;
+  // fused linear + activation
+  ag_linear_act_fwd_fn linear_act_fwd = nullptr;
+  ag_linear_act_bwd_fn linear_act_bwd = nullptr;
+  // selective scan (Mamba SSM)
+  ag_ssm_scan_fwd_fn ssm_scan_fwd = nullptr;
+  ag_ssm_scan_bwd_fn ssm_scan_bwd = nullptr;
+  // mixture of experts
+  ag_moe_fwd_fn moe_fwd = nullptr;
+  ag_moe_bwd_fn moe_bwd = nullptr;
+  // multi-head attention
+  ag_mha_fwd_fn mha_fwd = nullptr;
+  ag_mha_bwd_fn mha_bwd = nullptr;
+  ag_paged_attn_fwd_fn paged_attn_fwd = nullptr;
+  // fused SwiGLU FFN
+  ag_swiglu_fwd_fn swiglu_fwd = nullptr;
+  ag_swiglu_bwd_fn swiglu_bwd = nullptr;
+  // attention over packed variable-length batches
+  ag_mha_varlen_fwd_fn mha_varlen_fwd = nullptr;
+  ag_mha_varlen_bwd_fn mha_varlen_bwd = nullptr;
+  // rotary positional embedding
+  ag_rope_fn rope = nullptr;
+  // embedding lookup / bag with row-sparse gradients
+  ag_embedding_fwd_fn embedding_fwd = nullptr;
+  ag_embedding_bwd_fn embedding_bwd = nullptr;
+  // ReLU / LeakyReLU with 1-bit saved masks
+  ag_relu_fwd_mask_fn relu_fwd_mask = nullptr;
+  ag_leakyrelu_fwd_mask_fn leakyrelu_fwd_mask = nullptr;
+  ag_relu_bwd_mask_fn relu_bwd_mask = nullptr;
+  ag_leakyrelu_bwd_mask_fn leakyrelu_bwd_mask = nullptr;
+  // matmul with NN / NT / TN / TT operand layouts
+  ag_gemm_fn gemm = nullptr;
+  // add / sub / mul / div with row, column and scalar broadcasting
+  ag_binary_bcast_fn binary_bcast = nullptr;
+  ag_binary_reduce_fn binary_reduce = nullptr;
+  // sum / max / mean / sum of squares over one axis run or all elements
+  ag_reduce_fn reduce = nullptr;
+  // accumulating backward variants (out += grad instead of out = grad)
+  elem_bwd_fn relu_bwd_acc = nullptr;
+  elem_bwd_alpha_fn leakyrelu_bwd_acc = nullptr;
+  elem_bwd_fn sigmoid_bwd_from_s_acc = nullptr;
+  elem_bwd_fn tanh_bwd_from_t_acc = nullptr;
+  elem_bwd_fn gelu_bwd_acc = nullptr;
+  elem_bwd_fn softplus_bwd_acc = nullptr;
+  elem_bwd_fn exp_bwd_from_y_acc = nullptr;
+  elem_bwd_fn log_bwd_acc = nullptr;
+  elem_bwd_fn sqrt_bwd_from_y_acc = nullptr;
+  ag_relu_bwd_mask_fn relu_bwd_mask_acc = nullptr;
+  ag_leakyrelu_bwd_mask_fn leakyrelu_bwd_mask_acc = nullptr;
+  void (*matmul_bwd_dA_acc)(const float*, const float*, float*, int M, int K, int N) = nullptr;
+  void (*matmul_bwd_dB_acc)(const float*, const float*, float*, int M, int K, int N) = nullptr;
+  ag_linear_dW_fn linear_dW_acc = nullptr;
+  ag_linear_dX_fn linear_dX_acc = nullptr;
+  ag_linear_db_fn linear_db_acc = nullptr;
+  ag_gemm_fn gemm_acc = nullptr;
+  ag_linear_xent_bwd_fn linear_xent_bwd_acc = nullptr;
+  ag_layernorm_bwd_fn layernorm_bwd_acc = nullptr;
+  ag_rmsnorm_bwd_fn rmsnorm_bwd_acc = nullptr;
+  ag_linear_act_bwd_fn linear_act_bwd_acc = nullptr;
+  ag_swiglu_bwd_fn swiglu_bwd_acc = nullptr;
+  ag_ssm_scan_bwd_fn ssm_scan_bwd_acc = nullptr;
+  ag_moe_bwd_fn moe_bwd_acc = nullptr;
+  ag_mha_bwd_fn mha_bwd_acc = nullptr;
+  ag_mha_varlen_bwd_fn mha_varlen_bwd_acc = nullptr;
+  ag_linear_bwd_fn linear_bwd = nullptr;
+  ag_linear_bwd_fn linear_bwd_acc = nullptr;
+  // ABI v2 entries; null when the plugin only exports v1
+  ag_unary_v2_fn  unary_v2  = nullptr;
+  ag_binary_v2_fn binary_v2 = nullptr;
+  ag_gemm_v2_fn   gemm_v2   = nullptr;
 };
 
 // Global registry accessor
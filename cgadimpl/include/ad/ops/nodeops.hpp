@@ -19,6 +19,7 @@
 #include <math.h>
 #include <iterator>
 #include <memory>
+#include <functional>
 
 namespace ag {
 namespace detail {
@@ -32,9 +33,18 @@ std::shared_ptr<Node> add_nodeops(const std::shared_ptr<Node>& a, const std::sha
 std::shared_ptr<Node> sub_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b);
 std::shared_ptr<Node> mul_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b);
 std::shared_ptr<Node> div_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b);
+// Broadcast of two shapes viewed as [rows, cols], with each operand's ag_bcast mode (full / row / column / scalar).
+struct BinaryBroadcast { std::vector<int64_t> out; int64_t rows = 1, cols = 1; int a = AG_BCAST_FULL, b = AG_BCAST_FULL; };
+bool plan_binary_broadcast(const std::vector<int64_t>& a, const std::vector<int64_t>& b, BinaryBroadcast& plan); // false if the plugin kernels can't express it
+// ABI v2 plumbing: a descriptor viewing t in place (broadcast to *as when given), and a kernel call with per-thread workspace.
+bool kernel_desc(const Tensor& t, ag_tensor_desc& d, const std::vector<int64_t>* as = nullptr);
+bool run_v2(const std::function<int64_t(ag_workspace)>& call); // false if the kernel declined the descriptors
 
 std::shared_ptr<Node> relu_nodeops(const std::shared_ptr<Node>& x);
 std::shared_ptr<Node> matmul_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b);
+Tensor gemm(const Tensor& a, const Tensor& b, bool trans_a = false, bool trans_b = false); // op(a) @ op(b), no transposed copies on CPU
+bool gemm_accumulate(const Tensor& a, const Tensor& b, bool trans_a, bool trans_b, Tensor& c); // c += op(a) @ op(b) in place; false if no kernel takes it
+Tensor reduce_axes(const Tensor& x, int op, std::vector<int64_t> axes = {}, bool keepdim = false); // ag_reduce_op over axes (empty: all elements)
 std::shared_ptr<Node> sum_nodeops(const std::shared_ptr<Node>& x);
 std::shared_ptr<Node> flomul_nodeops(const std::shared_ptr<Node>& a, float b);
 std::shared_ptr<Node> floadd_nodeops(float b, const std::shared_ptr<Node>& a);
@@ -74,7 +84,8 @@ std::shared_ptr<Node> reci_nodeops(const std::shared_ptr<Node>& a);
 // std::shared_ptr<Node> tan_nodeops(const std::shared_ptr<Node>& x);
 
 std::shared_ptr<Node> linear_nodeops(const  std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c); // fused multiply-add a@b + c
-std::shared_ptr<Node> moewe_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& w, const std::shared_ptr<Node>& b);
+std::shared_ptr<Node> linear_act_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& W, const std::shared_ptr<Node>& b, ag_activation act); // act(x @ W^T + b), activation fused into the GEMM epilogue
+std::shared_ptr<Node> moe_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& Wg, const std::shared_ptr<Node>& W1, const std::shared_ptr<Node>& b1, const std::shared_ptr<Node>& W2, const std::shared_ptr<Node>& b2, int k, float capacity_factor, ag_activation act); // top-k routed expert FFNs
 std::shared_ptr<Node> reluatt_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d);
 std::shared_ptr<Node> sigatt_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d);
 std::shared_ptr<Node> gelu_nodeops(const std::shared_ptr<Node>& x); // tanh approx
@@ -87,7 +98,8 @@ std::shared_ptr<Node> rms_nodeops(const std::shared_ptr<Node>& x); // root mean
 std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g); // with learned scale
 std::shared_ptr<Node> dyntanh_nodeops(const std::shared_ptr<Node>& x, float& a, float& b, float& g); // dynamic tanh via mean_all
 std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b, float& g); // with learned scale and bias
-std::shared_ptr<Node> mambassm_nodeops(const std::shared_ptr<Node>& z, const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d); // state space model
+constexpr int kMambaScanChunk = 64; // time steps per chunk of the parallel selective scan
+std::shared_ptr<Node> mambassm_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d); // selective scan: x,a [B,T,D], b,c [B,T,N], d [D]
 
 
 // rowwise reductions / softmax family
@@ -96,14 +108,32 @@ std::shared_ptr<Node> rowmax_nodeops(const std::shared_ptr<Node>& x); // [B,C] -
 std::shared_ptr<Node> mean_all_nodeops( const std::shared_ptr<Node>& x); // scalar
 std::shared_ptr<Node> softmax_row_nodeops( const std::shared_ptr<Node>& z); // [B,C] -> [B,C]
 std::shared_ptr<Node> logsumexp_row_nodeops(const std::shared_ptr<Node>& z); // [B,C] -> [B,1]
+constexpr float kNormEps = 1e-5f; // epsilon shared by the layernorm / rmsnorm family
 std::shared_ptr<Node> laynor_nodeops(const std::shared_ptr<Node>& x);
+std::vector<float> alibi_slopes(int64_t heads); // per-head ALiBi slopes, 2^(-8/H), 2^(-16/H), ...
+Tensor rope_apply(const Tensor& x, const std::vector<int64_t>& positions, float base, bool inverse); // rotate x [..,H,D] by pos * base^(-2i/D)
+// dst[o, at + i, :] (+)= src[o, start + i, :] for o < outer, i < len; src is [outer, src_len, inner], dst [outer, dst_len, inner].
+void copy_blocks(const float* src, int64_t src_len, int64_t start, float* dst, int64_t dst_len, int64_t at,
+                 int64_t outer, int64_t len, int64_t inner, bool accumulate);
+std::shared_ptr<Node> reshape_nodeops(const std::shared_ptr<Node>& x, const std::vector<int64_t>& shape);
+std::shared_ptr<Node> narrow_nodeops(const std::shared_ptr<Node>& x, int64_t dim, int64_t start, int64_t length);
+std::shared_ptr<Node> expand_nodeops(const std::shared_ptr<Node>& x, const std::vector<int64_t>& shape);
+std::shared_ptr<Node> concat_nodeops(const std::vector<std::shared_ptr<Node>>& xs, int64_t dim);
+std::shared_ptr<Node> embedding_nodeops(const std::shared_ptr<Node>& indices, const std::shared_ptr<Node>& table, const std::vector<int64_t>& offsets, bool mean); // offsets empty: gather, else embedding bag
+std::shared_ptr<Node> rope_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& positions, float base);
 std::shared_ptr<Node> alibiatt_nodeops( const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d, float& m); // m = max seq len
 
 // composite loss (one-hot targets)
 std::shared_ptr<Node> cross_entropy_with_logits_nodeops(const std::shared_ptr<Node>& logits, const std::shared_ptr<Node>& onehot);
 std::shared_ptr<Node> kldivergence_nodeops(const std::shared_ptr<Node>& logits,const std::shared_ptr<Node>& onehot);
+// fused linear + cross-entropy over class-index targets; the vocabulary is streamed in chunks
+constexpr int kLinearCrossEntropyChunk = 256;
+std::shared_ptr<Node> linear_cross_entropy_nodeops(const std::shared_ptr<Node>& h, const std::shared_ptr<Node>& W, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& targets);
+Tensor onehot_from_indices(const std::vector<int64_t>& idx, int64_t classes, const Tensor& like);
 std::shared_ptr<Node> fmab_nodeops(const  std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c); // fused multiply-add a@b + c
 std::shared_ptr<Node> attention_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d);
+std::shared_ptr<Node> multihead_attention_nodeops(const std::shared_ptr<Node>& q, const std::shared_ptr<Node>& k, const std::shared_ptr<Node>& v, const ag_attn_mask& mask, bool alibi = false); // q [B,T,H,D], k,v [B,S,Hkv,D]
+std::shared_ptr<Node> varlen_attention_nodeops(const std::shared_ptr<Node>& q, const std::shared_ptr<Node>& k, const std::shared_ptr<Node>& v, const std::vector<int64_t>& cu_seqlens_q, const std::vector<int64_t>& cu_seqlens_k, const ag_attn_mask& mask, bool alibi = false); // q [Nq,H,D], k,v [Nk,Hkv,D] packed
 std::shared_ptr<Node> mse_loss_nodeops( const std::shared_ptr<Node>& pred, const std::shared_ptr<Node>& target);
 std::shared_ptr<Node> mae_loss_nodeops( const std::shared_ptr<Node>& pred, const std::shared_ptr<Node>& target);
 
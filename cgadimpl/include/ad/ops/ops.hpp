@@ -58,14 +58,22 @@ Value silu (const Value& x); // x * sigmoid(x)
 Value leaky_relu(const Value& x, float alpha=0.01f); // alpha via const input
 Value lisht(const Value& x);
 Value transpose(const Value& x);
+// Shape and layout. reshape (and transpose) are views of x; narrow, select, expand, concat and
+// split copy each element once, straight into an output of the final shape, and their VJPs add
+// gy into the matching region of the parent's grad in place. Negative dims count from the end.
+Value reshape(const Value& x, const std::vector<int64_t>& shape); // one entry may be -1
+Value narrow(const Value& x, int64_t dim, int64_t start, int64_t length);
+Value select(const Value& x, int64_t dim, int64_t index); // narrow to one entry and drop the dim
+Value expand(const Value& x, const std::vector<int64_t>& shape); // broadcast size-1 dims
+Value concat(const std::vector<Value>& xs, int64_t dim);
+std::vector<Value> split(const Value& x, int64_t dim, const std::vector<int64_t>& sizes); // e.g. fused QKV
 Value swiglu(const Value& x, const Value& a, const Value& b, const Value& c, const Value& d);
 Value rms(const Value& x); // root mean square normalization
 Value realrms(const Value& x, float g); // with learned scale
 Value dyntanh(const Value& x, float a, float b, float g); // dynamic tanh via mean_all
 Value relaynor(const Value& x, float b, float g); // with learned scale and bias
-Value mambassm(const Value& z, const Value& a, const Value& b, const Value& c, const Value& d); // state space model
+Value mambassm(const Value& x, const Value& a, const Value& b, const Value& c, const Value& d); // selective scan: x,a [B,T,D], b,c [B,T,N], d [D]
 Value sign (const Value& a, const Value& b);
-Value moewe(const Value& x, const Value& w, const Value& b);
 
 // rowwise reductions / softmax family
 Value rowsum (const Value& x); // [B,C] -> [B,1]
@@ -79,10 +87,58 @@ Value alibiatt(const Value& a, const Value& b, const Value& c, const Value& d, f
 // composite loss (one-hot targets)
 Value cross_entropy_with_logits(const Value& logits, const Value& onehot);
 Value kldivergence(const Value& logits, const Value& onehot);
+Value linear_cross_entropy(const Value& h, const Value& W, const Value& b, const Value& targets); // CE(linear(h, W, b), targets) without materializing logits
 Value fmab(const Value& a, const Value& b, const Value& c); // fused multiply-add a@b + c
+// Row lookup in table [V, D]: indices [..] (any dtype) -> [.., D]. The table's gradient is
+// row-sparse (Node::sparse_rows / sparse_grad), and SGD only updates the rows it names.
+Value embedding(const Value& indices, const Value& table);
+// Sum (or mean) of the rows of each bag, indices[offsets[b] .. offsets[b+1]) -> [B, D].
+Value embedding_bag(const Value& indices, const std::vector<int64_t>& offsets, const Value& table, bool mean = false);
 Value linear(const Value& a, const Value& b, const Value& c); // fused multiply-add a@b + c
 
+// Activations that linear_act can apply in the GEMM epilogue.
+enum class Activation : int {
+    None = AG_ACT_NONE,
+    ReLU = AG_ACT_RELU,
+    GELU = AG_ACT_GELU, // tanh approx, same as gelu()
+    SiLU = AG_ACT_SILU
+};
+Value linear_act(const Value& x, const Value& W, const Value& b, Activation act); // act(linear(x, W, b)) in one pass
+// Mixture of Experts FFN with top-k routing: x [..,D], Wg [E,D], W1 [E,H,D], b1 [E,H], W2 [E,D,H], b2 [E,D].
+// capacity_factor > 0 caps each expert at ceil(capacity_factor * tokens * k / E) assignments.
+Value moe(const Value& x, const Value& Wg, const Value& W1, const Value& b1, const Value& W2, const Value& b2,
+          int k = 2, float capacity_factor = 0.0f, Activation act = Activation::GELU);
+
 Value attention(const Value& a, const Value& b, const Value& c, const Value& d);
+// Which (query, key) pairs multihead_attention scores; the conditions combine and
+// tiles they mask out entirely are skipped. Queries are aligned to the last T keys.
+struct AttentionMask {
+    bool causal = false;
+    int window = 0;                    // > 0: each query sees only its `window` most recent keys
+    int block = 0;                     // tile size of `layout`
+    std::vector<unsigned char> layout; // block-sparse [ceil(T/block), ceil(S/block)], 0 = tile masked
+    bool alibi = false;                // add -slope_h * |i - j| to the scores, computed in the kernel
+};
+// Batched multi-head attention: q [B,T,H,D], k,v [B,S,Hkv,D]. Hkv < H shares each kv head
+// across H/Hkv query heads (GQA; Hkv == 1 is MQA).
+Value multihead_attention(const Value& q, const Value& k, const Value& v, bool causal = false);
+Value multihead_attention(const Value& q, const Value& k, const Value& v, const AttentionMask& mask);
+// Rotary positional embedding on x [.., H, D] ([T, D] is one head): the pairs (i, i + D/2) of
+// each head are rotated by pos * base^(-2i/D). positions holds one index per token, or one
+// per step shared across the batch.
+Value rope(const Value& x, const Value& positions, float base = 10000.0f);
+// Ragged batches: variable-length sequences packed back to back along the token axis,
+// with no padding. Sequence b owns rows [cu_seqlens[b], cu_seqlens[b+1]) of a [N, ...]
+// tensor. Row-wise ops (softmax_row, laynor, rms, the losses) take the packed tensor
+// as is, since they never mix tokens; attention takes the offsets.
+std::vector<int64_t> cu_seqlens(const std::vector<int64_t>& lengths); // {0, l0, l0+l1, ...}
+Tensor pack_sequences(const std::vector<Tensor>& seqs, std::vector<int64_t>* cu = nullptr); // concat along dim 0
+// multihead_attention within each packed sequence: q [Nq,H,D], k,v [Nk,Hkv,D]. Block-sparse
+// layouts are not supported here; causal, window and alibi apply per sequence.
+Value varlen_attention(const Value& q, const Value& k, const Value& v, const std::vector<int64_t>& cu_seqlens,
+                       const AttentionMask& mask = AttentionMask());
+Value varlen_attention(const Value& q, const Value& k, const Value& v, const std::vector<int64_t>& cu_seqlens_q,
+                       const std::vector<int64_t>& cu_seqlens_k, const AttentionMask& mask = AttentionMask());
 Value mse_loss(const Value& pred, const Value& target);
 Value mae_loss(const Value& pred, const Value& target);
 
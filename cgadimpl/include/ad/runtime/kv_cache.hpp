@@ -0,0 +1,73 @@
+// ===================================================
+// In file: cgadimpl/include/ad/runtime/kv_cache.hpp
+// ===================================================
+#pragma once
+
+#include "tensor.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace ag {
+
+/**
+ * @brief Paged key/value cache for incremental (autoregressive) decoding.
+ *
+ * Keys and values of all sequences live in one pool of fixed-size pages,
+ * [num_blocks, block_size, kv_heads, head_dim] each. A sequence holds a list
+ * of page ids, so sequences grow one page at a time, finished sequences hand
+ * their pages back, and the pool never fragments. Inference only: nothing
+ * here records autograd history.
+ */
+class PagedKVCache {
+public:
+    PagedKVCache(int64_t num_blocks, int64_t block_size, int64_t kv_heads, int64_t head_dim);
+
+    /// Starts an empty sequence and returns its id.
+    int add_sequence();
+    /// Returns the sequence's pages to the pool; the id may be reused.
+    void free_sequence(int seq);
+
+    /// Appends n tokens, k and v: [n, kv_heads, head_dim]. Throws when the pool is full.
+    void append(int seq, const Tensor& k, const Tensor& v);
+
+    /**
+     * @brief Attention of the last T cached tokens of each sequence over its cache.
+     * @param seqs  Sequence ids, one per batch row.
+     * @param q     Queries [B, T, H, head_dim] (or [T, H, head_dim] for one sequence);
+     *              H must be a multiple of kv_heads.
+     * @return      [same shape as q], on q's device.
+     */
+    Tensor attend(const std::vector<int>& seqs, const Tensor& q, bool causal = true, bool alibi = false) const;
+    Tensor attend(int seq, const Tensor& q, bool causal = true, bool alibi = false) const {
+        return attend(std::vector<int>{seq}, q, causal, alibi);
+    }
+
+    int64_t length(int seq) const;
+    int64_t free_blocks() const { return static_cast<int64_t>(free_.size()); }
+    int64_t block_size() const { return block_size_; }
+
+private:
+    struct Sequence {
+        std::vector<int> blocks;
+        int64_t len = 0;
+        bool live = false;
+    };
+    Sequence& sequence(int seq);
+    const Sequence& sequence(int seq) const;
+
+    int64_t block_size_, kv_heads_, head_dim_;
+    Tensor k_pool_, v_pool_;
+    std::vector<int> free_;
+    std::vector<Sequence> seqs_;
+};
+
+/**
+ * @brief One decoding step of single-head attention (as in ag::attention /
+ * ag::alibiatt) against a cache: only the new tokens x [n, d] are projected
+ * with Wk, Wv and appended, then their queries attend over the whole prefix.
+ * The cache must have been built with kv_heads = 1 and head_dim = Wk's columns.
+ */
+Tensor cached_attention(PagedKVCache& cache, int seq, const Tensor& x,
+                        const Tensor& Wq, const Tensor& Wk, const Tensor& Wv, bool alibi = false);
+
+} // namespace ag
@@ -29,6 +29,8 @@ class Linear : public Module {
 public:
     Linear(int in_features, int out_features, Device dev = Device::CPU);
     Value operator()(Value input) override;
+    // act(input @ W^T + b) as a single linear_act node
+    Value forward_act(Value input, Activation act);
 private:
     Value W, b;
 };
@@ -47,4 +49,14 @@ public:
     Value operator()(Value input) override;
 };
 
+class GELU : public Module {
+public:
+    Value operator()(Value input) override;
+};
+
+class SiLU : public Module {
+public:
+    Value operator()(Value input) override;
+};
+
 } // namespace ag::nn
\ No newline at end of file
@@ -5,6 +5,9 @@
 #pragma once
 #include "TensorLib.h"
 #include "device/DeviceCore.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace OwnTensor;
 
@@ -13,4 +16,27 @@ namespace ag {
     inline TensorOptions options(const Tensor& t) {
         return TensorOptions().with_dtype(t.dtype()).with_device(t.device()).with_req_grad(t.requires_grad());
     }
+
+    // True when t can be handed to the CPU plugin kernels as a raw float buffer.
+    inline bool is_cpu_f32(const Tensor& t) {
+        return t.is_cpu() && t.dtype() == Dtype::Float32;
+    }
+
+    // Contiguous host copy of a float32 tensor, for kernels that only exist on the CPU plugin.
+    inline Tensor host_f32(const Tensor& t, const char* what) {
+        if (t.dtype() != Dtype::Float32) throw std::runtime_error(std::string(what) + ": expected a float32 tensor");
+        return t.is_cpu() ? t.contiguous() : t.to_cpu();
+    }
+
+    // Reads an index tensor of any dtype (class targets, token ids, ...) into host int64.
+    inline std::vector<int64_t> read_indices(const Tensor& t) {
+        Tensor c = t.is_cpu() ? t.contiguous() : t.to_cpu();
+        std::vector<int64_t> out(c.numel());
+        dispatch_by_dtype(c.dtype(), [&](auto dummy){
+            using T = decltype(dummy);
+            const T* p = c.data<T>();
+            for (size_t i = 0; i < out.size(); ++i) out[i] = static_cast<int64_t>(p[i]);
+        });
+        return out;
+    }
 } // namespace ag       
\ No newline at end of file
@@ -2,6 +2,7 @@
 // FILE: cgadimpl/src/autodiff/autodiff_jvp_ops.cpp (GPU-Aware Version)
 // ====================================================================
 #include "ad/detail/autodiff_ops.hpp"
+#include "ad/ops/nodeops.hpp"
 #include <stdexcept> // Required for std::runtime_error
 #include "ad/runtime/runtime.hpp"
 
@@ -199,6 +200,42 @@ Tensor jvp_Linear(Node* n, const std::function<const Tensor&(Node*)>& t){
     
     return dA + dB + T(t, C);
 }
+
+// ===================================================================
+// jvp_LinearAct
+// ===================================================================
+Tensor jvp_LinearAct(Node* n, const std::function<const Tensor&(Node*)>& t){
+    Node* X = n->inputs[0].get();
+    Node* W = n->inputs[1].get();
+    Node* b = n->inputs[2].get();
+    const auto act = static_cast<ag_activation>(static_cast<int>(n->inputs[3]->value.data<float>()[0]));
+
+    // Tangent of the pre-activation z = x @ W^T + b
+    Tensor tz = OwnTensor::matmul(T(t, X), W->value.t()) + OwnTensor::matmul(X->value, T(t, W).t()) + T(t, b);
+
+    switch (act) {
+    case AG_ACT_RELU: {
+        const float epsilon = 1e-9f;
+        Tensor sign_output = n->value / (OwnTensor::abs(n->value, ag::current_stream()) + epsilon);
+        return tz * ((sign_output + OwnTensor::abs(sign_output, ag::current_stream())) * 0.5f);
+    }
+    case AG_ACT_GELU: {
+        const float c1 = 0.7978845608f, c2 = 0.044715f;
+        const Tensor& z = *n->tape[0];
+        Tensor z2 = z * z;
+        Tensor th_u = OwnTensor::tanh((z + z2 * z * c2) * c1);
+        Tensor du_dz = (1.0f + (z2 * (3.0f * c2))) * c1;
+        return tz * ((1.0f + th_u) * 0.5f + (z * (1.0f - (th_u * th_u)) * du_dz) * 0.5f);
+    }
+    case AG_ACT_SILU: {
+        const Tensor& z = *n->tape[0];
+        Tensor s = 1.0f / (1.0f + OwnTensor::exp(z * -1.0f));
+        return tz * (s + z * (s * (1.0f - s)));
+    }
+    default:
+        return tz;
+    }
+}
 Tensor jvp_Attention(Node* n, const std::function<const Tensor&(Node*)>& t){
     throw std::runtime_error("JVP for Attention not implemented yet!");
 }
@@ -333,6 +370,40 @@ Tensor jvp_MOE(Node* n, const std::function<const Tensor&(Node*)>& t){
     throw std::runtime_error("JVP for MOE not implemented yet!");
 }
 
+Tensor jvp_MultiHeadAttention(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for MultiHeadAttention not implemented yet!");
+}
+
+Tensor jvp_VarlenAttention(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for VarlenAttention not implemented yet!");
+}
+
+Tensor jvp_Reshape(Node* n, const std::function<const Tensor&(Node*)>& t){
+    return t(n->inputs[0].get()).reshape(n->value.shape());
+}
+
+Tensor jvp_Narrow(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for Narrow not implemented yet!");
+}
+
+Tensor jvp_Expand(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for Expand not implemented yet!");
+}
+
+Tensor jvp_Concat(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for Concat not implemented yet!");
+}
+
+Tensor jvp_Embedding(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for Embedding not implemented yet!");
+}
+
+Tensor jvp_RoPE(Node* n, const std::function<const Tensor&(Node*)>& t){
+    // The rotation is linear in x, so the tangent is rotated the same way.
+    const float base = n->inputs[2]->value.data<float>()[0];
+    return rope_apply(t(n->inputs[0].get()), read_indices(n->inputs[1]->value), base, /*inverse=*/false);
+}
+
 // ===================================================================
 // jvp_MSELoss
 // ===================================================================
@@ -475,15 +546,15 @@ Tensor jvp_RMSNorm(Node* n, const std::function<const Tensor&(Node*)>& t){
     Node* X_node = n->inputs[0].get();
     const Tensor& x = X_node->value;
 
-    const Tensor& rms = *n->tape[0];
-    const Tensor& y   = *n->tape[1];
+    const Tensor& rstd = *n->tape[0];   // 1/sqrt(mean(x^2) + eps)
+    const Tensor& y    = n->value;      // x * rstd
     
     // 'dot' is the row-wise sum of (tangent(x) * y)
     Tensor dot = OwnTensor::reduce_sum(T(t, X_node) * y, {-1}, true);
     
     const float N = static_cast<float>(x.shape().dims.back());
 
-    return (T(t, X_node) / rms) - (y * dot / (rms * N));
+    return rstd * (T(t, X_node) - y * (dot / N));
 }
 
 Tensor jvp_Dyntanh(Node* n, const std::function<const Tensor&(Node*)>& t){
@@ -600,6 +671,14 @@ Tensor jvp_KLDivergence(Node* n, const std::function<const Tensor&(Node*)>& t){
     throw std::runtime_error("JVP for KLDivergence not implemented yet!");
 }
 
+Tensor jvp_LinearCrossEntropy(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for LinearCrossEntropy not implemented yet!");
+}
+
+Tensor jvp_MambaSSM(Node* n, const std::function<const Tensor&(Node*)>& t){
+    throw std::runtime_error("JVP for MambaSSM not implemented yet!");
+}
+
 Tensor jvp_Leaf(Node*, const std::function<const Tensor&(Node*)>&){
     return Tensor(Shape{}, TensorOptions{}); // unused
 }
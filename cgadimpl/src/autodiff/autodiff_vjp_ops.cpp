@@ -1064,7 +1064,9 @@
 // ====================================================================
 
 #include "ad/detail/autodiff_ops.hpp"
+#include "ad/ops/nodeops.hpp"
 #include "ad/runtime/runtime.hpp"
+#include <algorithm>
 #include <cmath>
 #include <stdexcept> // Required for std::runtime_error
 
@@ -1094,44 +1096,142 @@ static Tensor reduce_for_broadcast(const Tensor& grad_in, const Tensor& target_v
 
     Tensor summed_grad = grad_in;
     if (!axes_to_sum.empty()) {
-        summed_grad = OwnTensor::reduce_sum(grad_in, axes_to_sum, true);
+        summed_grad = reduce_axes(grad_in, AG_REDUCE_SUM, axes_to_sum, true);
     }
     
     // Reshape to exactly match the target shape (e.g., from [1, 5] to [5]).
     return summed_grad.reshape(target_val.shape());
 }
 
+// Adds a gradient computed by a host-only plugin kernel, moving it to p's device.
+static void accumulate_host_grad(Node* p, const Tensor& g) {
+    if (!p->requires_grad()) return;
+    p->grad += p->value.is_cpu() ? g : g.to(p->value.device());
+}
+
+// Where a host backward kernel writes p's gradient. With an accumulating
+// kernel (acc) that is p->grad itself whenever it is a host float32 buffer of
+// p's shape, so no temporary or extra += pass is needed; otherwise the kernel
+// fills a host temporary (zeroed for acc) that finish() adds to p->grad.
+// data() is null when p needs no gradient.
+class GradSlot {
+public:
+    GradSlot(Node* p, bool acc) : p_(p) {
+        if (!p->requires_grad()) return;
+        if (acc && is_cpu_f32(p->grad) && p->grad.shape().dims == p->value.shape().dims) {
+            data_ = p->grad.data<float>();
+            return;
+        }
+        auto host = TensorOptions().with_dtype(Dtype::Float32);
+        tmp_ = acc ? Tensor::zeros(p->value.shape(), host) : Tensor(p->value.shape(), host);
+        data_ = tmp_.data<float>();
+        staged_ = true;
+    }
+    float* data() const { return data_; }
+    void finish() { if (staged_) accumulate_host_grad(p_, tmp_); }
+
+private:
+    Node* p_;
+    Tensor tmp_;
+    float* data_ = nullptr;
+    bool staged_ = false;
+};
+
+// p->grad += f'(saved) * gy with an accumulating elementwise kernel that
+// writes straight into p's gradient buffer. False leaves the caller on the
+// tensor path.
+static bool accumulate_elem_grad(Node* p, elem_bwd_fn fn, const Tensor& saved, const Tensor& gy) {
+    if (!fn || !is_cpu_f32(saved) || !is_cpu_f32(gy) || !is_cpu_f32(p->grad)) return false;
+    const auto& dims = p->grad.shape().dims;
+    if (saved.shape().dims != dims || gy.shape().dims != dims) return false;
+    Tensor sc = saved.contiguous(), gyc = gy.contiguous();
+    fn(sc.data<float>(), gyc.data<float>(), p->grad.data<float>(), gyc.numel());
+    return true;
+}
+
+// Appends a row-sparse gradient (host rows [R, D]) to p; repeated rows add up.
+static void accumulate_sparse_grad(Node* p, const std::vector<int>& rows, const Tensor& g) {
+    if (!p->requires_grad() || rows.empty()) return;
+    const int64_t R0 = static_cast<int64_t>(p->sparse_rows.size()), R = static_cast<int64_t>(rows.size());
+    const int64_t D = g.shape().dims[1];
+    Tensor merged(Shape{{R0 + R, D}}, TensorOptions().with_dtype(Dtype::Float32));
+    if (R0) std::copy_n(p->sparse_grad.data<float>(), R0 * D, merged.data<float>());
+    std::copy_n(g.data<float>(), R * D, merged.data<float>() + R0 * D);
+    p->sparse_rows.insert(p->sparse_rows.end(), rows.begin(), rows.end());
+    p->sparse_grad = merged;
+}
+
+// p->grad += alpha * reduce_for_broadcast(gy op M) in one kernel pass, where
+// M is null or a forward operand with broadcast mode m_bcast. Returns false
+// when the plugin can't take it, leaving the caller on the tensor-op path.
+static bool binary_grad_kernel(Node* p, const Tensor& gy, int op, const Tensor* M, int m_bcast,
+                               int p_bcast, const BinaryBroadcast& plan, float alpha) {
+    auto& K = ag::kernels::cpu();
+    if (!K.binary_reduce || !is_cpu_f32(gy) || !is_cpu_f32(p->grad) || (M && !is_cpu_f32(*M)) ||
+        gy.numel() != plan.rows * plan.cols) return false;
+    Tensor gyc = gy.contiguous();
+    Tensor mc = M ? M->contiguous() : gyc;
+    K.binary_reduce(op, gyc.data<float>(), M ? mc.data<float>() : nullptr, m_bcast, alpha,
+                    p->grad.data<float>(), p_bcast, plan.rows, plan.cols, 1);
+    return true;
+}
+
 // // ----- elementwise binary -----
 // // Correct: Accumulates gradient for both parents.
+// On cpu f32 the broadcast reduction is fused into the plugin's
+// binary_reduce, which sums gy (times the other operand) straight into grad.
 void vjp_Add(Node* n, const Tensor& gy){
     Node* A = n->inputs[0].get(); 
     Node* B = n->inputs[1].get();
-    if (A->requires_grad()) A->grad += reduce_for_broadcast(gy, A->value);
-    if (B->requires_grad()) B->grad += reduce_for_broadcast(gy, B->value);
+    BinaryBroadcast plan;
+    const bool fused = plan_binary_broadcast(A->value.shape().dims, B->value.shape().dims, plan);
+    if (A->requires_grad() && !(fused && binary_grad_kernel(A, gy, AG_BIN_MUL, nullptr, 0, plan.a, plan, 1.0f)))
+        A->grad += reduce_for_broadcast(gy, A->value);
+    if (B->requires_grad() && !(fused && binary_grad_kernel(B, gy, AG_BIN_MUL, nullptr, 0, plan.b, plan, 1.0f)))
+        B->grad += reduce_for_broadcast(gy, B->value);
 }
 
 void vjp_Sub(Node* n, const Tensor& gy){
     Node* A = n->inputs[0].get();
     Node* B = n->inputs[1].get();
-    if (A->requires_grad()) A->grad += reduce_for_broadcast(gy, A->value);
-    if (B->requires_grad()) B->grad += reduce_for_broadcast(gy * -1.0f, B->value);
+    BinaryBroadcast plan;
+    const bool fused = plan_binary_broadcast(A->value.shape().dims, B->value.shape().dims, plan);
+    if (A->requires_grad() && !(fused && binary_grad_kernel(A, gy, AG_BIN_MUL, nullptr, 0, plan.a, plan, 1.0f)))
+        A->grad += reduce_for_broadcast(gy, A->value);
+    if (B->requires_grad() && !(fused && binary_grad_kernel(B, gy, AG_BIN_MUL, nullptr, 0, plan.b, plan, -1.0f)))
+        B->grad += reduce_for_broadcast(gy * -1.0f, B->value);
 }
 
 void vjp_Mul(Node* n, const Tensor& gy){
     Node* A = n->inputs[0].get();
     Node* B = n->inputs[1].get();
-    if (A->requires_grad()) A->grad += reduce_for_broadcast(gy * B->value, A->value);
-    if (B->requires_grad()) B->grad += reduce_for_broadcast(gy * A->value, B->value);
+    BinaryBroadcast plan;
+    const bool fused = plan_binary_broadcast(A->value.shape().dims, B->value.shape().dims, plan);
+    if (A->requires_grad() && !(fused && binary_grad_kernel(A, gy, AG_BIN_MUL, &B->value, plan.b, plan.a, plan, 1.0f)))
+        A->grad += reduce_for_broadcast(gy * B->value, A->value);
+    if (B->requires_grad() && !(fused && binary_grad_kernel(B, gy, AG_BIN_MUL, &A->value, plan.a, plan.b, plan, 1.0f)))
+        B->grad += reduce_for_broadcast(gy * A->value, B->value);
 }
 void vjp_Div(Node* n, const Tensor& gy){
     Node* A = n->inputs[0].get();
     Node* B = n->inputs[1].get();
+    BinaryBroadcast plan;
+    const bool fused = plan_binary_broadcast(A->value.shape().dims, B->value.shape().dims, plan);
 
     // VJP for A: dL/dA = gy * (1/B)
-    if (A->requires_grad())  A->grad += reduce_for_broadcast(gy / B->value, A->value);
+    if (A->requires_grad() && !(fused && binary_grad_kernel(A, gy, AG_BIN_DIV, &B->value, plan.b, plan.a, plan, 1.0f)))
+        A->grad += reduce_for_broadcast(gy / B->value, A->value);
     
-    // VJP for B: dL/dB = gy * (-A / (B*B))
+    // VJP for B: dL/dB = gy * (-A / (B*B)) = -(gy * Y) / B with Y = A / B the output.
     if (B->requires_grad()) {
+        auto& K = ag::kernels::cpu();
+        if (fused && K.binary_bcast && is_cpu_f32(gy) && is_cpu_f32(n->value) && is_cpu_f32(B->grad) && is_cpu_f32(B->value)) {
+            Tensor gyc = gy.contiguous(), yc = n->value.contiguous();
+            Tensor gyy(yc.shape(), TensorOptions().with_dtype(Dtype::Float32));
+            K.binary_bcast(AG_BIN_MUL, gyc.data<float>(), AG_BCAST_FULL, yc.data<float>(), AG_BCAST_FULL,
+                           gyy.data<float>(), 1, yc.numel(), 0);
+            if (binary_grad_kernel(B, gyy, AG_BIN_DIV, &B->value, plan.b, plan.b, plan, -1.0f)) return;
+        }
         Tensor grad_B = gy * -1.0f * A->value / (B->value * B->value);
         B->grad += reduce_for_broadcast(grad_B, B->value);
     }
@@ -1151,10 +1251,10 @@ void vjp_FMA(Node* n, const Tensor& gy){
 
     // The OwnTensor operators handle device, stream, and broadcasting automatically.
     if (A->requires_grad()){
-        A->grad += OwnTensor::matmul(gy, Bt.t());
+        A->grad += gemm(gy, Bt, false, true);
     }
     if (B->requires_grad()){
-        B->grad += OwnTensor::matmul(At.t(), gy);
+        B->grad += gemm(At, gy, true, false);
     }
     if (C->requires_grad()) {
         C->grad += gy;
@@ -1162,6 +1262,61 @@ void vjp_FMA(Node* n, const Tensor& gy){
 }
 
 
+// ===================================================================
+// LayerNorm / RMSNorm family helper
+// ===================================================================
+// The forward ops keep only per-row statistics on the tape (mean for the
+// LayerNorm family, rstd = 1/sqrt(var + eps) for all). With xhat the
+// normalized input and g = gy * gamma:
+//   LayerNorm: dx = rstd * (g - mean(g) - xhat * mean(g * xhat))
+//   RMSNorm:   dx = rstd * (g - xhat * mean(g * xhat))
+// gamma is the scalar learned gain (1 for the plain ops). dx is added to
+// x->grad when x requires grad. Fills sum(gy * xhat) and sum(gy) for the gain
+// and bias gradients when asked.
+static void norm_backward(Node* x, const Tensor& gy, const Tensor* mean, const Tensor& rstd,
+                          float gamma, float* dgamma_sum, float* dbeta_sum) {
+    auto& K = ag::kernels::cpu();
+    const Tensor& X = x->value;
+    const int64_t cols = X.shape().dims.back();
+    const bool kernel = is_cpu_f32(X) && is_cpu_f32(gy) &&
+                        (mean ? K.layernorm_bwd != nullptr : K.rmsnorm_bwd != nullptr);
+    if (kernel) {
+        // dx goes straight into x->grad when the plugin has the accumulating variant.
+        const bool acc = mean ? K.layernorm_bwd_acc != nullptr : K.rmsnorm_bwd_acc != nullptr;
+        Tensor Xc = X.contiguous(), gyc = gy.contiguous();
+        GradSlot dx(x, acc);
+        std::vector<float> g(cols, gamma), dg(cols), db(cols);
+        const int64_t rows = X.numel() / cols;
+        if (mean) {
+            (acc ? K.layernorm_bwd_acc : K.layernorm_bwd)(
+                Xc.data<float>(), gyc.data<float>(), g.data(), mean->data<float>(), rstd.data<float>(), dx.data(),
+                dgamma_sum ? dg.data() : nullptr, dbeta_sum ? db.data() : nullptr, rows, cols);
+        } else {
+            (acc ? K.rmsnorm_bwd_acc : K.rmsnorm_bwd)(
+                Xc.data<float>(), gyc.data<float>(), g.data(), rstd.data<float>(), dx.data(),
+                dgamma_sum ? dg.data() : nullptr, rows, cols);
+        }
+        dx.finish();
+        if (dgamma_sum) { double a = 0.0; for (float v : dg) a += v; *dgamma_sum = static_cast<float>(a); }
+        if (dbeta_sum)  { double a = 0.0; for (float v : db) a += v; *dbeta_sum  = static_cast<float>(a); }
+        return;
+    }
+
+    Tensor xhat = mean ? (X - *mean) * rstd : X * rstd;
+    if (dgamma_sum) *dgamma_sum = reduce_axes(gy * xhat, AG_REDUCE_SUM).to_cpu().data<float>()[0];
+    if (dbeta_sum)  *dbeta_sum  = reduce_axes(gy, AG_REDUCE_SUM).to_cpu().data<float>()[0];
+    if (!x->requires_grad()) return;
+
+    Tensor g = gy * gamma;
+    Tensor mgx = reduce_axes(g * xhat, AG_REDUCE_MEAN, {-1}, true);
+    if (mean) x->grad += rstd * (g - reduce_axes(g, AG_REDUCE_MEAN, {-1}, true) - xhat * mgx);
+    else      x->grad += rstd * (g - xhat * mgx);
+}
+
+static void add_scalar_grad(Node* p, float v) {
+    p->grad += Tensor::full(p->value.shape(), TensorOptions().with_dtype(p->value.dtype()).with_device(p->value.device()), v);
+}
+
 // ===================================================================
 // vjp_LayerNorm
 // ===================================================================
@@ -1169,25 +1324,9 @@ void vjp_LayerNorm(Node* n, const Tensor& gy){
     Node* x = n->inputs[0].get();
     if (!x->requires_grad()) return;
 
-    // Get the number of features from the last dimension
-    const float N = static_cast<float>(x->value.shape().dims.back());
-    
-    const Tensor& variance = *n->tape[0];
-    const Tensor& mean = *n->tape[1];
-
-    Tensor std_dev = OwnTensor::sqrt(variance + 1e-5f, ag::current_stream()); // Use OwnTensor::sqrt
-    Tensor xmu = x->value - mean;
-
-    // Use reduce_sum for row-wise summation
-    Tensor grad_sum = OwnTensor::reduce_sum(gy, {-1}, true);
-    Tensor grad_dot_xmu = OwnTensor::reduce_sum(gy * xmu, {-1}, true);
-
-    Tensor term1 = gy * N;
-    Tensor term2 = term1 - grad_sum;
-    Tensor term3 = term2 - (xmu * (grad_dot_xmu / (variance + 1e-5f)));
-    Tensor dx = term3 / (std_dev * N);
-    
-    x->grad += dx;
+    const Tensor& mean = *n->tape[0];
+    const Tensor& rstd = *n->tape[1];
+    norm_backward(x, gy, &mean, rstd, 1.0f, nullptr, nullptr);
 }
 
 // ===================================================================
@@ -1197,17 +1336,8 @@ void vjp_RMSNorm(Node* n, const Tensor& gy){
     Node* x = n->inputs[0].get();
     if (!x->requires_grad()) return;
 
-    const Tensor& rms = *n->tape[0]; // rsqrt(variance + epsilon)
-    const Tensor& y_normalized = *n->tape[1]; // x * rsqrt(...)
-    
-    const float inv_N = 1.0f / static_cast<float>(x->value.shape().dims.back());
-
-    Tensor dot = OwnTensor::reduce_sum(gy * y_normalized, {-1}, true);
-    
-    // grad_x = rsqrt * (gy - y * dot)
-    Tensor grad_x = rms * (gy - y_normalized * dot);
-
-    x->grad += grad_x;
+    const Tensor& rstd = *n->tape[0]; // rsqrt(mean(x^2) + epsilon)
+    norm_backward(x, gy, nullptr, rstd, 1.0f, nullptr, nullptr);
 }
 
 // ===================================================================
@@ -1217,35 +1347,15 @@ void vjp_RealLayerNorm(Node* n, const Tensor& gy){
     Node* x = n->inputs[0].get();
     Node* g = n->inputs[1].get(); // Gain
     Node* b = n->inputs[2].get(); // Bias
-    
-    const float N = static_cast<float>(x->value.shape().dims.back());
 
-    const Tensor& variance = *n->tape[0];
-    const Tensor& mean = *n->tape[1];
-    const Tensor& x_normalized = *n->tape[2];
-    
-    Tensor std_dev = OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
-    Tensor xmu = x->value - mean;
+    const Tensor& mean = *n->tape[0];
+    const Tensor& rstd = *n->tape[1];
 
-    // VJP for the core normalization part (same as LayerNorm)
-    Tensor grad_sum = OwnTensor::reduce_sum(gy, {-1}, true);
-    Tensor grad_dot_xmu = OwnTensor::reduce_sum(gy * x_normalized, {-1}, true);
-
-    Tensor term1 = gy * N;
-    Tensor term2 = term1 - grad_sum;
-    Tensor term3 = term2 - (x_normalized * grad_dot_xmu);
-    Tensor dx_normalized = term3 / N;
-
-    // VJP for the affine transformation (scale and shift)
-    if (g->requires_grad()) {
-        g->grad += OwnTensor::reduce_sum(gy * x_normalized, {-1});
-    }
-    if (b->requires_grad()) {
-        b->grad += OwnTensor::reduce_sum(gy, {-1});
-    }
-    if (x->requires_grad()) {
-        x->grad += (g->value / std_dev) * dx_normalized;
-    }
+    float dgain = 0.0f, dbias = 0.0f;
+    norm_backward(x, gy, &mean, rstd, g->value.to_cpu().data<float>()[0],
+                  g->requires_grad() ? &dgain : nullptr, b->requires_grad() ? &dbias : nullptr);
+    if (g->requires_grad()) add_scalar_grad(g, dgain);
+    if (b->requires_grad()) add_scalar_grad(b, dbias);
 }
 
 // ----- Attention Mechanisms -----
@@ -1267,26 +1377,26 @@ void vjp_Attention(Node* n, const Tensor& gy){
     float scale = 1.0f / std::sqrt(static_cast<float>(k.shape().dims.back()));
 
     // All ops below will now use the stream-aware OwnTensor API
-    Tensor dL_ds = OwnTensor::matmul(gy, v.t());
-    Tensor dL_dv = OwnTensor::matmul(s.t(), gy);
+    Tensor dL_ds = gemm(gy, v, false, true);
+    Tensor dL_dv = gemm(s, gy, true, false);
     
     // VJP of softmax: s * (dL_ds - row_sum(s * dL_ds))
-    Tensor dot = OwnTensor::reduce_sum(s * dL_ds, {-1}, true);
+    Tensor dot = reduce_axes(s * dL_ds, AG_REDUCE_SUM, {-1}, true);
     Tensor dL_dg = s * (dL_ds - dot);
     
     // Propagate gradients back through the Q, K projections
     Tensor dL_dq = OwnTensor::matmul(dL_dg, k);
-    Tensor dL_dk = OwnTensor::matmul(dL_dg.t(), q);
+    Tensor dL_dk = gemm(dL_dg, q, true, false);
 
     // Propagate gradients to the weight matrices and the input A
     if (B->requires_grad()) {
-        B->grad += OwnTensor::matmul(A->value.t(), dL_dq) * scale;
+        B->grad += gemm(A->value, dL_dq, true, false) * scale;
     }
     if (C->requires_grad()) {
-        C->grad += OwnTensor::matmul(A->value.t(), dL_dk) * scale;
+        C->grad += gemm(A->value, dL_dk, true, false) * scale;
     }
     if (D->requires_grad()) {
-        D->grad += OwnTensor::matmul(A->value.t(), dL_dv);
+        D->grad += gemm(A->value, dL_dv, true, false);
     }
     if (A->requires_grad()) {
         Tensor dL_dA_q = OwnTensor::matmul(dL_dq, B->value);
@@ -1297,8 +1407,43 @@ void vjp_Attention(Node* n, const Tensor& gy){
 }
 
 void vjp_AlibiAttention(Node* n, const Tensor& gy){
-    // Assuming same VJP as Attention for now
-    vjp_Attention(n, gy);
+    Node* X  = n->inputs[0].get();
+    Node* Wq = n->inputs[1].get();
+    Node* Wk = n->inputs[2].get();
+    Node* Wv = n->inputs[3].get();
+    const Tensor& q = *n->tape[0];
+    const Tensor& k = *n->tape[1];
+    const Tensor& v = *n->tape[2];
+    const Tensor& lse = *n->tape[3];
+    const int64_t T = q.shape().dims[0], S = k.shape().dims[0], Dk = k.shape().dims.back();
+
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_bwd) {
+        throw std::runtime_error("alibiatt: backward needs mha_bwd from the CPU kernel plugin");
+    }
+    // Same fused kernel as the forward: scores and the bias are recomputed per tile.
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor oh = host_f32(n->value, "alibiatt"), gh = host_f32(gy, "alibiatt");
+    Tensor dq(q.shape(), host), dk(k.shape(), host), dv(v.shape(), host);
+    const std::vector<float> slope = alibi_slopes(1);
+    const ag_attn_mask mask{1, 0, 0, nullptr, slope.data()};
+    K.mha_bwd(q.data<float>(), k.data<float>(), v.data<float>(), oh.data<float>(), lse.data<float>(),
+              gh.data<float>(), dq.data<float>(), dk.data<float>(), dv.data<float>(),
+              1, (int)T, (int)S, 1, 1, (int)Dk, 1.0f / std::sqrt(static_cast<float>(Dk)), &mask);
+    if (!X->value.is_cpu()) {
+        dq = dq.to(X->value.device());
+        dk = dk.to(X->value.device());
+        dv = dv.to(X->value.device());
+    }
+
+    // q = X Wq, k = X Wk, v = X Wv
+    if (Wq->requires_grad()) Wq->grad += gemm(X->value, dq, true, false);
+    if (Wk->requires_grad()) Wk->grad += gemm(X->value, dk, true, false);
+    if (Wv->requires_grad()) Wv->grad += gemm(X->value, dv, true, false);
+    if (X->requires_grad()) {
+        X->grad += gemm(dq, Wq->value, false, true) + gemm(dk, Wk->value, false, true) +
+                   gemm(dv, Wv->value, false, true);
+    }
 }
 
 // ===================================================================
@@ -1311,9 +1456,31 @@ void vjp_SWIGLU(Node* n, const Tensor& gy){
     Node* C = n->inputs[3].get();
     Node* D = n->inputs[4].get();
 
+    auto& K = ag::kernels::cpu();
+    if (K.swiglu_bwd && n->tape.size() == 2 && is_cpu_f32(gy)) {
+        // Forward ran fused and taped the gate / up pre-activations: both gate
+        // derivatives come out of one pass and share one GEMM each for dX and dW.
+        const Tensor& Xv = X->value;
+        Tensor Xc = Xv.contiguous(), Ac = A->value.contiguous(), Cc = C->value.contiguous();
+        Tensor Gc = n->tape[0]->contiguous(), Uc = n->tape[1]->contiguous(), gyc = gy.contiguous();
+        const bool acc = K.swiglu_bwd_acc != nullptr;
+        GradSlot dX(X, acc), dA(A, acc), dB(B, acc), dC(C, acc), dD(D, acc);
+        (acc ? K.swiglu_bwd_acc : K.swiglu_bwd)(Xc.data<float>(), Ac.data<float>(), Cc.data<float>(),
+                                                Gc.data<float>(), Uc.data<float>(), gyc.data<float>(),
+                                                dX.data(), dA.data(), dB.data(), dC.data(), dD.data(),
+                                                (int)Xv.shape().dims[0], (int)Xv.shape().dims[1],
+                                                (int)A->value.shape().dims[0]);
+        dX.finish();
+        dA.finish();
+        dB.finish();
+        dC.finish();
+        dD.finish();
+        return;
+    }
+
     // Recompute intermediates using OwnTensor API
-    Tensor y = OwnTensor::matmul(X->value, A->value.t()) + B->value;
-    Tensor h = OwnTensor::matmul(X->value, C->value.t()) + D->value;
+    Tensor y = gemm(X->value, A->value, false, true) + B->value;
+    Tensor h = gemm(X->value, C->value, false, true) + D->value;
 
     // --- Re-implement sigmoid and its derivative using OwnTensor ops ---
     Tensor sig_y = 1.0f / (1.0f + OwnTensor::exp(y * -1.0f));
@@ -1326,10 +1493,10 @@ void vjp_SWIGLU(Node* n, const Tensor& gy){
     Tensor dL_dy = h * swish_grad * gy;
 
     if (D->requires_grad()) D->grad += dL_dh;
-    if (C->requires_grad()) C->grad += OwnTensor::matmul(dL_dh.t(), X->value);
+    if (C->requires_grad()) C->grad += gemm(dL_dh, X->value, true, false);
     
     if (B->requires_grad()) B->grad += dL_dy;
-    if (A->requires_grad()) A->grad += OwnTensor::matmul(dL_dy.t(), X->value);
+    if (A->requires_grad()) A->grad += gemm(dL_dy, X->value, true, false);
     
     if (X->requires_grad()) {
         X->grad += OwnTensor::matmul(dL_dh, C->value) + OwnTensor::matmul(dL_dy, A->value);
@@ -1342,6 +1509,19 @@ void vjp_Relu(Node* n, const Tensor& gy){
     Node* X = n->inputs[0].get();
      if (!X->requires_grad()) return;
 
+    // Forward taped the packed x > 0 bitmask: expand it in the kernel rather
+    // than touching X or the output.
+    auto& K = ag::kernels::cpu();
+    if (K.relu_bwd_mask && n->tape.size() == 1 && is_cpu_f32(gy)) {
+        Tensor gyc = gy.contiguous();
+        const bool acc = K.relu_bwd_mask_acc != nullptr;
+        GradSlot dX(X, acc);
+        (acc ? K.relu_bwd_mask_acc : K.relu_bwd_mask)(reinterpret_cast<const unsigned char*>(n->tape[0]->data<float>()),
+                                                      gyc.data<float>(), dX.data(), gyc.numel());
+        dX.finish();
+        return;
+    }
+
     // --- DEFINITIVE FIX for ReLU VJP ---
     // The output of the forward pass is n->value, which is relu(X->value).
     // Where n->value is > 0, the original input was > 0.
@@ -1368,6 +1548,7 @@ void vjp_Exp(Node* n, const Tensor& gy){
     if (!X->requires_grad()) return;
 
     // The VJP for exp(x) is gy * exp(x). The forward pass output is exp(x).
+    if (accumulate_elem_grad(X, ag::kernels::cpu().exp_bwd_from_y_acc, n->value, gy)) return;
     // This uses the stream-aware OwnTensor operator '*' for both CPU and GPU.
     X->grad += gy * n->value;
 }
@@ -1381,6 +1562,7 @@ void vjp_Log(Node* n, const Tensor& gy){
     if (!X->requires_grad()) return;
 
     // The VJP for log(x) is gy / x.
+    if (accumulate_elem_grad(X, ag::kernels::cpu().log_bwd_acc, X->value, gy)) return;
     // This uses the stream-aware OwnTensor operator '/' for both CPU and GPU.
     X->grad += gy / X->value;
 }
@@ -1431,6 +1613,7 @@ void vjp_Tanh(Node* n, const Tensor& gy){
     // VJP is gy * (1 - tanh(x)^2)
     // Here, t = n->value is the result of the forward tanh(x)
     const Tensor& t = n->value;
+    if (accumulate_elem_grad(X, ag::kernels::cpu().tanh_bwd_from_t_acc, t, gy)) return;
     X->grad += gy * (1.0f - (t * t));
 }
 
@@ -1444,6 +1627,7 @@ void vjp_Sigmoid(Node* n, const Tensor& gy){
     // VJP is gy * (sigmoid(x) * (1 - sigmoid(x)))
     // Here, s = n->value is the result of the forward sigmoid(x)
     const Tensor& s = n->value;
+    if (accumulate_elem_grad(X, ag::kernels::cpu().sigmoid_bwd_from_s_acc, s, gy)) return;
     X->grad += gy * (s * (1.0f - s));
 }
 
@@ -1456,6 +1640,7 @@ void vjp_Softplus(Node* n, const Tensor& gy){
     if (!X->requires_grad()) return;
 
     // VJP is gy * sigmoid(x)
+    if (accumulate_elem_grad(X, ag::kernels::cpu().softplus_bwd_acc, X->value, gy)) return;
     // sigmoid(x) = 1 / (1 + exp(-x))
     Tensor d_softplus = 1.0f / (1.0f + OwnTensor::exp(X->value * -1.0f));
     
@@ -1486,6 +1671,65 @@ void vjp_Transpose(Node* n, const Tensor& gy){
     X->grad += gy.t();
 }
 
+// ===================================================================
+// Shape / layout VJPs
+// ===================================================================
+// Adds gy [outer, len, inner] into rows [at, at + len) of p's grad, viewed as
+// [outer, p_len, inner]. A host grad is updated in place, so no zero-filled
+// parent-sized temporary is built; other devices go through one host scatter.
+static void accumulate_grad_region(Node* p, const Tensor& gy, int64_t gy_len, int64_t gy_start,
+                                   int64_t p_len, int64_t at, int64_t outer, int64_t len, int64_t inner) {
+    if (!p->requires_grad()) return;
+    Tensor gh = host_f32(gy, "narrow/concat");
+    if (is_cpu_f32(p->grad)) {
+        copy_blocks(gh.data<float>(), gy_len, gy_start, p->grad.data<float>(), p_len, at, outer, len, inner, true);
+        return;
+    }
+    Tensor full = Tensor::zeros(p->value.shape(), TensorOptions().with_dtype(Dtype::Float32));
+    copy_blocks(gh.data<float>(), gy_len, gy_start, full.data<float>(), p_len, at, outer, len, inner, false);
+    accumulate_host_grad(p, full);
+}
+
+void vjp_Reshape(Node* n, const Tensor& gy){
+    Node* X = n->inputs[0].get();
+    if (!X->requires_grad()) return;
+    X->grad += gy.reshape(X->value.shape());
+}
+
+void vjp_Narrow(Node* n, const Tensor& gy){
+    Node* X = n->inputs[0].get();
+    const float* c = n->inputs[1]->value.data<float>();
+    const int64_t dim = static_cast<int64_t>(c[0]), start = static_cast<int64_t>(c[1]), len = static_cast<int64_t>(c[2]);
+    const auto& xs = X->value.shape().dims;
+    int64_t outer = 1, inner = 1;
+    for (int64_t i = 0; i < dim; ++i) outer *= xs[i];
+    for (size_t i = dim + 1; i < xs.size(); ++i) inner *= xs[i];
+    accumulate_grad_region(X, gy, len, 0, xs[dim], start, outer, len, inner);
+}
+
+void vjp_Expand(Node* n, const Tensor& gy){
+    Node* X = n->inputs[0].get();
+    if (!X->requires_grad()) return;
+    X->grad += reduce_for_broadcast(gy, X->value);
+}
+
+void vjp_Concat(Node* n, const Tensor& gy){
+    const size_t k = n->inputs.size() - 1;
+    const int64_t dim = static_cast<int64_t>(n->inputs[k]->value.data<float>()[0]);
+    const auto& ys = n->value.shape().dims;
+    int64_t outer = 1, inner = 1;
+    for (int64_t i = 0; i < dim; ++i) outer *= ys[i];
+    for (size_t i = dim + 1; i < ys.size(); ++i) inner *= ys[i];
+    // Each input takes its own slice of gy, added straight into its grad.
+    int64_t at = 0;
+    for (size_t i = 0; i < k; ++i) {
+        Node* X = n->inputs[i].get();
+        const int64_t len = X->value.shape().dims[dim];
+        accumulate_grad_region(X, gy, ys[dim], at, len, 0, outer, len, inner);
+        at += len;
+    }
+}
+
 // ===================================================================
 // vjp_SiLU
 // ===================================================================
@@ -1562,13 +1806,26 @@ void vjp_GELU(Node* n, const Tensor& gy){
 void vjp_LeakyRelu(Node* n, const Tensor& gy){
     Node* X_node = n->inputs[0].get();
     if (!X_node->requires_grad()) return;
-    const Tensor& x = X_node->value;
     
     // Get alpha from the second input node
     Node* A_node = n->inputs[1].get();
     // Use .data<T>()[0] to get the scalar value from the 1x1 tensor
     float alpha = A_node->value.data<float>()[0]; 
 
+    // Bitmask path, as in vjp_Relu.
+    auto& K = ag::kernels::cpu();
+    if (K.leakyrelu_bwd_mask && n->tape.size() == 1 && is_cpu_f32(gy)) {
+        Tensor gyc = gy.contiguous();
+        const bool acc = K.leakyrelu_bwd_mask_acc != nullptr;
+        GradSlot dX(X_node, acc);
+        (acc ? K.leakyrelu_bwd_mask_acc : K.leakyrelu_bwd_mask)(
+            reinterpret_cast<const unsigned char*>(n->tape[0]->data<float>()),
+            gyc.data<float>(), dX.data(), gyc.numel(), alpha);
+        dX.finish();
+        return;
+    }
+    const Tensor& x = X_node->value;
+
     // --- Create the Leaky ReLU derivative mask using pure arithmetic ---
     // The mask should be 1 where x > 0 and alpha where x <= 0.
     
@@ -1596,14 +1853,15 @@ void vjp_MatMul(Node* n, const Tensor& gy){
     const Tensor& A = A_node->value;
     const Tensor& B = B_node->value;
 
+    // Both products accumulate into the grad buffers in place when a kernel takes them.
     // VJP for A: dL/dA = dL/dY @ B^T
-    if (A_node->requires_grad()) {
-        A_node->grad += OwnTensor::matmul(gy, B.t());
+    if (A_node->requires_grad() && !gemm_accumulate(gy, B, false, true, A_node->grad)) {
+        A_node->grad += gemm(gy, B, false, true);
     }
 
     // VJP for B: dL/dB = A^T @ dL/dY
-    if (B_node->requires_grad()) {
-        B_node->grad += OwnTensor::matmul(A.t(), gy);
+    if (B_node->requires_grad() && !gemm_accumulate(A, gy, true, false, B_node->grad)) {
+        B_node->grad += gemm(A, gy, true, false);
     }
 }
 
@@ -1640,6 +1898,21 @@ void vjp_Dyntanh(Node* n, const Tensor& gy){
 }
 
 // ----- Reductions -----
+// The reduction VJPs broadcast gy back over the reduced axes. On a host grad
+// that is one in-place binary_bcast add (gy as a scalar or one value per row)
+// instead of materializing the broadcast gradient first.
+static bool accumulate_broadcast_grad(Node* p, const Tensor& gy, float scale) {
+    auto& K = ag::kernels::cpu();
+    BinaryBroadcast plan;
+    if (!K.binary_bcast || !is_cpu_f32(p->grad) || !is_cpu_f32(gy) ||
+        !plan_binary_broadcast(p->grad.shape().dims, gy.shape().dims, plan) ||
+        plan.a != AG_BCAST_FULL || plan.out != p->grad.shape().dims) return false;
+    Tensor g = scale == 1.0f ? gy.contiguous() : gy * scale;
+    float* dst = p->grad.data<float>();
+    K.binary_bcast(AG_BIN_ADD, dst, AG_BCAST_FULL, g.data<float>(), plan.b, dst, plan.rows, plan.cols, 0);
+    return true;
+}
+
 // ===================================================================
 // vjp_Sum
 // ===================================================================
@@ -1649,6 +1922,7 @@ void vjp_Sum(Node* n, const Tensor& gy){
 
     // `gy` is a 1x1 scalar tensor. The '+' operator will automatically
     // broadcast it to the shape of X->grad.
+    if (accumulate_broadcast_grad(X, gy, 1.0f)) return;
     X->grad += gy;
 }
 
@@ -1661,6 +1935,7 @@ void vjp_RowSum(Node* n, const Tensor& gy){
 
     // `gy` has shape [B, 1]. The '+' operator will automatically
     // broadcast it to the shape of X->grad, which is [B, C].
+    if (accumulate_broadcast_grad(X, gy, 1.0f)) return;
     X->grad += gy;
 }
 
@@ -1668,12 +1943,28 @@ void vjp_RowSum(Node* n, const Tensor& gy){
 // vjp_RowMax
 // ===================================================================
 void vjp_RowMax(Node* n, const Tensor& gy){
-    // To implement this, we need to know the *index* of the max element in each row.
-    // This requires an `argmax` function which is not available in OwnTensor.
-    // The VJP would look like:
-    //   Tensor indices = OwnTensor::argmax(X->value, /*axis=*/-1);
-    //   X->grad.scatter_add_(/*axis=*/-1, indices, gy);
-    throw std::runtime_error("VJP for RowMax cannot be implemented without argmax or comparison ops in the tensor library.");
+    Node* X = n->inputs[0].get();
+    if (!X->requires_grad()) return;
+
+    // Each row's gradient goes to the first column equal to the saved
+    // forward max (the argmax), found with a host scan of [B, C].
+    const auto& xd = X->value.shape().dims;
+    if (xd.size() != 2 || X->value.dtype() != Dtype::Float32) {
+        throw std::runtime_error("vjp_RowMax: expects a 2D float32 input");
+    }
+    const int64_t R = xd[0], C = xd[1];
+    Tensor xh = host_f32(X->value, "rowmax"), mh = host_f32(n->value, "rowmax"), gh = host_f32(gy, "rowmax");
+    Tensor dX = Tensor::zeros(X->value.shape(), TensorOptions().with_dtype(Dtype::Float32));
+    const float* x = xh.data<float>();
+    const float* m = mh.data<float>();
+    const float* g = gh.data<float>();
+    float* dx = dX.data<float>();
+    for (int64_t r = 0; r < R; ++r) {
+        for (int64_t c = 0; c < C; ++c) {
+            if (x[r * C + c] == m[r]) { dx[r * C + c] = g[r]; break; }
+        }
+    }
+    accumulate_host_grad(X, dX);
 }
 
 // ===================================================================
@@ -1689,6 +1980,7 @@ void vjp_MeanAll(Node* n, const Tensor& gy){
     
     // `gy` is a scalar. `gy * scale` is also a scalar.
     // The `+=` operator will broadcast this scalar across the entire gradient tensor.
+    if (accumulate_broadcast_grad(X, gy, scale)) return;
     X->grad += gy * scale;
 }
 
@@ -1704,7 +1996,7 @@ void vjp_SoftmaxRow(Node* n, const Tensor& gy){
 
     // Calculate the dot product along the rows.
     // This needs to be a sum, not a matmul.
-    Tensor dot = OwnTensor::reduce_sum(y * gy, {-1}, true);
+    Tensor dot = reduce_axes(y * gy, AG_REDUCE_SUM, {-1}, true);
 
     // The += operator will broadcast 'dot' correctly.
     Z->grad += y * (gy - dot);
@@ -1720,9 +2012,9 @@ void vjp_LogSumExpRow(Node* n, const Tensor& gy){
     // --- Re-implement softmax using OwnTensor ops ---
     // This is the derivative of logsumexp.
     const Tensor& z_val = Z->value;
-    Tensor max_val = OwnTensor::reduce_max(z_val, {-1}, true);
+    Tensor max_val = reduce_axes(z_val, AG_REDUCE_MAX, {-1}, true);
     Tensor exp_z = OwnTensor::exp(z_val - max_val);
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     Tensor softmax_z = exp_z / sum_exp_z;
     // ---
     
@@ -1743,10 +2035,10 @@ void vjp_CeWithLogits(Node* n, const Tensor& gy){
     const float inv_batch_size = 1.0f / static_cast<float>(Z.shape().dims[0]);
 
     // Re-calculate stable softmax and log_softmax
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     Tensor softmax_z = exp_z / sum_exp_z;
     Tensor log_softmax_z = z_shifted - OwnTensor::log(sum_exp_z);
     
@@ -1775,10 +2067,10 @@ void vjp_KLDivergence(Node* n, const Tensor& gy){
     const float inv_batch_size = 1.0f / static_cast<float>(Z.shape().dims[0]);
 
     // Re-calculate stable softmax and log_softmax
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     Tensor softmax_z = exp_z / sum_exp_z;
     Tensor log_softmax_z = z_shifted - OwnTensor::log(sum_exp_z);
 
@@ -1796,6 +2088,53 @@ void vjp_KLDivergence(Node* n, const Tensor& gy){
 }
 
 
+// ===================================================================
+// vjp_LinearCrossEntropy
+// ===================================================================
+void vjp_LinearCrossEntropy(Node* n, const Tensor& gy){
+    Node* H_node = n->inputs[0].get();
+    Node* W_node = n->inputs[1].get();
+    Node* b_node = n->inputs[2].get();
+    const Tensor& H = H_node->value;   // [N, D]
+    const Tensor& W = W_node->value;   // [V, D]
+    const Tensor& B = b_node->value;
+    const Tensor& lse = *n->tape[0];   // [N, 1]
+    const int64_t N = H.shape().dims[0];
+    const int64_t D = H.shape().dims[1];
+    const int64_t V = W.shape().dims[0];
+
+    std::vector<int64_t> t = read_indices(n->inputs[3]->value);
+    int64_t valid = 0;
+    for (int64_t ti : t) valid += (ti >= 0);
+    if (valid == 0) return;
+    const float scale = gy.to_cpu().data<float>()[0] / static_cast<float>(valid);
+
+    auto& K = ag::kernels::cpu();
+    if (K.linear_xent_bwd && is_cpu_f32(H) && is_cpu_f32(W) && is_cpu_f32(B)) {
+        // Recompute the logits chunk by chunk; dH, dW and db come out of the same pass.
+        Tensor Hc = H.contiguous(), Wc = W.contiguous(), Bc = B.contiguous();
+        const bool acc = K.linear_xent_bwd_acc != nullptr;
+        GradSlot dH(H_node, acc), dW(W_node, acc), db(b_node, acc);
+        (acc ? K.linear_xent_bwd_acc : K.linear_xent_bwd)(
+            Hc.data<float>(), Wc.data<float>(), Bc.data<float>(), t.data(), lse.data<float>(), scale,
+            dH.data(), dW.data(), db.data(), (int)N, (int)D, (int)V, kLinearCrossEntropyChunk);
+        dH.finish();
+        dW.finish();
+        db.finish();
+        return;
+    }
+
+    // Reference path: G = (softmax(Z) - onehot) * scale, rows with ignored targets zeroed.
+    Tensor Z = gemm(H, W, false, true) + B.reshape(Shape{{1, V}});
+    Tensor Y = onehot_from_indices(t, V, Z);
+    Tensor valid_rows = reduce_axes(Y, AG_REDUCE_SUM, {-1}, true);
+    Tensor G = (OwnTensor::exp(Z - lse) * valid_rows - Y) * scale;
+    if (H_node->requires_grad()) H_node->grad += OwnTensor::matmul(G, W);
+    if (W_node->requires_grad()) W_node->grad += gemm(G, H, true, false);
+    if (b_node->requires_grad()) b_node->grad += reduce_axes(G, AG_REDUCE_SUM, {0}, true).reshape(B.shape());
+}
+
+
 // ===================================================================
 // vjp_Linear
 // ===================================================================
@@ -1807,6 +2146,23 @@ void vjp_Linear(Node* n, const Tensor& gy){
     const Tensor& X = X_node->value;
     const Tensor& W = W_node->value;
 
+    // 2D host case: one kernel pass over dY produces dX, dW and db together.
+    auto& K = ag::kernels::cpu();
+    if (K.linear_bwd && is_cpu_f32(X) && is_cpu_f32(W) && is_cpu_f32(gy) &&
+        X.shape().dims.size() == 2 && W.shape().dims.size() == 2 && gy.shape().dims.size() == 2 &&
+        b_node->value.numel() == W.shape().dims[0]) {
+        Tensor Xc = X.contiguous(), Wc = W.contiguous(), gyc = gy.contiguous();
+        const bool acc = K.linear_bwd_acc != nullptr;
+        GradSlot dX(X_node, acc), dW(W_node, acc), db(b_node, acc);
+        (acc ? K.linear_bwd_acc : K.linear_bwd)(Xc.data<float>(), Wc.data<float>(), gyc.data<float>(),
+                                                dX.data(), dW.data(), db.data(),
+                                                (int)X.shape().dims[0], (int)X.shape().dims[1], (int)W.shape().dims[0]);
+        dX.finish();
+        dW.finish();
+        db.finish();
+        return;
+    }
+
     // VJP for input X: dX = dY @ W. Correct.
     // [B, Out] @ [Out, In] -> [B, In]
     if (X_node->requires_grad()) {
@@ -1816,7 +2172,7 @@ void vjp_Linear(Node* n, const Tensor& gy){
     // VJP for weight W: dW = dY.T @ X. Correct math for Y = X @ W.T + b
     // [Out, B] @ [B, In] -> [Out, In]
     if (W_node->requires_grad()) {
-        W_node->grad += OwnTensor::matmul(gy.t(), X);
+        W_node->grad += gemm(gy, X, true, false);
     }
 
     // VJP for bias b: sum(dY) over batch dimension, keeping rank. Correct.
@@ -1824,9 +2180,232 @@ void vjp_Linear(Node* n, const Tensor& gy){
     if (b_node->requires_grad()) {
         // Change keepdim from 'false' to 'true'.
         // This makes the result [1, Out] instead of [Out].
-        b_node->grad += OwnTensor::reduce_sum(gy, {0}, true);
+        b_node->grad += reduce_axes(gy, AG_REDUCE_SUM, {0}, true);
     }
 }
+// ===================================================================
+// vjp_LinearAct
+// ===================================================================
+void vjp_LinearAct(Node* n, const Tensor& gy){
+    Node* X_node = n->inputs[0].get();
+    Node* W_node = n->inputs[1].get();
+    Node* b_node = n->inputs[2].get();
+    const Tensor& X = X_node->value;   // [B, In]
+    const Tensor& W = W_node->value;   // [Out, In]
+    const Tensor& B = b_node->value;
+    const auto act = static_cast<ag_activation>(static_cast<int>(n->inputs[3]->value.data<float>()[0]));
+    // GELU / SiLU taped z; ReLU masks on the output.
+    const Tensor& S = n->tape.empty() ? n->value : *n->tape[0];
+
+    auto& K = ag::kernels::cpu();
+    if (K.linear_act_bwd && is_cpu_f32(X) && is_cpu_f32(W) && is_cpu_f32(gy)) {
+        // act' is applied once into dZ, which then feeds dX, dW and db.
+        Tensor Xc = X.contiguous(), Wc = W.contiguous(), Sc = S.contiguous(), gyc = gy.contiguous();
+        const bool acc = K.linear_act_bwd_acc != nullptr;
+        GradSlot dX(X_node, acc), dW(W_node, acc), db(b_node, acc);
+        (acc ? K.linear_act_bwd_acc : K.linear_act_bwd)(
+            Xc.data<float>(), Wc.data<float>(), Sc.data<float>(), gyc.data<float>(), dX.data(), dW.data(), db.data(),
+            (int)X.shape().dims[0], (int)X.shape().dims[1], (int)W.shape().dims[0], act);
+        dX.finish();
+        dW.finish();
+        db.finish();
+        return;
+    }
+
+    // Reference path: dZ = gy * act'(z), then the vjp_Linear formulas.
+    Tensor gz = gy;
+    switch (act) {
+    case AG_ACT_RELU: {
+        const float epsilon = 1e-9f;
+        Tensor sign_output = S / (OwnTensor::abs(S, ag::current_stream()) + epsilon);
+        gz = gy * ((sign_output + OwnTensor::abs(sign_output, ag::current_stream())) * 0.5f);
+        break;
+    }
+    case AG_ACT_GELU: {
+        const float c1 = 0.7978845608f, c2 = 0.044715f;
+        Tensor z2 = S * S;
+        Tensor th_u = OwnTensor::tanh((S + z2 * S * c2) * c1);
+        Tensor du_dz = (1.0f + (z2 * (3.0f * c2))) * c1;
+        gz = gy * ((1.0f + th_u) * 0.5f + (S * (1.0f - (th_u * th_u)) * du_dz) * 0.5f);
+        break;
+    }
+    case AG_ACT_SILU: {
+        Tensor s = 1.0f / (1.0f + OwnTensor::exp(S * -1.0f));
+        gz = gy * (s * (1.0f + S * (1.0f - s)));
+        break;
+    }
+    default:
+        break;
+    }
+    if (X_node->requires_grad()) X_node->grad += OwnTensor::matmul(gz, W);
+    if (W_node->requires_grad()) W_node->grad += gemm(gz, X, true, false);
+    if (b_node->requires_grad()) b_node->grad += reduce_axes(gz, AG_REDUCE_SUM, {0}, true).reshape(B.shape());
+}
+// ===================================================================
+// vjp_MambaSSM
+// ===================================================================
+void vjp_MambaSSM(Node* n, const Tensor& gy){
+    Node* X = n->inputs[0].get();
+    Node* A = n->inputs[1].get();
+    Node* B = n->inputs[2].get();
+    Node* C = n->inputs[3].get();
+    Node* Dn = n->inputs[4].get();
+    const auto& xs = X->value.shape().dims;
+    const int64_t Bt = xs.size() == 3 ? xs[0] : 1;
+    const int64_t T  = xs[xs.size() - 2];
+    const int64_t D  = xs.back();
+    const int64_t N  = B->value.shape().dims.back();
+    const Tensor& hb = *n->tape[0];   // [Bt, nchunks, D, N] on the host
+
+    auto& K = ag::kernels::cpu();
+    if (!K.ssm_scan_bwd) {
+        throw std::runtime_error("mambassm: backward scan needs ssm_scan_bwd from the CPU kernel plugin");
+    }
+    Tensor xh = host_f32(X->value, "mambassm"), ah = host_f32(A->value, "mambassm");
+    Tensor bh = host_f32(B->value, "mambassm"), ch = host_f32(C->value, "mambassm");
+    Tensor dh = host_f32(Dn->value, "mambassm"), gh = host_f32(gy, "mambassm");
+
+    const bool acc = K.ssm_scan_bwd_acc != nullptr;
+    GradSlot dx(X, acc), da(A, acc), db(B, acc), dc(C, acc), dd(Dn, acc);
+    (acc ? K.ssm_scan_bwd_acc : K.ssm_scan_bwd)(
+        xh.data<float>(), ah.data<float>(), bh.data<float>(), ch.data<float>(), dh.data<float>(),
+        hb.data<float>(), gh.data<float>(), dx.data(), da.data(), db.data(), dc.data(), dd.data(),
+        (int)Bt, (int)T, (int)D, (int)N, kMambaScanChunk);
+
+    dx.finish();
+    da.finish();
+    db.finish();
+    dc.finish();
+    dd.finish();
+}
+
+// ===================================================================
+// vjp_MultiHeadAttention
+// ===================================================================
+void vjp_MultiHeadAttention(Node* n, const Tensor& gy){
+    Node* Q = n->inputs[0].get();
+    Node* Kn = n->inputs[1].get();
+    Node* V = n->inputs[2].get();
+    const auto& qs = Q->value.shape().dims;
+    const auto& ks = Kn->value.shape().dims;
+    const size_t r = qs.size();
+    const int64_t B = r == 4 ? qs[0] : 1;
+    const int64_t T = qs[r - 3], H = qs[r - 2], D = qs[r - 1];
+    const int64_t S = ks[r - 3], Hkv = ks[r - 2];
+    const Tensor& lse = *n->tape[0];   // [B, H, T] on the host
+    // Rebuild the mask from the config constant {causal, window, block, alibi, layout...}.
+    const Tensor& cfg = n->inputs[3]->value;
+    const float* c = cfg.data<float>();
+    std::vector<unsigned char> layout(c + 4, c + cfg.numel());
+    const std::vector<float> slopes = c[3] != 0.0f ? alibi_slopes(H) : std::vector<float>();
+    const ag_attn_mask mask{static_cast<int>(c[0]), static_cast<int>(c[1]), static_cast<int>(c[2]),
+                            layout.empty() ? nullptr : layout.data(), slopes.empty() ? nullptr : slopes.data()};
+
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_bwd) {
+        throw std::runtime_error("multihead_attention: backward needs mha_bwd from the CPU kernel plugin");
+    }
+    Tensor qh = host_f32(Q->value, "multihead_attention"), kh = host_f32(Kn->value, "multihead_attention");
+    Tensor vh = host_f32(V->value, "multihead_attention"), oh = host_f32(n->value, "multihead_attention");
+    Tensor gh = host_f32(gy, "multihead_attention");
+
+    const bool acc = K.mha_bwd_acc != nullptr;
+    GradSlot dq(Q, acc), dk(Kn, acc), dv(V, acc);
+    (acc ? K.mha_bwd_acc : K.mha_bwd)(qh.data<float>(), kh.data<float>(), vh.data<float>(), oh.data<float>(),
+                                      lse.data<float>(), gh.data<float>(), dq.data(), dk.data(), dv.data(),
+                                      (int)B, (int)T, (int)S, (int)H, (int)Hkv, (int)D,
+                                      1.0f / std::sqrt(static_cast<float>(D)), &mask);
+
+    dq.finish();
+    dk.finish();
+    dv.finish();
+}
+
+// ===================================================================
+// vjp_VarlenAttention
+// ===================================================================
+void vjp_VarlenAttention(Node* n, const Tensor& gy){
+    Node* Q = n->inputs[0].get();
+    Node* Kn = n->inputs[1].get();
+    Node* V = n->inputs[2].get();
+    const auto& qs = Q->value.shape().dims;
+    const int64_t H = qs[1], D = qs[2];
+    const int64_t Hkv = Kn->value.shape().dims[1];
+    const Tensor& lse = *n->tape[0];   // [H, Nq] on the host
+    // Config constant: {causal, window, alibi, B, cu_q..., cu_k...}.
+    const float* c = n->inputs[3]->value.data<float>();
+    const int B = static_cast<int>(c[3]);
+    std::vector<int> cu_q(B + 1), cu_k(B + 1);
+    for (int b = 0; b <= B; ++b) {
+        cu_q[b] = static_cast<int>(c[4 + b]);
+        cu_k[b] = static_cast<int>(c[4 + B + 1 + b]);
+    }
+    const std::vector<float> slopes = c[2] != 0.0f ? alibi_slopes(H) : std::vector<float>();
+    const ag_attn_mask mask{static_cast<int>(c[0]), static_cast<int>(c[1]), 0, nullptr,
+                            slopes.empty() ? nullptr : slopes.data()};
+
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_varlen_bwd) {
+        throw std::runtime_error("varlen_attention: backward needs mha_varlen_bwd from the CPU kernel plugin");
+    }
+    Tensor qh = host_f32(Q->value, "varlen_attention"), kh = host_f32(Kn->value, "varlen_attention");
+    Tensor vh = host_f32(V->value, "varlen_attention"), oh = host_f32(n->value, "varlen_attention");
+    Tensor gh = host_f32(gy, "varlen_attention");
+
+    const bool acc = K.mha_varlen_bwd_acc != nullptr;
+    GradSlot dq(Q, acc), dk(Kn, acc), dv(V, acc);
+    (acc ? K.mha_varlen_bwd_acc : K.mha_varlen_bwd)(
+        qh.data<float>(), kh.data<float>(), vh.data<float>(), oh.data<float>(), lse.data<float>(),
+        gh.data<float>(), dq.data(), dk.data(), dv.data(),
+        cu_q.data(), cu_k.data(), B, (int)H, (int)Hkv, (int)D,
+        1.0f / std::sqrt(static_cast<float>(D)), &mask);
+
+    dq.finish();
+    dk.finish();
+    dv.finish();
+}
+
+// ===================================================================
+// vjp_Embedding
+// ===================================================================
+void vjp_Embedding(Node* n, const Tensor& gy){
+    Node* W = n->inputs[1].get();
+    if (!W->requires_grad()) return;
+    // Config constant: {mode (0 gather, 1 sum, 2 mean), B, offsets...}.
+    const float* c = n->inputs[2]->value.data<float>();
+    const int mode = static_cast<int>(c[0]), B = static_cast<int>(c[1]);
+    std::vector<int> off(mode ? B + 1 : 0);
+    for (size_t i = 0; i < off.size(); ++i) off[i] = static_cast<int>(c[2 + i]);
+    const std::vector<int64_t> ids = read_indices(n->inputs[0]->value);
+    const std::vector<int> idx(ids.begin(), ids.end());
+    const int N = static_cast<int>(idx.size());
+    const int64_t D = W->value.shape().dims[1];
+
+    auto& K = ag::kernels::cpu();
+    if (!K.embedding_bwd) {
+        throw std::runtime_error("embedding: backward needs embedding_bwd from the CPU kernel plugin");
+    }
+    // Only the distinct looked-up rows get a gradient; the dense [V, D] grad is untouched.
+    Tensor gh = host_f32(gy, "embedding");
+    std::vector<int> rows(N);
+    Tensor dW(Shape{{std::max(N, 1), D}}, TensorOptions().with_dtype(Dtype::Float32));
+    const int R = K.embedding_bwd(idx.data(), mode ? off.data() : nullptr, gh.data<float>(), rows.data(),
+                                  dW.data<float>(), N, B, (int)D, mode == 2 ? 1 : 0);
+    rows.resize(R);
+    accumulate_sparse_grad(W, rows, dW);
+}
+
+// ===================================================================
+// vjp_RoPE
+// ===================================================================
+void vjp_RoPE(Node* n, const Tensor& gy){
+    Node* X = n->inputs[0].get();
+    if (!X->requires_grad()) return;
+    // The rotation is orthogonal, so its VJP is the rotation by the opposite angle.
+    const float base = n->inputs[2]->value.data<float>()[0];
+    X->grad += rope_apply(gy, read_indices(n->inputs[1]->value), base, /*inverse=*/true);
+}
+
 // ===================================================================
 // vjp_Reciprocal
 // ===================================================================
@@ -1839,10 +2418,18 @@ void vjp_Reciprocal(Node* n, const Tensor& gy){
 }
 
 // ===================================================================
-// vjp_RealRMSNorm (Stub)
+// vjp_RealRMSNorm
 // ===================================================================
 void vjp_RealRMSNorm(Node* n, const Tensor& gy){
-    throw std::runtime_error("VJP for RealRMSNorm not implemented yet!");
+    Node* x = n->inputs[0].get();
+    Node* g = n->inputs[1].get(); // Gain
+
+    const Tensor& rstd = *n->tape[0];
+
+    float dgain = 0.0f;
+    norm_backward(x, gy, nullptr, rstd, g->value.to_cpu().data<float>()[0],
+                  g->requires_grad() ? &dgain : nullptr, nullptr);
+    if (g->requires_grad()) add_scalar_grad(g, dgain);
 }
 
 // ===================================================================
@@ -1978,8 +2565,8 @@ void vjp_RELUAtt(Node* n, const Tensor& gy){
     float scale = 1.0f / std::sqrt(static_cast<float>(k.shape().dims.back()));
 
     // VJP for the final matmul: y = s @ v
-    Tensor dL_ds = matmul(gy, v.t());
-    Tensor dL_dv = matmul(s.t(), gy);
+    Tensor dL_ds = gemm(gy, v, false, true);
+    Tensor dL_dv = gemm(s, gy, true, false);
     
     // VJP for the ReLU: s = relu(g). Gradient is dL/ds * (g > 0)
     // We get the original 'g' by inverting the relu on 's': where s is 0, g was <=0.
@@ -1991,12 +2578,12 @@ void vjp_RELUAtt(Node* n, const Tensor& gy){
     
     // VJP for the scaled matmul: g = (q @ k.T) * scale
     Tensor dL_dq = matmul(dL_dg, k) * scale;
-    Tensor dL_dk = matmul(dL_dg.t(), q) * scale;
+    Tensor dL_dk = gemm(dL_dg, q, true, false) * scale;
 
     // Propagate gradients to the weight matrices and the input A
-    if (B->requires_grad()) B->grad += matmul(A->value.t(), dL_dq);
-    if (C->requires_grad()) C->grad += matmul(A->value.t(), dL_dk);
-    if (D->requires_grad()) D->grad += matmul(A->value.t(), dL_dv);
+    if (B->requires_grad()) B->grad += gemm(A->value, dL_dq, true, false);
+    if (C->requires_grad()) C->grad += gemm(A->value, dL_dk, true, false);
+    if (D->requires_grad()) D->grad += gemm(A->value, dL_dv, true, false);
     if (A->requires_grad()) {
         A->grad += matmul(dL_dq, B->value) + 
                    matmul(dL_dk, C->value) + 
@@ -2008,22 +2595,47 @@ void vjp_RELUAtt(Node* n, const Tensor& gy){
 // vjp_MOE
 // ===================================================================
 void vjp_MOE(Node* n, const Tensor& gy){
-    Node* X = n->inputs[0].get();
-    Node* W = n->inputs[1].get();
-    Node* B = n->inputs[2].get();
-
-    // VJP for input X: dX = dY @ W.T
-    if (X->requires_grad()) {
-        X->grad += OwnTensor::matmul(gy, W->value.t());
-    }
-    // VJP for weight W: dW = X.T @ dY
-    if (W->requires_grad()) {
-        W->grad += OwnTensor::matmul(X->value.t(), gy);
-    }
-    // VJP for bias B: dB is the sum of gradients along the batch dimension
-    if (B->requires_grad()) {
-        B->grad += OwnTensor::reduce_sum(gy, {0}, false);
+    Node* X  = n->inputs[0].get();
+    Node* Wg = n->inputs[1].get();
+    Node* W1 = n->inputs[2].get();
+    Node* b1 = n->inputs[3].get();
+    Node* W2 = n->inputs[4].get();
+    Node* b2 = n->inputs[5].get();
+    const float* cfg = n->inputs[6]->value.data<float>();
+    const int k = static_cast<int>(cfg[0]);
+    const auto act = static_cast<ag_activation>(static_cast<int>(cfg[1]));
+    const Tensor& route = *n->tape[0];
+    const Tensor& gate  = *n->tape[1];
+    const Tensor& Z1    = *n->tape[2];
+    const int64_t D = X->value.shape().dims.back();
+    const int64_t T = X->value.numel() / D;
+    const int64_t E = W1->value.shape().dims[0];
+    const int64_t H = W1->value.shape().dims[1];
+
+    auto& K = ag::kernels::cpu();
+    if (!K.moe_bwd) {
+        throw std::runtime_error("moe: backward needs moe_bwd from the CPU kernel plugin");
     }
+    Tensor xh = host_f32(X->value, "moe"), wgh = host_f32(Wg->value, "moe");
+    Tensor w1h = host_f32(W1->value, "moe"), b1h = host_f32(b1->value, "moe");
+    Tensor w2h = host_f32(W2->value, "moe"), b2h = host_f32(b2->value, "moe");
+    Tensor gh = host_f32(gy, "moe");
+
+    const bool acc = K.moe_bwd_acc != nullptr;
+    GradSlot dX(X, acc), dWg(Wg, acc), dW1(W1, acc), db1(b1, acc), dW2(W2, acc), db2(b2, acc);
+    // Gradients flow through the same routing the forward recorded on the tape.
+    (acc ? K.moe_bwd_acc : K.moe_bwd)(xh.data<float>(), wgh.data<float>(), w1h.data<float>(), b1h.data<float>(),
+                                      w2h.data<float>(), b2h.data<float>(),
+                                      route.data<float>(), gate.data<float>(), Z1.data<float>(), gh.data<float>(),
+                                      dX.data(), dWg.data(), dW1.data(), db1.data(), dW2.data(), db2.data(),
+                                      (int)T, (int)D, (int)H, (int)E, k, act);
+
+    dX.finish();
+    dWg.finish();
+    dW1.finish();
+    db1.finish();
+    dW2.finish();
+    db2.finish();
 }
 // ===================================================================
 // vjp_SigAtt
@@ -2035,8 +2647,8 @@ void vjp_SigAtt(Node* n, const Tensor& gy){
     float scale = 1.0f / std::sqrt(static_cast<float>(k.shape().dims.back()));
 
     // VJP for the final matmul: y = s @ v
-    Tensor dL_ds = matmul(gy, v.t());
-    Tensor dL_dv = matmul(s.t(), gy);
+    Tensor dL_ds = gemm(gy, v, false, true);
+    Tensor dL_dv = gemm(s, gy, true, false);
     
     // VJP for the Sigmoid activation: s = sigmoid(g)
     // dL/dg = dL/ds * (s * (1 - s))
@@ -2044,12 +2656,12 @@ void vjp_SigAtt(Node* n, const Tensor& gy){
     
     // VJP for the scaled matmul: g = (q @ k.T) * scale
     Tensor dL_dq = matmul(dL_dg, k) * scale;
-    Tensor dL_dk = matmul(dL_dg.t(), q) * scale;
+    Tensor dL_dk = gemm(dL_dg, q, true, false) * scale;
 
     // Propagate gradients to the weight matrices and the input A
-    if (B->requires_grad()) B->grad += matmul(A->value.t(), dL_dq);
-    if (C->requires_grad()) C->grad += matmul(A->value.t(), dL_dk);
-    if (D->requires_grad()) D->grad += matmul(A->value.t(), dL_dv);
+    if (B->requires_grad()) B->grad += gemm(A->value, dL_dq, true, false);
+    if (C->requires_grad()) C->grad += gemm(A->value, dL_dk, true, false);
+    if (D->requires_grad()) D->grad += gemm(A->value, dL_dv, true, false);
     if (A->requires_grad()) {
         A->grad += matmul(dL_dq, B->value) + 
                    matmul(dL_dk, C->value) + 
@@ -25,7 +25,12 @@ namespace ag {
 
 void zero_grad(const Value& root){
     auto order = topo_from(root.node.get());
-    for (Node* n : order) if (n->requires_grad()) n->grad = Tensor::zeros(n->value.shape(), ag::options(n->value));
+    for (Node* n : order) {
+        if (!n->requires_grad()) continue;
+        n->grad = Tensor::zeros(n->value.shape(), ag::options(n->value));
+        n->sparse_rows.clear();
+        n->sparse_grad = Tensor();
+    }
 }
 
 void backward(const Value& root, const Tensor* grad_seed){
@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <string>
 #include <cstdlib>   // <<< add this for std::getenv
+#include <cstring>
 
 #if defined(_WIN32)
   #include <windows.h>
@@ -75,6 +76,85 @@ void load_cpu_plugin(const char* path) {
   g_cpu.linear_dX     = table.linear_dX;
   g_cpu.linear_db     = table.linear_db;
 
+  // v2 is optional; plugins built before it only export v1, and everything
+  // past the v1 layout stays null for them. An older v2 plugin reports a
+  // smaller struct_size, and only the fields inside it are taken.
+  ag_cpu_v2 table_v2{};
+  using getter_v2_t = int(*)(ag_cpu_v2*);
+  if (auto sym_v2 = (getter_v2_t)ag_dlsym(handle, "ag_get_cpu_kernels_v2")) {
+    table_v2.struct_size = sizeof(table_v2);
+    if (sym_v2(&table_v2) != 0 || table_v2.abi_version != AG_KERNELS_ABI_V2 ||
+        table_v2.struct_size > sizeof(table_v2)) {
+      table_v2 = ag_cpu_v2{};
+    } else {
+      std::memset(reinterpret_cast<char*>(&table_v2) + table_v2.struct_size, 0,
+                  sizeof(table_v2) - table_v2.struct_size);
+    }
+  }
+  g_cpu.unary_v2  = table_v2.unary;
+  g_cpu.binary_v2 = table_v2.binary;
+  g_cpu.gemm_v2   = table_v2.gemm;
+
+  g_cpu.linear_xent_fwd = table_v2.linear_xent_fwd;
+  g_cpu.linear_xent_bwd = table_v2.linear_xent_bwd;
+
+  g_cpu.layernorm_fwd = table_v2.layernorm_fwd;
+  g_cpu.layernorm_bwd = table_v2.layernorm_bwd;
+  g_cpu.rmsnorm_fwd   = table_v2.rmsnorm_fwd;
+  g_cpu.rmsnorm_bwd   = table_v2.rmsnorm_bwd;
+  g_cpu.linear_act_fwd = table_v2.linear_act_fwd;
+  g_cpu.linear_act_bwd = table_v2.linear_act_bwd;
+  g_cpu.ssm_scan_fwd   = table_v2.ssm_scan_fwd;
+  g_cpu.ssm_scan_bwd   = table_v2.ssm_scan_bwd;
+  g_cpu.moe_fwd        = table_v2.moe_fwd;
+  g_cpu.moe_bwd        = table_v2.moe_bwd;
+  g_cpu.mha_fwd        = table_v2.mha_fwd;
+  g_cpu.mha_bwd        = table_v2.mha_bwd;
+  g_cpu.paged_attn_fwd = table_v2.paged_attn_fwd;
+  g_cpu.swiglu_fwd     = table_v2.swiglu_fwd;
+  g_cpu.swiglu_bwd     = table_v2.swiglu_bwd;
+  g_cpu.mha_varlen_fwd = table_v2.mha_varlen_fwd;
+  g_cpu.mha_varlen_bwd = table_v2.mha_varlen_bwd;
+  g_cpu.rope           = table_v2.rope;
+  g_cpu.embedding_fwd  = table_v2.embedding_fwd;
+  g_cpu.embedding_bwd  = table_v2.embedding_bwd;
+  g_cpu.relu_fwd_mask      = table_v2.relu_fwd_mask;
+  g_cpu.leakyrelu_fwd_mask = table_v2.leakyrelu_fwd_mask;
+  g_cpu.relu_bwd_mask      = table_v2.relu_bwd_mask;
+  g_cpu.leakyrelu_bwd_mask = table_v2.leakyrelu_bwd_mask;
+  g_cpu.gemm               = table_v2.gemm_f32;
+  g_cpu.binary_bcast       = table_v2.binary_bcast;
+  g_cpu.binary_reduce      = table_v2.binary_reduce;
+  g_cpu.reduce             = table_v2.reduce;
+
+  g_cpu.relu_bwd_acc = table_v2.relu_bwd_acc;
+  g_cpu.leakyrelu_bwd_acc = table_v2.leakyrelu_bwd_acc;
+  g_cpu.sigmoid_bwd_from_s_acc = table_v2.sigmoid_bwd_from_s_acc;
+  g_cpu.tanh_bwd_from_t_acc = table_v2.tanh_bwd_from_t_acc;
+  g_cpu.gelu_bwd_acc = table_v2.gelu_bwd_acc;
+  g_cpu.softplus_bwd_acc = table_v2.softplus_bwd_acc;
+  g_cpu.exp_bwd_from_y_acc = table_v2.exp_bwd_from_y_acc;
+  g_cpu.log_bwd_acc = table_v2.log_bwd_acc;
+  g_cpu.sqrt_bwd_from_y_acc = table_v2.sqrt_bwd_from_y_acc;
+  g_cpu.relu_bwd_mask_acc = table_v2.relu_bwd_mask_acc;
+  g_cpu.leakyrelu_bwd_mask_acc = table_v2.leakyrelu_bwd_mask_acc;
+  g_cpu.matmul_bwd_dA_acc = table_v2.matmul_bwd_dA_acc;
+  g_cpu.matmul_bwd_dB_acc = table_v2.matmul_bwd_dB_acc;
+  g_cpu.linear_dW_acc = table_v2.linear_dW_acc;
+  g_cpu.linear_dX_acc = table_v2.linear_dX_acc;
+  g_cpu.linear_db_acc = table_v2.linear_db_acc;
+  g_cpu.gemm_acc = table_v2.gemm_f32_acc;
+  g_cpu.linear_xent_bwd_acc = table_v2.linear_xent_bwd_acc;
+  g_cpu.layernorm_bwd_acc = table_v2.layernorm_bwd_acc;
+  g_cpu.rmsnorm_bwd_acc = table_v2.rmsnorm_bwd_acc;
+  g_cpu.linear_act_bwd_acc = table_v2.linear_act_bwd_acc;
+  g_cpu.swiglu_bwd_acc = table_v2.swiglu_bwd_acc;
+  g_cpu.ssm_scan_bwd_acc = table_v2.ssm_scan_bwd_acc;
+  g_cpu.moe_bwd_acc = table_v2.moe_bwd_acc;
+  g_cpu.mha_bwd_acc = table_v2.mha_bwd_acc;
+  g_cpu.mha_varlen_bwd_acc = table_v2.mha_varlen_bwd_acc;
+  g_cpu.linear_bwd     = table_v2.linear_bwd;
+  g_cpu.linear_bwd_acc = table_v2.linear_bwd_acc;
 }
 
 void load_cuda_plugin(const char* path) {
@@ -37,6 +37,10 @@ Value Linear::operator()(Value input) {
     return linear(input, W, b);
 }
 
+Value Linear::forward_act(Value input, Activation act) {
+    return linear_act(input, W, b, act);
+}
+
 Sequential::Sequential(const std::vector<Module*>& modules) : layers_(modules) {
     for (auto* mod : layers_) {
         for(auto& p : mod->parameters()) {
@@ -45,9 +49,27 @@ Sequential::Sequential(const std::vector<Module*>& modules) : layers_(modules) {
     }
 }
 
+// Activation a Linear can absorb into its GEMM epilogue, or None.
+static Activation fusable_activation(Module* m) {
+    if (dynamic_cast<ReLU*>(m)) return Activation::ReLU;
+    if (dynamic_cast<GELU*>(m)) return Activation::GELU;
+    if (dynamic_cast<SiLU*>(m)) return Activation::SiLU;
+    return Activation::None;
+}
+
 Value Sequential::operator()(Value x) {
-    for (auto* layer : layers_) {
-        x = (*layer)(x);
+    for (size_t i = 0; i < layers_.size(); ++i) {
+        // Linear directly followed by an activation runs as one linear_act node.
+        auto* lin = dynamic_cast<Linear*>(layers_[i]);
+        if (lin && i + 1 < layers_.size()) {
+            Activation act = fusable_activation(layers_[i + 1]);
+            if (act != Activation::None) {
+                x = lin->forward_act(x, act);
+                ++i;
+                continue;
+            }
+        }
+        x = (*layers_[i])(x);
     }
     return x;
 }
@@ -56,4 +78,12 @@ Value ReLU::operator()(Value input) {
     return ag::relu(input);
 }
 
+Value GELU::operator()(Value input) {
+    return ag::gelu(input);
+}
+
+Value SiLU::operator()(Value input) {
+    return ag::silu(input);
+}
+
 } // namespace ag::nn
\ No newline at end of file
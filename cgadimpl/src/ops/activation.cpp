@@ -158,9 +158,9 @@ std::shared_ptr<Node> attention_nodeops(const std::shared_ptr<Node>& a, const st
     Tensor g = matmul(q, k.t()) * scale;
 
     // Re-implement softmax using OwnTensor ops
-    Tensor max_val = reduce_max(g, {-1}, true);
+    Tensor max_val = reduce_axes(g, AG_REDUCE_MAX, {-1}, true);
     Tensor exp_g = exp(g - max_val);
-    Tensor sum_exp_g = reduce_sum(exp_g, {-1}, true);
+    Tensor sum_exp_g = reduce_axes(exp_g, AG_REDUCE_SUM, {-1}, true);
     Tensor s = exp_g / sum_exp_g;
 
     Tensor y = matmul(s, v);
@@ -258,30 +258,6 @@ std::shared_ptr<Node> reluatt_nodeops(const std::shared_ptr<Node>& a,
 }
 
 // ... other functions in nodeops.cpp ...
-// ===================================================================
-// moewe_nodeops
-// ===================================================================
-
-std::shared_ptr<Node> moewe_nodeops(const std::shared_ptr<Node>& x, 
-                                    const std::shared_ptr<Node>& w, 
-                                    const std::shared_ptr<Node>& b) {
-    // --- Step 1: Linear transformation ---
-    Tensor logits = OwnTensor::matmul(x->value, w->value.t()) + b->value;
-
-    // --- Step 2: Softmax implemented in a single expression ---
-    // This avoids the scoping issue and the default constructor error.
-    Tensor max_val = OwnTensor::reduce_max(logits, {-1}, true);
-    Tensor exp_logits = OwnTensor::exp(logits - max_val);
-    Tensor sum_exp_logits = OwnTensor::reduce_sum(exp_logits, {-1}, true);
-    Tensor y = exp_logits / sum_exp_logits;
-
-    // --- Step 3: Create the graph node ---
-    auto n = std::make_shared<Node>(y, Op::MOE, (x->requires_grad() || w->requires_grad() || b->requires_grad()), "moe");
-    n->inputs = {x, w, b}; 
-    ag::debug::on_node_created(n);  
-    return n;
-}
-
 // ===================================================================
 // reci_nodeops
 // ===================================================================
@@ -565,9 +541,9 @@ std::shared_ptr<Node> alibiatt_nodeops(const std::shared_ptr<Node>& a, const std
     Tensor g = logits + bias_cpu.to(logits.device());
  
     // Step 4: Re-implement softmax and initialize 's' in a single expression
-    Tensor max_val = OwnTensor::reduce_max(g, {-1}, true);
+    Tensor max_val = reduce_axes(g, AG_REDUCE_MAX, {-1}, true);
     Tensor exp_g = OwnTensor::exp(g - max_val);
-    Tensor sum_exp_g = OwnTensor::reduce_sum(exp_g, {-1}, true);
+    Tensor sum_exp_g = reduce_axes(exp_g, AG_REDUCE_SUM, {-1}, true);
     Tensor s = exp_g / sum_exp_g;
 
     // Step 5: Final projection
@@ -605,7 +581,7 @@ std::shared_ptr<Node> swiglu_nodeops(const std::shared_ptr<Node>& x, const std::
 // ============================================================================
  
 std::shared_ptr<Node> sum_nodeops(const std::shared_ptr<Node>& x){
-    Tensor y = OwnTensor::reduce_sum(x->value, {}, false);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_SUM);
     auto n = std::make_shared<Node>(y, Op::Sum, x->requires_grad(), "sum");
     n->inputs = {x};
     ag::debug::on_node_created(n);
@@ -875,7 +851,7 @@ std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float a
 // ============================================================================================
     std::shared_ptr<Node> rowsum_nodeops(const std::shared_ptr<Node>& x){
     // Reduce over axis 1 (the columns), and keep the dimension so shape goes from [B,C] to [B,1].
-    Tensor y = OwnTensor::reduce_sum(x->value, {1}, true);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_SUM, {1}, true);
     auto n = std::make_shared<Node>(y, Op::RowSum, x->requires_grad(), "rowsum");
     n->inputs = {x};
     ag::debug::on_node_created(n);
@@ -887,7 +863,7 @@ std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float a
 // ===================================================================
 std::shared_ptr<Node> rowmax_nodeops(const std::shared_ptr<Node>& x){
     // Reduce over axis 1 (columns) and keep the dimension.
-    Tensor y = OwnTensor::reduce_max(x->value, {1}, true);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_MAX, {1}, true);
     auto n = std::make_shared<Node>(y, Op::RowMax, x->requires_grad(), "rowmax");
     n->inputs={x};
     ag::debug::on_node_created(n);
@@ -905,7 +881,7 @@ std::shared_ptr<Node> rms_nodeops(const std::shared_ptr<Node>& x){
     Tensor x_squared = x->value * x->value;
 
     // Calculate the mean along the last dimension.
-    Tensor variance = OwnTensor::reduce_mean(x_squared, {-1}, true);
+    Tensor variance = reduce_axes(x_squared, AG_REDUCE_MEAN, {-1}, true);
 
     // Calculate the reciprocal square root (rsqrt) with an epsilon for stability.
     Tensor rsqrt_var = 1.0f / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
@@ -933,7 +909,7 @@ std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g_v
     const float inv_cols = 1.0f / static_cast<float>(x->value.shape().dims.back());
     
     // Calculate mean of squares along the last dim
-    Tensor variance = OwnTensor::reduce_sum(x->value * x->value, {-1}, true) * inv_cols;
+    Tensor variance = reduce_axes(x->value * x->value, AG_REDUCE_SUM, {-1}, true) * inv_cols;
     Tensor rsqrt_var = 1.0f / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
     Tensor y_normalized = x->value * rsqrt_var;
     
@@ -964,11 +940,11 @@ std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g_v
 // ===================================================================
 std::shared_ptr<Node> laynor_nodeops(const std::shared_ptr<Node>& x){
     // 1. Calculate mean across the last dimension
-    Tensor mean = OwnTensor::reduce_mean(x->value, {-1}, true);
+    Tensor mean = reduce_axes(x->value, AG_REDUCE_MEAN, {-1}, true);
     
     // 2. Calculate variance across the last dimension
     Tensor x_minus_mean = x->value - mean;
-    Tensor variance = OwnTensor::reduce_mean(x_minus_mean * x_minus_mean, {-1}, true);
+    Tensor variance = reduce_axes(x_minus_mean * x_minus_mean, AG_REDUCE_MEAN, {-1}, true);
     
     // 3. Normalize
     Tensor y = x_minus_mean / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
@@ -986,9 +962,9 @@ std::shared_ptr<Node> laynor_nodeops(const std::shared_ptr<Node>& x){
 // ===================================================================
 std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b_val, float& g_val){
     // 1. Calculate mean and variance
-    Tensor mean = OwnTensor::reduce_mean(x->value, {-1}, true);
+    Tensor mean = reduce_axes(x->value, AG_REDUCE_MEAN, {-1}, true);
     Tensor x_minus_mean = x->value - mean;
-    Tensor variance = OwnTensor::reduce_mean(x_minus_mean * x_minus_mean, {-1}, true);
+    Tensor variance = reduce_axes(x_minus_mean * x_minus_mean, AG_REDUCE_MEAN, {-1}, true);
     
     // 2. Normalize
     Tensor y_normalized = x_minus_mean / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
@@ -1024,7 +1000,7 @@ std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b_
 // ===================================================================
 std::shared_ptr<Node> mean_all_nodeops(const std::shared_ptr<Node>& x){
     // reduce_mean with empty axes reduces over the entire tensor
-    Tensor y = OwnTensor::reduce_mean(x->value);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_MEAN);
     auto n = std::make_shared<Node>(y, Op::MeanAll, x->requires_grad(), "meanall");
     n->inputs={x};
     ag::debug::on_node_created(n);
@@ -1061,14 +1037,14 @@ std::shared_ptr<Node> dyntanh_nodeops(const std::shared_ptr<Node>& x, float& a_v
 std::shared_ptr<Node> softmax_row_nodeops(const std::shared_ptr<Node>& z){ 
     // 1. Find the max value along the rows (last dimension) for numerical stability.
     // The `true` for keepdim ensures the result has shape [B, 1] for broadcasting.
-    Tensor max_val = OwnTensor::reduce_max(z->value, {-1}, true);
+    Tensor max_val = reduce_axes(z->value, AG_REDUCE_MAX, {-1}, true);
     
     // 2. Subtract the max and exponentiate.
     Tensor z_shifted = z->value - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
     
     // 3. Sum the exponents along the rows.
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     
     // 4. Divide to get the final softmax probabilities.
     Tensor y = exp_z / sum_exp_z;
@@ -1084,14 +1060,14 @@ std::shared_ptr<Node> softmax_row_nodeops(const std::shared_ptr<Node>& z){
 // ===================================================================
 std::shared_ptr<Node> logsumexp_row_nodeops(const std::shared_ptr<Node>& z){ 
     // 1. Find the max value along the rows (last dimension).
-    Tensor max_val = OwnTensor::reduce_max(z->value, {-1}, true);
+    Tensor max_val = reduce_axes(z->value, AG_REDUCE_MAX, {-1}, true);
     
     // 2. Subtract the max and exponentiate.
     Tensor z_shifted = z->value - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
     
     // 3. Sum the exponents along the rows and take the log.
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     Tensor log_sum = OwnTensor::log(sum_exp_z);
     
     // 4. Add the max value back.
@@ -1170,16 +1146,16 @@ std::shared_ptr<Node> cross_entropy_with_logits_nodeops(const std::shared_ptr<No
     // 1. Calculate log(softmax(Z)) in a numerically stable way.
     //    logsoftmax(z) = z - log(sum(exp(z)))
     //    stable_logsoftmax(z) = z - (log(sum(exp(z - max(z)))) + max(z))
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
-    Tensor log_sum_exp = OwnTensor::log(OwnTensor::reduce_sum(OwnTensor::exp(z_shifted), {-1}, true));
+    Tensor log_sum_exp = OwnTensor::log(reduce_axes(OwnTensor::exp(z_shifted), AG_REDUCE_SUM, {-1}, true));
     Tensor log_sm = z_shifted - log_sum_exp;
 
     // 2. Calculate the cross-entropy loss: -mean(sum(Y * log_sm))
     // The sum is over the class dimension (-1), the mean is over the batch dimension (0).
     Tensor prod = Y * log_sm;
-    Tensor sum_prod = OwnTensor::reduce_sum(prod, {-1}); // Sum over classes, shape=[B]
-    Tensor loss = OwnTensor::reduce_mean(sum_prod * -1.0f); // Mean over batch and negate
+    Tensor sum_prod = reduce_axes(prod, AG_REDUCE_SUM, {-1}); // Sum over classes, shape=[B]
+    Tensor loss = reduce_axes(sum_prod * -1.0f, AG_REDUCE_MEAN); // Mean over batch and negate
 
     auto n = std::make_shared<Node>(loss, Op::CeWithLogits, (logits->requires_grad() || onehot->requires_grad()), "ce_with_logits");
     n->inputs = {logits, onehot};
@@ -1200,17 +1176,17 @@ std::shared_ptr<Node> kldivergence_nodeops(const std::shared_ptr<Node>& logits,
     Tensor log_Y = OwnTensor::log(Y + 1e-9f);
     
     // 2. Calculate stable log_softmax(Z) (same as in cross-entropy).
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
-    Tensor log_sum_exp = OwnTensor::log(OwnTensor::reduce_sum(OwnTensor::exp(z_shifted), {-1}, true));
+    Tensor log_sum_exp = OwnTensor::log(reduce_axes(OwnTensor::exp(z_shifted), AG_REDUCE_SUM, {-1}, true));
     Tensor log_sm_Z = z_shifted - log_sum_exp;
 
     // 3. Calculate the KL Divergence: sum(Y * (log(Y) - log_softmax(Z)))
     Tensor kl_div_elementwise = Y * (log_Y - log_sm_Z);
 
     // 4. Sum over the class dimension, then take the mean over the batch dimension.
-    Tensor sum_kl = OwnTensor::reduce_sum(kl_div_elementwise, {-1});
-    Tensor loss = OwnTensor::reduce_mean(sum_kl);
+    Tensor sum_kl = reduce_axes(kl_div_elementwise, AG_REDUCE_SUM, {-1});
+    Tensor loss = reduce_axes(sum_kl, AG_REDUCE_MEAN);
 
     auto n = std::make_shared<Node>(loss, Op::KLDivergence, (logits->requires_grad() || onehot->requires_grad()), "kldivergence");
     n->inputs = {logits, onehot};
@@ -1229,7 +1205,7 @@ std::shared_ptr<Node> mse_loss_nodeops(const std::shared_ptr<Node>& pred, const
     // --- THIS IS THE BUG ---
     // It should be reduce_mean, not reduce_sum. `reduce_mean` correctly
     // computes the VJP for the mean operation. `sum` has a different VJP.
-    Tensor loss = OwnTensor::reduce_mean(sq); 
+    Tensor loss = reduce_axes(sq, AG_REDUCE_MEAN); 
     // --- END BUG ---
 
     auto n = std::make_shared<Node>(loss, Op::MSELoss, (pred->requires_grad()), "mseloss");
@@ -1246,7 +1222,7 @@ std::shared_ptr<Node> mae_loss_nodeops(const std::shared_ptr<Node>& pred, const
     Tensor diff = pred->value - target->value;
     Tensor abs_diff = OwnTensor::abs(diff, ag::current_stream());
     // The mean of the absolute error
-    Tensor loss = OwnTensor::reduce_mean(abs_diff);
+    Tensor loss = reduce_axes(abs_diff, AG_REDUCE_MEAN);
 
     auto n = std::make_shared<Node>(loss, Op::MAELoss, (pred->requires_grad() || target->requires_grad()), "maeloss");
     n->inputs = {pred, target};
@@ -7,16 +7,133 @@
 #include <cuda_runtime.h>
 #include "TensorLib.h" 
 #include <unordered_map>
+#include <map>
+#include <algorithm>
 #include <cmath> 
+#include <functional>
 
 
 namespace ag {
 namespace detail {
 
 
+// Finds a split of the broadcast shape into [rows, cols] under which each
+// operand is full, a row vector, a column vector or a scalar, e.g. [B,T,D] +
+// [D] is rows = B*T with a row vector, [B,T,D] * [B,T,1] a column vector.
+bool plan_binary_broadcast(const std::vector<int64_t>& a, const std::vector<int64_t>& b, BinaryBroadcast& plan) {
+    const size_t nd = std::max(a.size(), b.size());
+    std::vector<int64_t> pa(nd, 1), pb(nd, 1);
+    std::copy(a.begin(), a.end(), pa.begin() + (nd - a.size()));
+    std::copy(b.begin(), b.end(), pb.begin() + (nd - b.size()));
+    plan.out.assign(nd, 1);
+    for (size_t i = 0; i < nd; ++i) {
+        if (pa[i] != pb[i] && pa[i] != 1 && pb[i] != 1) return false;
+        plan.out[i] = pa[i] == 1 ? pb[i] : pa[i];
+    }
+    auto mode_at = [&](const std::vector<int64_t>& s, size_t k) {
+        bool full = true, one = true, row = true, col = true;
+        for (size_t i = 0; i < nd; ++i) {
+            full &= s[i] == plan.out[i];
+            one &= s[i] == 1;
+            row &= i < k ? s[i] == 1 : s[i] == plan.out[i];
+            col &= i < k ? s[i] == plan.out[i] : s[i] == 1;
+        }
+        return full ? AG_BCAST_FULL : one ? AG_BCAST_SCALAR : row ? AG_BCAST_ROW : col ? AG_BCAST_COL : -1;
+    };
+    for (size_t k = 0; k <= nd; ++k) {
+        const int ma = mode_at(pa, k), mb = mode_at(pb, k);
+        if (ma < 0 || mb < 0) continue;
+        plan.a = ma;
+        plan.b = mb;
+        plan.rows = plan.cols = 1;
+        for (size_t i = 0; i < nd; ++i) (i < k ? plan.rows : plan.cols) *= plan.out[i];
+        return true;
+    }
+    return false;
+}
+
+// v2 descriptor of t as stored, so views reach the kernel without a copy.
+// With `as`, t is broadcast (right-aligned) to that shape through stride-0
+// dims. False off the CPU, for dtypes the descriptors lack, or when t does
+// not broadcast to `as`.
+bool kernel_desc(const Tensor& t, ag_tensor_desc& d, const std::vector<int64_t>* as) {
+    if (!t.is_cpu()) return false;
+    switch (t.dtype()) {
+        case Dtype::Float32:  d.dtype = AG_DTYPE_F32;  break;
+        case Dtype::Float16:  d.dtype = AG_DTYPE_F16;  break;
+        case Dtype::Bfloat16: d.dtype = AG_DTYPE_BF16; break;
+        default: return false;
+    }
+    const auto& dims = t.shape().dims;
+    const auto& strides = t.stride().strides;
+    const std::vector<int64_t>& out = as ? *as : dims;
+    if (out.size() > AG_DESC_MAX_DIMS || dims.size() > out.size() || strides.size() != dims.size()) return false;
+    d.data = const_cast<void*>(t.data());
+    d.ndim = (int32_t)out.size();
+    const size_t lead = out.size() - dims.size();
+    for (size_t i = 0; i < out.size(); ++i) {
+        d.shape[i] = out[i];
+        const int64_t n = i < lead ? 1 : dims[i - lead];
+        if (n != out[i] && n != 1) return false;
+        d.strides[i] = n == out[i] && i >= lead ? strides[i - lead] : 0;
+    }
+    return true;
+}
+
+// Calls a v2 kernel with this thread's scratch buffer, growing it whenever
+// the kernel reports that it needs more. False if the kernel declined.
+bool run_v2(const std::function<int64_t(ag_workspace)>& call) {
+    thread_local std::vector<unsigned char> scratch;
+    for (;;) {
+        const int64_t rc = call(ag_workspace{scratch.data(), (int64_t)scratch.size()});
+        if (rc == 0) return true;
+        if (rc < 0 || rc <= (int64_t)scratch.size()) return false;
+        scratch.resize((size_t)rc);
+    }
+}
+
+// y = op(x) through the v2 unary kernel; x may be a view or 16-bit and y
+// gets x's dtype. False (y untouched) when the plugin can't take it.
+static bool unary_kernel(int op, const Tensor& x, Tensor& y, float alpha = 0.0f) {
+    auto& K = ag::kernels::cpu();
+    ag_tensor_desc dx{}, dy{};
+    if (!K.unary_v2 || !kernel_desc(x, dx)) return false;
+    Tensor r(x.shape(), ag::options(x));
+    if (!kernel_desc(r, dy) || !run_v2([&](ag_workspace ws) { return K.unary_v2(op, &dx, &dy, alpha, ws); }))
+        return false;
+    y = r;
+    return true;
+}
+
+// a op b through the plugin: v2 for cpu operands of one dtype under any
+// broadcast, else v1 for f32 ones whose broadcast it covers. Returns false
+// (y untouched) so the caller can use the tensor operator.
+static bool binary_kernel(int op, const Tensor& a, const Tensor& b, Tensor& y) {
+    auto& K = ag::kernels::cpu();
+    BinaryBroadcast plan;
+    if (K.binary_v2 && a.is_cpu() && b.is_cpu() && a.dtype() == b.dtype()) {
+        plan_binary_broadcast(a.shape().dims, b.shape().dims, plan);
+        ag_tensor_desc da{}, db{}, dy{};
+        if (kernel_desc(a, da, &plan.out) && kernel_desc(b, db, &plan.out)) {
+            Tensor r(Shape{plan.out}, TensorOptions().with_dtype(a.dtype()));
+            if (kernel_desc(r, dy) && run_v2([&](ag_workspace ws) { return K.binary_v2(op, &da, &db, &dy, 0, ws); })) {
+                y = r;
+                return true;
+            }
+        }
+    }
+    if (!K.binary_bcast || !is_cpu_f32(a) || !is_cpu_f32(b) ||
+        !plan_binary_broadcast(a.shape().dims, b.shape().dims, plan)) return false;
+    Tensor ac = a.contiguous(), bc = b.contiguous();
+    y = Tensor(Shape{plan.out}, TensorOptions().with_dtype(Dtype::Float32));
+    K.binary_bcast(op, ac.data<float>(), plan.a, bc.data<float>(), plan.b, y.data<float>(), plan.rows, plan.cols, 0);
+    return true;
+}
+
 std::shared_ptr<Node> add_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b){
-    // This correctly uses the stream-aware overloaded operator+
-    Tensor Y = a->value + b->value; 
+    Tensor Y;
+    // Plugin kernel for cpu f32, else the stream-aware overloaded operator+
+    if (!binary_kernel(AG_BIN_ADD, a->value, b->value, Y)) Y = a->value + b->value;
     // FIX: Use the new 3-argument Node constructor
     auto n = std::make_shared<Node>(Y, Op::Add, (a->requires_grad() || b->requires_grad()), "+");
     n->inputs = {a, b};
@@ -25,8 +142,9 @@ std::shared_ptr<Node> add_nodeops(const std::shared_ptr<Node>& a, const std::sha
 }
   
 std::shared_ptr<Node> sub_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b){
-    // This correctly uses the stream-aware overloaded operator-
-    Tensor Y = a->value - b->value;
+    Tensor Y;
+    // Plugin kernel for cpu f32, else the stream-aware overloaded operator-
+    if (!binary_kernel(AG_BIN_SUB, a->value, b->value, Y)) Y = a->value - b->value;
     // FIX: Use the new 3-argument Node constructor
     auto n = std::make_shared<Node>(Y, Op::Sub, (a->requires_grad() || b->requires_grad()), "-");
     n->inputs = {a, b};
@@ -35,8 +153,9 @@ std::shared_ptr<Node> sub_nodeops(const std::shared_ptr<Node>& a, const std::sha
 }
 
 std::shared_ptr<Node> mul_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b){ 
-    // This correctly uses the stream-aware overloaded operator*
-    Tensor y = a->value * b->value; 
+    Tensor y;
+    // Plugin kernel for cpu f32, else the stream-aware overloaded operator*
+    if (!binary_kernel(AG_BIN_MUL, a->value, b->value, y)) y = a->value * b->value;
     // FIX: Use the new 3-argument Node constructor
     auto n = std::make_shared<Node>(y, Op::Mul, (a->requires_grad() || b->requires_grad()), "*"); 
     n->inputs = {a, b}; 
@@ -45,7 +164,8 @@ std::shared_ptr<Node> mul_nodeops(const std::shared_ptr<Node>& a, const std::sha
 }
 
 std::shared_ptr<Node> div_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b){
-    const Tensor& C = a->value / b->value;
+    Tensor C;
+    if (!binary_kernel(AG_BIN_DIV, a->value, b->value, C)) C = a->value / b->value;
 
     auto n = std::make_shared<Node>(C, Op::Div, (a->requires_grad() || b->requires_grad()), "/");
     n->inputs = { a, b };
@@ -96,8 +216,31 @@ std::shared_ptr<Node> flomul_nodeops(const std::shared_ptr<Node>& a, float b) {
 // Corrected relu_nodeops - Hybrid dispatcher for now ************************************************************************************************************************************
 // ===================================================================
 
+// Space for a 1-bit-per-element sign mask of n values. The kernels address it
+// as (n + 7) / 8 bytes; it is held in a float tensor only because that is the
+// dtype the tape carries, and is never read as floats.
+static Tensor sign_mask_storage(int64_t n) {
+    return Tensor(Shape{{(n + 31) / 32}}, TensorOptions().with_dtype(Dtype::Float32));
+}
+
 std::shared_ptr<Node> relu_nodeops(const std::shared_ptr<Node>& x){
     const Tensor& X = x->value;
+    auto& K = ag::kernels::cpu();
+
+    // On CPU the plugin writes the x > 0 pattern as a bitmask next to Y; the
+    // backward reads only that, so neither X nor Y is kept alive for it.
+    if (K.relu_fwd_mask && is_cpu_f32(X)) {
+        Tensor Xc = X.contiguous();
+        Tensor Y(X.shape(), ag::options(X));
+        Tensor M = sign_mask_storage(X.numel());
+        K.relu_fwd_mask(Xc.data<float>(), Y.data<float>(),
+                        reinterpret_cast<unsigned char*>(M.data<float>()), X.numel());
+        auto n = std::make_shared<Node>(Y, Op::Relu, x->requires_grad(), "relu");
+        n->inputs = {x};
+        if (x->requires_grad()) n->tape = {std::make_shared<Tensor>(M)};
+        ag::debug::on_node_created(n);
+        return n;
+    }
     
     // --- FIX START ---
     // Replaced the manual kernel dispatch with a device-agnostic expression.
@@ -132,6 +275,119 @@ std::shared_ptr<Node> matmul_nodeops(const std::shared_ptr<Node>& a, const std::
     return n;
 }
 
+// Swaps a 2D descriptor's dims, viewing the same storage as its transpose.
+static void transpose_desc(ag_tensor_desc& d) {
+    std::swap(d.shape[0], d.shape[1]);
+    std::swap(d.strides[0], d.strides[1]);
+}
+
+// op(a) @ op(b) where op transposes the last two dims when asked. 2D cpu f32
+// operands go to the plugin GEMM, which packs straight from the stored
+// layout; anything else falls back to matmul over .t() views.
+Tensor gemm(const Tensor& a, const Tensor& b, bool trans_a, bool trans_b) {
+    auto& K = ag::kernels::cpu();
+    // v2 takes the operands' own strides, so views need no contiguous copy
+    // and 16-bit operands are converted in the kernel's workspace.
+    ag_tensor_desc da{}, db{}, dc{};
+    if (K.gemm_v2 && a.shape().dims.size() == 2 && b.shape().dims.size() == 2 && a.dtype() == b.dtype() &&
+        kernel_desc(a, da) && kernel_desc(b, db)) {
+        if (trans_a) transpose_desc(da);
+        if (trans_b) transpose_desc(db);
+        if (da.shape[1] != db.shape[0]) throw std::runtime_error("gemm: inner dimensions do not match");
+        Tensor c(Shape{{da.shape[0], db.shape[1]}}, TensorOptions().with_dtype(a.dtype()));
+        if (kernel_desc(c, dc) && run_v2([&](ag_workspace ws) { return K.gemm_v2(&da, &db, &dc, 0, ws); })) return c;
+    }
+    if (K.gemm && a.shape().dims.size() == 2 && b.shape().dims.size() == 2 && is_cpu_f32(a) && is_cpu_f32(b)) {
+        const auto& ad = a.shape().dims;
+        const auto& bd = b.shape().dims;
+        const int64_t M = trans_a ? ad[1] : ad[0], Ka = trans_a ? ad[0] : ad[1];
+        const int64_t N = trans_b ? bd[0] : bd[1], Kb = trans_b ? bd[1] : bd[0];
+        if (Ka != Kb) throw std::runtime_error("gemm: inner dimensions do not match");
+        Tensor ac = a.contiguous(), bc = b.contiguous();
+        Tensor c(Shape{{M, N}}, TensorOptions().with_dtype(Dtype::Float32));
+        K.gemm(ac.data<float>(), bc.data<float>(), c.data<float>(), (int)M, (int)Ka, (int)N, trans_a, trans_b);
+        return c;
+    }
+    return OwnTensor::matmul(trans_a ? a.t() : a, trans_b ? b.t() : b);
+}
+
+// c += op(a) @ op(b) in place, for 2D operands: the v2 GEMM with its
+// accumulate flag (views and 16-bit included), else the v1 gemm_acc on cpu
+// f32. False (c untouched) when neither applies, e.g. off the CPU.
+bool gemm_accumulate(const Tensor& a, const Tensor& b, bool trans_a, bool trans_b, Tensor& c) {
+    auto& K = ag::kernels::cpu();
+    const auto& ad = a.shape().dims;
+    const auto& bd = b.shape().dims;
+    const auto& cd = c.shape().dims;
+    if (ad.size() != 2 || bd.size() != 2 || cd.size() != 2) return false;
+    const int64_t M = trans_a ? ad[1] : ad[0], Ka = trans_a ? ad[0] : ad[1];
+    const int64_t N = trans_b ? bd[0] : bd[1], Kb = trans_b ? bd[1] : bd[0];
+    if (Ka != Kb || cd[0] != M || cd[1] != N) return false;
+
+    ag_tensor_desc da{}, db{}, dc{};
+    if (K.gemm_v2 && a.dtype() == b.dtype() && kernel_desc(a, da) && kernel_desc(b, db) && kernel_desc(c, dc)) {
+        if (trans_a) transpose_desc(da);
+        if (trans_b) transpose_desc(db);
+        if (run_v2([&](ag_workspace ws) { return K.gemm_v2(&da, &db, &dc, 1, ws); })) return true;
+    }
+    if (K.gemm_acc && is_cpu_f32(a) && is_cpu_f32(b) && is_cpu_f32(c)) {
+        Tensor ac = a.contiguous(), bc = b.contiguous();
+        K.gemm_acc(ac.data<float>(), bc.data<float>(), c.data<float>(), (int)M, (int)Ka, (int)N, trans_a, trans_b);
+        return true;
+    }
+    return false;
+}
+
+// Sum / max / mean / sum of squares of x over axes (empty: all elements).
+// On cpu f32 each run of adjacent axes is one plugin reduce over x viewed as
+// [outer, n, inner], last run first; split runs chain (SUMSQ continues as a
+// SUM, MEAN as MEAN). Other tensors use OwnTensor's reduce_*.
+Tensor reduce_axes(const Tensor& x, int op, std::vector<int64_t> axes, bool keepdim) {
+    auto& K = ag::kernels::cpu();
+    if (!K.reduce || !is_cpu_f32(x)) {
+        switch (op) {
+            case AG_REDUCE_MAX:   return OwnTensor::reduce_max(x, axes, keepdim);
+            case AG_REDUCE_MEAN:  return OwnTensor::reduce_mean(x, axes, keepdim);
+            case AG_REDUCE_SUMSQ: return OwnTensor::reduce_sum(x * x, axes, keepdim);
+            default:              return OwnTensor::reduce_sum(x, axes, keepdim);
+        }
+    }
+
+    std::vector<int64_t> dims = x.shape().dims;
+    const int64_t nd = static_cast<int64_t>(dims.size());
+    if (axes.empty()) for (int64_t d = 0; d < nd; ++d) axes.push_back(d);
+    for (auto& a : axes) {
+        if (a < 0) a += nd;
+        if (a < 0 || a >= nd) throw std::runtime_error("reduce_axes: axis out of range");
+    }
+    std::sort(axes.begin(), axes.end());
+    axes.erase(std::unique(axes.begin(), axes.end()), axes.end());
+
+    Tensor cur = x.contiguous();
+    for (size_t e = axes.size(); e > 0;) {
+        size_t s = e - 1;
+        while (s > 0 && axes[s - 1] + 1 == axes[s]) --s;
+        int64_t outer = 1, n = 1, inner = 1;
+        for (int64_t d = 0; d < nd; ++d) {
+            if (d < axes[s]) outer *= dims[d];
+            else if (d <= axes[e - 1]) n *= dims[d];
+            else inner *= dims[d];
+        }
+        for (size_t i = s; i < e; ++i) dims[axes[i]] = 1;
+        Tensor next(Shape{dims}, TensorOptions().with_dtype(Dtype::Float32));
+        K.reduce(op, cur.data<float>(), next.data<float>(), outer, n, inner);
+        if (op == AG_REDUCE_SUMSQ) op = AG_REDUCE_SUM;
+        cur = next;
+        e = s;
+    }
+    if (keepdim) return cur;
+    std::vector<int64_t> kept;
+    for (int64_t d = 0; d < nd; ++d)
+        if (!std::binary_search(axes.begin(), axes.end(), d)) kept.push_back(dims[d]);
+    if (kept.empty()) kept.push_back(1);
+    return cur.reshape(Shape{kept});
+}
+
 // =====================================================================================================
 // fmab nodeops
 // =====================================================================================================
@@ -159,9 +415,9 @@ std::shared_ptr<Node> attention_nodeops(const std::shared_ptr<Node>& a, const st
     Tensor g = matmul(q, k.t()) * scale;
 
     // Re-implement softmax using OwnTensor ops
-    Tensor max_val = reduce_max(g, {-1}, true);
+    Tensor max_val = reduce_axes(g, AG_REDUCE_MAX, {-1}, true);
     Tensor exp_g = exp(g - max_val);
-    Tensor sum_exp_g = reduce_sum(exp_g, {-1}, true);
+    Tensor sum_exp_g = reduce_axes(exp_g, AG_REDUCE_SUM, {-1}, true);
     Tensor s = exp_g / sum_exp_g;
 
     Tensor y = matmul(s, v);
@@ -176,6 +432,270 @@ std::shared_ptr<Node> attention_nodeops(const std::shared_ptr<Node>& a, const st
     ag::debug::on_node_created(n);
     return n;
 }
+
+// =====================================================================================================
+// multihead_attention_nodeops
+// =====================================================================================================
+// q: [B,T,H,D], k/v: [B,S,Hkv,D] (or the same without the batch dim). All heads
+// run in one plugin call; the tape keeps only the row logsumexp [B,H,T].
+// The mask travels to the backward as {causal, window, block, alibi, layout...}.
+std::shared_ptr<Node> multihead_attention_nodeops(const std::shared_ptr<Node>& q, const std::shared_ptr<Node>& k,
+                                                  const std::shared_ptr<Node>& v, const ag_attn_mask& mask, bool alibi){
+    const auto& qs = q->value.shape().dims;
+    const auto& ks = k->value.shape().dims;
+    if ((qs.size() != 3 && qs.size() != 4) || ks.size() != qs.size() || v->value.shape().dims != ks) {
+        throw std::runtime_error("multihead_attention: expected q [B,T,H,D] and k, v [B,S,Hkv,D]");
+    }
+    const size_t r = qs.size();
+    const int64_t B = r == 4 ? qs[0] : 1;
+    const int64_t T = qs[r - 3], H = qs[r - 2], D = qs[r - 1];
+    const int64_t S = ks[r - 3], Hkv = ks[r - 2];
+    if ((r == 4 && ks[0] != B) || ks[r - 1] != D || Hkv == 0 || H % Hkv != 0) {
+        throw std::runtime_error("multihead_attention: k/v must match q's batch and head dim, and Hkv must divide H");
+    }
+    int64_t nlayout = 0;
+    if (mask.block > 0 && mask.layout) {
+        nlayout = ((T + mask.block - 1) / mask.block) * ((S + mask.block - 1) / mask.block);
+    }
+
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_fwd) {
+        throw std::runtime_error("multihead_attention: needs mha_fwd from the CPU kernel plugin");
+    }
+    // ALiBi uses the standard per-head slopes; callers only say whether it is on.
+    const std::vector<float> slopes = alibi ? alibi_slopes(H) : std::vector<float>();
+    ag_attn_mask m = mask;
+    m.alibi = slopes.empty() ? nullptr : slopes.data();
+    Tensor qh = host_f32(q->value, "multihead_attention");
+    Tensor kh = host_f32(k->value, "multihead_attention");
+    Tensor vh = host_f32(v->value, "multihead_attention");
+
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor y(q->value.shape(), host);
+    Tensor lse(Shape{{B, H, T}}, host);
+    const float scale = 1.0f / std::sqrt(static_cast<float>(D));
+    K.mha_fwd(qh.data<float>(), kh.data<float>(), vh.data<float>(), y.data<float>(), lse.data<float>(),
+              (int)B, (int)T, (int)S, (int)H, (int)Hkv, (int)D, scale, &m);
+    if (!q->value.is_cpu()) y = y.to(q->value.device());
+
+    Tensor cfgT = Tensor::zeros(Shape{{1, 4 + nlayout}}, TensorOptions().with_req_grad(false));
+    float* c = cfgT.data<float>();
+    c[0] = static_cast<float>(mask.causal);
+    c[1] = static_cast<float>(mask.window);
+    c[2] = static_cast<float>(nlayout ? mask.block : 0);
+    c[3] = slopes.empty() ? 0.0f : 1.0f;
+    for (int64_t i = 0; i < nlayout; ++i) c[4 + i] = mask.layout[i] ? 1.0f : 0.0f;
+    auto cfg = make_tensor(cfgT, "mha_cfg");
+
+    const bool req = q->requires_grad() || k->requires_grad() || v->requires_grad();
+    auto n = std::make_shared<Node>(y, Op::MultiHeadAttention, req, "multihead_attention");
+    n->inputs = {q, k, v, cfg.node};
+    n->tape = {std::make_shared<Tensor>(lse)};
+    ag::debug::on_node_created(n);
+    return n;
+}
+// =====================================================================================================
+// varlen_attention_nodeops
+// =====================================================================================================
+// Packed ragged batch: q [Nq,H,D], k/v [Nk,Hkv,D] hold the sequences back to
+// back, sequence b owning rows [cu_q[b], cu_q[b+1]) and [cu_k[b], cu_k[b+1]).
+// Nothing is padded, and no sequence attends to another. The tape keeps the
+// logsumexp [H * Nq]; the config is {causal, window, alibi, B, cu_q..., cu_k...}.
+std::shared_ptr<Node> varlen_attention_nodeops(const std::shared_ptr<Node>& q, const std::shared_ptr<Node>& k,
+                                               const std::shared_ptr<Node>& v,
+                                               const std::vector<int64_t>& cu_seqlens_q,
+                                               const std::vector<int64_t>& cu_seqlens_k,
+                                               const ag_attn_mask& mask, bool alibi){
+    const auto& qs = q->value.shape().dims;
+    const auto& ks = k->value.shape().dims;
+    if (qs.size() != 3 || ks.size() != 3 || v->value.shape().dims != ks) {
+        throw std::runtime_error("varlen_attention: expected packed q [Nq,H,D] and k, v [Nk,Hkv,D]");
+    }
+    const int64_t Nq = qs[0], H = qs[1], D = qs[2];
+    const int64_t Nk = ks[0], Hkv = ks[1];
+    if (ks[2] != D || Hkv == 0 || H % Hkv != 0) {
+        throw std::runtime_error("varlen_attention: k/v must match q's head dim, and Hkv must divide H");
+    }
+    const int64_t B = static_cast<int64_t>(cu_seqlens_q.size()) - 1;
+    if (B < 1 || cu_seqlens_k.size() != cu_seqlens_q.size() ||
+        cu_seqlens_q.front() != 0 || cu_seqlens_k.front() != 0 ||
+        cu_seqlens_q.back() != Nq || cu_seqlens_k.back() != Nk) {
+        throw std::runtime_error("varlen_attention: cu_seqlens must start at 0 and end at the packed token counts");
+    }
+    std::vector<int> cu_q(B + 1), cu_k(B + 1);
+    for (int64_t b = 0; b <= B; ++b) {
+        cu_q[b] = static_cast<int>(cu_seqlens_q[b]);
+        cu_k[b] = static_cast<int>(cu_seqlens_k[b]);
+        if (b > 0 && (cu_q[b] < cu_q[b - 1] || cu_k[b] < cu_k[b - 1])) {
+            throw std::runtime_error("varlen_attention: cu_seqlens must be non-decreasing");
+        }
+    }
+
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_varlen_fwd) {
+        throw std::runtime_error("varlen_attention: needs mha_varlen_fwd from the CPU kernel plugin");
+    }
+    const std::vector<float> slopes = alibi ? alibi_slopes(H) : std::vector<float>();
+    const ag_attn_mask m{mask.causal, mask.window, 0, nullptr, slopes.empty() ? nullptr : slopes.data()};
+    Tensor qh = host_f32(q->value, "varlen_attention");
+    Tensor kh = host_f32(k->value, "varlen_attention");
+    Tensor vh = host_f32(v->value, "varlen_attention");
+
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor y(q->value.shape(), host);
+    Tensor lse(Shape{{H, Nq}}, host);
+    const float scale = 1.0f / std::sqrt(static_cast<float>(D));
+    K.mha_varlen_fwd(qh.data<float>(), kh.data<float>(), vh.data<float>(), y.data<float>(), lse.data<float>(),
+                     cu_q.data(), cu_k.data(), (int)B, (int)H, (int)Hkv, (int)D, scale, &m);
+    if (!q->value.is_cpu()) y = y.to(q->value.device());
+
+    // Offsets are stored as floats like every other config constant (exact up to 2^24 tokens).
+    Tensor cfgT = Tensor::zeros(Shape{{1, 4 + 2 * (B + 1)}}, TensorOptions().with_req_grad(false));
+    float* c = cfgT.data<float>();
+    c[0] = static_cast<float>(mask.causal);
+    c[1] = static_cast<float>(mask.window);
+    c[2] = slopes.empty() ? 0.0f : 1.0f;
+    c[3] = static_cast<float>(B);
+    for (int64_t b = 0; b <= B; ++b) {
+        c[4 + b] = static_cast<float>(cu_q[b]);
+        c[4 + B + 1 + b] = static_cast<float>(cu_k[b]);
+    }
+    auto cfg = make_tensor(cfgT, "varlen_cfg");
+
+    const bool req = q->requires_grad() || k->requires_grad() || v->requires_grad();
+    auto n = std::make_shared<Node>(y, Op::VarlenAttention, req, "varlen_attention");
+    n->inputs = {q, k, v, cfg.node};
+    n->tape = {std::make_shared<Tensor>(lse)};
+    ag::debug::on_node_created(n);
+    return n;
+}
+// =====================================================================================================
+// embedding_nodeops
+// =====================================================================================================
+// Gathers rows of table [V, D]. With no offsets the output is indices' shape
+// plus D; with offsets [B+1] it is an embedding bag [B, D] that sums (or
+// averages) each bag's rows without materializing them. The config is
+// {mode (0 gather, 1 sum, 2 mean), B, offsets...}.
+std::shared_ptr<Node> embedding_nodeops(const std::shared_ptr<Node>& indices, const std::shared_ptr<Node>& table,
+                                        const std::vector<int64_t>& offsets, bool mean){
+    const auto& ts = table->value.shape().dims;
+    if (ts.size() != 2) throw std::runtime_error("embedding: expected a table [V, D]");
+    const int64_t V = ts[0], D = ts[1];
+    const std::vector<int64_t> ids = read_indices(indices->value);
+    const int64_t N = static_cast<int64_t>(ids.size());
+    std::vector<int> idx(N);
+    for (int64_t i = 0; i < N; ++i) {
+        if (ids[i] < 0 || ids[i] >= V) throw std::runtime_error("embedding: index out of range");
+        idx[i] = static_cast<int>(ids[i]);
+    }
+    const bool bag = !offsets.empty();
+    const int64_t B = bag ? static_cast<int64_t>(offsets.size()) - 1 : N;
+    std::vector<int> off(offsets.begin(), offsets.end());
+    if (bag && (B < 1 || offsets.front() != 0 || offsets.back() != N ||
+                !std::is_sorted(offsets.begin(), offsets.end()))) {
+        throw std::runtime_error("embedding_bag: offsets must rise from 0 to the number of indices");
+    }
+
+    auto& K = ag::kernels::cpu();
+    if (!K.embedding_fwd) {
+        throw std::runtime_error("embedding: needs embedding_fwd from the CPU kernel plugin");
+    }
+    Tensor th = host_f32(table->value, "embedding");
+    std::vector<int64_t> ydims = bag ? std::vector<int64_t>{B, D} : indices->value.shape().dims;
+    if (!bag) ydims.push_back(D);
+    Tensor y(Shape{ydims}, TensorOptions().with_dtype(Dtype::Float32));
+    K.embedding_fwd(th.data<float>(), idx.data(), bag ? off.data() : nullptr, y.data<float>(),
+                    (int)N, (int)B, (int)D, mean ? 1 : 0);
+    if (!table->value.is_cpu()) y = y.to(table->value.device());
+
+    Tensor cfgT = Tensor::zeros(Shape{{1, 2 + (bag ? B + 1 : 0)}}, TensorOptions().with_req_grad(false));
+    float* c = cfgT.data<float>();
+    c[0] = bag ? (mean ? 2.0f : 1.0f) : 0.0f;
+    c[1] = static_cast<float>(B);
+    for (size_t i = 0; bag && i < off.size(); ++i) c[2 + i] = static_cast<float>(off[i]);
+    auto cfg = make_tensor(cfgT, "embedding_cfg");
+
+    auto n = std::make_shared<Node>(y, Op::Embedding, table->requires_grad(), bag ? "embedding_bag" : "embedding");
+    n->inputs = {indices, table, cfg.node};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
+// =====================================================================================================
+// rope_nodeops
+// =====================================================================================================
+// Rotary embedding on the last dim of x [.., H, D] (rotate-half pairing), one
+// position per token. The cos/sin tables are built once per (D, base) and only
+// grow when a larger position shows up, so a step costs one pass over x.
+namespace {
+struct RopeTable { std::vector<float> cos, sin; int64_t max_pos = 0; };
+
+const RopeTable& rope_table(int64_t D, float base, int64_t max_pos) {
+    static std::map<std::pair<int64_t, float>, RopeTable> cache;
+    RopeTable& t = cache[{D, base}];
+    if (t.max_pos < max_pos) {
+        const int64_t half = D / 2;
+        const int64_t n = std::max<int64_t>(max_pos, 2 * t.max_pos);
+        t.cos.resize(n * half);
+        t.sin.resize(n * half);
+        for (int64_t p = t.max_pos; p < n; ++p)
+            for (int64_t i = 0; i < half; ++i) {
+                const double a = p * std::pow((double)base, -2.0 * i / D);
+                t.cos[p * half + i] = static_cast<float>(std::cos(a));
+                t.sin[p * half + i] = static_cast<float>(std::sin(a));
+            }
+        t.max_pos = n;
+    }
+    return t;
+}
+} // namespace
+
+Tensor rope_apply(const Tensor& x, const std::vector<int64_t>& positions, float base, bool inverse) {
+    const auto& dims = x.shape().dims;
+    if (dims.empty() || dims.back() % 2 != 0) {
+        throw std::runtime_error("rope: the last dim of x must be even");
+    }
+    const int64_t D = dims.back();
+    const int64_t H = dims.size() >= 3 ? dims[dims.size() - 2] : 1;
+    const int64_t N = D * H ? static_cast<int64_t>(x.numel()) / (D * H) : 0;
+    // One position per token, or one per sequence step shared across the leading batch dims.
+    const int64_t P = static_cast<int64_t>(positions.size());
+    if (P == 0 || N % P != 0) {
+        throw std::runtime_error("rope: positions must have one entry per token (or per step, shared across the batch)");
+    }
+    std::vector<int> pos(N);
+    int64_t max_pos = 0;
+    for (int64_t n = 0; n < N; ++n) {
+        const int64_t p = positions[n % P];
+        if (p < 0) throw std::runtime_error("rope: positions must be non-negative");
+        pos[n] = static_cast<int>(p);
+        max_pos = std::max(max_pos, p + 1);
+    }
+
+    auto& K = ag::kernels::cpu();
+    if (!K.rope) {
+        throw std::runtime_error("rope: needs rope from the CPU kernel plugin");
+    }
+    const RopeTable& t = rope_table(D, base, max_pos);
+    Tensor xh = host_f32(x, "rope");
+    Tensor y(x.shape(), TensorOptions().with_dtype(Dtype::Float32));
+    K.rope(xh.data<float>(), y.data<float>(), t.cos.data(), t.sin.data(), pos.data(),
+           (int)N, (int)H, (int)D, inverse ? 1 : 0);
+    return x.is_cpu() ? y : y.to(x.device());
+}
+
+std::shared_ptr<Node> rope_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& positions, float base){
+    Tensor y = rope_apply(x->value, read_indices(positions->value), base, /*inverse=*/false);
+
+    Tensor baseT = Tensor::full(Shape{{1, 1}}, TensorOptions().with_req_grad(false), base);
+    auto cfg = make_tensor(baseT, "rope_base");
+
+    auto n = std::make_shared<Node>(y, Op::RoPE, x->requires_grad(), "rope");
+    n->inputs = {x, positions, cfg.node};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
 // =====================================================================================================
 // Corrected sigatt_nodeops - Pure OwnTensor
 // =====================================================================================================
@@ -258,28 +778,71 @@ std::shared_ptr<Node> reluatt_nodeops(const std::shared_ptr<Node>& a,
     return n; 
 }
 
-// ... other functions in nodeops.cpp ...
-// ===================================================================
-// moewe_nodeops
 // ===================================================================
+// moe_nodeops
+// ===================================================================
+// Mixture of Experts FFN: each token is routed to its top-k experts (gates =
+// softmax over the k chosen router logits), tokens are permuted into
+// per-expert buckets, all experts run as one grouped GEMM on the CPU plugin,
+// and the gated outputs are scattered back. x: [..., D]; Wg: [E,D];
+// W1: [E,H,D]; b1: [E,H]; W2: [E,D,H]; b2: [E,D]. With capacity_factor > 0
+// an expert takes at most ceil(capacity_factor * tokens * k / E) assignments.
+// Tape: route and gate [tokens,k] plus the hidden pre-activation of every
+// kept assignment, so the backward replays the same routing.
+std::shared_ptr<Node> moe_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& Wg,
+                                  const std::shared_ptr<Node>& W1, const std::shared_ptr<Node>& b1,
+                                  const std::shared_ptr<Node>& W2, const std::shared_ptr<Node>& b2,
+                                  int k, float capacity_factor, ag_activation act)
+{
+    const Tensor& X = x->value;
+    const int64_t D = X.shape().dims.back();
+    const int64_t T = D > 0 ? X.numel() / D : 0;
+    const auto& w1s = W1->value.shape().dims;
+    if (w1s.size() != 3 || w1s[2] != D) {
+        throw std::runtime_error("moe: W1 must be [E,H,D]");
+    }
+    const int64_t E = w1s[0], H = w1s[1];
+    if (Wg->value.numel() != E * D || W2->value.numel() != E * D * H ||
+        b1->value.numel() != E * H || b2->value.numel() != E * D) {
+        throw std::runtime_error("moe: expected Wg [E,D], b1 [E,H], W2 [E,D,H], b2 [E,D]");
+    }
+    if (k < 1 || k > E) {
+        throw std::runtime_error("moe: top-k must be between 1 and the number of experts");
+    }
+    const int capacity = capacity_factor > 0.0f
+        ? static_cast<int>(std::ceil(capacity_factor * static_cast<float>(T * k) / static_cast<float>(E)))
+        : 0;
 
-std::shared_ptr<Node> moewe_nodeops(const std::shared_ptr<Node>& x, 
-                                    const std::shared_ptr<Node>& w, 
-                                    const std::shared_ptr<Node>& b) {
-    // --- Step 1: Linear transformation ---
-    Tensor logits = OwnTensor::matmul(x->value, w->value.t()) + b->value;
-
-    // --- Step 2: Softmax implemented in a single expression ---
-    // This avoids the scoping issue and the default constructor error.
-    Tensor max_val = OwnTensor::reduce_max(logits, {-1}, true);
-    Tensor exp_logits = OwnTensor::exp(logits - max_val);
-    Tensor sum_exp_logits = OwnTensor::reduce_sum(exp_logits, {-1}, true);
-    Tensor y = exp_logits / sum_exp_logits;
-
-    // --- Step 3: Create the graph node ---
-    auto n = std::make_shared<Node>(y, Op::MOE, (x->requires_grad() || w->requires_grad() || b->requires_grad()), "moe");
-    n->inputs = {x, w, b}; 
-    ag::debug::on_node_created(n);  
+    auto& K = ag::kernels::cpu();
+    if (!K.moe_fwd) {
+        throw std::runtime_error("moe: routing and grouped expert GEMMs need moe_fwd from the CPU kernel plugin");
+    }
+    Tensor xh = host_f32(X, "moe"), wgh = host_f32(Wg->value, "moe");
+    Tensor w1h = host_f32(W1->value, "moe"), b1h = host_f32(b1->value, "moe");
+    Tensor w2h = host_f32(W2->value, "moe"), b2h = host_f32(b2->value, "moe");
+
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor y(X.shape(), host);
+    Tensor route(Shape{{T, (int64_t)k}}, host), gate(Shape{{T, (int64_t)k}}, host);
+    Tensor Z1(Shape{{T * k, H}}, host);
+    K.moe_fwd(xh.data<float>(), wgh.data<float>(), w1h.data<float>(), b1h.data<float>(),
+              w2h.data<float>(), b2h.data<float>(), y.data<float>(),
+              route.data<float>(), gate.data<float>(), Z1.data<float>(),
+              (int)T, (int)D, (int)H, (int)E, k, capacity, act);
+    if (!X.is_cpu()) y = y.to(X.device());
+
+    // k and the activation travel to the backward as constants, like leaky_relu's alpha.
+    Tensor cfgT = Tensor::zeros(Shape{{1, 2}}, TensorOptions().with_req_grad(false));
+    cfgT.data<float>()[0] = static_cast<float>(k);
+    cfgT.data<float>()[1] = static_cast<float>(act);
+    auto cfg = make_tensor(cfgT, "moe_cfg");
+
+    const bool req = x->requires_grad() || Wg->requires_grad() || W1->requires_grad() || b1->requires_grad() ||
+                     W2->requires_grad() || b2->requires_grad();
+    auto n = std::make_shared<Node>(y, Op::MOE, req, "moe");
+    n->inputs = {x, Wg, W1, b1, W2, b2, cfg.node};
+    n->tape = {std::make_shared<Tensor>(route), std::make_shared<Tensor>(gate), std::make_shared<Tensor>(Z1)};
+    ag::debug::on_node_created(n);
     return n;
 }
 
@@ -409,6 +972,70 @@ std::shared_ptr<Node> linear_nodeops(const std::shared_ptr<Node>& a, // Input X
     ag::debug::on_node_created(n);
     return n;
 }
+
+// ===================================================================
+// linear_act_nodeops
+// ===================================================================
+// y = act(x @ W^T + b), W is [out, in] like nn::Linear. On CPU the plugin
+// applies bias and activation in the GEMM epilogue. The pre-activation z is
+// only kept on the tape when the backward needs it (GELU, SiLU); ReLU masks
+// on y itself.
+std::shared_ptr<Node> linear_act_nodeops(const std::shared_ptr<Node>& x,
+                                         const std::shared_ptr<Node>& W,
+                                         const std::shared_ptr<Node>& b,
+                                         ag_activation act)
+{
+    const Tensor& X  = x->value;   // [B, In]
+    const Tensor& Wt = W->value;   // [Out, In]
+    const Tensor& Bv = b->value;   // [1, Out] or [Out]
+    const int64_t Bn  = X.shape().dims[0];
+    const int64_t In  = X.shape().dims[1];
+    const int64_t Out = Wt.shape().dims[0];
+    if (Wt.shape().dims[1] != In || Bv.numel() != Out) {
+        throw std::runtime_error("linear_act: expected x [B,In], W [Out,In] and b with Out elements");
+    }
+    const bool keep_z = (act == AG_ACT_GELU || act == AG_ACT_SILU);
+
+    Tensor y, z;
+    auto& K = ag::kernels::cpu();
+    if (K.linear_act_fwd && is_cpu_f32(X) && is_cpu_f32(Wt) && is_cpu_f32(Bv)) {
+        Tensor Xc = X.contiguous(), Wc = Wt.contiguous(), Bc = Bv.contiguous();
+        y = Tensor(Shape{{Bn, Out}}, ag::options(X));
+        if (keep_z) z = Tensor(Shape{{Bn, Out}}, ag::options(X));
+        K.linear_act_fwd(Xc.data<float>(), Wc.data<float>(), Bc.data<float>(), y.data<float>(),
+                         keep_z ? z.data<float>() : nullptr, (int)Bn, (int)In, (int)Out, act);
+    } else {
+        // Reference path: same formulas as linear followed by relu / gelu / silu.
+        z = matmul(X, Wt.t()) + Bv;
+        switch (act) {
+        case AG_ACT_RELU:
+            y = (z + OwnTensor::abs(z, ag::current_stream())) * 0.5f;
+            break;
+        case AG_ACT_GELU: {
+            const float c1 = 0.7978845608f, c2 = 0.044715f;
+            Tensor u = (z + z * z * z * c2) * c1;
+            y = z * (1.0f + OwnTensor::tanh(u)) * 0.5f;
+            break;
+        }
+        case AG_ACT_SILU:
+            y = z * (1.0f / (1.0f + OwnTensor::exp(z * -1.0f)));
+            break;
+        default:
+            y = z;
+            break;
+        }
+    }
+
+    // The activation travels to the backward as a 1x1 constant, like leaky_relu's alpha.
+    Tensor aT = Tensor::full(Shape{{1, 1}}, TensorOptions().with_req_grad(false), static_cast<float>(act));
+    auto aC = make_tensor(aT, "act");
+
+    auto n = std::make_shared<Node>(y, Op::LinearAct, (x->requires_grad() || W->requires_grad() || b->requires_grad()), "linear_act");
+    n->inputs = {x, W, b, aC.node};
+    if (keep_z) n->tape = {std::make_shared<Tensor>(z)};
+    ag::debug::on_node_created(n);
+    return n;
+}
 // ===================================================================
 // cosh_nodeops
 // ===================================================================
@@ -519,7 +1146,8 @@ std::shared_ptr<Node> sign_nodeops(const std::shared_ptr<Node>& x){
 std::shared_ptr<Node> sqrt_nodeops(const std::shared_ptr<Node>& x) {
     // 1. Call the OwnTensor::sqrt function directly.
     // It will handle device dispatch and stream context automatically.
-    Tensor y = OwnTensor::sqrt(x->value, ag::current_stream());
+    Tensor y;
+    if (!unary_kernel(AG_UNARY_SQRT, x->value, y)) y = OwnTensor::sqrt(x->value, ag::current_stream());
 
     // 2. Wrap the result in a new Node using the correct constructor.
     auto n = std::make_shared<Node>(y, Op::Sqrt, x->requires_grad(), "sqrt");
@@ -532,52 +1160,47 @@ std::shared_ptr<Node> sqrt_nodeops(const std::shared_ptr<Node>& x) {
 // alibiatt_nodeops
 // ===================================================================
 
-std::shared_ptr<Node> alibiatt_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d, float& m) {
-    // Step 1: Projections
-    Tensor q = OwnTensor::matmul(a->value, b->value); 
-    Tensor k = OwnTensor::matmul(a->value, c->value); 
-    Tensor v = OwnTensor::matmul(a->value, d->value);
-    
-    // Step 2: Scaled dot-product attention
-    float scale = 1.f / sqrtf(static_cast<float>(k.shape().dims.back()));
-    Tensor logits = OwnTensor::matmul(q, k.t()) * scale;
+std::vector<float> alibi_slopes(int64_t heads) {
+    // Geometric slopes 2^(-8/n), 2^(-16/n), ... for the nearest power of two n <= heads;
+    // the remaining heads take every other slope of the 2n sequence, as in the ALiBi paper.
+    int64_t n = 1;
+    while (n * 2 <= heads) n *= 2;
+    std::vector<float> slopes;
+    for (int64_t h = 1; h <= n; ++h) slopes.push_back(std::pow(2.0f, -8.0f * h / n));
+    for (int64_t h = 1; (int64_t)slopes.size() < heads; h += 2) slopes.push_back(std::pow(2.0f, -4.0f * h / n));
+    return slopes;
+}
 
-    
-    // Step 3: Create Alibi bias and add it in one step to initialize 'g'
-    Tensor bias_cpu(logits.shape(), OwnTensor::TensorOptions().with_dtype(logits.dtype()));
-    {
-        int n_heads = logits.shape().dims[0];
-        int seq_len = logits.shape().dims[1];
-        float slope_start = 1.0f / powf(2.0f, 8.0f / n_heads);
-
-        dispatch_by_dtype(bias_cpu.dtype(), [&](auto dummy){
-            using T = decltype(dummy);
-            T* data = bias_cpu.data<T>();
-            for(int h = 0; h < n_heads; ++h) {
-                float slope = powf(slope_start, h + 1);
-                for (int i = 0; i < seq_len; ++i) {
-                    for (int j = 0; j < seq_len; ++j) {
-                        data[h * seq_len * seq_len + i * seq_len + j] = (j > i) ? -std::numeric_limits<float>::infinity() : static_cast<T>(-(seq_len - 1 - j) * slope);
-                    }
-                }
-            }
-        });
+// Causal single-head attention with the ALiBi bias -slope * (i - j) applied
+// inside the fused attention kernel, so no [T,T] bias or score matrix is built.
+// The tape keeps q, k, v and the row logsumexp for the fused backward.
+std::shared_ptr<Node> alibiatt_nodeops(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d, float& m) {
+    (void)m; // the bias is a function of (i - j) only, so the max length does not matter
+    auto& K = ag::kernels::cpu();
+    if (!K.mha_fwd) {
+        throw std::runtime_error("alibiatt: needs mha_fwd from the CPU kernel plugin");
     }
-    Tensor g = logits + bias_cpu.to(logits.device());
- 
-    // Step 4: Re-implement softmax and initialize 's' in a single expression
-    Tensor max_val = OwnTensor::reduce_max(g, {-1}, true);
-    Tensor exp_g = OwnTensor::exp(g - max_val);
-    Tensor sum_exp_g = OwnTensor::reduce_sum(exp_g, {-1}, true);
-    Tensor s = exp_g / sum_exp_g;
 
-    // Step 5: Final projection
-    Tensor y = OwnTensor::matmul(s, v);
+    // Step 1: Projections
+    Tensor q = host_f32(OwnTensor::matmul(a->value, b->value), "alibiatt");
+    Tensor k = host_f32(OwnTensor::matmul(a->value, c->value), "alibiatt");
+    Tensor v = host_f32(OwnTensor::matmul(a->value, d->value), "alibiatt");
+    const int64_t T = q.shape().dims[0], S = k.shape().dims[0], Dk = k.shape().dims.back();
+
+    // Step 2: fused causal attention, one head, bias computed per score
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor y(Shape{{T, v.shape().dims.back()}}, host);
+    Tensor lse(Shape{{1, 1, T}}, host);
+    const std::vector<float> slope = alibi_slopes(1);
+    const ag_attn_mask mask{1, 0, 0, nullptr, slope.data()};
+    K.mha_fwd(q.data<float>(), k.data<float>(), v.data<float>(), y.data<float>(), lse.data<float>(),
+              1, (int)T, (int)S, 1, 1, (int)Dk, 1.0f / std::sqrt(static_cast<float>(Dk)), &mask);
+    if (!a->value.is_cpu()) y = y.to(a->value.device());
 
     auto n = std::make_shared<Node>(y, Op::AlibiAttention, (a->requires_grad() || b->requires_grad() || c->requires_grad() || d-> requires_grad()), "alibiattention"); 
     n->inputs = {a, b, c, d};
     n->tape = {std::make_shared<Tensor>(q), std::make_shared<Tensor>(k), 
-               std::make_shared<Tensor>(v), std::make_shared<Tensor>(s)};
+               std::make_shared<Tensor>(v), std::make_shared<Tensor>(lse)};
     ag::debug::on_node_created(n); 
     return n; 
 }
@@ -585,18 +1208,47 @@ std::shared_ptr<Node> alibiatt_nodeops(const std::shared_ptr<Node>& a, const std
 // ===================================================================
 // swiglu_nodeops
 // ===================================================================
+// w = silu(x @ a^T + b) * (x @ c^T + d). On CPU the plugin runs both
+// projections as one GEMM over the concatenated weight and applies the gating
+// in the epilogue; the gate and up pre-activations go on the tape so the
+// backward does not recompute them.
 std::shared_ptr<Node> swiglu_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d){ 
-    // Gate projection
-    Tensor y = OwnTensor::matmul(x->value, a->value.t()) + b->value; 
-    
-    // SiLU (Swish) activation on the gate: y * sigmoid(y)
-    Tensor q = y * (1.0f / (1.0f + OwnTensor::exp(y * -1.0f)));
-    
-    // Value projection and final multiplication
-    Tensor w = q * (OwnTensor::matmul(x->value, c->value.t()) + d->value);
+    const Tensor& X = x->value;
+    auto& K = ag::kernels::cpu();
+    const bool fused = K.swiglu_fwd && X.shape().dims.size() == 2 &&
+                       is_cpu_f32(X) && is_cpu_f32(a->value) && is_cpu_f32(b->value) &&
+                       is_cpu_f32(c->value) && is_cpu_f32(d->value);
+
+    Tensor w, g, u;
+    if (fused) {
+        const int64_t Bn = X.shape().dims[0];
+        const int64_t In = X.shape().dims[1];
+        const int64_t H  = a->value.shape().dims[0];
+        if (a->value.shape().dims[1] != In || c->value.shape().dims[0] != H || c->value.shape().dims[1] != In ||
+            b->value.numel() != H || d->value.numel() != H) {
+            throw std::runtime_error("swiglu: expected x [B,In], a/c [H,In] and b/d with H elements");
+        }
+        Tensor Xc = X.contiguous(), Ac = a->value.contiguous(), Bc = b->value.contiguous();
+        Tensor Cc = c->value.contiguous(), Dc = d->value.contiguous();
+        w = Tensor(Shape{{Bn, H}}, ag::options(X));
+        g = Tensor(Shape{{Bn, H}}, ag::options(X));
+        u = Tensor(Shape{{Bn, H}}, ag::options(X));
+        K.swiglu_fwd(Xc.data<float>(), Ac.data<float>(), Bc.data<float>(), Cc.data<float>(), Dc.data<float>(),
+                     w.data<float>(), g.data<float>(), u.data<float>(), (int)Bn, (int)In, (int)H);
+    } else {
+        // Gate projection
+        Tensor y = OwnTensor::matmul(X, a->value.t()) + b->value; 
+        
+        // SiLU (Swish) activation on the gate: y * sigmoid(y)
+        Tensor q = y * (1.0f / (1.0f + OwnTensor::exp(y * -1.0f)));
+        
+        // Value projection and final multiplication
+        w = q * (OwnTensor::matmul(X, c->value.t()) + d->value);
+    }
     
     auto n = std::make_shared<Node>(w, Op::SWIGLU, (x->requires_grad() || a->requires_grad() || b->requires_grad() || c->requires_grad() || d-> requires_grad()) , "swiglu"); 
     n->inputs={x, a, b, c, d};
+    if (fused) n->tape = {std::make_shared<Tensor>(g), std::make_shared<Tensor>(u)};
     ag::debug::on_node_created(n); 
     return n;
 }
@@ -606,7 +1258,7 @@ std::shared_ptr<Node> swiglu_nodeops(const std::shared_ptr<Node>& x, const std::
 // ============================================================================
  
 std::shared_ptr<Node> sum_nodeops(const std::shared_ptr<Node>& x){
-    Tensor y = OwnTensor::reduce_sum(x->value, {}, false);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_SUM);
     auto n = std::make_shared<Node>(y, Op::Sum, x->requires_grad(), "sum");
     n->inputs = {x};
     ag::debug::on_node_created(n);
@@ -631,12 +1283,167 @@ std::shared_ptr<Node> transpose_nodeops(const std::shared_ptr<Node>& x){
 }
 
 
+// ============================================================================
+// Shape / layout: reshape, narrow, expand, concat
+// ============================================================================
+// reshape is a view of its input. narrow and concat see a tensor as
+// [outer, n, inner] around the chosen dim, so every piece is `outer`
+// contiguous runs of len*inner floats copied once, straight into an output of
+// the final shape; their VJPs add gy into the parent's grad region in place.
+
+void copy_blocks(const float* src, int64_t src_len, int64_t start, float* dst, int64_t dst_len, int64_t at,
+                 int64_t outer, int64_t len, int64_t inner, bool accumulate) {
+    const int64_t run = len * inner;
+    for (int64_t o = 0; o < outer; ++o) {
+        const float* s = src + (o * src_len + start) * inner;
+        float* d = dst + (o * dst_len + at) * inner;
+        if (accumulate) {
+            for (int64_t i = 0; i < run; ++i) d[i] += s[i];
+        } else {
+            std::copy_n(s, run, d);
+        }
+    }
+}
+
+static int64_t wrap_dim(int64_t dim, size_t rank, const char* what) {
+    const int64_t r = static_cast<int64_t>(rank);
+    if (dim < -r || dim >= r) throw std::runtime_error(std::string(what) + ": dim out of range");
+    return dim < 0 ? dim + r : dim;
+}
+
+std::shared_ptr<Node> reshape_nodeops(const std::shared_ptr<Node>& x, const std::vector<int64_t>& shape){
+    std::vector<int64_t> dims = shape;
+    int64_t known = 1, infer = -1;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        if (dims[i] == -1 && infer < 0) infer = static_cast<int64_t>(i);
+        else known *= dims[i];
+    }
+    const int64_t numel = static_cast<int64_t>(x->value.numel());
+    if (infer >= 0 && known > 0) dims[infer] = numel / known;
+    int64_t total = 1;
+    for (int64_t d : dims) total *= d;
+    if (total != numel) throw std::runtime_error("reshape: shape does not match the number of elements");
+
+    Tensor y = x->value.reshape(Shape{dims});
+    auto n = std::make_shared<Node>(y, Op::Reshape, x->requires_grad(), "reshape");
+    n->inputs = {x};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
+std::shared_ptr<Node> narrow_nodeops(const std::shared_ptr<Node>& x, int64_t dim, int64_t start, int64_t length){
+    const auto& xs = x->value.shape().dims;
+    dim = wrap_dim(dim, xs.size(), "narrow");
+    if (start < 0 || length < 0 || start + length > xs[dim]) {
+        throw std::runtime_error("narrow: [start, start + length) is outside the dim");
+    }
+    int64_t outer = 1, inner = 1;
+    for (int64_t i = 0; i < dim; ++i) outer *= xs[i];
+    for (size_t i = dim + 1; i < xs.size(); ++i) inner *= xs[i];
+
+    std::vector<int64_t> ydims = xs;
+    ydims[dim] = length;
+    Tensor xh = host_f32(x->value, "narrow");
+    Tensor y(Shape{ydims}, TensorOptions().with_dtype(Dtype::Float32));
+    copy_blocks(xh.data<float>(), xs[dim], start, y.data<float>(), length, 0, outer, length, inner, false);
+    if (!x->value.is_cpu()) y = y.to(x->value.device());
+
+    Tensor cfgT = Tensor::zeros(Shape{{1, 3}}, TensorOptions().with_req_grad(false));
+    cfgT.data<float>()[0] = static_cast<float>(dim);
+    cfgT.data<float>()[1] = static_cast<float>(start);
+    cfgT.data<float>()[2] = static_cast<float>(length);
+    auto cfg = make_tensor(cfgT, "narrow_cfg");
+
+    auto n = std::make_shared<Node>(y, Op::Narrow, x->requires_grad(), "narrow");
+    n->inputs = {x, cfg.node};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
+std::shared_ptr<Node> expand_nodeops(const std::shared_ptr<Node>& x, const std::vector<int64_t>& shape){
+    const auto& xs = x->value.shape().dims;
+    const size_t r = shape.size();
+    if (xs.size() > r) throw std::runtime_error("expand: target shape has fewer dims than x");
+    // x's dims align to the right; size-1 (or missing) dims repeat with stride 0.
+    std::vector<int64_t> xstride(r, 0);
+    int64_t s = 1;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const size_t k = xs.size() - 1 - i, j = r - 1 - i;
+        if (xs[k] != shape[j] && xs[k] != 1) throw std::runtime_error("expand: only size-1 dims can be expanded");
+        xstride[j] = xs[k] == 1 ? 0 : s;
+        s *= xs[k];
+    }
+    Tensor xh = host_f32(x->value, "expand");
+    Tensor y(Shape{shape}, TensorOptions().with_dtype(Dtype::Float32));
+    const float* src = xh.data<float>();
+    float* dst = y.data<float>();
+    std::vector<int64_t> idx(r, 0);
+    const int64_t numel = static_cast<int64_t>(y.numel());
+    int64_t off = 0;
+    for (int64_t e = 0; e < numel; ++e) {
+        dst[e] = src[off];
+        // Odometer over the output index, keeping the source offset in step.
+        for (size_t j = r; j-- > 0;) {
+            if (++idx[j] < shape[j]) { off += xstride[j]; break; }
+            off -= xstride[j] * (shape[j] - 1);
+            idx[j] = 0;
+        }
+    }
+    if (!x->value.is_cpu()) y = y.to(x->value.device());
+
+    auto n = std::make_shared<Node>(y, Op::Expand, x->requires_grad(), "expand");
+    n->inputs = {x};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
+std::shared_ptr<Node> concat_nodeops(const std::vector<std::shared_ptr<Node>>& xs, int64_t dim){
+    if (xs.empty()) throw std::runtime_error("concat: no inputs");
+    std::vector<int64_t> ydims = xs[0]->value.shape().dims;
+    dim = wrap_dim(dim, ydims.size(), "concat");
+    int64_t total = 0;
+    bool req = false;
+    for (const auto& x : xs) {
+        std::vector<int64_t> d = x->value.shape().dims;
+        if (d.size() != ydims.size()) throw std::runtime_error("concat: inputs must have the same rank");
+        total += d[dim];
+        d[dim] = ydims[dim];
+        if (d != ydims) throw std::runtime_error("concat: inputs must agree on every dim but the concat dim");
+        req = req || x->requires_grad();
+    }
+    ydims[dim] = total;
+    int64_t outer = 1, inner = 1;
+    for (int64_t i = 0; i < dim; ++i) outer *= ydims[i];
+    for (size_t i = dim + 1; i < ydims.size(); ++i) inner *= ydims[i];
+
+    // Each input is written straight into its slot of the preallocated output.
+    Tensor y(Shape{ydims}, TensorOptions().with_dtype(Dtype::Float32));
+    int64_t at = 0;
+    for (const auto& x : xs) {
+        const int64_t len = x->value.shape().dims[dim];
+        Tensor xh = host_f32(x->value, "concat");
+        copy_blocks(xh.data<float>(), len, 0, y.data<float>(), total, at, outer, len, inner, false);
+        at += len;
+    }
+    if (!xs[0]->value.is_cpu()) y = y.to(xs[0]->value.device());
+
+    Tensor cfgT = Tensor::full(Shape{{1, 1}}, TensorOptions().with_req_grad(false), static_cast<float>(dim));
+    auto cfg = make_tensor(cfgT, "concat_dim");
+
+    auto n = std::make_shared<Node>(y, Op::Concat, req, "concat");
+    n->inputs = xs;
+    n->inputs.push_back(cfg.node);
+    ag::debug::on_node_created(n);
+    return n;
+}
+
 // ============================================================================
 // exp_nodeops
 // ============================================================================
 
 std::shared_ptr<Node> exp_nodeops(const std::shared_ptr<Node>& x){
-    Tensor y = OwnTensor::exp(x->value);
+    Tensor y;
+    if (!unary_kernel(AG_UNARY_EXP, x->value, y)) y = OwnTensor::exp(x->value);
     
     // 3. Use the correct Node constructor.
     auto n = std::make_shared<Node>(y, Op::Exp, x->requires_grad(), "exp");
@@ -687,7 +1494,9 @@ std::shared_ptr<Node> mish_nodeops(const std::shared_ptr<Node>& x){
     //  - Call the appropriate backend (CPU or CUDA kernel).
     //  - Get the current stream from the context if it's on the GPU.
     //  - Queue the operation asynchronously on that stream.
-    Tensor y = OwnTensor::tanh(x->value);
+    // On CPU the v2 plugin kernel goes first.
+    Tensor y;
+    if (!unary_kernel(AG_UNARY_TANH, x->value, y)) y = OwnTensor::tanh(x->value);
 
     // 2. Wrap the result in a new Node using the correct constructor.
     auto n = std::make_shared<Node>(y, Op::Tanh, x->requires_grad(), "tanh");
@@ -702,7 +1511,8 @@ std::shared_ptr<Node> mish_nodeops(const std::shared_ptr<Node>& x){
 std::shared_ptr<Node> sigmoid_nodeops(const std::shared_ptr<Node>& x){
     // Implement sigmoid using OwnTensor ops: 1 / (1 + exp(-x))
     // All operations are stream-aware.
-    Tensor y = 1.0f / (1.0f + OwnTensor::exp(x->value * -1.0f));
+    Tensor y;
+    if (!unary_kernel(AG_UNARY_SIGMOID, x->value, y)) y = 1.0f / (1.0f + OwnTensor::exp(x->value * -1.0f));
 
     auto n = std::make_shared<Node>(y, Op::Sigmoid, x->requires_grad(), "sigmoid"); 
     n->inputs={x}; 
@@ -763,6 +1573,14 @@ std::shared_ptr<Node> gaus_nodeops(const std::shared_ptr<Node>& x){
 // ===================================================================
 
 std::shared_ptr<Node> gelu_nodeops(const std::shared_ptr<Node>& x){
+    // On CPU one pass of the v2 plugin kernel replaces the expression below.
+    Tensor y;
+    if (unary_kernel(AG_UNARY_GELU, x->value, y)) {
+        auto n = std::make_shared<Node>(y, Op::GELU, x->requires_grad(), "gelu");
+        n->inputs={x};
+        ag::debug::on_node_created(n);
+        return n;
+    }
     // All of these operations will correctly use the thread-local stream context.
 
     // Constants for the GELU approximation
@@ -776,7 +1594,7 @@ std::shared_ptr<Node> gelu_nodeops(const std::shared_ptr<Node>& x){
     Tensor u = (x->value + x3 * c2) * c1;
 
     // 3. Calculate the full GELU formula: 0.5 * x * (1 + tanh(u))
-    Tensor y = x->value * (1.0f + OwnTensor::tanh(u)) * 0.5f;
+    y = x->value * (1.0f + OwnTensor::tanh(u)) * 0.5f;
     
     auto n = std::make_shared<Node>(y, Op::GELU, x->requires_grad(), "gelu");
     n->inputs={x};
@@ -799,13 +1617,16 @@ std::shared_ptr<Node> gcu_nodeops(const std::shared_ptr<Node>& x){
 // silu_nodeops
 // ===================================================================
 std::shared_ptr<Node> silu_nodeops(const std::shared_ptr<Node>& x){
-    // All of these operations will correctly use the thread-local stream context.
-    
-    // 1. Implement sigmoid: 1 / (1 + exp(-x))
-    Tensor sig_x = 1.0f / (1.0f + OwnTensor::exp(x->value * -1.0f));
+    Tensor y;
+    if (!unary_kernel(AG_UNARY_SILU, x->value, y)) {
+        // All of these operations will correctly use the thread-local stream context.
 
-    // 2. Implement silu: x * sigmoid(x)
-    Tensor y = x->value * sig_x;
+        // 1. Implement sigmoid: 1 / (1 + exp(-x))
+        Tensor sig_x = 1.0f / (1.0f + OwnTensor::exp(x->value * -1.0f));
+
+        // 2. Implement silu: x * sigmoid(x)
+        y = x->value * sig_x;
+    }
     
     auto n = std::make_shared<Node>(y, Op::SiLU, x->requires_grad(), "silu");
     n->inputs={x};
@@ -848,6 +1669,26 @@ std::shared_ptr<Node> lisht_nodeops(const std::shared_ptr<Node>& x){
 std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float alpha){ 
     // All of these operations will correctly use the thread-local stream context.
     
+    // We still need to pass alpha to the backward pass. Create a 1x1 constant node.
+    // NOTE: This now creates a NEW tensor with requires_grad=false.
+    Tensor aT = Tensor::full(Shape{{1, 1}}, TensorOptions().with_req_grad(false), alpha);
+    auto aC = make_tensor(aT, "alpha"); 
+
+    // CPU plugin path: Y plus the packed x > 0 bitmask the backward reads.
+    auto& K = ag::kernels::cpu();
+    if (K.leakyrelu_fwd_mask && is_cpu_f32(x->value)) {
+        Tensor Xc = x->value.contiguous();
+        Tensor Y(Xc.shape(), ag::options(Xc));
+        Tensor M = sign_mask_storage(Xc.numel());
+        K.leakyrelu_fwd_mask(Xc.data<float>(), Y.data<float>(),
+                             reinterpret_cast<unsigned char*>(M.data<float>()), Xc.numel(), alpha);
+        auto n = std::make_shared<Node>(Y, Op::LeakyRelu, x->requires_grad(), "leakyrelu");
+        n->inputs = {x, aC.node};
+        if (x->requires_grad()) n->tape = {std::make_shared<Tensor>(M)};
+        ag::debug::on_node_created(n);
+        return n;
+    }
+    
     // --- Re-implement Leaky ReLU using only arithmetic operations ---
     
     // 1. Isolate the positive part of x: (x + abs(x)) * 0.5
@@ -860,11 +1701,6 @@ std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float a
     Tensor Y = pos_part + (neg_part * alpha);
     
     // --- End of re-implementation ---
-
-    // We still need to pass alpha to the backward pass. Create a 1x1 constant node.
-    // NOTE: This now creates a NEW tensor with requires_grad=false.
-    Tensor aT = Tensor::full(Shape{{1, 1}}, TensorOptions().with_req_grad(false), alpha);
-    auto aC = make_tensor(aT, "alpha"); 
     
     auto n = std::make_shared<Node>(Y, Op::LeakyRelu, x->requires_grad(), "leakyrelu");
     n->inputs = {x, aC.node}; 
@@ -876,7 +1712,7 @@ std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float a
 // ============================================================================================
     std::shared_ptr<Node> rowsum_nodeops(const std::shared_ptr<Node>& x){
     // Reduce over axis 1 (the columns), and keep the dimension so shape goes from [B,C] to [B,1].
-    Tensor y = OwnTensor::reduce_sum(x->value, {1}, true);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_SUM, {1}, true);
     auto n = std::make_shared<Node>(y, Op::RowSum, x->requires_grad(), "rowsum");
     n->inputs = {x};
     ag::debug::on_node_created(n);
@@ -888,7 +1724,7 @@ std::shared_ptr<Node> leaky_relu_nodeops(const std::shared_ptr<Node>& x, float a
 // ===================================================================
 std::shared_ptr<Node> rowmax_nodeops(const std::shared_ptr<Node>& x){
     // Reduce over axis 1 (columns) and keep the dimension.
-    Tensor y = OwnTensor::reduce_max(x->value, {1}, true);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_MAX, {1}, true);
     auto n = std::make_shared<Node>(y, Op::RowMax, x->requires_grad(), "rowmax");
     n->inputs={x};
     ag::debug::on_node_created(n);
@@ -897,47 +1733,78 @@ std::shared_ptr<Node> rowmax_nodeops(const std::shared_ptr<Node>& x){
 
 
 // ===================================================================
-// rms_nodeops
+// Row normalization helpers (rms / realrms / laynor / relaynor)
 // ===================================================================
+// All four ops normalize over the last axis and keep only per-row statistics
+// on the tape: mean (LayerNorm family) and rstd = 1/sqrt(var + eps), both
+// shaped like x with the last axis reduced to 1. On CPU float32 the plugin's
+// Welford row kernels produce y and the statistics in one call.
+static Shape row_stat_shape(const Tensor& x) {
+    Shape s = x.shape();
+    s.dims.back() = 1;
+    return s;
+}
 
-// ... inside namespace ag::detail
-std::shared_ptr<Node> rms_nodeops(const std::shared_ptr<Node>& x){
-    // Calculate x^2
-    Tensor x_squared = x->value * x->value;
+// Reads the scalar learned gain/bias of relaynor/realrms.
+static float scalar_of(const std::shared_ptr<Node>& p) {
+    return p->value.to_cpu().data<float>()[0];
+}
 
-    // Calculate the mean along the last dimension.
-    Tensor variance = OwnTensor::reduce_mean(x_squared, {-1}, true);
+// y = normalize(x) * gamma + beta for a scalar gamma/beta.
+// mean is left empty for RMSNorm.
+static Tensor norm_forward(const Tensor& X, bool center, float gamma, float beta, bool affine,
+                           Tensor& mean, Tensor& rstd) {
+    auto& K = ag::kernels::cpu();
+    const int64_t cols = X.shape().dims.back();
+    if (is_cpu_f32(X) && (center ? K.layernorm_fwd != nullptr : K.rmsnorm_fwd != nullptr)) {
+        Tensor Xc = X.contiguous();
+        Tensor y(X.shape(), ag::options(X));
+        rstd = Tensor(row_stat_shape(X), TensorOptions().with_dtype(Dtype::Float32));
+        std::vector<float> g(affine ? cols : 0, gamma), b(affine ? cols : 0, beta);
+        if (center) {
+            mean = Tensor(row_stat_shape(X), TensorOptions().with_dtype(Dtype::Float32));
+            K.layernorm_fwd(Xc.data<float>(), affine ? g.data() : nullptr, affine ? b.data() : nullptr,
+                            y.data<float>(), mean.data<float>(), rstd.data<float>(), X.numel() / cols, cols, kNormEps);
+        } else {
+            K.rmsnorm_fwd(Xc.data<float>(), affine ? g.data() : nullptr,
+                          y.data<float>(), rstd.data<float>(), X.numel() / cols, cols, kNormEps);
+        }
+        return y;
+    }
 
-    // Calculate the reciprocal square root (rsqrt) with an epsilon for stability.
-    Tensor rsqrt_var = 1.0f / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
+    Tensor xhat;
+    if (center) {
+        mean = reduce_axes(X, AG_REDUCE_MEAN, {-1}, true);
+        Tensor x_minus_mean = X - mean;
+        Tensor variance = reduce_axes(x_minus_mean * x_minus_mean, AG_REDUCE_MEAN, {-1}, true);
+        rstd = 1.0f / OwnTensor::sqrt(variance + kNormEps, ag::current_stream());
+        xhat = x_minus_mean * rstd;
+    } else {
+        Tensor variance = reduce_axes(X * X, AG_REDUCE_MEAN, {-1}, true);
+        rstd = 1.0f / OwnTensor::sqrt(variance + kNormEps, ag::current_stream());
+        xhat = X * rstd;
+    }
+    return affine ? xhat * gamma + beta : xhat;
+}
 
-    // Normalize x
-    Tensor y = x->value * rsqrt_var;
+// ===================================================================
+// rms_nodeops
+// ===================================================================
+std::shared_ptr<Node> rms_nodeops(const std::shared_ptr<Node>& x){
+    Tensor mean, rstd;
+    Tensor y = norm_forward(x->value, /*center=*/false, 1.0f, 0.0f, /*affine=*/false, mean, rstd);
 
     auto n = std::make_shared<Node>(y, Op::RMSNorm, x->requires_grad(), "rmsnorm");
-    // --- FIX START ---
-    // The backward pass needs rsqrt_var and the normalized output 'y'.
-    n->tape.push_back(std::make_shared<Tensor>(rsqrt_var));
-    n->tape.push_back(std::make_shared<Tensor>(x->value)); // Incorrectly saving original x
-    n->tape.push_back(std::make_shared<Tensor>(y));         // Correctly save the normalized output y
-    // --- FIX END ---
+    n->tape.push_back(std::make_shared<Tensor>(rstd));
     n->inputs = {x};
     ag::debug::on_node_created(n);
     return n;
 }
-// ... rest of the file
 
 // ===================================================================
-// In file: cgadimpl/src/nodeops.cpp (Corrected)
+// realrms_nodeops
 // ===================================================================
 std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g_val){ // Pass g by value
-    const float inv_cols = 1.0f / static_cast<float>(x->value.shape().dims.back());
-    
-    // Calculate mean of squares along the last dim
-    Tensor variance = OwnTensor::reduce_sum(x->value * x->value, {-1}, true) * inv_cols;
-    Tensor rsqrt_var = 1.0f / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
-    Tensor y_normalized = x->value * rsqrt_var;
-    
     // Use our scalar caching mechanism for the gain 'g'
     static std::unordered_map<float, std::shared_ptr<Node>> scalar_cache;
     std::shared_ptr<Node> G;
@@ -950,11 +1817,11 @@ std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g_v
         scalar_cache[g_val] = G;
     }
 
-    Tensor y_scaled = y_normalized * G->value;
+    Tensor mean, rstd;
+    Tensor y_scaled = norm_forward(x->value, /*center=*/false, scalar_of(G), 0.0f, /*affine=*/true, mean, rstd);
 
-    auto n = std::make_shared<Node>(y_scaled, Op::RealRMSNorm, x->requires_grad(), "realrmsnorm");
-    n->tape.push_back(std::make_shared<Tensor>(rsqrt_var));
-    n->tape.push_back(std::make_shared<Tensor>(y_normalized));
+    auto n = std::make_shared<Node>(y_scaled, Op::RealRMSNorm, (x->requires_grad() || G->requires_grad()), "realrmsnorm");
+    n->tape.push_back(std::make_shared<Tensor>(rstd));
     n->inputs = {x, G};
     ag::debug::on_node_created(n);
     return n;
@@ -964,19 +1831,12 @@ std::shared_ptr<Node> realrms_nodeops(const std::shared_ptr<Node>& x, float& g_v
 // laynor_nodeops
 // ===================================================================
 std::shared_ptr<Node> laynor_nodeops(const std::shared_ptr<Node>& x){
-    // 1. Calculate mean across the last dimension
-    Tensor mean = OwnTensor::reduce_mean(x->value, {-1}, true);
-    
-    // 2. Calculate variance across the last dimension
-    Tensor x_minus_mean = x->value - mean;
-    Tensor variance = OwnTensor::reduce_mean(x_minus_mean * x_minus_mean, {-1}, true);
-    
-    // 3. Normalize
-    Tensor y = x_minus_mean / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
-    
+    Tensor mean, rstd;
+    Tensor y = norm_forward(x->value, /*center=*/true, 1.0f, 0.0f, /*affine=*/false, mean, rstd);
+
     auto n = std::make_shared<Node>(y, Op::LayerNorm, x->requires_grad(), "layernorm");
-    n->tape.push_back(std::make_shared<Tensor>(variance));
     n->tape.push_back(std::make_shared<Tensor>(mean));
+    n->tape.push_back(std::make_shared<Tensor>(rstd));
     n->inputs = {x};
     ag::debug::on_node_created(n);
     return n;
@@ -986,15 +1846,7 @@ std::shared_ptr<Node> laynor_nodeops(const std::shared_ptr<Node>& x){
 // relaynor_nodeops
 // ===================================================================
 std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b_val, float& g_val){
-    // 1. Calculate mean and variance
-    Tensor mean = OwnTensor::reduce_mean(x->value, {-1}, true);
-    Tensor x_minus_mean = x->value - mean;
-    Tensor variance = OwnTensor::reduce_mean(x_minus_mean * x_minus_mean, {-1}, true);
-    
-    // 2. Normalize
-    Tensor y_normalized = x_minus_mean / OwnTensor::sqrt(variance + 1e-5f, ag::current_stream());
-
-    // 3. Create or cache scalar nodes for gain and bias
+    // Create or cache scalar nodes for gain and bias
     static std::unordered_map<float, std::shared_ptr<Node>> cache;
     std::shared_ptr<Node> G, B;
     if (cache.count(g_val)) G = cache[g_val];
@@ -1008,13 +1860,12 @@ std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b_
         cache[b_val] = B;
     }
 
-    // 4. Apply scale and shift
-    Tensor y = y_normalized * G->value + B->value;
+    Tensor mean, rstd;
+    Tensor y = norm_forward(x->value, /*center=*/true, scalar_of(G), scalar_of(B), /*affine=*/true, mean, rstd);
 
-    auto n = std::make_shared<Node>(y, Op::RealLayerNorm, x->requires_grad(), "reallayernorm");
-    n->tape.push_back(std::make_shared<Tensor>(variance));
+    auto n = std::make_shared<Node>(y, Op::RealLayerNorm, (x->requires_grad() || G->requires_grad() || B->requires_grad()), "reallayernorm");
     n->tape.push_back(std::make_shared<Tensor>(mean));
-    n->tape.push_back(std::make_shared<Tensor>(y_normalized));
+    n->tape.push_back(std::make_shared<Tensor>(rstd));
     n->inputs = {x, G, B};
     ag::debug::on_node_created(n);
     return n;
@@ -1025,7 +1876,7 @@ std::shared_ptr<Node> relaynor_nodeops(const std::shared_ptr<Node>& x, float& b_
 // ===================================================================
 std::shared_ptr<Node> mean_all_nodeops(const std::shared_ptr<Node>& x){
     // reduce_mean with empty axes reduces over the entire tensor
-    Tensor y = OwnTensor::reduce_mean(x->value);
+    Tensor y = reduce_axes(x->value, AG_REDUCE_MEAN);
     auto n = std::make_shared<Node>(y, Op::MeanAll, x->requires_grad(), "meanall");
     n->inputs={x};
     ag::debug::on_node_created(n);
@@ -1062,14 +1913,14 @@ std::shared_ptr<Node> dyntanh_nodeops(const std::shared_ptr<Node>& x, float& a_v
 std::shared_ptr<Node> softmax_row_nodeops(const std::shared_ptr<Node>& z){ 
     // 1. Find the max value along the rows (last dimension) for numerical stability.
     // The `true` for keepdim ensures the result has shape [B, 1] for broadcasting.
-    Tensor max_val = OwnTensor::reduce_max(z->value, {-1}, true);
+    Tensor max_val = reduce_axes(z->value, AG_REDUCE_MAX, {-1}, true);
     
     // 2. Subtract the max and exponentiate.
     Tensor z_shifted = z->value - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
     
     // 3. Sum the exponents along the rows.
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     
     // 4. Divide to get the final softmax probabilities.
     Tensor y = exp_z / sum_exp_z;
@@ -1085,14 +1936,14 @@ std::shared_ptr<Node> softmax_row_nodeops(const std::shared_ptr<Node>& z){
 // ===================================================================
 std::shared_ptr<Node> logsumexp_row_nodeops(const std::shared_ptr<Node>& z){ 
     // 1. Find the max value along the rows (last dimension).
-    Tensor max_val = OwnTensor::reduce_max(z->value, {-1}, true);
+    Tensor max_val = reduce_axes(z->value, AG_REDUCE_MAX, {-1}, true);
     
     // 2. Subtract the max and exponentiate.
     Tensor z_shifted = z->value - max_val;
     Tensor exp_z = OwnTensor::exp(z_shifted);
     
     // 3. Sum the exponents along the rows and take the log.
-    Tensor sum_exp_z = OwnTensor::reduce_sum(exp_z, {-1}, true);
+    Tensor sum_exp_z = reduce_axes(exp_z, AG_REDUCE_SUM, {-1}, true);
     Tensor log_sum = OwnTensor::log(sum_exp_z);
     
     // 4. Add the max value back.
@@ -1107,56 +1958,48 @@ std::shared_ptr<Node> logsumexp_row_nodeops(const std::shared_ptr<Node>& z){
 // ===================================================================
 // mambassm_nodeops
 // ===================================================================
-std::shared_ptr<Node> mambassm_nodeops(const std::shared_ptr<Node>& z, const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d){
-
-    // All ops will use the stream from the context.
-    
-    if (z->tape.empty()) {
-        // --- Initialization Step ---
-        Tensor w = OwnTensor::matmul(z->value, b->value); 
-        Tensor q = OwnTensor::matmul(w, c->value);
-        Tensor y = (z->value * d->value) + q;
-
-        // Create a new leaf node for the initial state 'w'. It is not a parameter.
-        auto W = std::make_shared<Node>(w, Op::Leaf, "ssm_state");
-        
-        // The Op was wrong here, let's assume it should be a custom 'MambaSSM' Op
-        // Use a generic but existing Op as a placeholder. The final operation is an addition.
-        auto n = std::make_shared<Node>(y, Op::Add, "mambassm");
-        
-        // The inputs to this step are the original inputs plus the NEW state node.
-        n->inputs = {z, a, b, c, d, W}; 
-        
-        // Save the state for the NEXT step in the tape of the ORIGINAL input 'z'.
-        z->tape.push_back(std::make_shared<Tensor>(w));
-        
-        ag::debug::on_node_created(n);  
-        std::cout << "Initialized SSM state" << std::endl;
-        return n;
-    } else {
-        // --- Recurrent Step ---
-        
-        // Get the previous state 'w' from the tape of the input 'z'.
-        const Tensor& prev_w = *z->tape.back();
-        
-        Tensor w = OwnTensor::matmul(z->value, b->value) + prev_w; 
-        Tensor q = OwnTensor::matmul(w, c->value);
-        Tensor y = (z->value * d->value) + q;
-
-        // Create a new leaf node for the CURRENT state 'w'.
-        auto W = std::make_shared<Node>(w, Op::Leaf, "ssm_state");
-        
-        // Use a generic but existing Op as a placeholder. The final operation is an addition.
-        auto n = std::make_shared<Node>(y, Op::Add, "mambassm");
-        n->inputs = {z, a, b, c, d, W}; 
-        
-        // Update the tape of the input 'z' with the new state for the next step.
-        z->tape.push_back(std::make_shared<Tensor>(w));
+// Selective scan over a whole sequence as one node:
+//   h_t = exp(a_t) * h_{t-1} + b_t x_t,   y_t = c_t . h_t + d * x_t
+// x, a: [T,D] or [B,T,D] (a is the input-dependent log-decay), b, c: [T,N]
+// or [B,T,N], d: D elements. The plugin runs a chunked parallel scan and only
+// the state entering each chunk of kMambaScanChunk steps goes on the tape.
+std::shared_ptr<Node> mambassm_nodeops(const std::shared_ptr<Node>& x, const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& c, const std::shared_ptr<Node>& d){
+    const Tensor& X = x->value;
+    const auto& xs = X.shape().dims;
+    if (xs.size() != 2 && xs.size() != 3) {
+        throw std::runtime_error("mambassm: x must be [T,D] or [B,T,D]");
+    }
+    const int64_t Bt = xs.size() == 3 ? xs[0] : 1;
+    const int64_t T  = xs[xs.size() - 2];
+    const int64_t D  = xs.back();
+    const int64_t N  = b->value.shape().dims.back();
+    if (a->value.numel() != X.numel() || b->value.numel() != Bt * T * N ||
+        c->value.numel() != Bt * T * N || d->value.numel() != D) {
+        throw std::runtime_error("mambassm: expected a like x, b and c [B,T,N], d with D elements");
+    }
 
-        ag::debug::on_node_created(n);  
-        std::cout << "SSM step" << std::endl;
-        return n;
+    auto& K = ag::kernels::cpu();
+    if (!K.ssm_scan_fwd) {
+        throw std::runtime_error("mambassm: selective scan needs ssm_scan_fwd from the CPU kernel plugin");
     }
+    Tensor xh = host_f32(X, "mambassm"), ah = host_f32(a->value, "mambassm");
+    Tensor bh = host_f32(b->value, "mambassm"), ch = host_f32(c->value, "mambassm");
+    Tensor dh = host_f32(d->value, "mambassm");
+
+    const int64_t nck = (T + kMambaScanChunk - 1) / kMambaScanChunk;
+    auto host = TensorOptions().with_dtype(Dtype::Float32);
+    Tensor y(X.shape(), host);
+    Tensor hb(Shape{{Bt, nck, D, N}}, host);
+    K.ssm_scan_fwd(xh.data<float>(), ah.data<float>(), bh.data<float>(), ch.data<float>(), dh.data<float>(),
+                   y.data<float>(), hb.data<float>(), (int)Bt, (int)T, (int)D, (int)N, kMambaScanChunk);
+    if (!X.is_cpu()) y = y.to(X.device());
+
+    const bool req = x->requires_grad() || a->requires_grad() || b->requires_grad() || c->requires_grad() || d->requires_grad();
+    auto n = std::make_shared<Node>(y, Op::MambaSSM, req, "mambassm");
+    n->inputs = {x, a, b, c, d};
+    n->tape = {std::make_shared<Tensor>(hb)}; // stays on the host, only the backward scan reads it
+    ag::debug::on_node_created(n);
+    return n;
 }
 
 // ===================================================================
@@ -1171,16 +2014,16 @@ std::shared_ptr<Node> cross_entropy_with_logits_nodeops(const std::shared_ptr<No
     // 1. Calculate log(softmax(Z)) in a numerically stable way.
     //    logsoftmax(z) = z - log(sum(exp(z)))
     //    stable_logsoftmax(z) = z - (log(sum(exp(z - max(z)))) + max(z))
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
-    Tensor log_sum_exp = OwnTensor::log(OwnTensor::reduce_sum(OwnTensor::exp(z_shifted), {-1}, true));
+    Tensor log_sum_exp = OwnTensor::log(reduce_axes(OwnTensor::exp(z_shifted), AG_REDUCE_SUM, {-1}, true));
     Tensor log_sm = z_shifted - log_sum_exp;
 
     // 2. Calculate the cross-entropy loss: -mean(sum(Y * log_sm))
     // The sum is over the class dimension (-1), the mean is over the batch dimension (0).
     Tensor prod = Y * log_sm;
-    Tensor sum_prod = OwnTensor::reduce_sum(prod, {-1}); // Sum over classes, shape=[B]
-    Tensor loss = OwnTensor::reduce_mean(sum_prod * -1.0f); // Mean over batch and negate
+    Tensor sum_prod = reduce_axes(prod, AG_REDUCE_SUM, {-1}); // Sum over classes, shape=[B]
+    Tensor loss = reduce_axes(sum_prod * -1.0f, AG_REDUCE_MEAN); // Mean over batch and negate
 
     auto n = std::make_shared<Node>(loss, Op::CeWithLogits, (logits->requires_grad() || onehot->requires_grad()), "ce_with_logits");
     n->inputs = {logits, onehot};
@@ -1188,6 +2031,76 @@ std::shared_ptr<Node> cross_entropy_with_logits_nodeops(const std::shared_ptr<No
     return n;
 }
 
+// ===================================================================
+// linear_cross_entropy_nodeops
+// ===================================================================
+// loss = mean_n( logsumexp_v(h_n . W_v + b_v) - (h_n . W_t + b_t) ),  t = targets[n]
+// W is [V, D] like nn::Linear. Targets are class indices; rows with a
+// negative target are ignored and excluded from the mean. On CPU the plugin
+// kernel streams over vocabulary chunks with a running logsumexp, so only
+// the per-row logsumexp [N,1] is kept on the tape and the [N,V] logits are
+// never materialized.
+Tensor onehot_from_indices(const std::vector<int64_t>& idx, int64_t classes, const Tensor& like) {
+    Tensor oh = Tensor::zeros(Shape{{(int64_t)idx.size(), classes}}, TensorOptions().with_dtype(Dtype::Float32));
+    float* p = oh.data<float>();
+    for (size_t i = 0; i < idx.size(); ++i) {
+        if (idx[i] >= 0) p[i * classes + idx[i]] = 1.0f;
+    }
+    return oh.to(like.device());
+}
+
+std::shared_ptr<Node> linear_cross_entropy_nodeops(const std::shared_ptr<Node>& h, const std::shared_ptr<Node>& W, const std::shared_ptr<Node>& b, const std::shared_ptr<Node>& targets){
+    const Tensor& H  = h->value;   // [N, D]
+    const Tensor& Wt = W->value;   // [V, D]
+    const Tensor& B  = b->value;   // [1, V] or [V]
+    const int64_t N = H.shape().dims[0];
+    const int64_t D = H.shape().dims[1];
+    const int64_t V = Wt.shape().dims[0];
+    if (Wt.shape().dims[1] != D || B.numel() != V) {
+        throw std::runtime_error("linear_cross_entropy: expected h [N,D], W [V,D] and b with V elements");
+    }
+    std::vector<int64_t> t = read_indices(targets->value);
+    if ((int64_t)t.size() != N) {
+        throw std::runtime_error("linear_cross_entropy: targets must hold one class index per row of h");
+    }
+    int64_t valid = 0;
+    for (int64_t ti : t) {
+        if (ti >= V) throw std::runtime_error("linear_cross_entropy: target index out of range");
+        valid += (ti >= 0);
+    }
+    const float inv_valid = valid > 0 ? 1.0f / static_cast<float>(valid) : 0.0f;
+
+    Tensor lse;
+    float loss_val = 0.0f;
+    auto& K = ag::kernels::cpu();
+    if (K.linear_xent_fwd && is_cpu_f32(H) && is_cpu_f32(Wt) && is_cpu_f32(B)) {
+        Tensor Hc = H.contiguous(), Wc = Wt.contiguous(), Bc = B.contiguous();
+        lse = Tensor(Shape{{N, 1}}, TensorOptions().with_dtype(Dtype::Float32));
+        std::vector<float> row_loss(N);
+        K.linear_xent_fwd(Hc.data<float>(), Wc.data<float>(), Bc.data<float>(), t.data(),
+                          lse.data<float>(), row_loss.data(), (int)N, (int)D, (int)V, kLinearCrossEntropyChunk);
+        double acc = 0.0;
+        for (float l : row_loss) acc += l;
+        loss_val = static_cast<float>(acc) * inv_valid;
+    } else {
+        // Reference path: materializes the logits once, same math as cross_entropy_with_logits.
+        Tensor Z = OwnTensor::matmul(H, Wt.t()) + B.reshape(Shape{{1, V}});
+        Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
+        lse = OwnTensor::log(reduce_axes(OwnTensor::exp(Z - max_val), AG_REDUCE_SUM, {-1}, true)) + max_val;
+        Tensor Y = onehot_from_indices(t, V, Z);
+        Tensor valid_rows = reduce_axes(Y, AG_REDUCE_SUM, {-1}, true);
+        Tensor row_loss = (lse - reduce_axes(Z * Y, AG_REDUCE_SUM, {-1}, true)) * valid_rows;
+        loss_val = reduce_axes(row_loss, AG_REDUCE_SUM).to_cpu().data<float>()[0] * inv_valid;
+    }
+    Tensor loss = Tensor::full(Shape{{1, 1}}, TensorOptions().with_dtype(H.dtype()).with_device(H.device()), loss_val);
+
+    auto n = std::make_shared<Node>(loss, Op::LinearCrossEntropy, (h->requires_grad() || W->requires_grad() || b->requires_grad()), "linear_cross_entropy");
+    n->inputs = {h, W, b, targets};
+    n->tape = {std::make_shared<Tensor>(lse)};
+    ag::debug::on_node_created(n);
+    return n;
+}
+
 // ===================================================================
 // kldivergence_nodeops
 // ===================================================================
@@ -1201,17 +2114,17 @@ std::shared_ptr<Node> kldivergence_nodeops(const std::shared_ptr<Node>& logits,
     Tensor log_Y = OwnTensor::log(Y + 1e-9f);
     
     // 2. Calculate stable log_softmax(Z) (same as in cross-entropy).
-    Tensor max_val = OwnTensor::reduce_max(Z, {-1}, true);
+    Tensor max_val = reduce_axes(Z, AG_REDUCE_MAX, {-1}, true);
     Tensor z_shifted = Z - max_val;
-    Tensor log_sum_exp = OwnTensor::log(OwnTensor::reduce_sum(OwnTensor::exp(z_shifted), {-1}, true));
+    Tensor log_sum_exp = OwnTensor::log(reduce_axes(OwnTensor::exp(z_shifted), AG_REDUCE_SUM, {-1}, true));
     Tensor log_sm_Z = z_shifted - log_sum_exp;
 
     // 3. Calculate the KL Divergence: sum(Y * (log(Y) - log_softmax(Z)))
     Tensor kl_div_elementwise = Y * (log_Y - log_sm_Z);
 
     // 4. Sum over the class dimension, then take the mean over the batch dimension.
-    Tensor sum_kl = OwnTensor::reduce_sum(kl_div_elementwise, {-1});
-    Tensor loss = OwnTensor::reduce_mean(sum_kl);
+    Tensor sum_kl = reduce_axes(kl_div_elementwise, AG_REDUCE_SUM, {-1});
+    Tensor loss = reduce_axes(sum_kl, AG_REDUCE_MEAN);
 
     auto n = std::make_shared<Node>(loss, Op::KLDivergence, (logits->requires_grad() || onehot->requires_grad()), "kldivergence");
     n->inputs = {logits, onehot};
@@ -1230,7 +2143,7 @@ std::shared_ptr<Node> mse_loss_nodeops(const std::shared_ptr<Node>& pred, const
     // --- THIS IS THE BUG ---
     // It should be reduce_mean, not reduce_sum. `reduce_mean` correctly
     // computes the VJP for the mean operation. `sum` has a different VJP.
-    Tensor loss = OwnTensor::reduce_mean(sq); 
+    Tensor loss = reduce_axes(sq, AG_REDUCE_MEAN); 
     // --- END BUG ---
 
     auto n = std::make_shared<Node>(loss, Op::MSELoss, (pred->requires_grad()), "mseloss");
@@ -1247,7 +2160,7 @@ std::shared_ptr<Node> mae_loss_nodeops(const std::shared_ptr<Node>& pred, const
     Tensor diff = pred->value - target->value;
     Tensor abs_diff = OwnTensor::abs(diff, ag::current_stream());
     // The mean of the absolute error
-    Tensor loss = OwnTensor::reduce_mean(abs_diff);
+    Tensor loss = reduce_axes(abs_diff, AG_REDUCE_MEAN);
 
     auto n = std::make_shared<Node>(loss, Op::MAELoss, (pred->requires_grad() || target->requires_grad()), "maeloss");
     n->inputs = {pred, target};
@@ -5,6 +5,9 @@
 #include "ad/ops/nodeops.hpp" // Include the new node-level declarations
 #include "ad/autodiff/inplace.hpp"
 #include "ad/runtime/runtime.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 
 namespace ag {
     Value inplace_checkpoint(const Value& v) {
@@ -102,9 +105,15 @@ namespace ag {
         return Value(ag::detail::linear_nodeops(a.node, b.node, c.node)); 
     }
 
+    Value linear_act(const Value& x, const Value& W, const Value& b, Activation act){
+        return Value(ag::detail::linear_act_nodeops(x.node, W.node, b.node, static_cast<ag_activation>(act)));
+    }
+
 
-        Value moewe(const Value& x, const Value& w, const Value& b){ 
-        return Value(ag::detail::moewe_nodeops(x.node, w.node, b.node));
+    Value moe(const Value& x, const Value& Wg, const Value& W1, const Value& b1, const Value& W2, const Value& b2,
+              int k, float capacity_factor, Activation act){
+        return Value(ag::detail::moe_nodeops(x.node, Wg.node, W1.node, b1.node, W2.node, b2.node,
+                                             k, capacity_factor, static_cast<ag_activation>(act)));
     }
 
 
@@ -122,6 +131,77 @@ namespace ag {
     return Value(ag::detail::attention_nodeops(a.node, b.node, c.node, d.node));
     }
 
+    Value multihead_attention(const Value& q, const Value& k, const Value& v, bool causal){
+        AttentionMask mask;
+        mask.causal = causal;
+        return multihead_attention(q, k, v, mask);
+    }
+
+    Value multihead_attention(const Value& q, const Value& k, const Value& v, const AttentionMask& mask){
+        ag_attn_mask m{mask.causal ? 1 : 0, mask.window, mask.layout.empty() ? 0 : mask.block,
+                       mask.layout.empty() ? nullptr : mask.layout.data(), nullptr};
+        return Value(ag::detail::multihead_attention_nodeops(q.node, k.node, v.node, m, mask.alibi));
+    }
+
+    Value embedding(const Value& indices, const Value& table){
+        return Value(ag::detail::embedding_nodeops(indices.node, table.node, {}, false));
+    }
+
+    Value embedding_bag(const Value& indices, const std::vector<int64_t>& offsets, const Value& table, bool mean){
+        if (offsets.empty()) throw std::runtime_error("embedding_bag: offsets must hold B + 1 entries");
+        return Value(ag::detail::embedding_nodeops(indices.node, table.node, offsets, mean));
+    }
+
+    Value rope(const Value& x, const Value& positions, float base){
+        return Value(ag::detail::rope_nodeops(x.node, positions.node, base));
+    }
+
+    std::vector<int64_t> cu_seqlens(const std::vector<int64_t>& lengths){
+        std::vector<int64_t> cu(lengths.size() + 1, 0);
+        for (size_t i = 0; i < lengths.size(); ++i) cu[i + 1] = cu[i] + lengths[i];
+        return cu;
+    }
+
+    Tensor pack_sequences(const std::vector<Tensor>& seqs, std::vector<int64_t>* cu){
+        if (seqs.empty()) throw std::runtime_error("pack_sequences: no sequences");
+        std::vector<int64_t> dims = seqs[0].shape().dims;
+        std::vector<int64_t> lengths;
+        for (const Tensor& s : seqs) {
+            const auto& d = s.shape().dims;
+            if (d.empty() || !std::equal(d.begin() + 1, d.end(), dims.begin() + 1, dims.end())) {
+                throw std::runtime_error("pack_sequences: sequences must agree on every dim but the first");
+            }
+            lengths.push_back(d[0]);
+        }
+        const std::vector<int64_t> offsets = cu_seqlens(lengths);
+        dims[0] = offsets.back();
+
+        Tensor out(Shape{dims}, TensorOptions().with_dtype(Dtype::Float32));
+        float* p = out.data<float>();
+        for (const Tensor& s : seqs) {
+            Tensor h = host_f32(s, "pack_sequences");
+            std::memcpy(p, h.data<float>(), sizeof(float) * h.numel());
+            p += h.numel();
+        }
+        if (cu) *cu = offsets;
+        return seqs[0].is_cpu() ? out : out.to(seqs[0].device());
+    }
+
+    Value varlen_attention(const Value& q, const Value& k, const Value& v, const std::vector<int64_t>& cu_seqlens,
+                           const AttentionMask& mask){
+        return varlen_attention(q, k, v, cu_seqlens, cu_seqlens, mask);
+    }
+
+    Value varlen_attention(const Value& q, const Value& k, const Value& v, const std::vector<int64_t>& cu_seqlens_q,
+                           const std::vector<int64_t>& cu_seqlens_k, const AttentionMask& mask){
+        if (!mask.layout.empty()) {
+            throw std::runtime_error("varlen_attention: block-sparse layouts are not supported for packed batches");
+        }
+        ag_attn_mask m{mask.causal ? 1 : 0, mask.window, 0, nullptr, nullptr};
+        return Value(ag::detail::varlen_attention_nodeops(q.node, k.node, v.node, cu_seqlens_q, cu_seqlens_k,
+                                                          m, mask.alibi));
+    }
+
 
     Value alibiatt(const Value& a, const Value& b, const Value& c, const Value& d, float m) { 
     return Value(ag::detail::alibiatt_nodeops(a.node, b.node, c.node, d.node, m));
@@ -142,6 +222,49 @@ namespace ag {
         return Value(ag::detail::transpose_nodeops(x.node));
     }
 
+    Value reshape(const Value& x, const std::vector<int64_t>& shape){
+        return Value(ag::detail::reshape_nodeops(x.node, shape));
+    }
+
+    Value narrow(const Value& x, int64_t dim, int64_t start, int64_t length){
+        return Value(ag::detail::narrow_nodeops(x.node, dim, start, length));
+    }
+
+    Value select(const Value& x, int64_t dim, int64_t index){
+        std::vector<int64_t> dims = x.shape();
+        const int64_t r = static_cast<int64_t>(dims.size());
+        if (dim < -r || dim >= r) throw std::runtime_error("select: dim out of range");
+        if (dim < 0) dim += r;
+        Value y = narrow(x, dim, index, 1);
+        dims.erase(dims.begin() + dim);
+        return reshape(y, dims);
+    }
+
+    Value expand(const Value& x, const std::vector<int64_t>& shape){
+        return Value(ag::detail::expand_nodeops(x.node, shape));
+    }
+
+    Value concat(const std::vector<Value>& xs, int64_t dim){
+        std::vector<std::shared_ptr<Node>> nodes;
+        for (const Value& x : xs) nodes.push_back(x.node);
+        return Value(ag::detail::concat_nodeops(nodes, dim));
+    }
+
+    std::vector<Value> split(const Value& x, int64_t dim, const std::vector<int64_t>& sizes){
+        const int64_t r = static_cast<int64_t>(x.shape().size());
+        const int64_t total = x.shape().at(dim < 0 ? dim + r : dim);
+        if (std::accumulate(sizes.begin(), sizes.end(), int64_t{0}) != total) {
+            throw std::runtime_error("split: sizes must add up to the dim");
+        }
+        std::vector<Value> parts;
+        int64_t start = 0;
+        for (int64_t len : sizes) {
+            parts.push_back(narrow(x, dim, start, len));
+            start += len;
+        }
+        return parts;
+    }
+
     Value exp(const Value& x){ 
         return Value(ag::detail::exp_nodeops(x.node));
     }
@@ -260,11 +383,8 @@ return Value(ag::detail::realrms_nodeops(x.node, g));
     }
 
 
-    Value mambassm(const Value& z, const Value& a, const Value& b, const Value& c, const Value& d){ 
-
-        return Value(ag::detail::mambassm_nodeops(z.node, a.node, b.node, c.node, d.node));
-
-        
+    Value mambassm(const Value& x, const Value& a, const Value& b, const Value& c, const Value& d){ 
+        return Value(ag::detail::mambassm_nodeops(x.node, a.node, b.node, c.node, d.node));
     }
 
 
@@ -278,6 +398,10 @@ return Value(ag::detail::realrms_nodeops(x.node, g));
         return Value(ag::detail::kldivergence_nodeops(logits.node, onehot.node));
     }
 
+    Value linear_cross_entropy(const Value& h, const Value& W, const Value& b, const Value& targets){
+        return Value(ag::detail::linear_cross_entropy_nodeops(h.node, W.node, b.node, targets.node));
+    }
+
     Value mse_loss(const Value& pred, const Value& target) {
     return Value(ag::detail::mse_loss_nodeops(pred.node, target.node));
 }
@@ -377,6 +501,12 @@ Tensor forward_eval_node(const std::shared_ptr<Node> &node) {
             // This logic MUST match the forward logic in linear_nodeops
             return matmul(input_X, weight_W.t()) + bias_b;
         }
+        case Op::LinearAct: {
+            // Goes through linear_act_nodeops so the kernel/fallback choice matches the forward.
+            const auto& in = node->inputs;
+            auto act = static_cast<ag_activation>(static_cast<int>(in[3]->value.data<float>()[0]));
+            return ag::detail::linear_act_nodeops(in[0], in[1], in[2], act)->value;
+        }
         // case Op::Sigmoid: {
         //     const Tensor &X = node->inputs[0]->value;
         // //     return Tensor::sigmoid(X);
@@ -406,80 +536,15 @@ Tensor forward_eval_node(const std::shared_ptr<Node> &node) {
          *
          * Steps:
          *    1. Compute queries (q), keys (k), and values (v) via matmul.
-         *    2. Compute scaled dot-product attention scores.
-         *    3. Apply ALIBI positional bias.
-         *    4. Compute softmax over the attention weights.
-         *    5. Multiply attention weights with the values to get the output.
+         *    2. Run the fused causal attention kernel, which adds the
+         *       ALIBI bias -slope * (i - j) to each score as it goes.
          */
         case Op::AlibiAttention: {
-            // NOTE: This re-computation will automatically use the correct CUDA stream
-            // because all the OwnTensor functions called below (matmul, exp, sum, etc.)
-            // are designed to get the stream from the thread-local context.
-
-            const Tensor &a = node->inputs[0]->value;
-            const Tensor &b = node->inputs[1]->value;
-            const Tensor &c = node->inputs[2]->value;
-            const Tensor &d = node->inputs[3]->value;
-
-            // Step 1: compute projections using the new matmul function
-            Tensor q = matmul(a, b);
-            Tensor k = matmul(a, c);
-            Tensor v = matmul(a, d);
-
-            // Step 2: scaled dot-product attention
-            // FIX: Use .shape().dims.back() instead of .cols()
-            float scale = 1.0f / sqrtf(static_cast<float>(k.shape().dims.back()));
-            Tensor k_transposed = k.t(); // .t() is still correct
-            Tensor logits = (matmul(q, k_transposed)) * scale;
-
-            // Step 3: add ALIBI bias
-            // FIX: Re-implement the missing 'alibi' function.
-            // Alibi creates a positional bias matrix.
-            {
-                int n_heads = logits.shape().dims[0]; // Assuming shape is [heads, seq, seq]
-                int seq_len = logits.shape().dims[1];
-                
-                // For simplicity, create bias on CPU and move to GPU.
-                // For max performance, this would be a custom CUDA kernel.
-                auto cpu_opts = TensorOptions().with_dtype(logits.dtype());
-                Tensor bias_cpu(Shape{{n_heads, seq_len, seq_len}}, cpu_opts);
-
-                // This is a simplified ALIBI implementation.
-                float slope_start = 1.0f / powf(2.0f, 8.0f / n_heads);
-                
-                dispatch_by_dtype(bias_cpu.dtype(), [&](auto dummy){
-                    using T = decltype(dummy);
-                    T* data = bias_cpu.data<T>();
-                    for(int h = 0; h < n_heads; ++h) {
-                        float slope = powf(slope_start, h + 1);
-                        for (int i = 0; i < seq_len; ++i) {
-                            for (int j = 0; j < seq_len; ++j) {
-                                // Causal mask part of alibi
-                                data[h * seq_len * seq_len + i * seq_len + j] = (j > i) ? -std::numeric_limits<T>::infinity() : static_cast<T>(-(seq_len - 1 - j) * slope);
-                            }
-                        }
-                    }
-                });
-                
-                // Move the created bias to the same device as the logits and add it.
-                logits += bias_cpu.to(logits.device());
-            }
-
-            // Step 4: softmax normalization over rows
-            // FIX: Re-implement the missing 'softmax_row' function using basic ops.
-            Tensor s{Shape{}, Dtype::Float32};  ///************************************************************************************************************************************************************************* */
-            {
-                // Numerically stable softmax: subtract max before exponentiating
-                Tensor max_val = reduce_max(logits, {-1}, true);
-                Tensor z = logits - max_val;
-                Tensor exp_z = exp(z);
-                Tensor sum_exp_z = reduce_sum(exp_z, {-1}, true);
-                s = exp_z / sum_exp_z; // Broadcasting is handled by the '/' operator
-            }
-
-            // Step 5: output = attention weights × values
-            Tensor y = matmul(s, v);
-            return y;
+            // Same fused path as the forward: the bias is applied per score in
+            // the attention kernel and never materialized.
+            float max_len = 0.0f;
+            return ag::detail::alibiatt_nodeops(node->inputs[0], node->inputs[1], node->inputs[2],
+                                                node->inputs[3], max_len)->value;
         }
 
         // ============================================================
@@ -3,14 +3,41 @@
 // ===================================================================
 #include "optim.hpp"
 #include <math.h>
+#include <unordered_set>
 
 // No new includes are needed because tensor.hpp brings in everything.
 
 namespace ag {
 
+// value[rows[i]] -= lr * g[i] for a row-sparse gradient g [R, D].
+static void sgd_sparse_rows(Node* n, float learning_rate) {
+    const int64_t D = n->sparse_grad.shape().dims[1];
+    const float* g = n->sparse_grad.data<float>();
+    if (is_cpu_f32(n->value)) {
+        float* w = n->value.data<float>();
+        for (size_t i = 0; i < n->sparse_rows.size(); ++i)
+            for (int64_t d = 0; d < D; ++d) w[n->sparse_rows[i] * D + d] -= learning_rate * g[i * D + d];
+        return;
+    }
+    // Off the host: scatter into a dense update and apply it on the parameter's device.
+    Tensor dense = Tensor::zeros(n->value.shape(), TensorOptions().with_dtype(Dtype::Float32));
+    float* u = dense.data<float>();
+    for (size_t i = 0; i < n->sparse_rows.size(); ++i)
+        for (int64_t d = 0; d < D; ++d) u[n->sparse_rows[i] * D + d] += g[i * D + d];
+    n->value += -learning_rate * (n->value.is_cpu() ? dense : dense.to(n->value.device()));
+}
+
 void SGD(const Value& root, const Tensor* grad_seed, float learning_rate) { // Changed to float for consistency
     auto order = topo_from(root.node.get());
 
+    // Parameters that only feed embedding lookups have no dense gradient, so
+    // they skip the full-table update and only their touched rows change.
+    std::unordered_set<Node*> dense_use;
+    for (Node* n : order)
+        for (size_t k = 0; k < n->inputs.size(); ++k)
+            if (!(n->op == Op::Embedding && k == 1)) dense_use.insert(n->inputs[k].get());
+    if (root.node) dense_use.insert(root.node.get());
+
     // NOTE: The 'backward' function is responsible for seeding the initial gradient.
     // The SGD optimizer's job is just to update the weights.
     // Therefore, the "seed" block is not actually needed here, as backward() must
@@ -32,7 +59,8 @@ void SGD(const Value& root, const Tensor* grad_seed, float learning_rate) { // C
             // 2. n->value += ...
             // This calls the overloaded operator+=, which also correctly
             // gets the stream from the context for GPU operations.
-            n->value += -learning_rate * n->grad;
+            if (dense_use.count(n)) n->value += -learning_rate * n->grad;
+            if (!n->sparse_rows.empty()) sgd_sparse_rows(n, learning_rate);
         }
     }
 }
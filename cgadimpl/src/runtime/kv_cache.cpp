@@ -0,0 +1,130 @@
+// ===================================================
+// In file: cgadimpl/src/runtime/kv_cache.cpp
+// ===================================================
+#include "ad/runtime/kv_cache.hpp"
+#include "ad/ops/nodeops.hpp"
+#include "ad/ops/kernels_api.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace ag {
+
+PagedKVCache::PagedKVCache(int64_t num_blocks, int64_t block_size, int64_t kv_heads, int64_t head_dim)
+    : block_size_(block_size), kv_heads_(kv_heads), head_dim_(head_dim),
+      k_pool_(Shape{{num_blocks, block_size, kv_heads, head_dim}}, TensorOptions().with_dtype(Dtype::Float32)),
+      v_pool_(Shape{{num_blocks, block_size, kv_heads, head_dim}}, TensorOptions().with_dtype(Dtype::Float32)) {
+    if (num_blocks <= 0 || block_size <= 0 || kv_heads <= 0 || head_dim <= 0) {
+        throw std::runtime_error("PagedKVCache: all sizes must be positive");
+    }
+    // Pop from the back, so hand out low page ids first.
+    for (int64_t b = num_blocks - 1; b >= 0; --b) free_.push_back(static_cast<int>(b));
+}
+
+int PagedKVCache::add_sequence() {
+    for (size_t i = 0; i < seqs_.size(); ++i) {
+        if (!seqs_[i].live) {
+            seqs_[i] = Sequence{{}, 0, true};
+            return static_cast<int>(i);
+        }
+    }
+    seqs_.push_back(Sequence{{}, 0, true});
+    return static_cast<int>(seqs_.size() - 1);
+}
+
+void PagedKVCache::free_sequence(int seq) {
+    Sequence& s = sequence(seq);
+    free_.insert(free_.end(), s.blocks.rbegin(), s.blocks.rend());
+    s = Sequence{};
+}
+
+const PagedKVCache::Sequence& PagedKVCache::sequence(int seq) const {
+    if (seq < 0 || seq >= static_cast<int>(seqs_.size()) || !seqs_[seq].live) {
+        throw std::runtime_error("PagedKVCache: unknown sequence id " + std::to_string(seq));
+    }
+    return seqs_[seq];
+}
+
+PagedKVCache::Sequence& PagedKVCache::sequence(int seq) {
+    return const_cast<Sequence&>(static_cast<const PagedKVCache&>(*this).sequence(seq));
+}
+
+int64_t PagedKVCache::length(int seq) const {
+    return sequence(seq).len;
+}
+
+void PagedKVCache::append(int seq, const Tensor& k, const Tensor& v) {
+    Sequence& s = sequence(seq);
+    const int64_t row = kv_heads_ * head_dim_;
+    if (k.numel() % row != 0 || v.numel() != k.numel()) {
+        throw std::runtime_error("PagedKVCache::append: k and v must be [n, kv_heads, head_dim]");
+    }
+    const int64_t n = k.numel() / row;
+    const int64_t need = (s.len + n + block_size_ - 1) / block_size_ - static_cast<int64_t>(s.blocks.size());
+    if (need > static_cast<int64_t>(free_.size())) {
+        throw std::runtime_error("PagedKVCache::append: out of cache blocks");
+    }
+    for (int64_t i = 0; i < need; ++i) {
+        s.blocks.push_back(free_.back());
+        free_.pop_back();
+    }
+
+    Tensor kh = host_f32(k, "PagedKVCache::append"), vh = host_f32(v, "PagedKVCache::append");
+    float* kp = k_pool_.data<float>();
+    float* vp = v_pool_.data<float>();
+    for (int64_t i = 0; i < n; ++i) {
+        const int64_t pos = s.len + i;
+        const int64_t dst = (static_cast<int64_t>(s.blocks[pos / block_size_]) * block_size_ + pos % block_size_) * row;
+        std::copy_n(kh.data<float>() + i * row, row, kp + dst);
+        std::copy_n(vh.data<float>() + i * row, row, vp + dst);
+    }
+    s.len += n;
+}
+
+Tensor PagedKVCache::attend(const std::vector<int>& seqs, const Tensor& q, bool causal, bool alibi) const {
+    const auto& qs = q.shape().dims;
+    const int64_t B = static_cast<int64_t>(seqs.size());
+    if (qs.size() < 3 || qs.back() != head_dim_ || qs[qs.size() - 2] % kv_heads_ != 0 ||
+        (qs.size() == 4 ? qs[0] != B : B != 1)) {
+        throw std::runtime_error("PagedKVCache::attend: q must be [B, T, H, head_dim] with H a multiple of kv_heads");
+    }
+    const int64_t T = qs[qs.size() - 3], H = qs[qs.size() - 2];
+
+    auto& K = ag::kernels::cpu();
+    if (!K.paged_attn_fwd) {
+        throw std::runtime_error("PagedKVCache::attend: needs paged_attn_fwd from the CPU kernel plugin");
+    }
+    int64_t max_blocks = 1;
+    for (int s : seqs) {
+        const Sequence& sq = sequence(s);
+        if (sq.len < T) throw std::runtime_error("PagedKVCache::attend: queries must already be appended");
+        max_blocks = std::max<int64_t>(max_blocks, static_cast<int64_t>(sq.blocks.size()));
+    }
+    std::vector<int> tables(B * max_blocks, 0), lens(B);
+    for (int64_t b = 0; b < B; ++b) {
+        const Sequence& sq = sequence(seqs[b]);
+        std::copy(sq.blocks.begin(), sq.blocks.end(), tables.begin() + b * max_blocks);
+        lens[b] = static_cast<int>(sq.len);
+    }
+
+    const std::vector<float> slopes = alibi ? detail::alibi_slopes(H) : std::vector<float>();
+    const ag_attn_mask mask{causal ? 1 : 0, 0, 0, nullptr, slopes.empty() ? nullptr : slopes.data()};
+    Tensor qh = host_f32(q, "PagedKVCache::attend");
+    Tensor out(q.shape(), TensorOptions().with_dtype(Dtype::Float32));
+    K.paged_attn_fwd(qh.data<float>(), k_pool_.data<float>(), v_pool_.data<float>(), tables.data(), lens.data(),
+                     out.data<float>(), (int)B, (int)T, (int)H, (int)kv_heads_, (int)head_dim_,
+                     (int)block_size_, (int)max_blocks, 1.0f / std::sqrt(static_cast<float>(head_dim_)), &mask);
+    return q.is_cpu() ? out : out.to(q.device());
+}
+
+Tensor cached_attention(PagedKVCache& cache, int seq, const Tensor& x,
+                        const Tensor& Wq, const Tensor& Wk, const Tensor& Wv, bool alibi) {
+    // Only the new rows are projected; the prefix's k and v come from the cache.
+    cache.append(seq, OwnTensor::matmul(x, Wk), OwnTensor::matmul(x, Wv));
+    Tensor q = OwnTensor::matmul(x, Wq);
+    const int64_t n = q.shape().dims[0], d = q.shape().dims[1];
+    Tensor y = cache.attend(seq, q.reshape(Shape{{n, 1, d}}), /*causal=*/true, alibi);
+    return y.reshape(Shape{{n, d}});
+}
+
+} // namespace ag
@@ -0,0 +1,100 @@
+#include "benchmark_utils.hpp"
+#include "ad/ops/kernels_api.hpp"
+#include <omp.h>
+
+// Forward declare our kernel implementations
+extern "C" {
+    void mha_fwd_impl_optimized(const float* Q, const float* K, const float* V, float* O, float* L,
+                                int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask);
+    void mha_bwd_impl_optimized(const float* Q, const float* K, const float* V, const float* O, const float* L,
+                                const float* dO, float* dQ, float* dK, float* dV,
+                                int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask);
+}
+
+static double time_ms(const std::function<void()>& f, int runs) {
+    Timer timer;
+    f(); // warm-up
+    double total_ms = 0;
+    for (int i = 0; i < runs; ++i) {
+        timer.start();
+        f();
+        total_ms += timer.stop();
+    }
+    return total_ms / runs;
+}
+
+// Number of (query, key) pairs the mask lets through, for the FLOP count.
+static double visible_pairs(const ag_attn_mask* m, int T, int S) {
+    if (!m) return (double)T * S;
+    const int nbk = m->block > 0 ? (S + m->block - 1) / m->block : 0;
+    double n = 0;
+    for (int t = 0; t < T; ++t) {
+        const int p = t + S - T;
+        for (int j = 0; j < S; ++j) {
+            if (m->causal && j > p) continue;
+            if (m->window > 0 && j <= p - m->window) continue;
+            if (m->layout && nbk && !m->layout[(t / m->block) * nbk + j / m->block]) continue;
+            n += 1;
+        }
+    }
+    return n;
+}
+
+struct Result { double fwd_ms, fb_ms; };
+
+static Result benchmark_mask(const std::string& name, const ag_attn_mask* mask, const Result* dense,
+                             int B, int T, int H, int Hkv, int D, int runs) {
+    const int S = T;
+    const float scale = 1.0f / std::sqrt((float)D);
+    std::vector<float> Q((size_t)B * T * H * D), K((size_t)B * S * Hkv * D), V(K.size());
+    fill_random(Q); fill_random(K); fill_random(V);
+    std::vector<float> O(Q.size()), L((size_t)B * H * T), dO(Q.size()), dQ(Q.size()), dK(K.size()), dV(V.size());
+    fill_random(dO);
+
+    auto fwd = [&]{ mha_fwd_impl_optimized(Q.data(), K.data(), V.data(), O.data(), L.data(), B, T, S, H, Hkv, D, scale, mask); };
+    Result r;
+    r.fwd_ms = time_ms(fwd, runs);
+    r.fb_ms = time_ms([&]{
+        fwd();
+        mha_bwd_impl_optimized(Q.data(), K.data(), V.data(), O.data(), L.data(), dO.data(),
+                               dQ.data(), dK.data(), dV.data(), B, T, S, H, Hkv, D, scale, mask);
+    }, runs);
+
+    // QK^T and PV: 4*D flops per visible pair and head.
+    const double pairs = visible_pairs(mask, T, S);
+    const double gflop = 4.0 * D * pairs * B * H / 1e9;
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+              << " | density " << std::setprecision(3) << pairs / ((double)T * S)
+              << " | fwd " << std::setprecision(2) << std::setw(8) << r.fwd_ms << " ms "
+              << std::setw(6) << gflop / (r.fwd_ms / 1000.0) << " GFLOPS"
+              << " | fwd+bwd " << std::setw(8) << r.fb_ms << " ms";
+    if (dense) std::cout << " | speedup x" << std::setprecision(2) << dense->fwd_ms / r.fwd_ms
+                         << " / x" << dense->fb_ms / r.fb_ms;
+    std::cout << std::endl;
+    return r;
+}
+
+int main() {
+    const int B = 1, T = 2048, H = 8, Hkv = 2, D = 64;
+    std::cout << "===== Masked Attention Benchmark (B=" << B << " T=" << T << " H=" << H << " Hkv=" << Hkv
+              << " D=" << D << ", " << omp_get_max_threads() << " threads) =====" << std::endl;
+
+    const Result dense = benchmark_mask("dense", nullptr, nullptr, B, T, H, Hkv, D, 2);
+
+    ag_attn_mask causal{1, 0, 0, nullptr, nullptr};
+    benchmark_mask("causal", &causal, &dense, B, T, H, Hkv, D, 2);
+
+    ag_attn_mask window{1, 256, 0, nullptr, nullptr};
+    benchmark_mask("sliding window 256", &window, &dense, B, T, H, Hkv, D, 2);
+
+    // Local + strided block-sparse layout: each block row keeps its diagonal
+    // neighbourhood and every 8th block column.
+    const int blk = 64, nb = T / blk;
+    std::vector<unsigned char> layout((size_t)nb * nb, 0);
+    for (int i = 0; i < nb; ++i)
+        for (int j = 0; j <= i; ++j)
+            layout[(size_t)i * nb + j] = (i - j < 2 || j % 8 == 0) ? 1 : 0;
+    ag_attn_mask sparse{1, 0, blk, layout.data(), nullptr};
+    benchmark_mask("block-sparse 64 (causal)", &sparse, &dense, B, T, H, Hkv, D, 2);
+    return 0;
+}
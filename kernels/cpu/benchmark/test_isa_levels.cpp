@@ -0,0 +1,63 @@
+#include "benchmark_utils.hpp"
+#include "ad/ops/kernels_api.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+// Loads the plugin table once per ISA level (forced through AG_CPU_ISA) and
+// times the same kernels on each. Levels the CPU cannot run fall back to the
+// best supported one, which the plugin reports on stderr.
+static const char* kLevels[] = {"sse4", "avx2", "avx512"};
+
+static double time_ms(const std::function<void()>& fn, int runs) {
+    fn();
+    Timer t;
+    t.start();
+    for (int r = 0; r < runs; ++r) fn();
+    return t.stop() / runs;
+}
+
+static float max_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    float m = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) m = std::max(m, std::fabs(a[i] - b[i]));
+    return m;
+}
+
+int main() {
+    std::cout << "===== ISA Level Benchmark =====" << std::endl;
+    const int M = 512, K = 512, N = 512;
+    const int64_t n = 1 << 22;
+    const int rows = 4096, cols = 1024;
+    std::vector<float> A((size_t)M * K), B((size_t)K * N), X(n), G(cols), Bt(cols);
+    fill_random(A); fill_random(B); fill_random(X); fill_random(G); fill_random(Bt);
+
+    std::vector<float> ref_mm, ref_gelu, ref_ln;
+    for (const char* level : kLevels) {
+        setenv("AG_CPU_ISA", level, 1);
+        ag_cpu_v1 k{};
+        ag_cpu_v2 k2{};
+        k2.struct_size = sizeof(k2);
+        if (ag_get_cpu_kernels_v1(&k) != 0 || ag_get_cpu_kernels_v2(&k2) != 0) {
+            std::cout << level << ": unavailable" << std::endl;
+            continue;
+        }
+
+        std::vector<float> C((size_t)M * N), Y(n), L((size_t)rows * cols), mean(rows), rstd(rows);
+        const double mm = time_ms([&] { k.matmul(A.data(), B.data(), C.data(), M, K, N); }, 10);
+        const double ge = time_ms([&] { k.gelu(X.data(), Y.data(), n); }, 10);
+        const double ln = time_ms([&] {
+            k2.layernorm_fwd(X.data(), G.data(), Bt.data(), L.data(), mean.data(), rstd.data(), rows, cols, 1e-5f);
+        }, 10);
+
+        if (ref_mm.empty()) { ref_mm = C; ref_gelu = Y; ref_ln = L; }
+        std::cout << std::left << std::setw(8) << level << std::fixed << std::setprecision(3)
+                  << " matmul " << M << "^3: " << std::setw(8) << mm << " ms ("
+                  << std::setprecision(2) << calculate_gflops(M, K, N, mm) << " GFLOPS)"
+                  << std::setprecision(3) << " | gelu 4M: " << std::setw(7) << ge << " ms"
+                  << " | layernorm " << rows << "x" << cols << ": " << std::setw(7) << ln << " ms"
+                  << " | max |diff| vs " << kLevels[0] << ": " << std::scientific
+                  << std::max({max_abs_diff(C, ref_mm), max_abs_diff(Y, ref_gelu), max_abs_diff(L, ref_ln)})
+                  << std::fixed << std::endl;
+    }
+    unsetenv("AG_CPU_ISA");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "benchmark_utils.hpp"
+#include "ad/ops/kernels_api.hpp"
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+
+// Forward declare our kernel implementations
+extern "C" {
+    void matmul_impl_optimized(const float* A, const float* B, float* C, int M, int K, int N);
+    void mha_fwd_impl_optimized(const float* Q, const float* K, const float* V, float* O, float* L,
+                                int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask);
+    void paged_attn_fwd_impl_optimized(const float* Q, const float* Kc, const float* Vc,
+                                       const int* block_tables, const int* ctx_lens, float* O,
+                                       int B, int T, int H, int Hkv, int D, int block_size, int max_blocks,
+                                       float scale, const ag_attn_mask* mask);
+}
+
+// One decoder attention layer: d_model = H * D, GQA with Hkv kv heads.
+static const int H = 8, Hkv = 2, D = 64, DM = H * D, KVW = Hkv * D, BLOCK = 16;
+
+// Decode `steps` tokens for `batch` sequences that already hold `ctx` tokens.
+// With the cache, each step projects only the new token, appends it to its
+// pages and attends over the pool. Returns tokens/s over all sequences.
+static double decode_cached(int batch, int ctx, int steps) {
+    const int max_blocks = (ctx + steps + BLOCK - 1) / BLOCK;
+    const size_t pool = (size_t)batch * max_blocks * BLOCK * KVW;
+    std::vector<float> Kc(pool), Vc(pool), Wq((size_t)DM * DM), Wk((size_t)DM * KVW), Wv(Wk.size());
+    fill_random(Kc); fill_random(Vc); fill_random(Wq); fill_random(Wk); fill_random(Wv);
+    // Interleave the sequences' pages, as a shared pool would after a while.
+    std::vector<int> tables((size_t)batch * max_blocks), lens(batch, ctx);
+    for (int i = 0; i < max_blocks; ++i)
+        for (int b = 0; b < batch; ++b) tables[(size_t)b * max_blocks + i] = i * batch + b;
+
+    std::vector<float> x((size_t)batch * DM), q(x.size()), k((size_t)batch * KVW), v(k.size()), o(x.size());
+    fill_random(x);
+    const ag_attn_mask mask{1, 0, 0, nullptr, nullptr};
+    Timer timer;
+    timer.start();
+    for (int s = 0; s < steps; ++s) {
+        matmul_impl_optimized(x.data(), Wq.data(), q.data(), batch, DM, DM);
+        matmul_impl_optimized(x.data(), Wk.data(), k.data(), batch, DM, KVW);
+        matmul_impl_optimized(x.data(), Wv.data(), v.data(), batch, DM, KVW);
+        for (int b = 0; b < batch; ++b) {
+            const int pos = lens[b]++;
+            const size_t dst = ((size_t)tables[(size_t)b * max_blocks + pos / BLOCK] * BLOCK + pos % BLOCK) * KVW;
+            std::memcpy(&Kc[dst], &k[(size_t)b * KVW], KVW * sizeof(float));
+            std::memcpy(&Vc[dst], &v[(size_t)b * KVW], KVW * sizeof(float));
+        }
+        paged_attn_fwd_impl_optimized(q.data(), Kc.data(), Vc.data(), tables.data(), lens.data(), o.data(),
+                                      batch, 1, H, Hkv, D, BLOCK, max_blocks, 1.0f / std::sqrt((float)D), &mask);
+    }
+    return (double)batch * steps / (timer.stop() / 1000.0);
+}
+
+// Without a cache every step re-projects k and v for the whole prefix.
+static double decode_recompute(int ctx, int steps) {
+    std::vector<float> X((size_t)(ctx + steps) * DM), Wq((size_t)DM * DM), Wk((size_t)DM * KVW), Wv(Wk.size());
+    fill_random(X); fill_random(Wq); fill_random(Wk); fill_random(Wv);
+    std::vector<float> q(DM), K((size_t)(ctx + steps) * KVW), V(K.size()), o(DM), L(H);
+    const ag_attn_mask mask{1, 0, 0, nullptr, nullptr};
+    Timer timer;
+    timer.start();
+    for (int s = 0; s < steps; ++s) {
+        const int S = ctx + s + 1;
+        matmul_impl_optimized(X.data(), Wk.data(), K.data(), S, DM, KVW);
+        matmul_impl_optimized(X.data(), Wv.data(), V.data(), S, DM, KVW);
+        matmul_impl_optimized(X.data() + (size_t)(S - 1) * DM, Wq.data(), q.data(), 1, DM, DM);
+        mha_fwd_impl_optimized(q.data(), K.data(), V.data(), o.data(), L.data(), 1, 1, S, H, Hkv, D,
+                               1.0f / std::sqrt((float)D), &mask);
+    }
+    return (double)steps / (timer.stop() / 1000.0);
+}
+
+int main() {
+    std::cout << "===== KV-Cache Decode Throughput (H=" << H << " Hkv=" << Hkv << " D=" << D
+              << " page=" << BLOCK << ", " << omp_get_max_threads() << " threads) =====" << std::endl;
+    std::cout << std::setw(8) << "context" << " | " << std::setw(14) << "recompute" << " | "
+              << std::setw(14) << "paged B=1" << " | " << std::setw(14) << "paged B=8" << "   (tokens/s)" << std::endl;
+    for (int ctx : {256, 1024, 4096, 16384}) {
+        const double base = ctx <= 4096 ? decode_recompute(ctx, 8) : 0.0;
+        const double c1 = decode_cached(1, ctx, 64);
+        const double c8 = decode_cached(8, ctx, 32);
+        std::cout << std::setw(8) << ctx << " | " << std::fixed << std::setprecision(1) << std::setw(14);
+        if (base > 0) std::cout << base; else std::cout << "-";
+        std::cout << " | " << std::setw(14) << c1 << " | " << std::setw(14) << c8 << std::endl;
+    }
+    return 0;
+}
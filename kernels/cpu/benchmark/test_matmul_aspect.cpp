@@ -1,35 +1,54 @@
-// #include "benchmark_utils.hpp"
-// #include <Eigen/Dense>
+#include "benchmark_utils.hpp"
+#include <omp.h>
+#include <algorithm>
 
-// extern "C" {
-//     void matmul_impl_naive(const float*, const float*, float*, int, int, int);
-//     void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
-// }
+// Forward declare our kernel implementations
+extern "C" {
+    void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
+    int gemm_partition_impl(int M, int N, int K, int threads);
+    void gemm_force_partition_impl(int partition);
+}
 
-// void benchmark_size(const std::string& title, int M, int K, int N, int runs) {
-//     std::cout << "\n--- " << title << ": " << M << "x" << K << "x" << N << " (" << runs << " runs) ---" << std::endl;
-//     std::vector<float> A(M * K), B(K * N), C(M * N);
-//     fill_random(A); fill_random(B);
+static const char* partition_name(int p) {
+    switch (p) {
+    case 1: return "rows";
+    case 2: return "cols";
+    case 3: return "split-K";
+    default: return "serial";
+    }
+}
 
-//     Eigen::Map<Eigen::Matrix<float, -1, -1, Eigen::RowMajor>> A_eigen(A.data(), M, K);
-//     Eigen::Map<Eigen::Matrix<float, -1, -1, Eigen::RowMajor>> B_eigen(B.data(), K, N);
-//     Eigen::Matrix<float, -1, -1, Eigen::RowMajor> C_eigen(M, N);
-//     auto eigen_func = [&](const float*, const float*, float*, int, int, int) {
-//         C_eigen.noalias() = A_eigen * B_eigen;
-//     };
+// Row-block partitioning only (what every shape used to get) versus the
+// shape-aware choice.
+void benchmark_size(const std::string& title, int M, int K, int N, int runs) {
+    const int chosen = gemm_partition_impl(M, N, K, omp_get_max_threads());
+    std::cout << "\n--- " << title << ": " << M << "x" << K << "x" << N << " (" << runs << " runs, "
+              << omp_get_max_threads() << " threads, picks " << partition_name(chosen) << ") ---" << std::endl;
+    std::vector<float> A((size_t)M * K), B((size_t)K * N), C((size_t)M * N), C_rows((size_t)M * N);
+    fill_random(A); fill_random(B);
 
-//     run_matmul_benchmark("Naive", matmul_impl_naive, A, B, C, M, K, N, runs);
-//     run_matmul_benchmark("Optimized", matmul_impl_optimized, A, B, C, M, K, N, runs);
-//     run_matmul_benchmark("Eigen", eigen_func, A, B, C, M, K, N, runs);
-// }
+    gemm_force_partition_impl(1);
+    run_matmul_benchmark("Rows only", matmul_impl_optimized, A, B, C_rows, M, K, N, runs);
+    gemm_force_partition_impl(-1);
+    run_matmul_benchmark("Shape-aware", matmul_impl_optimized, A, B, C, M, K, N, runs);
 
-// int main() {
-//     std::cout << "===== MatMul Aspect Ratio Benchmark =====" << std::endl;
-//     // Tall & Skinny: M is large, K and N are small
-//     benchmark_size("Tall & Skinny", 4096, 64, 64, 10);
-//     // Fat & Short: K is large, M and N are small
-//     benchmark_size("Fat & Short", 64, 4096, 64, 10);
-//     // Outer Product: K=1
-//     benchmark_size("Outer Product", 2048, 1, 2048, 10);
-//     return 0;
-// }
\ No newline at end of file
+    float max_err = 0.0f;
+    for (size_t i = 0; i < C.size(); ++i) max_err = std::max(max_err, std::fabs(C[i] - C_rows[i]));
+    std::cout << "max |diff|: " << std::scientific << max_err << std::fixed << std::endl;
+}
+
+int main() {
+    std::cout << "===== MatMul Aspect Ratio Benchmark =====" << std::endl;
+    // Tall & Skinny: M is large, K and N are small
+    benchmark_size("Tall & Skinny", 4096, 64, 64, 10);
+    // Fat & Short: K is large, M and N are small
+    benchmark_size("Fat & Short", 64, 4096, 64, 10);
+    // Outer Product: K=1
+    benchmark_size("Outer Product", 2048, 1, 2048, 10);
+    // Small-batch inference through a wide layer
+    benchmark_size("Decode M=1", 1, 4096, 4096, 10);
+    benchmark_size("Decode M=16", 16, 4096, 4096, 10);
+    // Weight gradient of a narrow layer over a long batch
+    benchmark_size("Narrow dW", 32, 65536, 32, 5);
+    return 0;
+}
@@ -1,48 +1,57 @@
-// #include "benchmark_utils.hpp"
-// #include <omp.h> // For omp_set_num_threads
-
-// extern "C" {
-//     void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
-// }
-
-// int main() {
-//     std::cout << "===== MatMul Thread Scalability Benchmark =====" << std::endl;
-//     const int M = 1024, K = 1024, N = 1024;
-//     const int runs = 5;
-//     std::cout << "--- Size: " << M << "x" << K << "x" << N << " (" << runs << " runs) ---\n" << std::endl;
-
-//     std::vector<float> A(M * K), B(K * N), C(M * N);
-//     fill_random(A);
-//     fill_random(B);
-
-//     double baseline_ms = 0.0;
-//     int max_threads = omp_get_max_threads();
-
-//     std::cout << std::setw(10) << "Threads" << std::setw(15) << "Time (ms)"
-//               << std::setw(15) << "GFLOPS" << std::setw(10) << "Speedup" << std::endl;
-//     std::cout << std::string(50, '-') << std::endl;
-
-//     for (int t = 1; t <= max_threads; t *= 2) {
-//         omp_set_num_threads(t);
-//         Timer timer;
-//         double total_ms = 0;
-//         matmul_impl_optimized(A.data(), B.data(), C.data(), M, K, N); // Warm-up
-//         for (int i = 0; i < runs; ++i) {
-//             timer.start();
-//             matmul_impl_optimized(A.data(), B.data(), C.data(), M, K, N);
-//             total_ms += timer.stop();
-//         }
-//         double avg_ms = total_ms / runs;
-
-//         if (t == 1) {
-//             baseline_ms = avg_ms;
-//         }
-
-//         std::cout << std::setw(10) << t
-//                   << std::fixed << std::setprecision(3) << std::setw(15) << avg_ms
-//                   << std::fixed << std::setprecision(2) << std::setw(15) << calculate_gflops(M, K, N, avg_ms)
-//                   << std::fixed << std::setprecision(2) << std::setw(10) << (baseline_ms / avg_ms) << "x"
-//                   << std::endl;
-//     }
-//     return 0;
-// }
\ No newline at end of file
+#include "benchmark_utils.hpp"
+#include <omp.h> // For omp_set_num_threads
+
+extern "C" {
+    void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
+    int gemm_partition_impl(int M, int N, int K, int threads);
+}
+
+static void scale_shape(const char* title, int M, int K, int N, int runs) {
+    std::cout << "\n--- " << title << ": " << M << "x" << K << "x" << N << " (" << runs << " runs) ---\n" << std::endl;
+
+    std::vector<float> A((size_t)M * K), B((size_t)K * N), C((size_t)M * N);
+    fill_random(A);
+    fill_random(B);
+
+    double baseline_ms = 0.0;
+    int max_threads = omp_get_max_threads();
+
+    std::cout << std::setw(10) << "Threads" << std::setw(10) << "Split" << std::setw(15) << "Time (ms)"
+              << std::setw(15) << "GFLOPS" << std::setw(10) << "Speedup" << std::endl;
+    std::cout << std::string(60, '-') << std::endl;
+
+    for (int t = 1; t <= max_threads; t *= 2) {
+        omp_set_num_threads(t);
+        static const char* names[] = {"serial", "rows", "cols", "split-K"};
+        Timer timer;
+        double total_ms = 0;
+        matmul_impl_optimized(A.data(), B.data(), C.data(), M, K, N); // Warm-up
+        for (int i = 0; i < runs; ++i) {
+            timer.start();
+            matmul_impl_optimized(A.data(), B.data(), C.data(), M, K, N);
+            total_ms += timer.stop();
+        }
+        double avg_ms = total_ms / runs;
+
+        if (t == 1) {
+            baseline_ms = avg_ms;
+        }
+
+        std::cout << std::setw(10) << t << std::setw(10) << names[gemm_partition_impl(M, N, K, t)]
+                  << std::fixed << std::setprecision(3) << std::setw(15) << avg_ms
+                  << std::fixed << std::setprecision(2) << std::setw(15) << calculate_gflops(M, K, N, avg_ms)
+                  << std::fixed << std::setprecision(2) << std::setw(10) << (baseline_ms / avg_ms) << "x"
+                  << std::endl;
+    }
+    omp_set_num_threads(max_threads);
+}
+
+int main() {
+    std::cout << "===== MatMul Thread Scalability Benchmark =====" << std::endl;
+    scale_shape("Square", 1024, 1024, 1024, 5);
+    // One row block: only column partitioning can use more than one thread.
+    scale_shape("Small batch", 8, 4096, 4096, 10);
+    // One row block and a single column sliver pair: only split-K scales.
+    scale_shape("Narrow dW", 32, 65536, 32, 5);
+    return 0;
+}
@@ -1,35 +1,59 @@
-// #include "benchmark_utils.hpp"
-// #include <Eigen/Dense>
+#include "benchmark_utils.hpp"
+#include <immintrin.h>
+#include <algorithm>
 
-// // Forward declare our kernel implementations
-// extern "C" {
-//     void matmul_impl_naive(const float*, const float*, float*, int, int, int);
-//     void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
-// }
+// Forward declare our kernel implementations
+extern "C" {
+    void matmul_impl_optimized(const float*, const float*, float*, int, int, int);
+}
 
-// void benchmark_size(int M, int K, int N, int runs) {
-//     std::cout << "\n--- Benchmarking Size: " << M << "x" << K << "x" << N << " (" << runs << " runs) ---" << std::endl;
-//     std::vector<float> A(M * K), B(K * N), C(M * N);
-//     fill_random(A);
-//     fill_random(B);
+// The previous 32x32x32 tiled kernel, kept as the baseline: C is loaded and
+// stored on every k step and B is read unpacked.
+static void matmul_tiled(const float* A, const float* B, float* C, int M, int K, int N) {
+    const int TILE = 32;
+    std::fill(C, C + (size_t)M * N, 0.0f);
+    #pragma omp parallel for collapse(2)
+    for (int i0 = 0; i0 < M; i0 += TILE) {
+        for (int j0 = 0; j0 < N; j0 += TILE) {
+            const int i1 = std::min(i0 + TILE, M), j1 = std::min(j0 + TILE, N);
+            for (int k0 = 0; k0 < K; k0 += TILE) {
+                const int k1 = std::min(k0 + TILE, K);
+                for (int i = i0; i < i1; ++i) {
+                    for (int k = k0; k < k1; ++k) {
+                        const __m256 a = _mm256_set1_ps(A[(size_t)i * K + k]);
+                        int j = j0;
+                        for (; j + 8 <= j1; j += 8) {
+                            __m256 c = _mm256_loadu_ps(C + (size_t)i * N + j);
+                            c = _mm256_fmadd_ps(a, _mm256_loadu_ps(B + (size_t)k * N + j), c);
+                            _mm256_storeu_ps(C + (size_t)i * N + j, c);
+                        }
+                        for (; j < j1; ++j) C[(size_t)i * N + j] += A[(size_t)i * K + k] * B[(size_t)k * N + j];
+                    }
+                }
+            }
+        }
+    }
+}
 
-//     Eigen::Map<Eigen::Matrix<float, -1, -1, Eigen::RowMajor>> A_eigen(A.data(), M, K);
-//     Eigen::Map<Eigen::Matrix<float, -1, -1, Eigen::RowMajor>> B_eigen(B.data(), K, N);
-//     Eigen::Matrix<float, -1, -1, Eigen::RowMajor> C_eigen(M, N);
+void benchmark_size(int M, int K, int N, int runs) {
+    std::cout << "\n--- Benchmarking Size: " << M << "x" << K << "x" << N << " (" << runs << " runs) ---" << std::endl;
+    std::vector<float> A((size_t)M * K), B((size_t)K * N), C((size_t)M * N), C_ref((size_t)M * N);
+    fill_random(A);
+    fill_random(B);
 
-//     auto eigen_func = [&](const float*, const float*, float*, int, int, int) {
-//         C_eigen.noalias() = A_eigen * B_eigen;
-//     };
+    run_matmul_benchmark("Tiled", matmul_tiled, A, B, C_ref, M, K, N, runs);
+    run_matmul_benchmark("Packed", matmul_impl_optimized, A, B, C, M, K, N, runs);
 
-//     run_matmul_benchmark("Naive", matmul_impl_naive, A, B, C, M, K, N, runs);
-//     run_matmul_benchmark("Optimized", matmul_impl_optimized, A, B, C, M, K, N, runs);
-//     run_matmul_benchmark("Eigen", eigen_func, A, B, C, M, K, N, runs);
-// }
+    float max_err = 0.0f;
+    for (size_t i = 0; i < C.size(); ++i) max_err = std::max(max_err, std::fabs(C[i] - C_ref[i]));
+    std::cout << "max |diff| vs tiled: " << std::scientific << max_err << std::fixed << std::endl;
+}
 
-// int main() {
-//     std::cout << "===== MatMul Throughput Benchmark =====" << std::endl;
-//     benchmark_size(256, 256, 256, 20);
-//     benchmark_size(512, 512, 512, 10);
-//     benchmark_size(1024, 1024, 1024, 5);
-//     return 0;
-// }
\ No newline at end of file
+int main() {
+    std::cout << "===== MatMul Throughput Benchmark =====" << std::endl;
+    benchmark_size(256, 256, 256, 20);
+    benchmark_size(512, 512, 512, 10);
+    benchmark_size(1024, 1024, 1024, 5);
+    benchmark_size(1000, 999, 1001, 5);
+    return 0;
+}
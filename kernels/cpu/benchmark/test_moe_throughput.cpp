@@ -0,0 +1,67 @@
+#include "benchmark_utils.hpp"
+#include <omp.h>
+
+// Forward declare our kernel implementations
+extern "C" {
+    void moe_fwd_impl_optimized(const float* X, const float* Wg, const float* W1, const float* b1,
+                                const float* W2, const float* b2, float* Y,
+                                float* route, float* gate, float* Z1,
+                                int T, int D, int H, int E, int k, int capacity, int act);
+    void moe_bwd_impl_optimized(const float* X, const float* Wg, const float* W1, const float* b1,
+                                const float* W2, const float* b2,
+                                const float* route, const float* gate, const float* Z1, const float* gy,
+                                float* dX, float* dWg, float* dW1, float* db1, float* dW2, float* db2,
+                                int T, int D, int H, int E, int k, int act);
+}
+
+static double time_ms(const std::function<void()>& f, int runs) {
+    Timer timer;
+    f(); // warm-up
+    double total_ms = 0;
+    for (int i = 0; i < runs; ++i) {
+        timer.start();
+        f();
+        total_ms += timer.stop();
+    }
+    return total_ms / runs;
+}
+
+void benchmark_moe(int T, int D, int H, int E, int k, float capacity_factor, int runs) {
+    const int capacity = capacity_factor > 0.0f ? (int)std::ceil(capacity_factor * T * k / E) : 0;
+    std::vector<float> X((size_t)T * D), Wg((size_t)E * D), W1((size_t)E * H * D), b1((size_t)E * H);
+    std::vector<float> W2((size_t)E * D * H), b2((size_t)E * D), Y((size_t)T * D), gy(Y.size(), 1.0f);
+    fill_random(X); fill_random(Wg); fill_random(W1); fill_random(b1); fill_random(W2); fill_random(b2);
+    std::vector<float> route((size_t)T * k), gate(route.size()), Z1((size_t)T * k * H);
+    std::vector<float> dX(X.size()), dWg(Wg.size()), dW1(W1.size()), db1(b1.size()), dW2(W2.size()), db2(b2.size());
+
+    auto fwd = [&]{
+        moe_fwd_impl_optimized(X.data(), Wg.data(), W1.data(), b1.data(), W2.data(), b2.data(), Y.data(),
+                               route.data(), gate.data(), Z1.data(), T, D, H, E, k, capacity, 2 /* GELU */);
+    };
+    const double f_ms = time_ms(fwd, runs);
+    const double fb_ms = time_ms([&]{
+        fwd();
+        moe_bwd_impl_optimized(X.data(), Wg.data(), W1.data(), b1.data(), W2.data(), b2.data(),
+                               route.data(), gate.data(), Z1.data(), gy.data(),
+                               dX.data(), dWg.data(), dW1.data(), db1.data(), dW2.data(), db2.data(),
+                               T, D, H, E, k, 2);
+    }, runs);
+
+    int dropped = 0;
+    for (float r : route) dropped += r < 0.0f;
+    std::cout << "E=" << std::setw(3) << E << " k=" << k << " cf=" << std::fixed << std::setprecision(2)
+              << capacity_factor << " | fwd " << std::setprecision(3) << std::setw(9) << f_ms << " ms "
+              << std::setprecision(1) << std::setw(9) << T / (f_ms / 1000.0) / 1e3 << " ktok/s"
+              << " | fwd+bwd " << std::setprecision(3) << std::setw(9) << fb_ms << " ms "
+              << std::setprecision(1) << std::setw(9) << T / (fb_ms / 1000.0) / 1e3 << " ktok/s"
+              << " | dropped " << dropped << "/" << T * k << std::endl;
+}
+
+int main() {
+    std::cout << "===== MoE Token Throughput Benchmark (" << omp_get_max_threads() << " threads) =====" << std::endl;
+    const int T = 2048, D = 256, H = 512;
+    for (int E : {4, 8, 16, 32}) benchmark_moe(T, D, H, E, 2, 0.0f, 3);
+    std::cout << std::endl;
+    for (float cf : {0.5f, 1.0f, 1.25f, 2.0f}) benchmark_moe(T, D, H, 8, 2, cf, 3);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "benchmark_utils.hpp"
+#include "ad/ops/kernels_api.hpp"
+#include <algorithm>
+
+// Forward declare our kernel implementations
+extern "C" {
+    void reduce_impl_optimized(int op, const float* x, float* y, int64_t outer, int64_t n, int64_t inner);
+}
+
+static const char* kOpNames[] = {"sum", "max", "mean", "sumsq"};
+
+// Plain scalar loop over the same [outer, n, inner] layout, one double
+// accumulator so it also serves as the accuracy reference.
+static void reduce_naive(int op, const float* x, float* y, int64_t outer, int64_t n, int64_t inner) {
+    for (int64_t o = 0; o < outer; ++o) {
+        for (int64_t i = 0; i < inner; ++i) {
+            double acc = op == AG_REDUCE_MAX ? -INFINITY : 0.0;
+            for (int64_t k = 0; k < n; ++k) {
+                const double v = x[(o * n + k) * inner + i];
+                if (op == AG_REDUCE_MAX) acc = std::max(acc, v);
+                else acc += op == AG_REDUCE_SUMSQ ? v * v : v;
+            }
+            y[o * inner + i] = (float)(op == AG_REDUCE_MEAN ? acc / (double)n : acc);
+        }
+    }
+}
+
+static double time_ms(const std::function<void()>& fn, int runs) {
+    fn();
+    Timer t;
+    t.start();
+    for (int r = 0; r < runs; ++r) fn();
+    return t.stop() / runs;
+}
+
+// Reductions read every input once, so GB/s over the input is the figure of merit.
+static void run_case(const char* name, int64_t outer, int64_t n, int64_t inner) {
+    std::vector<float> x((size_t)(outer * n * inner)), y((size_t)(outer * inner)), yr(y.size());
+    fill_random(x);
+    const double gb = x.size() * sizeof(float) / 1e9;
+    std::cout << name << " [" << outer << ", " << n << ", " << inner << "]" << std::endl;
+    for (int op = AG_REDUCE_SUM; op <= AG_REDUCE_SUMSQ; ++op) {
+        const double fast = time_ms([&] { reduce_impl_optimized(op, x.data(), y.data(), outer, n, inner); }, 20);
+        const double naive = time_ms([&] { reduce_naive(op, x.data(), yr.data(), outer, n, inner); }, 3);
+        float rel = 0.0f;
+        for (size_t i = 0; i < y.size(); ++i)
+            rel = std::max(rel, std::fabs(y[i] - yr[i]) / std::max(1.0f, std::fabs(yr[i])));
+        std::cout << "  " << std::left << std::setw(6) << kOpNames[op] << std::fixed << std::setprecision(3)
+                  << " kernel: " << std::setw(8) << fast << " ms (" << std::setprecision(1) << std::setw(6)
+                  << gb / (fast / 1e3) << " GB/s) | naive: " << std::setprecision(3) << std::setw(8) << naive
+                  << " ms (" << std::setprecision(1) << std::setw(6) << gb / (naive / 1e3) << " GB/s)"
+                  << " | max rel diff: " << std::scientific << std::setprecision(2) << rel << std::fixed << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "===== Reduction Bandwidth Benchmark =====" << std::endl;
+    run_case("last axis", 4096, 4096, 1);
+    run_case("axis 0", 1, 4096, 4096);
+    run_case("all elements", 1, 1 << 24, 1);
+    run_case("middle axis", 64, 256, 1024);
+    return 0;
+}
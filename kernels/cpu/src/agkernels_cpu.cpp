@@ -16,8 +16,177 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cpuid.h>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#if !defined(__AVX__)
+#include "simd_compat_sse.hpp"
+#endif
 // #include "adkernels_cpu.cpp"
+
+// The plugin is built once per ISA level (sse4, avx2, avx512) with
+// -DAG_CPU_ISA=<level>; each build lands in its own namespace and exposes
+// <level>::fill_cpu_kernels, and agkernels_cpu_dispatch.cpp picks one with
+// cpuid. Built without AG_CPU_ISA (the benchmarks), this is the plain
+// extern "C" plugin for whatever flags it was compiled with.
+#ifdef AG_CPU_ISA
+#define AG_STR2(x) #x
+#define AG_STR(x) AG_STR2(x)
+namespace AG_CPU_ISA {
+#else
 extern "C" {
+#endif
+
+// ---------------- Autotuning cache ----------------
+// Tile sizes and parallel thresholds are tuned on first use, per (op, shape
+// class), by timing a few candidates, and kept in memory and in a small text
+// cache so later processes start tuned. Entries are keyed by CPU model and ISA
+// level; lines for other machines in the same file are ignored. The file is
+// AG_TUNE_CACHE if set, else $XDG_CACHE_HOME/agkernels_tune.txt, else
+// $HOME/.cache/agkernels_tune.txt. AG_AUTOTUNE=0 disables tuning and uses the
+// built-in defaults.
+struct TuneEntry { long long v[4]; };
+
+static std::mutex g_tune_mu;
+static std::map<std::string, TuneEntry> g_tune;
+static std::string g_tune_path;
+static std::string g_tune_cpu;
+#ifdef AG_CPU_ISA
+static const char* g_tune_isa = AG_STR(AG_CPU_ISA);
+#else
+static const char* g_tune_isa = "native";
+#endif
+static std::atomic<bool> g_tune_enabled{true};
+
+// Tuned GEMM blocking per (M, N, K) shape class, read on every GEMM without
+// the lock. A slot packs mc, kc, nc and threads (12 bits each) with the
+// omp_get_max_threads() it was tuned for in the top 16 bits; 0 is empty and
+// GEMM_TUNE_BUSY marks a class that some thread is timing right now.
+static constexpr int GEMM_TUNE_CLASSES = 4 * 4 * 4;
+static constexpr uint64_t GEMM_TUNE_BUSY = 1;
+static std::atomic<uint64_t> g_gemm_tuned[GEMM_TUNE_CLASSES];
+
+static std::string tune_cpu_model() {
+    unsigned int regs[12] = {0};
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000u, &eax, &ebx, &ecx, &edx) && eax >= 0x80000004u) {
+        for (unsigned int i = 0; i < 3; ++i)
+            __get_cpuid(0x80000002u + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2], &regs[4 * i + 3]);
+    }
+    std::string s(reinterpret_cast<const char*>(regs), sizeof(regs));
+    s = s.c_str();
+    for (char& c : s) if (c == '\t' || c == '\n') c = ' ';
+    const size_t b = s.find_first_not_of(' '), e = s.find_last_not_of(' ');
+    return b == std::string::npos ? std::string("unknown") : s.substr(b, e - b + 1);
+}
+
+static std::string tune_cache_path() {
+    if (const char* p = std::getenv("AG_TUNE_CACHE")) return p;
+    if (const char* x = std::getenv("XDG_CACHE_HOME")) return std::string(x) + "/agkernels_tune.txt";
+    if (const char* h = std::getenv("HOME")) return std::string(h) + "/.cache/agkernels_tune.txt";
+    return std::string();
+}
+
+// Called from ag_get_cpu_kernels_v1: reads the entries for this CPU and ISA.
+static void tune_load() {
+    std::lock_guard<std::mutex> lock(g_tune_mu);
+    const char* on = std::getenv("AG_AUTOTUNE");
+    g_tune_enabled.store(!(on && std::strcmp(on, "0") == 0));
+    for (auto& slot : g_gemm_tuned) slot.store(0);
+    g_tune_cpu = tune_cpu_model();
+    g_tune_path = tune_cache_path();
+    g_tune.clear();
+    if (g_tune_path.empty()) return;
+    FILE* f = std::fopen(g_tune_path.c_str(), "r");
+    if (!f) return;
+    char line[512];
+    while (std::fgets(line, sizeof(line), f)) {
+        // cpu \t isa \t key \t v0 v1 v2 v3
+        char* cpu = line;
+        char* isa = std::strchr(cpu, '\t'); if (!isa) continue; *isa++ = '\0';
+        char* key = std::strchr(isa, '\t'); if (!key) continue; *key++ = '\0';
+        char* vals = std::strchr(key, '\t'); if (!vals) continue; *vals++ = '\0';
+        TuneEntry e{};
+        if (std::sscanf(vals, "%lld %lld %lld %lld", &e.v[0], &e.v[1], &e.v[2], &e.v[3]) != 4) continue;
+        if (g_tune_cpu == cpu && std::strcmp(isa, g_tune_isa) == 0) g_tune[key] = e;
+    }
+    std::fclose(f);
+}
+
+// Both expect g_tune_mu to be held.
+static bool tune_lookup(const std::string& key, TuneEntry& e) {
+    auto it = g_tune.find(key);
+    if (it == g_tune.end()) return false;
+    e = it->second;
+    return true;
+}
+
+static void tune_store(const std::string& key, const TuneEntry& e) {
+    g_tune[key] = e;
+    if (g_tune_path.empty()) return;
+    if (FILE* f = std::fopen(g_tune_path.c_str(), "a")) {
+        std::fprintf(f, "%s\t%s\t%s\t%lld %lld %lld %lld\n", g_tune_cpu.c_str(), g_tune_isa, key.c_str(),
+                     e.v[0], e.v[1], e.v[2], e.v[3]);
+        std::fclose(f);
+    }
+}
+
+// Best of `reps` runs, in milliseconds.
+static double tune_time_ms(const std::function<void()>& f, int reps) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+// Element count from which the streaming elementwise kernels fork threads.
+// Untuned they always do; the tuner times a ReLU-shaped loop serially and in
+// parallel at growing sizes and keeps the first size where threads win.
+static std::atomic<long long> g_elem_parallel_min{-1};
+
+static long long elem_parallel_min_tune() {
+    std::vector<float> x(1 << 20), y(1 << 20);
+    for (size_t i = 0; i < x.size(); ++i) x[i] = (float)((int)(i % 17) - 8);
+    auto probe = [&](int64_t n, bool par) {
+        const __m256 zero = _mm256_setzero_ps();
+        #pragma omp parallel for if (par)
+        for (int64_t i = 0; i < n; i += 8)
+            _mm256_storeu_ps(y.data() + i, _mm256_max_ps(_mm256_loadu_ps(x.data() + i), zero));
+    };
+    if (omp_get_max_threads() <= 1) return 1LL << 40;
+    for (int64_t n = 1 << 12; n <= (1 << 20); n <<= 2) {
+        const double serial = tune_time_ms([&]{ probe(n, false); }, 5);
+        const double par = tune_time_ms([&]{ probe(n, true); }, 5);
+        if (par < 0.9 * serial) return n;
+    }
+    return 1LL << 40;
+}
+
+static long long elem_parallel_min() {
+    long long v = g_elem_parallel_min.load(std::memory_order_relaxed);
+    if (v >= 0) return v;
+    std::lock_guard<std::mutex> lock(g_tune_mu);
+    v = g_elem_parallel_min.load();
+    if (v >= 0) return v;
+    TuneEntry e{};
+    const std::string key = "elem/t" + std::to_string(omp_get_max_threads());
+    if (!g_tune_enabled.load()) e.v[0] = 0;
+    else if (!tune_lookup(key, e)) {
+        if (omp_in_parallel()) return 0;  // can't time threads from here; decide on a later call
+        e.v[0] = elem_parallel_min_tune();
+        tune_store(key, e);
+    }
+    g_elem_parallel_min.store(e.v[0]);
+    return e.v[0];
+}
 
 // ---------------- Optimized Implementations ----------------
 
@@ -28,7 +197,7 @@ extern "C" {
 void relu_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 zeros = _mm256_setzero_ps(); // A vector of 8 zeros
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         // Ensure we don't read past the end of the array
         if (i + 8 <= n) {
@@ -48,7 +217,7 @@ void leakyrelu_impl_optimized(const float* x, float* y, int64_t n, float alpha)
     const __m256 kZero  = _mm256_setzero_ps();
     const __m256 kAlpha = _mm256_set1_ps(alpha);
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // Load 8 float values
@@ -80,7 +249,7 @@ void gelu_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 k0_044715 = _mm256_set1_ps(0.044715f);
     const __m256 kSqrt2OverPi = _mm256_set1_ps(0.7978845608028654f); // sqrt(2/pi)
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // Load 8 float values
@@ -119,62 +288,484 @@ void gelu_impl_optimized(const float* x, float* y, int64_t n) {
     }
 }
 
+// ---------------- Packed GEMM (BLIS-style) ----------------
+// C[M,N] (row-major, leading dimension ldc) = or += A[M,K] @ B[K,N], where A
+// and B are addressed through row/column strides so a transposed operand is
+// read in place. Loop nest: NC-wide column blocks of B, KC-deep slabs packed
+// into NR-wide slivers (kept in L1 by the micro-kernel), MC-tall blocks of A
+// packed into MR-tall slivers (kept in L2), and a 6x16 micro-kernel that
+// holds its C tile in 12 ymm registers for the whole KC loop. The AVX-512
+// build uses a 12x32 micro-kernel instead (24 of the 32 zmm registers).
+#ifdef __AVX512F__
+static constexpr int GEMM_MR = 12;
+static constexpr int GEMM_NR = 32;
+#else
+static constexpr int GEMM_MR = 6;
+static constexpr int GEMM_NR = 16;
+#endif
+
+// Cache blocking and thread count for one GEMM. The defaults size the A block
+// to 144 KiB (L2), a B sliver to 16 KiB (L1) and a B block to 2 MiB; the
+// autotuner may replace mc, kc and threads per shape class.
+struct GemmBlocking { int mc, kc, nc, threads; };
+static constexpr int GEMM_MC = 144;
+static constexpr int GEMM_KC = 256;
+static constexpr int GEMM_NC = 2048;
+
+// Optional hook run on each tile of C once all of K has been accumulated into
+// it, while the tile is still in cache (bias, activation, ...). fn gets the
+// tile's address and its position (i, j) and size (m, n) in the output, where
+// (row0, col0) is the position of the C pointer the GEMM was given.
+struct GemmEpilogue {
+    void (*fn)(const void* ctx, float* C, int64_t ldc, int i, int j, int m, int n);
+    const void* ctx;
+    int row0, col0;
+};
+
+// Packs A[0..mc, 0..kc) into MR-row slivers, k-major within a sliver; rows
+// past mc are zero so the micro-kernel never branches on them. A non-null
+// rowsum[0..mc) also receives the sum of each row over the kc columns, for
+// free while the values pass through registers.
+static void gemm_pack_a(const float* A, int64_t rsa, int64_t csa, int mc, int kc, float* Ap,
+                        float* rowsum = nullptr) {
+    for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+        const int mr = std::min(GEMM_MR, mc - i0);
+        for (int k = 0; k < kc; ++k) {
+            const float* a = A + (int64_t)i0 * rsa + (int64_t)k * csa;
+            int r = 0;
+            for (; r < mr; ++r) Ap[r] = a[r * rsa];
+            for (; r < GEMM_MR; ++r) Ap[r] = 0.0f;
+            if (rowsum)
+                for (r = 0; r < mr; ++r) rowsum[i0 + r] += Ap[r];
+            Ap += GEMM_MR;
+        }
+    }
+}
+
+// Packs B[0..kc, 0..nc) into NR-column slivers, k-major within a sliver,
+// zero-padding the last one.
+static void gemm_pack_b_sliver(const float* B, int64_t rsb, int64_t csb, int kc, int nr, float* Bp) {
+    if (csb == 1 && nr == GEMM_NR) {
+        for (int k = 0; k < kc; ++k, Bp += GEMM_NR) {
+            const float* b = B + (int64_t)k * rsb;
+            for (int c = 0; c < GEMM_NR; c += 8) _mm256_storeu_ps(Bp + c, _mm256_loadu_ps(b + c));
+        }
+        return;
+    }
+    for (int k = 0; k < kc; ++k, Bp += GEMM_NR) {
+        const float* b = B + (int64_t)k * rsb;
+        int c = 0;
+        for (; c < nr; ++c) Bp[c] = b[c * csb];
+        for (; c < GEMM_NR; ++c) Bp[c] = 0.0f;
+    }
+}
+
+// C[0..mr, 0..nr) (+)= Ap^T Bp over kc. Partial tiles go through a scratch
+// tile so the register block is always full width.
+static inline void gemm_micro_6x16(int kc, const float* Ap, const float* Bp, float* C, int64_t ldc,
+                                   int mr, int nr, bool accumulate) {
+    __m256 c[GEMM_MR][2];
+    for (int r = 0; r < GEMM_MR; ++r) c[r][0] = c[r][1] = _mm256_setzero_ps();
+    for (int k = 0; k < kc; ++k, Ap += GEMM_MR, Bp += GEMM_NR) {
+        const __m256 b0 = _mm256_loadu_ps(Bp);
+        const __m256 b1 = _mm256_loadu_ps(Bp + 8);
+        for (int r = 0; r < GEMM_MR; ++r) {
+            const __m256 a = _mm256_broadcast_ss(Ap + r);
+            c[r][0] = _mm256_fmadd_ps(a, b0, c[r][0]);
+            c[r][1] = _mm256_fmadd_ps(a, b1, c[r][1]);
+        }
+    }
+    if (mr == GEMM_MR && nr == GEMM_NR) {
+        for (int r = 0; r < GEMM_MR; ++r) {
+            float* crow = C + r * ldc;
+            if (accumulate) {
+                c[r][0] = _mm256_add_ps(c[r][0], _mm256_loadu_ps(crow));
+                c[r][1] = _mm256_add_ps(c[r][1], _mm256_loadu_ps(crow + 8));
+            }
+            _mm256_storeu_ps(crow, c[r][0]);
+            _mm256_storeu_ps(crow + 8, c[r][1]);
+        }
+        return;
+    }
+    alignas(32) float tile[GEMM_MR * GEMM_NR];
+    for (int r = 0; r < GEMM_MR; ++r) {
+        _mm256_store_ps(tile + r * GEMM_NR, c[r][0]);
+        _mm256_store_ps(tile + r * GEMM_NR + 8, c[r][1]);
+    }
+    for (int r = 0; r < mr; ++r) {
+        float* crow = C + r * ldc;
+        for (int j = 0; j < nr; ++j) crow[j] = accumulate ? crow[j] + tile[r * GEMM_NR + j] : tile[r * GEMM_NR + j];
+    }
+}
+
+#ifdef __AVX512F__
+// AVX-512 counterpart of gemm_micro_6x16; partial tiles are written through
+// the lane mask instead of a scratch tile.
+static inline void gemm_micro_12x32(int kc, const float* Ap, const float* Bp, float* C, int64_t ldc,
+                                    int mr, int nr, bool accumulate) {
+    __m512 c[GEMM_MR][2];
+    for (int r = 0; r < GEMM_MR; ++r) c[r][0] = c[r][1] = _mm512_setzero_ps();
+    for (int k = 0; k < kc; ++k, Ap += GEMM_MR, Bp += GEMM_NR) {
+        const __m512 b0 = _mm512_loadu_ps(Bp);
+        const __m512 b1 = _mm512_loadu_ps(Bp + 16);
+        for (int r = 0; r < GEMM_MR; ++r) {
+            const __m512 a = _mm512_set1_ps(Ap[r]);
+            c[r][0] = _mm512_fmadd_ps(a, b0, c[r][0]);
+            c[r][1] = _mm512_fmadd_ps(a, b1, c[r][1]);
+        }
+    }
+    const __mmask16 m0 = nr >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << nr) - 1);
+    const __mmask16 m1 = nr >= 32 ? (__mmask16)0xFFFF : nr <= 16 ? (__mmask16)0 : (__mmask16)((1u << (nr - 16)) - 1);
+    for (int r = 0; r < mr; ++r) {
+        float* crow = C + r * ldc;
+        if (accumulate) {
+            c[r][0] = _mm512_add_ps(c[r][0], _mm512_maskz_loadu_ps(m0, crow));
+            c[r][1] = _mm512_add_ps(c[r][1], _mm512_maskz_loadu_ps(m1, crow + 16));
+        }
+        _mm512_mask_storeu_ps(crow, m0, c[r][0]);
+        _mm512_mask_storeu_ps(crow + 16, m1, c[r][1]);
+    }
+}
+#define gemm_micro gemm_micro_12x32
+#else
+#define gemm_micro gemm_micro_6x16
+#endif
+
+// Runs the micro-kernel over a packed mc x kc block of A against the packed
+// kc x nc block of B. ep (last K slab only) is applied to each finished tile;
+// (ib, jb) is the block's position within the GEMM's C.
+static void gemm_macro(const float* Ap, const float* Bp, float* C, int64_t ldc,
+                       int mc, int nc, int kc, bool accumulate,
+                       const GemmEpilogue* ep = nullptr, int ib = 0, int jb = 0) {
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+        const int nr = std::min(GEMM_NR, nc - j0);
+        const float* b = Bp + (int64_t)j0 * kc;
+        for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+            const int mr = std::min(GEMM_MR, mc - i0);
+            float* c = C + (int64_t)i0 * ldc + j0;
+            gemm_micro(kc, Ap + (int64_t)i0 * kc, b, c, ldc, mr, nr, accumulate);
+            if (ep) ep->fn(ep->ctx, c, ldc, ep->row0 + ib + i0, ep->col0 + jb + j0, mr, nr);
+        }
+    }
+}
+
+// Pack buffer sizes for a blocking. The last panel of each block is padded
+// to a full MR or NR, so mc and nc (which a cache entry may set to anything)
+// are rounded up to whole tiles.
+static int64_t gemm_pack_a_size(const GemmBlocking& bk, int K) {
+    return (int64_t)(bk.mc + GEMM_MR - 1) / GEMM_MR * GEMM_MR * std::min(K, bk.kc);
+}
+static int64_t gemm_pack_b_size(const GemmBlocking& bk, int N, int K) {
+    return (int64_t)(std::min(N, bk.nc) + GEMM_NR - 1) / GEMM_NR * GEMM_NR * std::min(K, bk.kc);
+}
+
+// Single-threaded loop nest over caller-owned pack buffers of
+// gemm_pack_a_size and gemm_pack_b_size floats.
+static void gemm_serial(int M, int N, int K,
+                        const float* A, int64_t rsa, int64_t csa,
+                        const float* B, int64_t rsb, int64_t csb,
+                        float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk, float* Ap, float* Bp,
+                        float* a_rowsum, const GemmEpilogue* ep) {
+    for (int jc = 0; jc < N; jc += bk.nc) {
+        const int nc = std::min(bk.nc, N - jc);
+        for (int pc = 0; pc < K; pc += bk.kc) {
+            const int kc = std::min(bk.kc, K - pc);
+            for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+                gemm_pack_b_sliver(B + (int64_t)pc * rsb + (int64_t)(jc + j0) * csb, rsb, csb, kc,
+                                   std::min(GEMM_NR, nc - j0), Bp + (int64_t)j0 * kc);
+            }
+            for (int ic = 0; ic < M; ic += bk.mc) {
+                const int mc = std::min(bk.mc, M - ic);
+                gemm_pack_a(A + (int64_t)ic * rsa + (int64_t)pc * csa, rsa, csa, mc, kc, Ap,
+                            a_rowsum && jc == 0 ? a_rowsum + ic : nullptr);
+                gemm_macro(Ap, Bp, C + (int64_t)ic * ldc + jc, ldc, mc, nc, kc, accumulate || pc > 0,
+                           pc + kc == K ? ep : nullptr, ic, jc);
+            }
+        }
+    }
+}
+
+static void gemm_serial_alloc(int M, int N, int K,
+                              const float* A, int64_t rsa, int64_t csa,
+                              const float* B, int64_t rsb, int64_t csb,
+                              float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk,
+                              float* a_rowsum = nullptr, const GemmEpilogue* ep = nullptr) {
+    if (M <= 0 || N <= 0 || K <= 0) return;
+    std::vector<float> Ap((size_t)gemm_pack_a_size(bk, K)), Bp((size_t)gemm_pack_b_size(bk, N, K));
+    gemm_serial(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, bk, Ap.data(), Bp.data(), a_rowsum, ep);
+}
+
+// How the threads split one GEMM. ROWS shares each packed B block and hands
+// out MC-row blocks of A; it needs M >= threads * MC to keep every thread
+// busy. Small-batch shapes (M of 1..16) have a single row block, so COLS
+// gives each thread its own range of NR-column slivers instead. When M and N
+// are both small and K is long (weight gradients of a narrow layer), SPLIT_K
+// runs slabs of K on separate threads into private C copies and reduces them.
+enum GemmPartition { GEMM_SERIAL = 0, GEMM_ROWS = 1, GEMM_COLS = 2, GEMM_SPLIT_K = 3 };
+static constexpr double GEMM_PARALLEL_MIN_FLOPS = 2.0 * 64 * 64 * 64;  // below this, threads cost more than they save
+static constexpr int GEMM_SPLIT_K_MIN = 128;                           // shallowest K slab worth its own C copy
+static int g_gemm_force_partition = -1;
+
+static int gemm_partition(int M, int N, int K, int threads, int mc) {
+    if (M <= 0 || N <= 0 || K <= 0) return GEMM_SERIAL;
+    if (g_gemm_force_partition >= 0) return g_gemm_force_partition;
+    if (threads <= 1 || 2.0 * M * N * K < GEMM_PARALLEL_MIN_FLOPS) return GEMM_SERIAL;
+    const int row_blocks = (M + mc - 1) / mc;
+    const int slivers = (N + GEMM_NR - 1) / GEMM_NR;
+    if (row_blocks >= threads) return GEMM_ROWS;
+    if (slivers >= threads) return GEMM_COLS;
+    if (K >= threads * GEMM_SPLIT_K_MIN) return GEMM_SPLIT_K;
+    return row_blocks >= slivers ? GEMM_ROWS : GEMM_COLS;
+}
+
+int gemm_partition_impl(int M, int N, int K, int threads) {
+    return gemm_partition(M, N, K, threads, GEMM_MC);
+}
+
+// Benchmarks only: pins every GEMM to one partition; -1 restores the choice
+// made by gemm_partition_impl.
+void gemm_force_partition_impl(int partition) {
+    g_gemm_force_partition = partition;
+}
+
+static void gemm_rows(int M, int N, int K,
+                      const float* A, int64_t rsa, int64_t csa,
+                      const float* B, int64_t rsb, int64_t csb,
+                      float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk, float* a_rowsum,
+                      const GemmEpilogue* ep) {
+    std::vector<float> Bp((size_t)gemm_pack_b_size(bk, N, K));
+
+    #pragma omp parallel num_threads(bk.threads)
+    {
+        std::vector<float> Ap((size_t)gemm_pack_a_size(bk, K));
+        for (int jc = 0; jc < N; jc += bk.nc) {
+            const int nc = std::min(bk.nc, N - jc);
+            for (int pc = 0; pc < K; pc += bk.kc) {
+                const int kc = std::min(bk.kc, K - pc);
+                const bool acc = accumulate || pc > 0;
+
+                #pragma omp for schedule(static)
+                for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+                    gemm_pack_b_sliver(B + (int64_t)pc * rsb + (int64_t)(jc + j0) * csb, rsb, csb, kc,
+                                       std::min(GEMM_NR, nc - j0), Bp.data() + (int64_t)j0 * kc);
+                }
+
+                #pragma omp for schedule(dynamic)
+                for (int ic = 0; ic < M; ic += bk.mc) {
+                    const int mc = std::min(bk.mc, M - ic);
+                    gemm_pack_a(A + (int64_t)ic * rsa + (int64_t)pc * csa, rsa, csa, mc, kc, Ap.data(),
+                                a_rowsum && jc == 0 ? a_rowsum + ic : nullptr);
+                    gemm_macro(Ap.data(), Bp.data(), C + (int64_t)ic * ldc + jc, ldc, mc, nc, kc, acc,
+                               pc + kc == K ? ep : nullptr, ic, jc);
+                }
+            }
+        }
+    }
+}
+
+static void gemm_cols(int M, int N, int K,
+                      const float* A, int64_t rsa, int64_t csa,
+                      const float* B, int64_t rsb, int64_t csb,
+                      float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk, float* a_rowsum,
+                      const GemmEpilogue* ep) {
+    const int slivers = (N + GEMM_NR - 1) / GEMM_NR;
+    const int parts = std::max(1, std::min(bk.threads, slivers));
+    #pragma omp parallel for schedule(static) num_threads(bk.threads)
+    for (int p = 0; p < parts; ++p) {
+        const int j0 = (int)((int64_t)slivers * p / parts) * GEMM_NR;
+        const int j1 = std::min(N, (int)((int64_t)slivers * (p + 1) / parts) * GEMM_NR);
+        // Every part packs all of A; only the first one sums its rows.
+        GemmEpilogue part_ep{};
+        if (ep) { part_ep = *ep; part_ep.col0 += j0; }
+        gemm_serial_alloc(M, j1 - j0, K, A, rsa, csa, B + (int64_t)j0 * csb, rsb, csb,
+                          C + j0, ldc, accumulate, bk, p == 0 ? a_rowsum : nullptr, ep ? &part_ep : nullptr);
+    }
+}
+
+static void gemm_split_k(int M, int N, int K,
+                         const float* A, int64_t rsa, int64_t csa,
+                         const float* B, int64_t rsb, int64_t csb,
+                         float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk, float* a_rowsum,
+                         const GemmEpilogue* ep) {
+    const int parts = std::max(1, std::min(bk.threads, K / GEMM_SPLIT_K_MIN));
+    // Slab 0 lands in C (and a_rowsum) directly; the others get a private
+    // M x N buffer and M row sums. The epilogue waits for the reduction.
+    std::vector<float> partial((size_t)(parts - 1) * M * N);
+    std::vector<float> partial_sum(a_rowsum ? (size_t)(parts - 1) * M : 0, 0.0f);
+    #pragma omp parallel for schedule(static) num_threads(bk.threads)
+    for (int p = 0; p < parts; ++p) {
+        const int k0 = (int)((int64_t)K * p / parts), k1 = (int)((int64_t)K * (p + 1) / parts);
+        const float* Ak = A + (int64_t)k0 * csa;
+        const float* Bk = B + (int64_t)k0 * rsb;
+        if (p == 0) gemm_serial_alloc(M, N, k1 - k0, Ak, rsa, csa, Bk, rsb, csb, C, ldc, accumulate, bk, a_rowsum);
+        else        gemm_serial_alloc(M, N, k1 - k0, Ak, rsa, csa, Bk, rsb, csb,
+                                      partial.data() + (size_t)(p - 1) * M * N, N, false, bk,
+                                      a_rowsum ? partial_sum.data() + (size_t)(p - 1) * M : nullptr);
+    }
+    #pragma omp parallel for schedule(static) num_threads(bk.threads)
+    for (int i = 0; i < M; ++i) {
+        float* crow = C + (int64_t)i * ldc;
+        for (int p = 1; p < parts; ++p) {
+            const float* prow = partial.data() + ((size_t)(p - 1) * M + i) * N;
+            int j = 0;
+            for (; j + 8 <= N; j += 8)
+                _mm256_storeu_ps(crow + j, _mm256_add_ps(_mm256_loadu_ps(crow + j), _mm256_loadu_ps(prow + j)));
+            for (; j < N; ++j) crow[j] += prow[j];
+            if (a_rowsum) a_rowsum[i] += partial_sum[(size_t)(p - 1) * M + i];
+        }
+        if (ep) ep->fn(ep->ctx, crow, ldc, ep->row0 + i, ep->col0, 1, N);
+    }
+}
+
+// a_rowsum, when non-null, has the row sums of A over K added to it as a
+// by-product of packing (each A element is packed once per column block, and
+// only the first block sums). ep, when non-null, runs on every finished tile.
+static void gemm_run(int M, int N, int K,
+                     const float* A, int64_t rsa, int64_t csa,
+                     const float* B, int64_t rsb, int64_t csb,
+                     float* C, int64_t ldc, bool accumulate, const GemmBlocking& bk,
+                     float* a_rowsum = nullptr, const GemmEpilogue* ep = nullptr) {
+    switch (gemm_partition(M, N, K, bk.threads, bk.mc)) {
+    case GEMM_ROWS:    gemm_rows(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, bk, a_rowsum, ep); break;
+    case GEMM_COLS:    gemm_cols(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, bk, a_rowsum, ep); break;
+    case GEMM_SPLIT_K: gemm_split_k(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, bk, a_rowsum, ep); break;
+    default:           gemm_serial_alloc(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, bk, a_rowsum, ep); break;
+    }
+}
+
+// Shape classes for tuning: each of M, N and K falls in <= 16, <= 128,
+// <= 1024 or larger.
+static int gemm_dim_class(int x) { return x <= 16 ? 0 : x <= 128 ? 1 : x <= 1024 ? 2 : 3; }
+
+// Times every (mc, kc, threads) candidate on a problem of the caller's shape,
+// capped at 256 x 256 x 512 so one class costs tens of milliseconds once.
+static GemmBlocking gemm_tune(int M, int N, int K, int threads) {
+    const int m = std::min(M, 256), n = std::min(N, 256), k = std::min(K, 512);
+    std::vector<float> A((size_t)m * k), B((size_t)k * n), C((size_t)m * n);
+    for (size_t i = 0; i < A.size(); ++i) A[i] = (float)(i % 7) * 0.25f;
+    for (size_t i = 0; i < B.size(); ++i) B[i] = (float)(i % 5) * 0.5f;
+    GemmBlocking best{GEMM_MC, GEMM_KC, GEMM_NC, threads};
+    double best_ms = 1e30;
+    for (int t : {threads, std::max(1, threads / 2)}) {
+        for (int mc : {72, 144, 288})
+            for (int kc : {128, 256, 512}) {
+                const GemmBlocking bk{mc, kc, GEMM_NC, t};
+                const double ms = tune_time_ms([&]{ gemm_run(m, n, k, A.data(), k, 1, B.data(), n, 1, C.data(), n, false, bk); }, 3);
+                if (ms < best_ms) { best_ms = ms; best = bk; }
+            }
+        if (threads == 1) break;
+    }
+    return best;
+}
+
+static uint64_t gemm_tune_pack(const GemmBlocking& bk, int threads) {
+    return (uint64_t)bk.mc | (uint64_t)bk.kc << 12 | (uint64_t)bk.nc << 24 | (uint64_t)bk.threads << 36 |
+           (uint64_t)threads << 48;
+}
+
+// Entries that do not fit the packed slot (hand-edited cache lines) are
+// treated as missing and retuned.
+static bool gemm_tune_fits(const GemmBlocking& bk, int threads) {
+    auto ok = [](int v) { return v > 0 && v < (1 << 12); };
+    return ok(bk.mc) && ok(bk.kc) && ok(bk.nc) && ok(bk.threads) && threads < (1 << 16);
+}
+
+// Slow path of gemm_blocking: cache lookup under the lock, timing outside it,
+// then store and publish to the slot.
+static GemmBlocking gemm_blocking_tune(int M, int N, int K, int threads, std::atomic<uint64_t>& slot) {
+    const GemmBlocking def{GEMM_MC, GEMM_KC, GEMM_NC, threads};
+    const std::string key = "gemm/m" + std::to_string(gemm_dim_class(M)) + "n" + std::to_string(gemm_dim_class(N)) +
+                            "k" + std::to_string(gemm_dim_class(K)) + "t" + std::to_string(threads);
+    TuneEntry e{};
+    bool found;
+    {
+        std::lock_guard<std::mutex> lock(g_tune_mu);
+        found = tune_lookup(key, e);
+    }
+    GemmBlocking bk{(int)e.v[0], (int)e.v[1], (int)e.v[2], std::max(1, std::min(threads, (int)e.v[3]))};
+    if (!found || !gemm_tune_fits(bk, threads)) {
+        bk = gemm_tune(M, N, K, threads);
+        e.v[0] = bk.mc; e.v[1] = bk.kc; e.v[2] = bk.nc; e.v[3] = bk.threads;
+        std::lock_guard<std::mutex> lock(g_tune_mu);
+        tune_store(key, e);
+    }
+    if (!gemm_tune_fits(bk, threads)) {
+        slot.store(0, std::memory_order_release);
+        return def;
+    }
+    slot.store(gemm_tune_pack(bk, threads), std::memory_order_release);
+    return bk;
+}
+
+static GemmBlocking gemm_blocking(int M, int N, int K) {
+    const int threads = omp_in_parallel() ? 1 : omp_get_max_threads();
+    const GemmBlocking def{GEMM_MC, GEMM_KC, GEMM_NC, threads};
+    // Nested calls run on one thread and are not representative to time.
+    if (!g_tune_enabled.load(std::memory_order_relaxed) || (threads == 1 && omp_in_parallel())) return def;
+    std::atomic<uint64_t>& slot = g_gemm_tuned[(gemm_dim_class(M) * 4 + gemm_dim_class(N)) * 4 + gemm_dim_class(K)];
+    uint64_t v = slot.load(std::memory_order_acquire);
+    if (v != 0 && v != GEMM_TUNE_BUSY && (int)(v >> 48) == threads) {
+        const int mask = (1 << 12) - 1;
+        return GemmBlocking{(int)(v & mask), (int)(v >> 12 & mask), (int)(v >> 24 & mask), (int)(v >> 36 & mask)};
+    }
+    // Claim the class; whoever loses the race (or finds it being timed)
+    // runs with the defaults rather than waiting.
+    if (v == GEMM_TUNE_BUSY || !slot.compare_exchange_strong(v, GEMM_TUNE_BUSY, std::memory_order_acq_rel))
+        return def;
+    return gemm_blocking_tune(M, N, K, threads, slot);
+}
+
+// C[M,N] = A @ B, or C += A @ B when accumulate. Element (i,k) of A is
+// A[i * rsa + k * csa] and (k,j) of B is B[k * rsb + j * csb], so passing
+// (rsa, csa) = (1, lda) multiplies by the transpose without copying it.
+// a_rowsum[0..M), if given, is added the row sums of A (see gemm_run), and
+// ep runs on the finished output (see GemmEpilogue).
+static void gemm_strided(int M, int N, int K,
+                         const float* A, int64_t rsa, int64_t csa,
+                         const float* B, int64_t rsb, int64_t csb,
+                         float* C, int64_t ldc, bool accumulate, float* a_rowsum = nullptr,
+                         const GemmEpilogue* ep = nullptr) {
+    if (M <= 0 || N <= 0) return;
+    if (K <= 0) {
+        for (int i = 0; i < M; ++i) {
+            float* crow = C + (int64_t)i * ldc;
+            if (!accumulate) std::fill(crow, crow + N, 0.0f);
+            if (ep) ep->fn(ep->ctx, crow, ldc, ep->row0 + i, ep->col0, 1, N);
+        }
+        return;
+    }
+    gemm_run(M, N, K, A, rsa, csa, B, rsb, csb, C, ldc, accumulate, gemm_blocking(M, N, K), a_rowsum, ep);
+}
+
 /**
- * Optimized MatMul using AVX2, FMA, OpenMP, and cache blocking.
+ * Optimized MatMul: packed-panel GEMM with a 6x16 AVX2/FMA micro-kernel.
  * C(MxN) = A(MxK) * B(KxN)
  */
 void matmul_impl_optimized(const float* A, const float* B, float* C, int M, int K, int N) {
-    // Simple blocked implementation with safe bounds and AVX2 inner loop.
-    const int TILE_M = 32;   // tune on your CPU
-    const int TILE_K = 32;
-    const int TILE_N = 32;
-    const int VEC = 8;
+    gemm_strided(M, N, K, A, K, 1, B, N, 1, C, N, false);
+}
 
-    // Zero C entirely (safe)
-    #pragma omp parallel for
-    for (int i = 0; i < M; ++i) {
-        float* crow = C + i * N;
-        for (int j = 0; j < N; ++j) crow[j] = 0.0f;
-    }
-
-    #pragma omp parallel for collapse(2)
-    for (int i0 = 0; i0 < M; i0 += TILE_M) {
-        for (int j0 = 0; j0 < N; j0 += TILE_N) {
-            int i1 = std::min(i0 + TILE_M, M);
-            int j1 = std::min(j0 + TILE_N, N);
-
-            for (int k0 = 0; k0 < K; k0 += TILE_K) {
-                int k1 = std::min(k0 + TILE_K, K);
-
-                for (int i = i0; i < i1; ++i) {
-                    const float* Arow = A + i * K;
-                    float* Crow = C + i * N;
-
-                    for (int k = k0; k < k1; ++k) {
-                        // broadcast A[i,k]
-                        __m256 a_vec = _mm256_set1_ps(Arow[k]);
-
-                        int j = j0;
-                        // vectorized inner loop (process groups of 8)
-                        for ( ; j + VEC <= j1; j += VEC) {
-                            __m256 b_vec = _mm256_loadu_ps(B + k * N + j);   // B[k, j..]
-                            __m256 c_vec = _mm256_loadu_ps(Crow + j);       // C[i, j..]
-                            c_vec = _mm256_fmadd_ps(a_vec, b_vec, c_vec);
-                            _mm256_storeu_ps(Crow + j, c_vec);
-                        }
-                        // tail scalar
-                        for ( ; j < j1; ++j) {
-                            Crow[j] += Arow[k] * B[k * N + j];
-                        }
-                    }
-                } // i
-            } // k0
-        } // j0
-    } // i0
+// C(MxN) = op(A) * op(B) with A stored MxK (KxM if trans_a) and B stored KxN
+// (NxK if trans_b); the transposes are absorbed by the packing strides.
+void gemm_impl_optimized(const float* A, const float* B, float* C, int M, int K, int N,
+                         int trans_a, int trans_b) {
+    gemm_strided(M, N, K,
+                 A, trans_a ? 1 : K, trans_a ? M : 1,
+                 B, trans_b ? 1 : N, trans_b ? K : 1,
+                 C, N, false);
+}
+// C += op(A) * op(B)
+void gemm_acc_impl_optimized(const float* A, const float* B, float* C, int M, int K, int N,
+                             int trans_a, int trans_b) {
+    gemm_strided(M, N, K,
+                 A, trans_a ? 1 : K, trans_a ? M : 1,
+                 B, trans_b ? 1 : N, trans_b ? K : 1,
+                 C, N, true);
 }
 
 
 
+
 static inline __m256 log256_approx(__m256 x) {
     const __m256 one = _mm256_set1_ps(1.0f);
     const __m256 ln2 = _mm256_set1_ps(0.6931471805599453f);
@@ -264,7 +855,7 @@ static inline __m256 exp256_approx(__m256 x) {
 void sigmoid_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 one = _mm256_set1_ps(1.0f);
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // load 8 values
@@ -304,7 +895,7 @@ void tanh_impl_optimized(const float* x, float* y, int64_t n) {
     // mask for absolute value (0x7FFFFFFF)
     const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // load 8 floats
@@ -371,7 +962,7 @@ void softplus_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 L2 = _mm256_set1_ps(-1.0f / 2.0f);
     const __m256 L1 = _mm256_set1_ps( 1.0f );
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // load 8 floats
@@ -435,7 +1026,7 @@ void exp_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 c1 = _mm256_set1_ps(1.0f);
     const __m256 c0 = _mm256_set1_ps(1.0f);
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
@@ -494,7 +1085,7 @@ void log_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 L5 = _mm256_set1_ps( 0.1999990000f);
     const __m256 ln2 = _mm256_set1_ps(0.6931471805599453f);
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
@@ -548,7 +1139,7 @@ void log_impl_optimized(const float* x, float* y, int64_t n) {
 void sqrt_impl_optimized(const float* x, float* y, int64_t n) {
     const __m256 zero = _mm256_set1_ps(0.0f);
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // load 8 floats
@@ -571,7 +1162,7 @@ void pow_impl_optimized(const float* x, float* y, int64_t n, float exponent) {
     // const __m256 zero = _mm256_set1_ps(0.0f);
     const __m256 min_val = _mm256_set1_ps(1e-20f); // to prevent log(0)
 
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             // load x
@@ -597,16 +1188,9 @@ void pow_impl_optimized(const float* x, float* y, int64_t n, float exponent) {
 void linear_impl_optimized(const float* X, const float* W, const float* b, float* Y,
                            int B, int In, int Out) {
     assert(X != nullptr && W != nullptr && Y != nullptr);
-    if (B <= 0 || In <= 0 || Out <= 0) return;
-
-    // Tunable tile sizes (good starting points)
-    constexpr int TILE_B = 16;  // tile over batch
-    constexpr int TILE_O = 64;  // tile over output (columns)
-    constexpr int TILE_I = 64;  // tile over input (k)
-
-    const int VEC = 8; // AVX2 vector width
+    if (B <= 0 || Out <= 0) return;
 
-    // Initialize output with bias if provided, otherwise zero
+    // Initialize output with bias if provided, then accumulate X @ W into it.
     #pragma omp parallel for schedule(static)
     for (int bi = 0; bi < B; ++bi) {
         float* Yrow = Y + (size_t)bi * Out;
@@ -616,71 +1200,47 @@ void linear_impl_optimized(const float* X, const float* W, const float* b, float
             for (int j = 0; j < Out; ++j) Yrow[j] = 0.0f;
         }
     }
-
-    // Blocked matmul-like accumulation: for each block of batch x out, accumulate over In
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int b0 = 0; b0 < B; b0 += TILE_B) {
-        for (int o0 = 0; o0 < Out; o0 += TILE_O) {
-            int b1 = std::min(b0 + TILE_B, B);
-            int o1 = std::min(o0 + TILE_O, Out);
-
-            for (int k0 = 0; k0 < In; k0 += TILE_I) {
-                int k1 = std::min(k0 + TILE_I, In);
-
-                // Process the tile (b0..b1) x (o0..o1), accumulating over k0..k1
-                for (int bi = b0; bi < b1; ++bi) {
-                    const float* Xrow = X + (size_t)bi * In;
-                    float* Yrow = Y + (size_t)bi * Out;
-
-                    for (int k = k0; k < k1; ++k) {
-                        // broadcast X[bi,k]
-                        __m256 a_vec = _mm256_set1_ps(Xrow[k]);
-                        const float* Wrow = W + (size_t)k * Out; // W[k, 0..Out-1]
-
-                        int oj = o0;
-                        // vectorized loop over outputs
-                        for (; oj + VEC <= o1; oj += VEC) {
-                            __m256 w_vec = _mm256_loadu_ps(Wrow + oj);
-                            __m256 y_vec = _mm256_loadu_ps(Yrow + oj);
-                            y_vec = _mm256_fmadd_ps(a_vec, w_vec, y_vec); // y += a * w
-                            _mm256_storeu_ps(Yrow + oj, y_vec);
-                        }
-                        // scalar tail
-                        for (; oj < o1; ++oj) {
-                            Yrow[oj] += Xrow[k] * Wrow[oj];
-                        }
-                    } // k
-                } // bi
-            } // k0
-        } // o0
-    } // b0
+    gemm_strided(B, Out, In, X, In, 1, W, Out, 1, Y, Out, true);
 }
 
 
+// Each backward kernel has one body and two entry points: *_impl_optimized
+// overwrites its gradient outputs, *_acc_impl_optimized adds into them, so
+// the graph can pass a parent's existing grad buffer straight in.
+static inline void grad_store256(float* p, __m256 v, bool acc) {
+    _mm256_storeu_ps(p, acc ? _mm256_add_ps(_mm256_loadu_ps(p), v) : v);
+}
+static inline void grad_store1(float* p, float v, bool acc) { *p = acc ? *p + v : v; }
 
 // ReLU backward: dX = dY * (x > 0 ? 1 : 0)
-void relu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+static void relu_bwd_kernel(const float* x, const float* dY, float* dX, int64_t n, bool acc) {
     const __m256 zero = _mm256_setzero_ps();
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
             __m256 dyv = _mm256_loadu_ps(dY + i);
             __m256 mask = _mm256_cmp_ps(xv, zero, _CMP_GT_OS); // true where x>0
             __m256 res = _mm256_and_ps(dyv, mask); // keep dY where mask true
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
-            for (int64_t j = i; j < n; ++j) dX[j] = x[j] > 0.0f ? dY[j] : 0.0f;
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, x[j] > 0.0f ? dY[j] : 0.0f, acc);
         }
     }
 }
+void relu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    relu_bwd_kernel(x, dY, dX, n, false);
+}
+void relu_bwd_acc_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    relu_bwd_kernel(x, dY, dX, n, true);
+}
 
 // LeakyReLU backward: y = (x > 0) ? x : alpha*x
 // dX = dY * (x > 0 ? 1 : alpha)
-void leakyrelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n, float alpha) {
+static void leakyrelu_bwd_kernel(const float* x, const float* dY, float* dX, int64_t n, float alpha, bool acc) {
     const __m256 zero = _mm256_setzero_ps();
     const __m256 aval = _mm256_set1_ps(alpha);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
@@ -688,19 +1248,127 @@ void leakyrelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, in
             __m256 mask = _mm256_cmp_ps(xv, zero, _CMP_GT_OS); // x>0
             __m256 neg_mult = _mm256_mul_ps(dy, aval);         // alpha * dY
             __m256 res = _mm256_blendv_ps(neg_mult, dy, mask); // choose dY or alpha*dY
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
+        } else {
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, x[j] > 0.0f ? dY[j] : alpha * dY[j], acc);
+        }
+    }
+}
+void leakyrelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n, float alpha) {
+    leakyrelu_bwd_kernel(x, dY, dX, n, alpha, false);
+}
+void leakyrelu_bwd_acc_impl_optimized(const float* x, const float* dY, float* dX, int64_t n, float alpha) {
+    leakyrelu_bwd_kernel(x, dY, dX, n, alpha, true);
+}
+
+// ReLU / LeakyReLU that also pack the x > 0 pattern into mask, one bit per
+// element (bit i & 7 of byte i >> 3). Each iteration owns one mask byte, so
+// the 8-wide movemask of the compare is stored directly.
+void relu_fwd_mask_impl_optimized(const float* x, float* y, unsigned char* mask, int64_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    const int64_t nb = (n + 7) / 8;
+    #pragma omp parallel for if (n >= elem_parallel_min())
+    for (int64_t b = 0; b < nb; ++b) {
+        const int64_t i = b * 8;
+        if (i + 8 <= n) {
+            __m256 xv = _mm256_loadu_ps(x + i);
+            __m256 gt = _mm256_cmp_ps(xv, zero, _CMP_GT_OS);
+            _mm256_storeu_ps(y + i, _mm256_and_ps(xv, gt));
+            mask[b] = (unsigned char)_mm256_movemask_ps(gt);
+        } else {
+            unsigned char bits = 0;
+            for (int64_t j = i; j < n; ++j) {
+                const bool pos = x[j] > 0.0f;
+                y[j] = pos ? x[j] : 0.0f;
+                bits |= (unsigned char)(pos << (j - i));
+            }
+            mask[b] = bits;
+        }
+    }
+}
+
+void leakyrelu_fwd_mask_impl_optimized(const float* x, float* y, unsigned char* mask, int64_t n, float alpha) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 aval = _mm256_set1_ps(alpha);
+    const int64_t nb = (n + 7) / 8;
+    #pragma omp parallel for if (n >= elem_parallel_min())
+    for (int64_t b = 0; b < nb; ++b) {
+        const int64_t i = b * 8;
+        if (i + 8 <= n) {
+            __m256 xv = _mm256_loadu_ps(x + i);
+            __m256 gt = _mm256_cmp_ps(xv, zero, _CMP_GT_OS);
+            _mm256_storeu_ps(y + i, _mm256_blendv_ps(_mm256_mul_ps(xv, aval), xv, gt));
+            mask[b] = (unsigned char)_mm256_movemask_ps(gt);
+        } else {
+            unsigned char bits = 0;
+            for (int64_t j = i; j < n; ++j) {
+                const bool pos = x[j] > 0.0f;
+                y[j] = pos ? x[j] : alpha * x[j];
+                bits |= (unsigned char)(pos << (j - i));
+            }
+            mask[b] = bits;
+        }
+    }
+}
+
+// Expand one mask byte to 8 lanes: broadcast it, keep lane k's bit and
+// compare against that bit, giving all-ones where it was set.
+static inline __m256 mask_byte_lanes(unsigned char bits) {
+    const __m256i sel = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i v = _mm256_and_si256(_mm256_set1_epi32(bits), sel);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, sel));
+}
+
+// Backward from the packed mask alone: dX = dY where the bit is set, else 0
+// (ReLU) or alpha * dY (LeakyReLU).
+static void relu_bwd_mask_kernel(const unsigned char* mask, const float* dY, float* dX, int64_t n, bool acc) {
+    const int64_t nb = (n + 7) / 8;
+    #pragma omp parallel for if (n >= elem_parallel_min())
+    for (int64_t b = 0; b < nb; ++b) {
+        const int64_t i = b * 8;
+        if (i + 8 <= n) {
+            __m256 dy = _mm256_loadu_ps(dY + i);
+            grad_store256(dX + i, _mm256_and_ps(dy, mask_byte_lanes(mask[b])), acc);
+        } else {
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, ((mask[b] >> (j - i)) & 1) ? dY[j] : 0.0f, acc);
+        }
+    }
+}
+void relu_bwd_mask_impl_optimized(const unsigned char* mask, const float* dY, float* dX, int64_t n) {
+    relu_bwd_mask_kernel(mask, dY, dX, n, false);
+}
+void relu_bwd_mask_acc_impl_optimized(const unsigned char* mask, const float* dY, float* dX, int64_t n) {
+    relu_bwd_mask_kernel(mask, dY, dX, n, true);
+}
+
+static void leakyrelu_bwd_mask_kernel(const unsigned char* mask, const float* dY, float* dX, int64_t n, float alpha, bool acc) {
+    const __m256 aval = _mm256_set1_ps(alpha);
+    const int64_t nb = (n + 7) / 8;
+    #pragma omp parallel for if (n >= elem_parallel_min())
+    for (int64_t b = 0; b < nb; ++b) {
+        const int64_t i = b * 8;
+        if (i + 8 <= n) {
+            __m256 dy = _mm256_loadu_ps(dY + i);
+            __m256 res = _mm256_blendv_ps(_mm256_mul_ps(dy, aval), dy, mask_byte_lanes(mask[b]));
+            grad_store256(dX + i, res, acc);
         } else {
-            for (int64_t j = i; j < n; ++j) dX[j] = x[j] > 0.0f ? dY[j] : alpha * dY[j];
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, ((mask[b] >> (j - i)) & 1) ? dY[j] : alpha * dY[j], acc);
         }
     }
 }
+void leakyrelu_bwd_mask_impl_optimized(const unsigned char* mask, const float* dY, float* dX, int64_t n, float alpha) {
+    leakyrelu_bwd_mask_kernel(mask, dY, dX, n, alpha, false);
+}
+void leakyrelu_bwd_mask_acc_impl_optimized(const unsigned char* mask, const float* dY, float* dX, int64_t n, float alpha) {
+    leakyrelu_bwd_mask_kernel(mask, dY, dX, n, alpha, true);
+}
 
 // Sigmoid backward: s = sigmoid(x); dX = dY * s * (1 - s)
 // If forward stored sigmoid output 's' instead of x, you can accept s directly.
 void sigmoid_bwd_impl_optimized_from_x(const float* x, const float* dY, float* dX, int64_t n) {
     // compute sigmoid(x) then derivative
     const __m256 one = _mm256_set1_ps(1.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
@@ -725,28 +1393,34 @@ void sigmoid_bwd_impl_optimized_from_x(const float* x, const float* dY, float* d
 }
 
 // If you stored sigmoid output s in forward, you can implement a faster version:
-void sigmoid_bwd_impl_optimized_from_s(const float* s, const float* dY, float* dX, int64_t n) {
+static void sigmoid_bwd_from_s_kernel(const float* s, const float* dY, float* dX, int64_t n, bool acc) {
     const __m256 one = _mm256_set1_ps(1.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 sv = _mm256_loadu_ps(s + i);
             __m256 dy = _mm256_loadu_ps(dY + i);
             __m256 t = _mm256_mul_ps(sv, _mm256_sub_ps(one, sv)); // s*(1-s)
             __m256 res = _mm256_mul_ps(dy, t);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
             for (int64_t j = i; j < n; ++j)
-                dX[j] = dY[j] * s[j] * (1.0f - s[j]);
+                grad_store1(dX + j, dY[j] * s[j] * (1.0f - s[j]), acc);
         }
     }
 }
+void sigmoid_bwd_impl_optimized_from_s(const float* s, const float* dY, float* dX, int64_t n) {
+    sigmoid_bwd_from_s_kernel(s, dY, dX, n, false);
+}
+void sigmoid_bwd_from_s_acc_impl_optimized(const float* s, const float* dY, float* dX, int64_t n) {
+    sigmoid_bwd_from_s_kernel(s, dY, dX, n, true);
+}
 
 // Tanh backward: t = tanh(x); dX = dY * (1 - t^2)
 // If forward stored tanh(x) as 't', use that for faster compute.
-void tanh_bwd_impl_optimized_from_t(const float* t, const float* dY, float* dX, int64_t n) {
+static void tanh_bwd_from_t_kernel(const float* t, const float* dY, float* dX, int64_t n, bool acc) {
     const __m256 one = _mm256_set1_ps(1.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 tv = _mm256_loadu_ps(t + i);
@@ -754,23 +1428,29 @@ void tanh_bwd_impl_optimized_from_t(const float* t, const float* dY, float* dX,
             __m256 tv2 = _mm256_mul_ps(tv, tv);
             __m256 tterm = _mm256_sub_ps(one, tv2);
             __m256 res = _mm256_mul_ps(dy, tterm);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
             for (int64_t j = i; j < n; ++j)
-                dX[j] = dY[j] * (1.0f - t[j]*t[j]);
+                grad_store1(dX + j, dY[j] * (1.0f - t[j]*t[j]), acc);
         }
     }
 }
+void tanh_bwd_impl_optimized_from_t(const float* t, const float* dY, float* dX, int64_t n) {
+    tanh_bwd_from_t_kernel(t, dY, dX, n, false);
+}
+void tanh_bwd_from_t_acc_impl_optimized(const float* t, const float* dY, float* dX, int64_t n) {
+    tanh_bwd_from_t_kernel(t, dY, dX, n, true);
+}
 
 // GELU backward using tanh-approx derivative:
 // For GELU(x) = 0.5*x*(1 + tanh(u)), u = sqrt(2/pi)*(x + 0.044715 x^3)
 // derivative (from common approximation) implemented elementwise:
-void gelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+static void gelu_bwd_kernel(const float* x, const float* dY, float* dX, int64_t n, bool acc) {
     const __m256 kSqrt2OverPi = _mm256_set1_ps(0.7978845608028654f);
     const __m256 k0_044715 = _mm256_set1_ps(0.044715f);
     const __m256 k0_5 = _mm256_set1_ps(0.5f);
     const __m256 one = _mm256_set1_ps(1.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
@@ -795,7 +1475,7 @@ void gelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t
             __m256 part1 = _mm256_mul_ps(k0_5, one_plus_th); // 0.5*(1+th)
             __m256 part2 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(k0_5, xv), term2), dudx);
             __m256 grad = _mm256_mul_ps(_mm256_add_ps(part1, part2), _mm256_loadu_ps(dY + i));
-            _mm256_storeu_ps(dX + i, grad);
+            grad_store256(dX + i, grad, acc);
         } else {
             for (int64_t j = i; j < n; ++j) {
                 float v = x[j];
@@ -808,17 +1488,23 @@ void gelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t
                 float dudx = 0.7978845608028654f * (1.0f + 3.0f * 0.044715f * v2);
                 float part1 = 0.5f * one_plus_th;
                 float part2 = 0.5f * v * term2 * dudx;
-                dX[j] = (part1 + part2) * dY[j];
+                grad_store1(dX + j, (part1 + part2) * dY[j], acc);
             }
         }
     }
 }
+void gelu_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    gelu_bwd_kernel(x, dY, dX, n, false);
+}
+void gelu_bwd_acc_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    gelu_bwd_kernel(x, dY, dX, n, true);
+}
 
 // Softplus backward: d/dx log(1+exp(x)) = sigmoid(x)
-void softplus_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+static void softplus_bwd_kernel(const float* x, const float* dY, float* dX, int64_t n, bool acc) {
     // use sigmoid(x) as derivative
     // const __m256 one = _mm256_set1_ps(1.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             float tmp_x[8]; _mm256_storeu_ps(tmp_x, _mm256_loadu_ps(x + i));
@@ -827,111 +1513,104 @@ void softplus_bwd_impl_optimized(const float* x, const float* dY, float* dX, int
             __m256 sv = _mm256_loadu_ps(s);
             __m256 dy = _mm256_loadu_ps(dY + i);
             __m256 res = _mm256_mul_ps(dy, sv);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
             for (int64_t j = i; j < n; ++j) {
                 float s = 1.0f / (1.0f + std::exp(-x[j]));
-                dX[j] = dY[j] * s;
+                grad_store1(dX + j, dY[j] * s, acc);
             }
         }
     }
 }
+void softplus_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    softplus_bwd_kernel(x, dY, dX, n, false);
+}
+void softplus_bwd_acc_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    softplus_bwd_kernel(x, dY, dX, n, true);
+}
 
 // Exp backward: d/dx exp(x) = exp(x); dX = dY * exp(x)
-void exp_bwd_impl_optimized_from_y(const float* y, const float* dY, float* dX, int64_t n) {
+static void exp_bwd_from_y_kernel(const float* y, const float* dY, float* dX, int64_t n, bool acc) {
     // if forward stored y = exp(x), this is fastest
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 yv = _mm256_loadu_ps(y + i);
             __m256 dy = _mm256_loadu_ps(dY + i);
             __m256 res = _mm256_mul_ps(dy, yv);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
-            for (int64_t j = i; j < n; ++j) dX[j] = dY[j] * y[j];
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, dY[j] * y[j], acc);
         }
     }
 }
+void exp_bwd_impl_optimized_from_y(const float* y, const float* dY, float* dX, int64_t n) {
+    exp_bwd_from_y_kernel(y, dY, dX, n, false);
+}
+void exp_bwd_from_y_acc_impl_optimized(const float* y, const float* dY, float* dX, int64_t n) {
+    exp_bwd_from_y_kernel(y, dY, dX, n, true);
+}
 
 // Log backward: d/dx log(x) = 1/x; dX = dY / x
-void log_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
-    #pragma omp parallel for
+static void log_bwd_kernel(const float* x, const float* dY, float* dX, int64_t n, bool acc) {
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 xv = _mm256_loadu_ps(x + i);
             __m256 dy = _mm256_loadu_ps(dY + i);
             __m256 res = _mm256_div_ps(dy, xv);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
-            for (int64_t j = i; j < n; ++j) dX[j] = dY[j] / x[j];
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, dY[j] / x[j], acc);
         }
     }
 }
+void log_bwd_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    log_bwd_kernel(x, dY, dX, n, false);
+}
+void log_bwd_acc_impl_optimized(const float* x, const float* dY, float* dX, int64_t n) {
+    log_bwd_kernel(x, dY, dX, n, true);
+}
 
 // Sqrt backward: y = sqrt(x) ; d/dx sqrt(x) = 1/(2*sqrt(x)) ; if forward stored y you can use y.
-void sqrt_bwd_impl_optimized_from_y(const float* y, const float* dY, float* dX, int64_t n) {
+static void sqrt_bwd_from_y_kernel(const float* y, const float* dY, float* dX, int64_t n, bool acc) {
     const __m256 two = _mm256_set1_ps(2.0f);
-    #pragma omp parallel for
+    #pragma omp parallel for if (n >= elem_parallel_min())
     for (int64_t i = 0; i < n; i += 8) {
         if (i + 8 <= n) {
             __m256 yv = _mm256_loadu_ps(y + i);
             __m256 dy = _mm256_loadu_ps(dY + i);
             __m256 denom = _mm256_mul_ps(two, yv);
             __m256 res = _mm256_div_ps(dy, denom);
-            _mm256_storeu_ps(dX + i, res);
+            grad_store256(dX + i, res, acc);
         } else {
-            for (int64_t j = i; j < n; ++j) dX[j] = dY[j] / (2.0f * y[j]);
+            for (int64_t j = i; j < n; ++j) grad_store1(dX + j, dY[j] / (2.0f * y[j]), acc);
         }
     }
 }
+void sqrt_bwd_impl_optimized_from_y(const float* y, const float* dY, float* dX, int64_t n) {
+    sqrt_bwd_from_y_kernel(y, dY, dX, n, false);
+}
+void sqrt_bwd_from_y_acc_impl_optimized(const float* y, const float* dY, float* dX, int64_t n) {
+    sqrt_bwd_from_y_kernel(y, dY, dX, n, true);
+}
 // Compute dA = dC @ B^T
 // A: [M,K], B: [K,N], dC: [M,N]
-
+// B^T is read in place through the GEMM's strides; nothing is transposed.
 void matmul_bwd_dA_impl_optimized(const float* dC, const float* B, float* dA, int M, int K, int N) {
-    // This function needs to compute dA(M,K) = dC(M,N) @ B^T(N,K).
-    
-    // 1. Allocate temporary memory for B transposed (B_t will have shape N,K)
-    std::vector<float> B_t_vec( (size_t)N * K );
-    float* B_t = B_t_vec.data();
-
-    // 2. Transpose B into B_t. B is (K,N), B_t is (N,K).
-    // This is a simple, parallelized transpose loop.
-    #pragma omp parallel for collapse(2)
-    for (int i = 0; i < K; ++i) {
-        for (int j = 0; j < N; ++j) {
-            B_t[j * K + i] = B[i * N + j];
-        }
-    }
-
-    // 3. Now we can call the existing optimized matmul.
-    // The shapes are: dA(M,K) = dC(M,N) @ B_t(N,K)
-    matmul_impl_optimized(dC, B_t, dA, M, N, K);
-    
-    // The temporary memory for B_t is automatically freed when B_t_vec goes out of scope.
+    gemm_strided(M, K, N, dC, N, 1, B, 1, N, dA, K, false);
+}
+void matmul_bwd_dA_acc_impl_optimized(const float* dC, const float* B, float* dA, int M, int K, int N) {
+    gemm_strided(M, K, N, dC, N, 1, B, 1, N, dA, K, true);
 }
 
 // Compute dB = A^T @ dC
 // A: [M,K], dC: [M,N] -> A^T: [K,M] @ [M,N] = [K,N]
 void matmul_bwd_dB_impl_optimized(const float* A, const float* dC, float* dB, int M, int K, int N) {
-    // This function needs to compute dB(K,N) = A^T(K,M) @ dC(M,N).
-
-    // 1. Allocate temporary memory for A transposed (A_t will have shape K,M)
-    std::vector<float> A_t_vec( (size_t)K * M );
-    float* A_t = A_t_vec.data();
-
-    // 2. Transpose A into A_t. A is (M,K), A_t is (K,M).
-    #pragma omp parallel for collapse(2)
-    for (int i = 0; i < M; ++i) {
-        for (int j = 0; j < K; ++j) {
-            A_t[j * M + i] = A[i * K + j];
-        }
-    }
-
-    // 3. Now we can call the existing optimized matmul.
-    // The shapes are: dB(K,N) = A_t(K,M) @ dC(M,N)
-    matmul_impl_optimized(A_t, dC, dB, K, M, N);
-
-    // The temporary memory for A_t is automatically freed.
+    gemm_strided(K, N, M, A, 1, K, dC, N, 1, dB, N, false);
+}
+void matmul_bwd_dB_acc_impl_optimized(const float* A, const float* dC, float* dB, int M, int K, int N) {
+    gemm_strided(K, N, M, A, 1, K, dC, N, 1, dB, N, true);
 }
 
 
@@ -939,130 +1618,35 @@ void matmul_bwd_dB_impl_optimized(const float* A, const float* dC, float* dB, in
 void linear_dW_impl_optimized(const float* X, const float* dY, float* dW,
                               int B, int In, int Out) {
     assert(X && dY && dW);
-    if (B <= 0 || In <= 0 || Out <= 0) return;
-
-    const int TILE_I = 32;   // tile over In (rows of dW)
-    const int TILE_O = 64;   // tile over Out (cols of dW)
-    const int TILE_B = 64;   // accumulate blocks of batch
-    const int VEC = 8;
-    
-    // Zero dW
-    std::fill(dW, dW + (size_t)In * Out, 0.0f);
-
-    // For each block of (i0..i1) x (o0..o1) compute partial sums
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int i0 = 0; i0 < In; i0 += TILE_I) {
-        for (int o0 = 0; o0 < Out; o0 += TILE_O) {
-            int i1 = std::min(i0 + TILE_I, In);
-            int o1 = std::min(o0 + TILE_O, Out);
-
-            // Use a local buffer to accumulate over B blocks to reduce contention
-            std::vector<float> local((size_t)(i1 - i0) * (o1 - o0));
-            std::fill(local.begin(), local.end(), 0.0f);
-
-            for (int b0 = 0; b0 < B; b0 += TILE_B) {
-                int b1 = std::min(b0 + TILE_B, B);
-
-                for (int b = b0; b < b1; ++b) {
-                    const float* Xrow = X + (size_t)b * In;
-                    const float* DYrow = dY + (size_t)b * Out;
-
-                    // accumulate into local[(i-i0)*(o1-o0) + (o-o0)]
-                    for (int i = i0; i < i1; ++i) {
-                        __m256 x_bcast = _mm256_set1_ps(Xrow[i]);
-                        int o = o0;
-                        // vector loop
-                        for (; o + VEC <= o1; o += VEC) {
-                            __m256 dy_vec = _mm256_loadu_ps(DYrow + o);
-                            __m256 acc = _mm256_loadu_ps(&local[(i - i0) * (o1 - o0) + (o - o0)]);
-                            acc = _mm256_fmadd_ps(x_bcast, dy_vec, acc);
-                            _mm256_storeu_ps(&local[(i - i0) * (o1 - o0) + (o - o0)], acc);
-                        }
-                        for (; o < o1; ++o) {
-                            local[(i - i0) * (o1 - o0) + (o - o0)] += Xrow[i] * DYrow[o];
-                        }
-                    }
-                } // b block
-            } // b0
-
-            // write local into global dW
-            for (int i = i0; i < i1; ++i) {
-                float* dWrow = dW + (size_t)i * Out;
-                int o = o0;
-                // vector copy
-                for (; o + VEC <= o1; o += VEC) {
-                    __m256 v = _mm256_loadu_ps(&local[(i - i0) * (o1 - o0) + (o - o0)]);
-                    __m256 orig = _mm256_loadu_ps(dWrow + o);
-                    orig = _mm256_add_ps(orig, v);
-                    _mm256_storeu_ps(dWrow + o, orig);
-                }
-                for (; o < o1; ++o) dWrow[o] += local[(i - i0) * (o1 - o0) + (o - o0)];
-            }
-        }
-    }
+    gemm_strided(In, Out, B, X, 1, In, dY, Out, 1, dW, Out, false);
+}
+void linear_dW_acc_impl_optimized(const float* X, const float* dY, float* dW,
+                                  int B, int In, int Out) {
+    assert(X && dY && dW);
+    gemm_strided(In, Out, B, X, 1, In, dY, Out, 1, dW, Out, true);
 }
 
 // Compute dX = dY @ W^T   (B x In) ; dY (B x Out), W (In x Out)
 void linear_dX_impl_optimized(const float* dY, const float* W, float* dX,
                               int B, int In, int Out) {
     assert(dY && W && dX);
-    if (B <= 0 || In <= 0 || Out <= 0) return;
-
-    const int TILE_B = 32;
-    const int TILE_I = 32;
-    const int TILE_O = 64;
-    const int VEC = 8;
-
-    // Zero dX
-    #pragma omp parallel for schedule(static)
-    for (int b = 0; b < B; ++b) {
-        float* dxrow = dX + (size_t)b * In;
-        for (int i = 0; i < In; ++i) dxrow[i] = 0.0f;
-    }
-
-    // We compute for each b and i: dX[b,i] += sum_o dY[b,o] * W[i,o]
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int b0 = 0; b0 < B; b0 += TILE_B) {
-        for (int i0 = 0; i0 < In; i0 += TILE_I) {
-            int b1 = std::min(b0 + TILE_B, B);
-            int i1 = std::min(i0 + TILE_I, In);
-
-            for (int o0 = 0; o0 < Out; o0 += TILE_O) {
-                int o1 = std::min(o0 + TILE_O, Out);
-
-                for (int b = b0; b < b1; ++b) {
-                    const float* dyrow = dY + (size_t)b * Out;
-                    float* dxrow = dX + (size_t)b * In;
-
-                    for (int i = i0; i < i1; ++i) {
-                        // compute dot(dyrow[o0..o1), W[i*Out + o0..o1))
-                        __m256 acc = _mm256_setzero_ps();
-                        int o = o0;
-                        for (; o + VEC <= o1; o += VEC) {
-                            __m256 dy_vec = _mm256_loadu_ps(dyrow + o);
-                            __m256 w_vec  = _mm256_loadu_ps(W + (size_t)i * Out + o);
-                            acc = _mm256_fmadd_ps(dy_vec, w_vec, acc);
-                        }
-                        float tmp[VEC];
-                        _mm256_storeu_ps(tmp, acc);
-                        float sum = tmp[0]+tmp[1]+tmp[2]+tmp[3]+tmp[4]+tmp[5]+tmp[6]+tmp[7];
-                        for (; o < o1; ++o) sum += dyrow[o] * W[i * Out + o];
-                        dxrow[i] += sum;
-                    }
-                } // b
-            } // o0
-        } // i0
-    } // b0
+    gemm_strided(B, In, Out, dY, Out, 1, W, 1, Out, dX, In, false);
+}
+void linear_dX_acc_impl_optimized(const float* dY, const float* W, float* dX,
+                                  int B, int In, int Out) {
+    assert(dY && W && dX);
+    gemm_strided(B, In, Out, dY, Out, 1, W, 1, Out, dX, In, true);
 }
 
-// Compute db = sum_rows(dY)  (1 x Out)
-void linear_db_impl_optimized(const float* dY, float* db, int B, int Out) {
-    assert(dY && db);
-    if (B <= 0 || Out <= 0) return;
+// Compute db = sum_rows(dY)  (1 x Out); acc keeps db's old contents
+static void linear_db_kernel(const float* dY, float* db, int B, int Out, bool acc) {
+    assert(db && (dY || B <= 0));
+    if (Out <= 0) return;
 
     const int VEC = 8;
-    // zero
-    std::fill(db, db + Out, 0.0f);
+    // zero (an empty batch still sums to zero)
+    if (!acc) std::fill(db, db + Out, 0.0f);
+    if (B <= 0) return;
 
     // Accumulate in parallel with per-thread local buffer to avoid atomic adds
     int num_threads = omp_get_max_threads();
@@ -1092,11 +1676,2543 @@ void linear_db_impl_optimized(const float* dY, float* db, int B, int Out) {
         for (int o = 0; o < Out; ++o) db[o] += local[t][o];
     }
 }
-// ---------------- required export ----------------
-// This part exports the new optimized functions.
-AG_EXPORT int ag_get_cpu_kernels_v1(struct ag_cpu_v1* out){
-  if (!out) return -1;
-    out->abi_version = AG_KERNELS_ABI_V1;
+void linear_db_impl_optimized(const float* dY, float* db, int B, int Out) {
+    linear_db_kernel(dY, db, B, Out, false);
+}
+void linear_db_acc_impl_optimized(const float* dY, float* db, int B, int Out) {
+    linear_db_kernel(dY, db, B, Out, true);
+}
+
+// ---------------- Fused linear backward ----------------
+// Y = X @ W^T + b with W: [Out,In] (nn::Linear layout). dX = dY @ W and
+// dW = dY^T @ X run as two full-size GEMMs; db is the row sums of dW's A
+// operand (dY^T), so it is accumulated while that GEMM packs its A panels
+// instead of costing its own sweep over dY. The two GEMMs contract dY over
+// different axes, so their packed panels cannot be reused between them.
+static void linear_bwd_kernel(const float* X, const float* W, const float* dY,
+                              float* dX, float* dW, float* db, int B, int In, int Out, bool acc) {
+    assert(X && W && dY);
+    if (Out <= 0) return;
+
+    // dX[B,In] = dY[B,Out] @ W[Out,In]. With B == 0 the dW GEMM has no K and
+    // only zeroes dW (non-acc); db is zeroed below.
+    if (dX) gemm_strided(B, In, Out, dY, Out, 1, W, In, 1, dX, In, acc);
+    // With In == 0 the dW GEMM has no columns and never packs dY^T, so db
+    // needs its own sweep.
+    if (!dW || In <= 0) {
+        if (db) linear_db_kernel(dY, db, B, Out, acc);
+        return;
+    }
+    // dW[Out,In] = dY^T @ X, db[Out] = row sums of dY^T
+    if (db && !acc) std::fill(db, db + Out, 0.0f);
+    gemm_strided(Out, In, B, dY, 1, Out, X, In, 1, dW, In, acc, db);
+}
+void linear_bwd_impl_optimized(const float* X, const float* W, const float* dY,
+                               float* dX, float* dW, float* db, int B, int In, int Out) {
+    linear_bwd_kernel(X, W, dY, dX, dW, db, B, In, Out, false);
+}
+void linear_bwd_acc_impl_optimized(const float* X, const float* W, const float* dY,
+                                   float* dX, float* dW, float* db, int B, int In, int Out) {
+    linear_bwd_kernel(X, W, dY, dX, dW, db, B, In, Out, true);
+}
+
+// ---------------- Fused linear + cross-entropy (LM head) ----------------
+// Logits Z = H @ W^T + b with H: [N,D], W: [V,D] (nn::Linear layout), b: [V].
+// The vocabulary is visited in chunks of `chunk` columns, so at most a
+// [rows x chunk] tile of logits is alive at a time and peak memory does
+// not grow with V. Rows whose target is negative are ignored.
+
+static inline float hsum256(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    lo = _mm_hadd_ps(lo, lo);
+    lo = _mm_hadd_ps(lo, lo);
+    return _mm_cvtss_f32(lo);
+}
+
+// out[i*ld + j] = H[r0+i,:] . W[v0+j,:] + b[v0+j]   for i < nr (nr <= 4), j < nv
+static inline void xent_logits_tile(const float* H, const float* W, const float* b,
+                                    int r0, int nr, int v0, int nv, int D,
+                                    float* out, int ld) {
+    const float* h[4];
+    for (int i = 0; i < 4; ++i) h[i] = H + (size_t)(r0 + std::min(i, nr - 1)) * D;
+
+    for (int j = 0; j < nv; ++j) {
+        const float* w = W + (size_t)(v0 + j) * D;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        int k = 0;
+        for (; k + 8 <= D; k += 8) {
+            __m256 wv = _mm256_loadu_ps(w + k);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(h[0] + k), wv, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(h[1] + k), wv, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(h[2] + k), wv, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(h[3] + k), wv, acc3);
+        }
+        float s[4] = {hsum256(acc0), hsum256(acc1), hsum256(acc2), hsum256(acc3)};
+        for (; k < D; ++k) {
+            for (int i = 0; i < 4; ++i) s[i] += h[i][k] * w[k];
+        }
+        const float bias = b ? b[v0 + j] : 0.0f;
+        for (int i = 0; i < nr; ++i) out[(size_t)i * ld + j] = s[i] + bias;
+    }
+}
+
+// Forward: lse[n] = logsumexp_v Z[n,v], loss[n] = lse[n] - Z[n, targets[n]].
+// `loss` may be null.
+void linear_xent_fwd_impl_optimized(const float* H, const float* W, const float* b,
+                                    const int64_t* targets, float* lse, float* loss,
+                                    int N, int D, int V, int chunk) {
+    assert(H && W && targets && lse);
+    if (N <= 0 || D <= 0 || V <= 0) return;
+    if (chunk <= 0) chunk = 256;
+    constexpr int RB = 4; // rows sharing one pass over a W row
+
+    #pragma omp parallel
+    {
+        std::vector<float> tile((size_t)RB * chunk);
+
+        #pragma omp for schedule(dynamic)
+        for (int r0 = 0; r0 < N; r0 += RB) {
+            const int nr = std::min(RB, N - r0);
+            float m[RB], s[RB], zt[RB];
+            for (int i = 0; i < RB; ++i) { m[i] = -INFINITY; s[i] = 0.0f; zt[i] = 0.0f; }
+
+            for (int v0 = 0; v0 < V; v0 += chunk) {
+                const int nv = std::min(chunk, V - v0);
+                xent_logits_tile(H, W, b, r0, nr, v0, nv, D, tile.data(), nv);
+
+                for (int i = 0; i < nr; ++i) {
+                    const float* z = tile.data() + (size_t)i * nv;
+                    // running logsumexp: rescale the old sum to the new max
+                    float cmax = m[i];
+                    for (int j = 0; j < nv; ++j) cmax = std::max(cmax, z[j]);
+                    const __m256 mv = _mm256_set1_ps(cmax);
+                    __m256 accv = _mm256_setzero_ps();
+                    int j = 0;
+                    for (; j + 8 <= nv; j += 8) {
+                        accv = _mm256_add_ps(accv, exp256_approx(_mm256_sub_ps(_mm256_loadu_ps(z + j), mv)));
+                    }
+                    float acc = hsum256(accv);
+                    for (; j < nv; ++j) acc += std::exp(z[j] - cmax);
+                    s[i] = s[i] * std::exp(m[i] - cmax) + acc;
+                    m[i] = cmax;
+
+                    const int64_t t = targets[r0 + i];
+                    if (t >= v0 && t < v0 + nv) zt[i] = z[t - v0];
+                }
+            }
+
+            for (int i = 0; i < nr; ++i) {
+                lse[r0 + i] = m[i] + std::log(s[i]);
+                if (loss) loss[r0 + i] = targets[r0 + i] >= 0 ? lse[r0 + i] - zt[i] : 0.0f;
+            }
+        }
+    }
+}
+
+// Backward: with G[n,v] = scale * (softmax(Z)[n,v] - [v == targets[n]]),
+//   dH = G @ W,  dW = G^T @ H,  db = sum_n G[n,:]
+// Logits are recomputed one vocabulary chunk at a time from H, W and the
+// saved lse, so the only scratch is a [N x chunk] tile. dH, dW and db are
+// overwritten (added to when acc); any of them may be null.
+static void linear_xent_bwd_kernel(const float* H, const float* W, const float* b,
+                                   const int64_t* targets, const float* lse, float scale,
+                                   float* dH, float* dW, float* db,
+                                   int N, int D, int V, int chunk, bool acc) {
+    assert(H && W && targets && lse);
+    if (N <= 0 || D <= 0 || V <= 0) return;
+    if (chunk <= 0) chunk = 256;
+    constexpr int RB = 4;
+    const int VEC = 8;
+
+    if (dH && !acc) std::fill(dH, dH + (size_t)N * D, 0.0f);
+    std::vector<float> G((size_t)N * std::min(chunk, V));
+
+    for (int v0 = 0; v0 < V; v0 += chunk) {
+        const int nv = std::min(chunk, V - v0);
+
+        // 1. G tile for this chunk (recomputed logits -> softmax - onehot)
+        #pragma omp parallel for schedule(static)
+        for (int r0 = 0; r0 < N; r0 += RB) {
+            const int nr = std::min(RB, N - r0);
+            float* g = G.data() + (size_t)r0 * nv;
+            xent_logits_tile(H, W, b, r0, nr, v0, nv, D, g, nv);
+            for (int i = 0; i < nr; ++i) {
+                float* gi = g + (size_t)i * nv;
+                const int64_t t = targets[r0 + i];
+                if (t < 0) { std::fill(gi, gi + nv, 0.0f); continue; }
+                const __m256 lv = _mm256_set1_ps(lse[r0 + i]);
+                const __m256 sv = _mm256_set1_ps(scale);
+                int j = 0;
+                for (; j + VEC <= nv; j += VEC) {
+                    __m256 p = exp256_approx(_mm256_sub_ps(_mm256_loadu_ps(gi + j), lv));
+                    _mm256_storeu_ps(gi + j, _mm256_mul_ps(p, sv));
+                }
+                for (; j < nv; ++j) gi[j] = std::exp(gi[j] - lse[r0 + i]) * scale;
+                if (t >= v0 && t < v0 + nv) gi[t - v0] -= scale;
+            }
+        }
+
+        // 2. dH[n,:] += sum_j G[n,j] * W[v0+j,:]   (rows are independent)
+        if (dH) {
+            #pragma omp parallel for schedule(static)
+            for (int n = 0; n < N; ++n) {
+                const float* gn = G.data() + (size_t)n * nv;
+                float* dh = dH + (size_t)n * D;
+                for (int j = 0; j < nv; ++j) {
+                    const float gj = gn[j];
+                    if (gj == 0.0f) continue;
+                    const __m256 gv = _mm256_set1_ps(gj);
+                    const float* w = W + (size_t)(v0 + j) * D;
+                    int k = 0;
+                    for (; k + VEC <= D; k += VEC) {
+                        _mm256_storeu_ps(dh + k, _mm256_fmadd_ps(gv, _mm256_loadu_ps(w + k), _mm256_loadu_ps(dh + k)));
+                    }
+                    for (; k < D; ++k) dh[k] += gj * w[k];
+                }
+            }
+        }
+
+        // 3. dW[v0+j,:] = sum_n G[n,j] * H[n,:], db[v0+j] = sum_n G[n,j]
+        //    (vocabulary rows are independent; 4 rows share each pass over H)
+        if (dW || db) {
+            #pragma omp parallel for schedule(dynamic)
+            for (int j0 = 0; j0 < nv; j0 += RB) {
+                const int nj = std::min(RB, nv - j0);
+                if (dW && !acc) {
+                    for (int j = 0; j < nj; ++j) {
+                        float* dw = dW + (size_t)(v0 + j0 + j) * D;
+                        std::fill(dw, dw + D, 0.0f);
+                    }
+                }
+                float bsum[RB] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (int n = 0; n < N; ++n) {
+                    const float* gn = G.data() + (size_t)n * nv + j0;
+                    for (int j = 0; j < nj; ++j) bsum[j] += gn[j];
+                    if (!dW) continue;
+                    const float* h = H + (size_t)n * D;
+                    for (int j = 0; j < nj; ++j) {
+                        const float gj = gn[j];
+                        if (gj == 0.0f) continue;
+                        const __m256 gv = _mm256_set1_ps(gj);
+                        float* dw = dW + (size_t)(v0 + j0 + j) * D;
+                        int k = 0;
+                        for (; k + VEC <= D; k += VEC) {
+                            _mm256_storeu_ps(dw + k, _mm256_fmadd_ps(gv, _mm256_loadu_ps(h + k), _mm256_loadu_ps(dw + k)));
+                        }
+                        for (; k < D; ++k) dw[k] += gj * h[k];
+                    }
+                }
+                if (db) {
+                    for (int j = 0; j < nj; ++j) grad_store1(db + v0 + j0 + j, bsum[j], acc);
+                }
+            }
+        }
+    }
+}
+void linear_xent_bwd_impl_optimized(const float* H, const float* W, const float* b,
+                                    const int64_t* targets, const float* lse, float scale,
+                                    float* dH, float* dW, float* db,
+                                    int N, int D, int V, int chunk) {
+    linear_xent_bwd_kernel(H, W, b, targets, lse, scale, dH, dW, db, N, D, V, chunk, false);
+}
+void linear_xent_bwd_acc_impl_optimized(const float* H, const float* W, const float* b,
+                                        const int64_t* targets, const float* lse, float scale,
+                                        float* dH, float* dW, float* db,
+                                        int N, int D, int V, int chunk) {
+    linear_xent_bwd_kernel(H, W, b, targets, lse, scale, dH, dW, db, N, D, V, chunk, true);
+}
+
+// ---------------- LayerNorm / RMSNorm ----------------
+// x is viewed as [rows, cols] and normalized over the last axis. Only the
+// per-row mean and rstd = 1/sqrt(var + eps) are handed back for the tape.
+// gamma/beta hold `cols` values and may be null (plain normalization).
+
+// Vectorized Welford pass: 8 lanes keep a running (mean, M2) over strided
+// elements and are merged with Chan's formula, then the tail is folded in.
+static inline void welford_row(const float* x, int64_t cols, float& mean_out, float& var_out) {
+    __m256 m  = _mm256_setzero_ps();
+    __m256 m2 = _mm256_setzero_ps();
+    float cnt = 0.0f;
+    int64_t k = 0;
+    for (; k + 8 <= cols; k += 8) {
+        cnt += 1.0f;
+        __m256 v = _mm256_loadu_ps(x + k);
+        __m256 d = _mm256_sub_ps(v, m);
+        m  = _mm256_fmadd_ps(d, _mm256_set1_ps(1.0f / cnt), m);
+        m2 = _mm256_fmadd_ps(d, _mm256_sub_ps(v, m), m2);
+    }
+    float lm[8], lM[8];
+    _mm256_storeu_ps(lm, m);
+    _mm256_storeu_ps(lM, m2);
+
+    double n = 0.0, mean = 0.0, M2 = 0.0;
+    if (cnt > 0.0f) {
+        n = cnt; mean = lm[0]; M2 = lM[0];
+        for (int l = 1; l < 8; ++l) {
+            const double tot = n + cnt;
+            const double d = lm[l] - mean;
+            mean += d * cnt / tot;
+            M2 += lM[l] + d * d * n * cnt / tot;
+            n = tot;
+        }
+    }
+    for (; k < cols; ++k) {
+        n += 1.0;
+        const double d = x[k] - mean;
+        mean += d / n;
+        M2 += d * (x[k] - mean);
+    }
+    mean_out = static_cast<float>(mean);
+    var_out  = static_cast<float>(M2 / static_cast<double>(cols));
+}
+
+static inline float sumsq_row(const float* x, int64_t cols) {
+    __m256 acc = _mm256_setzero_ps();
+    int64_t k = 0;
+    for (; k + 8 <= cols; k += 8) {
+        __m256 v = _mm256_loadu_ps(x + k);
+        acc = _mm256_fmadd_ps(v, v, acc);
+    }
+    float s = hsum256(acc);
+    for (; k < cols; ++k) s += x[k] * x[k];
+    return s;
+}
+
+// y = (x - mean) * rstd * gamma + beta
+void layernorm_fwd_impl_optimized(const float* x, const float* gamma, const float* beta,
+                                  float* y, float* mean, float* rstd,
+                                  int64_t rows, int64_t cols, float eps) {
+    assert(x && y);
+    if (rows <= 0 || cols <= 0) return;
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t r = 0; r < rows; ++r) {
+        const float* xr = x + r * cols;
+        float* yr = y + r * cols;
+        float mu, var;
+        welford_row(xr, cols, mu, var);
+        const float rs = 1.0f / std::sqrt(var + eps);
+        if (mean) mean[r] = mu;
+        if (rstd) rstd[r] = rs;
+
+        const __m256 muv = _mm256_set1_ps(mu);
+        const __m256 rsv = _mm256_set1_ps(rs);
+        int64_t k = 0;
+        for (; k + 8 <= cols; k += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xr + k), muv), rsv);
+            if (gamma) v = _mm256_mul_ps(v, _mm256_loadu_ps(gamma + k));
+            if (beta)  v = _mm256_add_ps(v, _mm256_loadu_ps(beta + k));
+            _mm256_storeu_ps(yr + k, v);
+        }
+        for (; k < cols; ++k) {
+            float v = (xr[k] - mu) * rs;
+            if (gamma) v *= gamma[k];
+            if (beta)  v += beta[k];
+            yr[k] = v;
+        }
+    }
+}
+
+// With xhat = (x - mean) * rstd and g = dy * gamma:
+//   dx     = rstd * (g - mean(g) - xhat * mean(g * xhat))
+//   dgamma = sum_rows(dy * xhat),  dbeta = sum_rows(dy)
+// The row sums and the dgamma/dbeta partials come out of the same read of
+// x and dy. Outputs are overwritten (added to when acc); dx, dgamma and
+// dbeta may be null.
+static void layernorm_bwd_kernel(const float* x, const float* dy, const float* gamma,
+                                 const float* mean, const float* rstd,
+                                 float* dx, float* dgamma, float* dbeta,
+                                 int64_t rows, int64_t cols, bool acc) {
+    assert(x && dy && mean && rstd);
+    if (rows <= 0 || cols <= 0) return;
+
+    const int num_threads = omp_get_max_threads();
+    const bool need_params = dgamma || dbeta;
+    std::vector<float> partial(need_params ? (size_t)num_threads * 2 * cols : 0, 0.0f);
+    const float inv_cols = 1.0f / static_cast<float>(cols);
+
+    #pragma omp parallel
+    {
+        float* pg = need_params ? partial.data() + (size_t)omp_get_thread_num() * 2 * cols : nullptr;
+        float* pb = need_params ? pg + cols : nullptr;
+
+        #pragma omp for schedule(static)
+        for (int64_t r = 0; r < rows; ++r) {
+            const float* xr = x + r * cols;
+            const float* dyr = dy + r * cols;
+            const __m256 muv = _mm256_set1_ps(mean[r]);
+            const __m256 rsv = _mm256_set1_ps(rstd[r]);
+
+            __m256 sg = _mm256_setzero_ps(), sgx = _mm256_setzero_ps();
+            int64_t k = 0;
+            for (; k + 8 <= cols; k += 8) {
+                __m256 d  = _mm256_loadu_ps(dyr + k);
+                __m256 xh = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xr + k), muv), rsv);
+                __m256 g  = gamma ? _mm256_mul_ps(d, _mm256_loadu_ps(gamma + k)) : d;
+                sg  = _mm256_add_ps(sg, g);
+                sgx = _mm256_fmadd_ps(g, xh, sgx);
+                if (pg) {
+                    _mm256_storeu_ps(pg + k, _mm256_fmadd_ps(d, xh, _mm256_loadu_ps(pg + k)));
+                    _mm256_storeu_ps(pb + k, _mm256_add_ps(d, _mm256_loadu_ps(pb + k)));
+                }
+            }
+            float s_g = hsum256(sg), s_gx = hsum256(sgx);
+            for (; k < cols; ++k) {
+                const float xh = (xr[k] - mean[r]) * rstd[r];
+                const float g = gamma ? dyr[k] * gamma[k] : dyr[k];
+                s_g += g;
+                s_gx += g * xh;
+                if (pg) { pg[k] += dyr[k] * xh; pb[k] += dyr[k]; }
+            }
+            if (!dx) continue;
+
+            float* dxr = dx + r * cols;
+            const float mg = s_g * inv_cols, mgx = s_gx * inv_cols;
+            const __m256 mgv = _mm256_set1_ps(mg), mgxv = _mm256_set1_ps(mgx);
+            k = 0;
+            for (; k + 8 <= cols; k += 8) {
+                __m256 d  = _mm256_loadu_ps(dyr + k);
+                __m256 xh = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xr + k), muv), rsv);
+                __m256 g  = gamma ? _mm256_mul_ps(d, _mm256_loadu_ps(gamma + k)) : d;
+                __m256 v  = _mm256_sub_ps(_mm256_sub_ps(g, mgv), _mm256_mul_ps(xh, mgxv));
+                grad_store256(dxr + k, _mm256_mul_ps(v, rsv), acc);
+            }
+            for (; k < cols; ++k) {
+                const float xh = (xr[k] - mean[r]) * rstd[r];
+                const float g = gamma ? dyr[k] * gamma[k] : dyr[k];
+                grad_store1(dxr + k, (g - mg - xh * mgx) * rstd[r], acc);
+            }
+        }
+    }
+
+    if (dgamma && !acc) std::fill(dgamma, dgamma + cols, 0.0f);
+    if (dbeta && !acc)  std::fill(dbeta, dbeta + cols, 0.0f);
+    for (int t = 0; t < num_threads && need_params; ++t) {
+        const float* pg = partial.data() + (size_t)t * 2 * cols;
+        for (int64_t k = 0; k < cols; ++k) {
+            if (dgamma) dgamma[k] += pg[k];
+            if (dbeta)  dbeta[k]  += pg[cols + k];
+        }
+    }
+}
+void layernorm_bwd_impl_optimized(const float* x, const float* dy, const float* gamma,
+                                  const float* mean, const float* rstd,
+                                  float* dx, float* dgamma, float* dbeta,
+                                  int64_t rows, int64_t cols) {
+    layernorm_bwd_kernel(x, dy, gamma, mean, rstd, dx, dgamma, dbeta, rows, cols, false);
+}
+void layernorm_bwd_acc_impl_optimized(const float* x, const float* dy, const float* gamma,
+                                      const float* mean, const float* rstd,
+                                      float* dx, float* dgamma, float* dbeta,
+                                      int64_t rows, int64_t cols) {
+    layernorm_bwd_kernel(x, dy, gamma, mean, rstd, dx, dgamma, dbeta, rows, cols, true);
+}
+
+// y = x * rstd * gamma, rstd = 1/sqrt(mean(x^2) + eps)
+void rmsnorm_fwd_impl_optimized(const float* x, const float* gamma, float* y, float* rstd,
+                                int64_t rows, int64_t cols, float eps) {
+    assert(x && y);
+    if (rows <= 0 || cols <= 0) return;
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t r = 0; r < rows; ++r) {
+        const float* xr = x + r * cols;
+        float* yr = y + r * cols;
+        const float rs = 1.0f / std::sqrt(sumsq_row(xr, cols) / static_cast<float>(cols) + eps);
+        if (rstd) rstd[r] = rs;
+
+        const __m256 rsv = _mm256_set1_ps(rs);
+        int64_t k = 0;
+        for (; k + 8 <= cols; k += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(xr + k), rsv);
+            if (gamma) v = _mm256_mul_ps(v, _mm256_loadu_ps(gamma + k));
+            _mm256_storeu_ps(yr + k, v);
+        }
+        for (; k < cols; ++k) yr[k] = gamma ? xr[k] * rs * gamma[k] : xr[k] * rs;
+    }
+}
+
+// With xhat = x * rstd and g = dy * gamma:
+//   dx = rstd * (g - xhat * mean(g * xhat)),  dgamma = sum_rows(dy * xhat)
+static void rmsnorm_bwd_kernel(const float* x, const float* dy, const float* gamma,
+                               const float* rstd, float* dx, float* dgamma,
+                               int64_t rows, int64_t cols, bool acc) {
+    assert(x && dy && rstd);
+    if (rows <= 0 || cols <= 0) return;
+
+    const int num_threads = omp_get_max_threads();
+    std::vector<float> partial(dgamma ? (size_t)num_threads * cols : 0, 0.0f);
+    const float inv_cols = 1.0f / static_cast<float>(cols);
+
+    #pragma omp parallel
+    {
+        float* pg = dgamma ? partial.data() + (size_t)omp_get_thread_num() * cols : nullptr;
+
+        #pragma omp for schedule(static)
+        for (int64_t r = 0; r < rows; ++r) {
+            const float* xr = x + r * cols;
+            const float* dyr = dy + r * cols;
+            const __m256 rsv = _mm256_set1_ps(rstd[r]);
+
+            __m256 sgx = _mm256_setzero_ps();
+            int64_t k = 0;
+            for (; k + 8 <= cols; k += 8) {
+                __m256 d  = _mm256_loadu_ps(dyr + k);
+                __m256 xh = _mm256_mul_ps(_mm256_loadu_ps(xr + k), rsv);
+                __m256 g  = gamma ? _mm256_mul_ps(d, _mm256_loadu_ps(gamma + k)) : d;
+                sgx = _mm256_fmadd_ps(g, xh, sgx);
+                if (pg) _mm256_storeu_ps(pg + k, _mm256_fmadd_ps(d, xh, _mm256_loadu_ps(pg + k)));
+            }
+            float s_gx = hsum256(sgx);
+            for (; k < cols; ++k) {
+                const float xh = xr[k] * rstd[r];
+                const float g = gamma ? dyr[k] * gamma[k] : dyr[k];
+                s_gx += g * xh;
+                if (pg) pg[k] += dyr[k] * xh;
+            }
+            if (!dx) continue;
+
+            float* dxr = dx + r * cols;
+            const float mgx = s_gx * inv_cols;
+            const __m256 mgxv = _mm256_set1_ps(mgx);
+            k = 0;
+            for (; k + 8 <= cols; k += 8) {
+                __m256 d  = _mm256_loadu_ps(dyr + k);
+                __m256 xh = _mm256_mul_ps(_mm256_loadu_ps(xr + k), rsv);
+                __m256 g  = gamma ? _mm256_mul_ps(d, _mm256_loadu_ps(gamma + k)) : d;
+                grad_store256(dxr + k, _mm256_mul_ps(_mm256_sub_ps(g, _mm256_mul_ps(xh, mgxv)), rsv), acc);
+            }
+            for (; k < cols; ++k) {
+                const float xh = xr[k] * rstd[r];
+                const float g = gamma ? dyr[k] * gamma[k] : dyr[k];
+                grad_store1(dxr + k, (g - xh * mgx) * rstd[r], acc);
+            }
+        }
+    }
+
+    if (dgamma) {
+        if (!acc) std::fill(dgamma, dgamma + cols, 0.0f);
+        for (int t = 0; t < num_threads; ++t) {
+            const float* pg = partial.data() + (size_t)t * cols;
+            for (int64_t k = 0; k < cols; ++k) dgamma[k] += pg[k];
+        }
+    }
+}
+void rmsnorm_bwd_impl_optimized(const float* x, const float* dy, const float* gamma,
+                                const float* rstd, float* dx, float* dgamma,
+                                int64_t rows, int64_t cols) {
+    rmsnorm_bwd_kernel(x, dy, gamma, rstd, dx, dgamma, rows, cols, false);
+}
+void rmsnorm_bwd_acc_impl_optimized(const float* x, const float* dy, const float* gamma,
+                                    const float* rstd, float* dx, float* dgamma,
+                                    int64_t rows, int64_t cols) {
+    rmsnorm_bwd_kernel(x, dy, gamma, rstd, dx, dgamma, rows, cols, true);
+}
+
+// ---------------- Broadcasting binary ops ----------------
+// The output is viewed as [rows, cols] and each operand is full, a row vector
+// (one value per column), a column vector (one value per row) or a scalar, so
+// bias adds, per-channel scales and scalar ops never expand the small operand.
+// The op and broadcast switches are loop-invariant and get unswitched.
+static constexpr int64_t BIN_BLOCK = 4096;
+
+static inline __m256 bin_op256(int op, __m256 a, __m256 b) {
+    switch (op) {
+        case AG_BIN_SUB: return _mm256_sub_ps(a, b);
+        case AG_BIN_MUL: return _mm256_mul_ps(a, b);
+        case AG_BIN_DIV: return _mm256_div_ps(a, b);
+        default:         return _mm256_add_ps(a, b);
+    }
+}
+
+static inline float bin_op1(int op, float a, float b) {
+    switch (op) {
+        case AG_BIN_SUB: return a - b;
+        case AG_BIN_MUL: return a * b;
+        case AG_BIN_DIV: return a / b;
+        default:         return a + b;
+    }
+}
+
+// Row r of an operand: either read per column (vec) or a single value
+// broadcast across the row.
+static inline const float* bcast_row(const float* p, int mode, int64_t r, int64_t cols, bool& vec) {
+    vec = mode == AG_BCAST_FULL || mode == AG_BCAST_ROW;
+    switch (mode) {
+        case AG_BCAST_FULL: return p + r * cols;
+        case AG_BCAST_COL:  return p + r;
+        default:            return p;
+    }
+}
+
+// c[0..n) = alpha * (a op b) (+ c), with a and b vectors or broadcast scalars.
+static inline void binary_span(int op, const float* a, bool av, const float* b, bool bv,
+                               float* c, int64_t n, float alpha, bool accumulate) {
+    const __m256 as = _mm256_set1_ps(*a), bs = _mm256_set1_ps(*b), al = _mm256_set1_ps(alpha);
+    int64_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 v = bin_op256(op, av ? _mm256_loadu_ps(a + j) : as, bv ? _mm256_loadu_ps(b + j) : bs);
+        if (alpha != 1.0f) v = _mm256_mul_ps(v, al);
+        if (accumulate) v = _mm256_add_ps(v, _mm256_loadu_ps(c + j));
+        _mm256_storeu_ps(c + j, v);
+    }
+    for (; j < n; ++j) {
+        const float v = alpha * bin_op1(op, av ? a[j] : *a, bv ? b[j] : *b);
+        c[j] = accumulate ? c[j] + v : v;
+    }
+}
+
+// sum over j < n of (g[j] op m), with m a vector or a broadcast scalar.
+static inline float binary_row_sum(int op, const float* g, const float* m, bool mv, int64_t n) {
+    const __m256 ms = _mm256_set1_ps(*m);
+    __m256 acc = _mm256_setzero_ps();
+    int64_t j = 0;
+    for (; j + 8 <= n; j += 8)
+        acc = _mm256_add_ps(acc, bin_op256(op, _mm256_loadu_ps(g + j), mv ? _mm256_loadu_ps(m + j) : ms));
+    float s = hsum256(acc);
+    for (; j < n; ++j) s += bin_op1(op, g[j], mv ? m[j] : *m);
+    return s;
+}
+
+void binary_bcast_impl_optimized(int op, const float* A, int a_bcast, const float* B, int b_bcast,
+                                 float* C, int64_t rows, int64_t cols, int accumulate) {
+    if (rows <= 0 || cols <= 0) return;
+    // Long rows are split into blocks so one wide row still spreads over threads.
+    const int64_t nb = (cols + BIN_BLOCK - 1) / BIN_BLOCK;
+    #pragma omp parallel for if (rows * cols >= elem_parallel_min())
+    for (int64_t t = 0; t < rows * nb; ++t) {
+        const int64_t r = t / nb, j0 = (t % nb) * BIN_BLOCK, n = std::min(BIN_BLOCK, cols - j0);
+        bool av, bv;
+        const float* a = bcast_row(A, a_bcast, r, cols, av);
+        const float* b = bcast_row(B, b_bcast, r, cols, bv);
+        binary_span(op, av ? a + j0 : a, av, bv ? b + j0 : b, bv, C + r * cols + j0, n, 1.0f, accumulate != 0);
+    }
+}
+
+void add_impl_optimized(const float* A, const float* B, float* C, int64_t n) {
+    binary_bcast_impl_optimized(AG_BIN_ADD, A, AG_BCAST_FULL, B, AG_BCAST_FULL, C, 1, n, 0);
+}
+void sub_impl_optimized(const float* A, const float* B, float* C, int64_t n) {
+    binary_bcast_impl_optimized(AG_BIN_SUB, A, AG_BCAST_FULL, B, AG_BCAST_FULL, C, 1, n, 0);
+}
+void mul_impl_optimized(const float* A, const float* B, float* C, int64_t n) {
+    binary_bcast_impl_optimized(AG_BIN_MUL, A, AG_BCAST_FULL, B, AG_BCAST_FULL, C, 1, n, 0);
+}
+void div_impl_optimized(const float* A, const float* B, float* C, int64_t n) {
+    binary_bcast_impl_optimized(AG_BIN_DIV, A, AG_BCAST_FULL, B, AG_BCAST_FULL, C, 1, n, 0);
+}
+
+// Gradient of a broadcast operand in one pass over G: the elementwise factor
+// (G op M) is formed on the fly and summed straight into out, so neither the
+// full-size product nor a separate reduction is materialized.
+void binary_reduce_impl_optimized(int op, const float* G, const float* M, int m_bcast, float alpha,
+                                  float* out, int out_bcast, int64_t rows, int64_t cols, int accumulate) {
+    if (rows <= 0 || cols <= 0) return;
+    static const float one = 1.0f;
+    if (!M) { M = &one; m_bcast = AG_BCAST_SCALAR; op = AG_BIN_MUL; }
+    const bool par = rows * cols >= elem_parallel_min();
+
+    if (out_bcast == AG_BCAST_FULL) {
+        #pragma omp parallel for if (par)
+        for (int64_t r = 0; r < rows; ++r) {
+            bool mv;
+            const float* m = bcast_row(M, m_bcast, r, cols, mv);
+            binary_span(op, G + r * cols, true, m, mv, out + r * cols, cols, alpha, accumulate != 0);
+        }
+    } else if (out_bcast == AG_BCAST_COL) {
+        #pragma omp parallel for if (par)
+        for (int64_t r = 0; r < rows; ++r) {
+            bool mv;
+            const float* m = bcast_row(M, m_bcast, r, cols, mv);
+            const float s = alpha * binary_row_sum(op, G + r * cols, m, mv, cols);
+            out[r] = accumulate ? out[r] + s : s;
+        }
+    } else if (out_bcast == AG_BCAST_SCALAR) {
+        double total = 0.0;
+        #pragma omp parallel for reduction(+:total) if (par)
+        for (int64_t r = 0; r < rows; ++r) {
+            bool mv;
+            const float* m = bcast_row(M, m_bcast, r, cols, mv);
+            total += binary_row_sum(op, G + r * cols, m, mv, cols);
+        }
+        const float s = alpha * (float)total;
+        out[0] = accumulate ? out[0] + s : s;
+    } else {
+        // Row vector: column sums. Each thread sums a contiguous band of rows
+        // into its own partial row; the partials are added at the end.
+        const int threads = par ? omp_get_max_threads() : 1;
+        std::vector<float> partial((size_t)threads * cols, 0.0f);
+        #pragma omp parallel num_threads(threads)
+        {
+            const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+            float* acc = partial.data() + (size_t)t * cols;
+            for (int64_t r = rows * t / nt; r < rows * (t + 1) / nt; ++r) {
+                bool mv;
+                const float* m = bcast_row(M, m_bcast, r, cols, mv);
+                binary_span(op, G + r * cols, true, m, mv, acc, cols, 1.0f, true);
+            }
+        }
+        for (int64_t j = 0; j < cols; ++j) {
+            float s = 0.0f;
+            for (int t = 0; t < threads; ++t) s += partial[(size_t)t * cols + j];
+            out[j] = accumulate ? out[j] + alpha * s : alpha * s;
+        }
+    }
+}
+
+// ---------------- Reductions ----------------
+// x is viewed as [outer, n, inner] and reduced over n, which covers the last
+// axis (inner = 1), any run of adjacent axes, and all elements (outer = inner
+// = 1). Contiguous spans use four independent accumulators so the adds
+// pipeline instead of waiting on one register; long spans are cut into
+// blocks reduced in parallel and combined pairwise.
+static constexpr int64_t RED_BLOCK = 16384;
+
+static inline __m256 red_combine256(int op, __m256 a, __m256 v) {
+    switch (op) {
+        case AG_REDUCE_MAX:   return _mm256_max_ps(a, v);
+        case AG_REDUCE_SUMSQ: return _mm256_fmadd_ps(v, v, a);
+        default:              return _mm256_add_ps(a, v);
+    }
+}
+
+static inline float red_combine1(int op, float a, float v) {
+    switch (op) {
+        case AG_REDUCE_MAX:   return std::max(a, v);
+        case AG_REDUCE_SUMSQ: return a + v * v;
+        default:              return a + v;
+    }
+}
+
+static inline float red_init(int op) { return op == AG_REDUCE_MAX ? -INFINITY : 0.0f; }
+
+static inline float hmax256(__m256 v) {
+    float t[8];
+    _mm256_storeu_ps(t, v);
+    return *std::max_element(t, t + 8);
+}
+
+// Unscaled reduction of x[0..n); MEAN is summed here and scaled by the caller.
+static float reduce_span(int op, const float* x, int64_t n) {
+    const __m256 init = _mm256_set1_ps(red_init(op));
+    __m256 a0 = init, a1 = init, a2 = init, a3 = init;
+    int64_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+        a0 = red_combine256(op, a0, _mm256_loadu_ps(x + j));
+        a1 = red_combine256(op, a1, _mm256_loadu_ps(x + j + 8));
+        a2 = red_combine256(op, a2, _mm256_loadu_ps(x + j + 16));
+        a3 = red_combine256(op, a3, _mm256_loadu_ps(x + j + 24));
+    }
+    for (; j + 8 <= n; j += 8) a0 = red_combine256(op, a0, _mm256_loadu_ps(x + j));
+    float r;
+    if (op == AG_REDUCE_MAX) {
+        r = hmax256(_mm256_max_ps(_mm256_max_ps(a0, a1), _mm256_max_ps(a2, a3)));
+    } else {
+        r = hsum256(_mm256_add_ps(_mm256_add_ps(a0, a1), _mm256_add_ps(a2, a3)));
+    }
+    for (; j < n; ++j) r = red_combine1(op, r, x[j]);
+    return r;
+}
+
+// Block partials are combined as a binary tree, so a sum over n elements
+// adds O(log(n / RED_BLOCK)) rounding steps on top of one block's.
+static float reduce_long(int op, const float* x, int64_t n, bool par) {
+    if (n <= RED_BLOCK) return reduce_span(op, x, n);
+    const int64_t nb = (n + RED_BLOCK - 1) / RED_BLOCK;
+    std::vector<float> part(nb);
+    #pragma omp parallel for if (par)
+    for (int64_t b = 0; b < nb; ++b)
+        part[b] = reduce_span(op, x + b * RED_BLOCK, std::min(RED_BLOCK, n - b * RED_BLOCK));
+    const int cop = op == AG_REDUCE_MAX ? AG_REDUCE_MAX : AG_REDUCE_SUM;
+    for (int64_t w = 1; w < nb; w *= 2)
+        for (int64_t b = 0; b + w < nb; b += 2 * w) part[b] = red_combine1(cop, part[b], part[b + w]);
+    return part[0];
+}
+
+void reduce_impl_optimized(int op, const float* x, float* y, int64_t outer, int64_t n, int64_t inner) {
+    if (outer <= 0 || inner <= 0) return;
+    if (n <= 0) {
+        std::fill(y, y + outer * inner, op == AG_REDUCE_MEAN ? NAN : red_init(op));
+        return;
+    }
+    const float scale = op == AG_REDUCE_MEAN ? 1.0f / (float)n : 1.0f;
+    const bool par = outer * n * inner >= elem_parallel_min();
+
+    if (inner == 1) {
+        // Enough rows to go around: one row per task. Otherwise each row is
+        // split into blocks instead.
+        if (outer >= omp_get_max_threads()) {
+            #pragma omp parallel for if (par)
+            for (int64_t o = 0; o < outer; ++o) y[o] = reduce_long(op, x + o * n, n, false) * scale;
+        } else {
+            for (int64_t o = 0; o < outer; ++o) y[o] = reduce_long(op, x + o * n, n, par) * scale;
+        }
+        return;
+    }
+
+    // Strided axis: each task owns 32 output columns and streams the n rows
+    // of that strip, so every load is a contiguous 8-wide vector.
+    const int64_t nib = (inner + 31) / 32;
+    const __m256 init = _mm256_set1_ps(red_init(op)), sc = _mm256_set1_ps(scale);
+    #pragma omp parallel for if (par)
+    for (int64_t t = 0; t < outer * nib; ++t) {
+        const int64_t o = t / nib, i0 = (t % nib) * 32, w = std::min<int64_t>(32, inner - i0);
+        const float* xo = x + o * n * inner + i0;
+        float* yo = y + o * inner + i0;
+        if (w == 32) {
+            __m256 a0 = init, a1 = init, a2 = init, a3 = init;
+            for (int64_t k = 0; k < n; ++k) {
+                const float* row = xo + k * inner;
+                a0 = red_combine256(op, a0, _mm256_loadu_ps(row));
+                a1 = red_combine256(op, a1, _mm256_loadu_ps(row + 8));
+                a2 = red_combine256(op, a2, _mm256_loadu_ps(row + 16));
+                a3 = red_combine256(op, a3, _mm256_loadu_ps(row + 24));
+            }
+            _mm256_storeu_ps(yo, _mm256_mul_ps(a0, sc));
+            _mm256_storeu_ps(yo + 8, _mm256_mul_ps(a1, sc));
+            _mm256_storeu_ps(yo + 16, _mm256_mul_ps(a2, sc));
+            _mm256_storeu_ps(yo + 24, _mm256_mul_ps(a3, sc));
+        } else {
+            float acc[32];
+            std::fill(acc, acc + w, red_init(op));
+            for (int64_t k = 0; k < n; ++k) {
+                const float* row = xo + k * inner;
+                for (int64_t i = 0; i < w; ++i) acc[i] = red_combine1(op, acc[i], row[i]);
+            }
+            for (int64_t i = 0; i < w; ++i) yo[i] = acc[i] * scale;
+        }
+    }
+}
+
+// ---------------- Fused linear + activation ----------------
+// Y = act(X @ W^T + b) with X: [B,In], W: [Out,In] (nn::Linear layout), b: [Out].
+// Runs the packed GEMM with W read through its strides as W^T, and adds the
+// bias and applies the activation in the GEMM epilogue, on each tile while it
+// is still in cache. Z (the pre-activation) is only written when non-null
+// (backward of GELU/SiLU needs it; ReLU can use Y instead).
+
+static inline __m256 act_tanh256(__m256 u) {
+    // tanh(u) = 1 - 2 / (1 + e^{2u}); clamp so e^{2u} stays finite
+    u = _mm256_max_ps(_mm256_min_ps(u, _mm256_set1_ps(15.0f)), _mm256_set1_ps(-15.0f));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = exp256_approx(_mm256_add_ps(u, u));
+    return _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(one, e)));
+}
+
+static inline __m256 act_fwd256(__m256 z, int act) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    switch (act) {
+    case AG_ACT_RELU:
+        return _mm256_max_ps(z, _mm256_setzero_ps());
+    case AG_ACT_GELU: {
+        __m256 z3 = _mm256_mul_ps(_mm256_mul_ps(z, z), z);
+        __m256 u = _mm256_mul_ps(_mm256_set1_ps(0.7978845608028654f),
+                                 _mm256_fmadd_ps(_mm256_set1_ps(0.044715f), z3, z));
+        __m256 th = act_tanh256(u);
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), z), _mm256_add_ps(one, th));
+    }
+    case AG_ACT_SILU: {
+        __m256 e = exp256_approx(_mm256_sub_ps(_mm256_setzero_ps(), z));
+        return _mm256_div_ps(z, _mm256_add_ps(one, e));
+    }
+    default:
+        return z;
+    }
+}
+
+// dZ = dY * act'(s); s is Z for GELU/SiLU and either Z or Y for ReLU.
+static inline __m256 act_bwd256(__m256 s, __m256 dy, int act) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    switch (act) {
+    case AG_ACT_RELU:
+        return _mm256_and_ps(dy, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GT_OQ));
+    case AG_ACT_GELU: {
+        const __m256 c1 = _mm256_set1_ps(0.7978845608028654f);
+        const __m256 c2 = _mm256_set1_ps(0.044715f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        __m256 s2 = _mm256_mul_ps(s, s);
+        __m256 u = _mm256_mul_ps(c1, _mm256_fmadd_ps(_mm256_mul_ps(c2, s2), s, s));
+        __m256 th = act_tanh256(u);
+        // du/dz = c1 * (1 + 3 c2 z^2)
+        __m256 du = _mm256_mul_ps(c1, _mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f), c2), s2, one));
+        __m256 sech2 = _mm256_fnmadd_ps(th, th, one);
+        __m256 g = _mm256_fmadd_ps(_mm256_mul_ps(half, s), _mm256_mul_ps(sech2, du),
+                                   _mm256_mul_ps(half, _mm256_add_ps(one, th)));
+        return _mm256_mul_ps(dy, g);
+    }
+    case AG_ACT_SILU: {
+        __m256 e = exp256_approx(_mm256_sub_ps(_mm256_setzero_ps(), s));
+        __m256 sg = _mm256_div_ps(one, _mm256_add_ps(one, e));
+        // sigma(z) * (1 + z * (1 - sigma(z)))
+        __m256 g = _mm256_mul_ps(sg, _mm256_fmadd_ps(s, _mm256_sub_ps(one, sg), one));
+        return _mm256_mul_ps(dy, g);
+    }
+    default:
+        return dy;
+    }
+}
+
+static inline float act_bwd1(float s, float dy, int act) {
+    switch (act) {
+    case AG_ACT_RELU: return s > 0.0f ? dy : 0.0f;
+    case AG_ACT_GELU: {
+        const float c1 = 0.7978845608028654f, c2 = 0.044715f;
+        float th = std::tanh(c1 * (s + c2 * s * s * s));
+        float du = c1 * (1.0f + 3.0f * c2 * s * s);
+        return dy * (0.5f * (1.0f + th) + 0.5f * s * (1.0f - th * th) * du);
+    }
+    case AG_ACT_SILU: {
+        float sg = 1.0f / (1.0f + std::exp(-s));
+        return dy * sg * (1.0f + s * (1.0f - sg));
+    }
+    default: return dy;
+    }
+}
+
+static constexpr int LA_NR = 16;         // output columns per strip (two AVX2 registers)
+static constexpr int LA_MR = 4;          // rows per register tile
+static constexpr int LA_ROW_BLOCK = 64;  // rows swept per packed strip
+
+// Epilogue of the fused linear: z = acc + b[j], Z <- z, Y <- act(z).
+struct LinearActEpilogue { const float* b; float* Z; int Out; int act; };
+
+static void linear_act_epilogue(const void* ctx, float* C, int64_t ldc, int i, int j, int m, int n) {
+    const LinearActEpilogue& e = *static_cast<const LinearActEpilogue*>(ctx);
+    for (int r = 0; r < m; ++r) {
+        float* y = C + (int64_t)r * ldc;
+        float* z = e.Z ? e.Z + (size_t)(i + r) * e.Out + j : nullptr;
+        const float* bias = e.b ? e.b + j : nullptr;
+        int c = 0;
+        for (; c + 8 <= n; c += 8) {
+            __m256 v = _mm256_loadu_ps(y + c);
+            if (bias) v = _mm256_add_ps(v, _mm256_loadu_ps(bias + c));
+            if (z) _mm256_storeu_ps(z + c, v);
+            _mm256_storeu_ps(y + c, act_fwd256(v, e.act));
+        }
+        if (c < n) {
+            alignas(32) float tmp[8] = {0};
+            for (int t = 0; t < n - c; ++t) tmp[t] = y[c + t] + (bias ? bias[c + t] : 0.0f);
+            if (z) std::memcpy(z + c, tmp, sizeof(float) * (n - c));
+            _mm256_store_ps(tmp, act_fwd256(_mm256_load_ps(tmp), e.act));
+            std::memcpy(y + c, tmp, sizeof(float) * (n - c));
+        }
+    }
+}
+
+void linear_act_fwd_impl_optimized(const float* X, const float* W, const float* b,
+                                   float* Y, float* Z, int B, int In, int Out, int act) {
+    assert(X && W && Y);
+    if (B <= 0 || Out <= 0) return;
+    const LinearActEpilogue la{b, Z, Out, act};
+    const GemmEpilogue ep{&linear_act_epilogue, &la, 0, 0};
+    // Y[B,Out] = X[B,In] @ W^T, element (k,j) of W^T being W[j * In + k]
+    gemm_strided(B, Out, In, X, In, 1, W, 1, In, Y, Out, false, nullptr, &ep);
+}
+
+// Backward of Y = act(X @ W^T + b). S is the tensor saved by the forward
+// (Z for GELU/SiLU, Y or Z for ReLU; ignored for AG_ACT_NONE). The activation
+// derivative is applied once into dZ, which then feeds all three GEMM-shaped
+// reductions. dX, dW and db are overwritten (added to when acc); any of them
+// may be null.
+static void linear_act_bwd_kernel(const float* X, const float* W, const float* S,
+                                  const float* dY, float* dX, float* dW, float* db,
+                                  int B, int In, int Out, int act, bool acc) {
+    assert(X && W && dY);
+    if (Out <= 0) return;
+
+    const float* dZ = dY;
+    std::vector<float> dZbuf;
+    if (act != AG_ACT_NONE) {
+        assert(S);
+        const int64_t n = (int64_t)B * Out;
+        dZbuf.resize((size_t)n);
+        float* g = dZbuf.data();
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < n; i += 8) {
+            if (i + 8 <= n) {
+                _mm256_storeu_ps(g + i, act_bwd256(_mm256_loadu_ps(S + i), _mm256_loadu_ps(dY + i), act));
+            } else {
+                for (int64_t j = i; j < n; ++j) g[j] = act_bwd1(S[j], dY[j], act);
+            }
+        }
+        dZ = g;
+    }
+
+    // dX[B,In] = dZ[B,Out] @ W[Out,In]
+    if (dX) gemm_strided(B, In, Out, dZ, Out, 1, W, In, 1, dX, In, acc);
+    // dW[Out,In] = dZ^T @ X, zeroed (non-acc) when B == 0. db is a sweep of
+    // its own, so it is written for In == 0 as well.
+    if (dW) gemm_strided(Out, In, B, dZ, 1, Out, X, In, 1, dW, In, acc);
+    if (db) linear_db_kernel(dZ, db, B, Out, acc);
+}
+void linear_act_bwd_impl_optimized(const float* X, const float* W, const float* S,
+                                   const float* dY, float* dX, float* dW, float* db,
+                                   int B, int In, int Out, int act) {
+    linear_act_bwd_kernel(X, W, S, dY, dX, dW, db, B, In, Out, act, false);
+}
+void linear_act_bwd_acc_impl_optimized(const float* X, const float* W, const float* S,
+                                       const float* dY, float* dX, float* dW, float* db,
+                                       int B, int In, int Out, int act) {
+    linear_act_bwd_kernel(X, W, S, dY, dX, dW, db, B, In, Out, act, true);
+}
+
+// ---------------- Fused SwiGLU FFN ----------------
+// Y = silu(X @ Wg^T + bg) * (X @ Wu^T + bu), X: [B,In], Wg/Wu: [H,In], Y: [B,H].
+// Both projections run as one GEMM against the concatenated weight [Wg; Wu]:
+// each packed strip holds 8 gate columns next to the same 8 up columns, so one
+// 4x16 register tile yields matching gate/up values and silu(g) * u is applied
+// in the epilogue. G and U (nullable) receive the two pre-activations for the
+// backward.
+static constexpr int SG_NC = LA_NR / 2;  // output columns per strip
+
+static inline void swiglu_block(const float* X, const float* Wg, const float* bg,
+                                const float* Wu, const float* bu, float* Y, float* G, float* U,
+                                int r_begin, int r_end, int j0, int In, int H, float* Wt) {
+    constexpr int NR = LA_NR, MR = LA_MR;
+    const int nc = std::min(SG_NC, H - j0);
+
+    // Wt[k*NR + j] = Wg[j0+j, k], Wt[k*NR + 8 + j] = Wu[j0+j, k], zero-padded past H
+    for (int j = 0; j < SG_NC; ++j) {
+        const float* wg = j < nc ? Wg + (size_t)(j0 + j) * In : nullptr;
+        const float* wu = j < nc ? Wu + (size_t)(j0 + j) * In : nullptr;
+        for (int k = 0; k < In; ++k) {
+            Wt[(size_t)k * NR + j] = wg ? wg[k] : 0.0f;
+            Wt[(size_t)k * NR + SG_NC + j] = wu ? wu[k] : 0.0f;
+        }
+    }
+    alignas(32) float bias[NR] = {0};
+    for (int j = 0; j < nc; ++j) {
+        if (bg) bias[j] = bg[j0 + j];
+        if (bu) bias[SG_NC + j] = bu[j0 + j];
+    }
+    const __m256 b0 = _mm256_load_ps(bias), b1 = _mm256_load_ps(bias + 8);
+
+    for (int r0 = r_begin; r0 < r_end; r0 += MR) {
+        const int nr = std::min(MR, r_end - r0);
+        const float* x[MR];
+        for (int i = 0; i < MR; ++i) x[i] = X + (size_t)(r0 + std::min(i, nr - 1)) * In;
+
+        __m256 acc[MR][2];
+        for (int i = 0; i < MR; ++i) { acc[i][0] = b0; acc[i][1] = b1; }
+
+        for (int k = 0; k < In; ++k) {
+            const __m256 w0 = _mm256_loadu_ps(&Wt[(size_t)k * NR]);
+            const __m256 w1 = _mm256_loadu_ps(&Wt[(size_t)k * NR + 8]);
+            for (int i = 0; i < MR; ++i) {
+                const __m256 a = _mm256_set1_ps(x[i][k]);
+                acc[i][0] = _mm256_fmadd_ps(a, w0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_ps(a, w1, acc[i][1]);
+            }
+        }
+
+        // epilogue: gate and up halves of the tile are already side by side
+        for (int i = 0; i < nr; ++i) {
+            const size_t off = (size_t)(r0 + i) * H + j0;
+            const __m256 y = _mm256_mul_ps(act_fwd256(acc[i][0], AG_ACT_SILU), acc[i][1]);
+            if (nc == SG_NC) {
+                _mm256_storeu_ps(Y + off, y);
+                if (G) _mm256_storeu_ps(G + off, acc[i][0]);
+                if (U) _mm256_storeu_ps(U + off, acc[i][1]);
+            } else {
+                alignas(32) float tmp[SG_NC];
+                _mm256_store_ps(tmp, y);
+                std::memcpy(Y + off, tmp, sizeof(float) * nc);
+                if (G) { _mm256_store_ps(tmp, acc[i][0]); std::memcpy(G + off, tmp, sizeof(float) * nc); }
+                if (U) { _mm256_store_ps(tmp, acc[i][1]); std::memcpy(U + off, tmp, sizeof(float) * nc); }
+            }
+        }
+    }
+}
+
+void swiglu_fwd_impl_optimized(const float* X, const float* Wg, const float* bg,
+                               const float* Wu, const float* bu, float* Y, float* G, float* U,
+                               int B, int In, int H) {
+    assert(X && Wg && Wu && Y);
+    if (B <= 0 || H <= 0) return;
+
+    const int n_strips = (H + SG_NC - 1) / SG_NC;
+    const int n_rblocks = (B + LA_ROW_BLOCK - 1) / LA_ROW_BLOCK;
+
+    #pragma omp parallel
+    {
+        std::vector<float> Wt((size_t)std::max(In, 1) * LA_NR);
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int s = 0; s < n_strips; ++s) {
+            for (int rb = 0; rb < n_rblocks; ++rb) {
+                swiglu_block(X, Wg, bg, Wu, bu, Y, G, U, rb * LA_ROW_BLOCK, std::min(B, (rb + 1) * LA_ROW_BLOCK),
+                             s * SG_NC, In, H, Wt.data());
+            }
+        }
+    }
+}
+
+// Backward from the saved pre-activations G and U. One elementwise pass writes
+// both derivatives side by side, dZ = [dG | dU] with dU = dY * silu(g) and
+// dG = dY * u * silu'(g). dX is two GEMMs into the same output, one per
+// half of dZ, and dWg / dWu likewise read their half through its row stride,
+// so the weights are never copied.
+// Outputs are overwritten (added to when acc) and may be null.
+static void swiglu_bwd_kernel(const float* X, const float* Wg, const float* Wu,
+                              const float* G, const float* U, const float* dY,
+                              float* dX, float* dWg, float* dbg, float* dWu, float* dbu,
+                              int B, int In, int H, bool acc) {
+    assert(X && Wg && Wu && G && U && dY);
+    // The bias gradients need only dZ, so In == 0 still writes them, and
+    // B == 0 zeroes every gradient (non-acc) through the K == 0 GEMMs.
+    if (H <= 0 || B < 0 || In < 0) return;
+    const int H2 = 2 * H;
+
+    std::vector<float> dZ((size_t)B * H2);
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < B; ++r) {
+        const float* g = G + (size_t)r * H;
+        const float* u = U + (size_t)r * H;
+        const float* dy = dY + (size_t)r * H;
+        float* dg = dZ.data() + (size_t)r * H2;
+        float* du = dg + H;
+        int j = 0;
+        for (; j + 8 <= H; j += 8) {
+            const __m256 gv = _mm256_loadu_ps(g + j), dyv = _mm256_loadu_ps(dy + j);
+            _mm256_storeu_ps(du + j, _mm256_mul_ps(dyv, act_fwd256(gv, AG_ACT_SILU)));
+            _mm256_storeu_ps(dg + j, act_bwd256(gv, _mm256_mul_ps(dyv, _mm256_loadu_ps(u + j)), AG_ACT_SILU));
+        }
+        for (; j < H; ++j) {
+            du[j] = dy[j] * g[j] / (1.0f + std::exp(-g[j]));
+            dg[j] = act_bwd1(g[j], dy[j] * u[j], AG_ACT_SILU);
+        }
+    }
+
+    // dX[B,In] = dZ[:, :H] @ Wg + dZ[:, H:] @ Wu
+    if (dX) {
+        gemm_strided(B, In, H, dZ.data(), H2, 1, Wg, In, 1, dX, In, acc);
+        gemm_strided(B, In, H, dZ.data() + H, H2, 1, Wu, In, 1, dX, In, true);
+    }
+    // dWg = dZ[:, :H]^T @ X, dWu = dZ[:, H:]^T @ X
+    if (dWg) gemm_strided(H, In, B, dZ.data(), 1, H2, X, In, 1, dWg, In, acc);
+    if (dWu) gemm_strided(H, In, B, dZ.data() + H, 1, H2, X, In, 1, dWu, In, acc);
+    if (dbg || dbu) {
+        std::vector<float> db(H2);
+        linear_db_impl_optimized(dZ.data(), db.data(), B, H2);
+        for (int j = 0; j < H; ++j) {
+            if (dbg) grad_store1(dbg + j, db[j], acc);
+            if (dbu) grad_store1(dbu + j, db[H + j], acc);
+        }
+    }
+}
+void swiglu_bwd_impl_optimized(const float* X, const float* Wg, const float* Wu,
+                               const float* G, const float* U, const float* dY,
+                               float* dX, float* dWg, float* dbg, float* dWu, float* dbu,
+                               int B, int In, int H) {
+    swiglu_bwd_kernel(X, Wg, Wu, G, U, dY, dX, dWg, dbg, dWu, dbu, B, In, H, false);
+}
+void swiglu_bwd_acc_impl_optimized(const float* X, const float* Wg, const float* Wu,
+                                   const float* G, const float* U, const float* dY,
+                                   float* dX, float* dWg, float* dbg, float* dWu, float* dbu,
+                                   int B, int In, int H) {
+    swiglu_bwd_kernel(X, Wg, Wu, G, U, dY, dX, dWg, dbg, dWu, dbu, B, In, H, true);
+}
+
+// ---------------- Rotary positional embedding (RoPE) ----------------
+// X, Y: [N,H,D] (N tokens, H heads), pos: [N] token positions, cos/sin:
+// [max_pos, D/2] tables. Rotate-half pairing as in GPT-NeoX / LLaMA: element i
+// and i + D/2 of each head are rotated by angle pos * theta_i,
+//   y_i = x_i cos - x_{i+D/2} sin,   y_{i+D/2} = x_{i+D/2} cos + x_i sin.
+// inverse != 0 rotates by the negative angle, which is the VJP. Y may alias X.
+void rope_impl_optimized(const float* X, float* Y, const float* cos_t, const float* sin_t,
+                         const int* pos, int N, int H, int D, int inverse) {
+    assert(X && Y && cos_t && sin_t && pos && D % 2 == 0);
+    const int half = D / 2;
+    const __m256 sign = _mm256_set1_ps(inverse ? -1.0f : 1.0f);
+
+    #pragma omp parallel for schedule(static)
+    for (int n = 0; n < N; ++n) {
+        const float* c = cos_t + (size_t)pos[n] * half;
+        const float* s = sin_t + (size_t)pos[n] * half;
+        for (int h = 0; h < H; ++h) {
+            const float* x = X + ((size_t)n * H + h) * D;
+            float* y = Y + ((size_t)n * H + h) * D;
+            int i = 0;
+            for (; i + 8 <= half; i += 8) {
+                const __m256 cv = _mm256_loadu_ps(c + i);
+                const __m256 sv = _mm256_mul_ps(sign, _mm256_loadu_ps(s + i));
+                const __m256 x1 = _mm256_loadu_ps(x + i), x2 = _mm256_loadu_ps(x + half + i);
+                _mm256_storeu_ps(y + i, _mm256_fnmadd_ps(x2, sv, _mm256_mul_ps(x1, cv)));
+                _mm256_storeu_ps(y + half + i, _mm256_fmadd_ps(x1, sv, _mm256_mul_ps(x2, cv)));
+            }
+            for (; i < half; ++i) {
+                const float sv = inverse ? -s[i] : s[i];
+                const float x1 = x[i], x2 = x[half + i];
+                y[i] = x1 * c[i] - x2 * sv;
+                y[half + i] = x2 * c[i] + x1 * sv;
+            }
+        }
+    }
+}
+
+// ---------------- Selective scan (Mamba SSM) ----------------
+// Per batch row, channel d and state n:
+//   h_t[d,n] = exp(a_t[d]) * h_{t-1}[d,n] + b_t[n] * x_t[d]
+//   y_t[d]   = sum_n c_t[n] * h_t[d,n] + dskip[d] * x_t[d]
+// with x, a: [Bt,T,D], b, c: [Bt,T,N], dskip: [D] (may be null), h_{-1} = 0.
+// a is the (input-dependent) log-decay, so the recurrence is linear in h and
+// composes associatively across time. T is cut into chunks: each chunk is
+// scanned from a zero state in parallel, the chunk carries are combined with
+// a short serial pass over chunks, and a second parallel pass produces y from
+// the true entering state. hb [Bt, nchunks, D, N] receives the state entering
+// each chunk; it is all the backward needs to rebuild the rest.
+
+// Run steps t0..t1 of one batch row, updating h [D,N] in place. y may be null.
+static inline void ssm_chunk_fwd(const float* x, const float* a, const float* b, const float* c,
+                                 const float* dskip, float* h, float* y,
+                                 int t0, int t1, int D, int N) {
+    for (int t = t0; t < t1; ++t) {
+        const float* bt = b + (size_t)t * N;
+        const float* ct = c + (size_t)t * N;
+        for (int d = 0; d < D; ++d) {
+            const float xv = x[(size_t)t * D + d];
+            const float decay = std::exp(a[(size_t)t * D + d]);
+            float* hd = h + (size_t)d * N;
+            const __m256 dv = _mm256_set1_ps(decay), xs = _mm256_set1_ps(xv);
+            __m256 acc = _mm256_setzero_ps();
+            int n = 0;
+            for (; n + 8 <= N; n += 8) {
+                __m256 hv = _mm256_fmadd_ps(dv, _mm256_loadu_ps(hd + n), _mm256_mul_ps(xs, _mm256_loadu_ps(bt + n)));
+                _mm256_storeu_ps(hd + n, hv);
+                acc = _mm256_fmadd_ps(_mm256_loadu_ps(ct + n), hv, acc);
+            }
+            float s = hsum256(acc);
+            for (; n < N; ++n) {
+                hd[n] = decay * hd[n] + xv * bt[n];
+                s += ct[n] * hd[n];
+            }
+            if (y) y[(size_t)t * D + d] = s + (dskip ? dskip[d] * xv : 0.0f);
+        }
+    }
+}
+
+void ssm_scan_fwd_impl_optimized(const float* x, const float* a, const float* b, const float* c,
+                                 const float* dskip, float* y, float* hb,
+                                 int Bt, int T, int D, int N, int chunk) {
+    assert(x && a && b && c && y);
+    if (Bt <= 0 || T <= 0 || D <= 0 || N <= 0) return;
+    if (chunk <= 0) chunk = T;
+    const int nck = (T + chunk - 1) / chunk;
+    const size_t DN = (size_t)D * N;
+
+    std::vector<float> hb_local;
+    if (!hb) { hb_local.resize((size_t)Bt * nck * DN); hb = hb_local.data(); }
+    std::vector<float> S((size_t)Bt * nck * DN);       // chunk-local end state
+    std::vector<float> logP((size_t)Bt * nck * D);     // summed log-decay per chunk
+
+    // 1) every chunk from a zero state
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int bi = 0; bi < Bt; ++bi) {
+        for (int k = 0; k < nck; ++k) {
+            const int t0 = k * chunk, t1 = std::min(T, t0 + chunk);
+            const float* xb = x + (size_t)bi * T * D;
+            const float* ab = a + (size_t)bi * T * D;
+            float* h = S.data() + ((size_t)bi * nck + k) * DN;
+            std::fill(h, h + DN, 0.0f);
+            ssm_chunk_fwd(xb, ab, b + (size_t)bi * T * N, c + (size_t)bi * T * N, nullptr, h, nullptr, t0, t1, D, N);
+            float* lp = logP.data() + ((size_t)bi * nck + k) * D;
+            for (int d = 0; d < D; ++d) {
+                float s = 0.0f;
+                for (int t = t0; t < t1; ++t) s += ab[(size_t)t * D + d];
+                lp[d] = s;
+            }
+        }
+    }
+
+    // 2) carry states across chunks: H_k = P_k * H_{k-1} + S_k
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int bi = 0; bi < Bt; ++bi) {
+        for (int d = 0; d < D; ++d) {
+            float* hin = hb + (size_t)bi * nck * DN + (size_t)d * N;
+            std::fill(hin, hin + N, 0.0f);
+            for (int k = 1; k < nck; ++k) {
+                const size_t prev = ((size_t)bi * nck + k - 1);
+                const float p = std::exp(logP[prev * D + d]);
+                const float* hp = hb + prev * DN + (size_t)d * N;
+                const float* sp = S.data() + prev * DN + (size_t)d * N;
+                float* hk = hb + (prev + 1) * DN + (size_t)d * N;
+                for (int n = 0; n < N; ++n) hk[n] = p * hp[n] + sp[n];
+            }
+        }
+    }
+
+    // 3) rescan every chunk from its true entering state
+    #pragma omp parallel
+    {
+        std::vector<float> h(DN);
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int bi = 0; bi < Bt; ++bi) {
+            for (int k = 0; k < nck; ++k) {
+                const int t0 = k * chunk, t1 = std::min(T, t0 + chunk);
+                const float* hin = hb + ((size_t)bi * nck + k) * DN;
+                std::copy(hin, hin + DN, h.begin());
+                ssm_chunk_fwd(x + (size_t)bi * T * D, a + (size_t)bi * T * D,
+                              b + (size_t)bi * T * N, c + (size_t)bi * T * N, dskip,
+                              h.data(), y + (size_t)bi * T * D, t0, t1, D, N);
+            }
+        }
+    }
+}
+
+// Backward. The adjoint g_t = dL/dh_t runs backwards in time:
+//   g_t[d,n] = c_t[n] * gy_t[d] + exp(a_{t+1}[d]) * g_{t+1}[d,n]
+// and is chunked exactly like the forward: local adjoints from a zero carry,
+// a serial pass over chunks for the carries, then one parallel pass per chunk
+// that rebuilds h from hb and emits all gradients. Outputs are overwritten
+// (added to when acc) and may be null.
+static void ssm_scan_bwd_kernel(const float* x, const float* a, const float* b, const float* c,
+                                const float* dskip, const float* hb, const float* gy,
+                                float* dx, float* da, float* db, float* dc, float* ddskip,
+                                int Bt, int T, int D, int N, int chunk, bool acc) {
+    assert(x && a && b && c && hb && gy);
+    if (Bt <= 0 || T <= 0 || D <= 0 || N <= 0) return;
+    if (chunk <= 0) chunk = T;
+    const int nck = (T + chunk - 1) / chunk;
+    const size_t DN = (size_t)D * N;
+
+    std::vector<float> Lr((size_t)Bt * nck * DN);   // exp(a_t0) * local g_t0
+    std::vector<float> logP((size_t)Bt * nck * D);
+    std::vector<float> R((size_t)Bt * nck * DN);    // carry entering each chunk from the right
+    std::vector<float> dd_part(ddskip ? (size_t)Bt * nck * D : 0);
+
+    // 1) local adjoint per chunk with a zero right carry
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int bi = 0; bi < Bt; ++bi) {
+        for (int k = 0; k < nck; ++k) {
+            const int t0 = k * chunk, t1 = std::min(T, t0 + chunk);
+            const float* ab = a + (size_t)bi * T * D;
+            const float* cb = c + (size_t)bi * T * N;
+            const float* gb = gy + (size_t)bi * T * D;
+            float* r = Lr.data() + ((size_t)bi * nck + k) * DN;
+            float* lp = logP.data() + ((size_t)bi * nck + k) * D;
+            std::fill(r, r + DN, 0.0f);
+            std::fill(lp, lp + D, 0.0f);
+            for (int t = t1 - 1; t >= t0; --t) {
+                const float* ct = cb + (size_t)t * N;
+                for (int d = 0; d < D; ++d) {
+                    const float g = gb[(size_t)t * D + d];
+                    const float e = std::exp(ab[(size_t)t * D + d]);
+                    lp[d] += ab[(size_t)t * D + d];
+                    float* rd = r + (size_t)d * N;
+                    for (int n = 0; n < N; ++n) rd[n] = e * (ct[n] * g + rd[n]);
+                }
+            }
+        }
+    }
+
+    // 2) right-to-left carries: R_{k-1} = Lr_k + P_k * R_k
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int bi = 0; bi < Bt; ++bi) {
+        for (int d = 0; d < D; ++d) {
+            const size_t last = (size_t)bi * nck + nck - 1;
+            float* rl = R.data() + last * DN + (size_t)d * N;
+            std::fill(rl, rl + N, 0.0f);
+            for (int k = nck - 1; k > 0; --k) {
+                const size_t cur = (size_t)bi * nck + k;
+                const float p = std::exp(logP[cur * D + d]);
+                const float* rk = R.data() + cur * DN + (size_t)d * N;
+                const float* lk = Lr.data() + cur * DN + (size_t)d * N;
+                float* rp = R.data() + (cur - 1) * DN + (size_t)d * N;
+                for (int n = 0; n < N; ++n) rp[n] = lk[n] + p * rk[n];
+            }
+        }
+    }
+
+    // 3) rebuild h inside each chunk and run the adjoint with the true carry
+    #pragma omp parallel
+    {
+        std::vector<float> H((size_t)(chunk + 1) * DN);   // H[0] = entering state, H[i+1] = h_{t0+i}
+        std::vector<float> r(DN);
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int bi = 0; bi < Bt; ++bi) {
+            for (int k = 0; k < nck; ++k) {
+                const int t0 = k * chunk, t1 = std::min(T, t0 + chunk);
+                const size_t slot = (size_t)bi * nck + k;
+                const float* xb = x + (size_t)bi * T * D;
+                const float* ab = a + (size_t)bi * T * D;
+                const float* bb = b + (size_t)bi * T * N;
+                const float* cb = c + (size_t)bi * T * N;
+                const float* gb = gy + (size_t)bi * T * D;
+
+                std::copy(hb + slot * DN, hb + (slot + 1) * DN, H.begin());
+                for (int t = t0; t < t1; ++t) {
+                    float* hn = H.data() + (size_t)(t - t0 + 1) * DN;
+                    std::copy(hn - DN, hn, hn);
+                    ssm_chunk_fwd(xb, ab, bb, cb, nullptr, hn, nullptr, t, t + 1, D, N);
+                }
+
+                std::copy(R.begin() + slot * DN, R.begin() + (slot + 1) * DN, r.begin());
+                float* ddp = ddskip ? dd_part.data() + slot * D : nullptr;
+                if (ddp) std::fill(ddp, ddp + D, 0.0f);
+                for (int t = t1 - 1; t >= t0; --t) {
+                    const float* bt = bb + (size_t)t * N;
+                    const float* ct = cb + (size_t)t * N;
+                    const float* ht = H.data() + (size_t)(t - t0 + 1) * DN;
+                    const float* hp = ht - DN;
+                    float* dbt = db ? db + ((size_t)bi * T + t) * N : nullptr;
+                    float* dct = dc ? dc + ((size_t)bi * T + t) * N : nullptr;
+                    if (dbt && !acc) std::fill(dbt, dbt + N, 0.0f);
+                    if (dct && !acc) std::fill(dct, dct + N, 0.0f);
+                    for (int d = 0; d < D; ++d) {
+                        const size_t td = (size_t)t * D + d;
+                        const float gyv = gb[td], xv = xb[td];
+                        const float e = std::exp(ab[td]);
+                        float* rd = r.data() + (size_t)d * N;
+                        const float* htd = ht + (size_t)d * N;
+                        const float* hpd = hp + (size_t)d * N;
+                        const __m256 gys = _mm256_set1_ps(gyv), xs = _mm256_set1_ps(xv), es = _mm256_set1_ps(e);
+                        __m256 sx = _mm256_setzero_ps(), sa = _mm256_setzero_ps();
+                        int n = 0;
+                        for (; n + 8 <= N; n += 8) {
+                            __m256 gv = _mm256_fmadd_ps(_mm256_loadu_ps(ct + n), gys, _mm256_loadu_ps(rd + n));
+                            sx = _mm256_fmadd_ps(gv, _mm256_loadu_ps(bt + n), sx);
+                            sa = _mm256_fmadd_ps(gv, _mm256_loadu_ps(hpd + n), sa);
+                            if (dbt) _mm256_storeu_ps(dbt + n, _mm256_fmadd_ps(gv, xs, _mm256_loadu_ps(dbt + n)));
+                            if (dct) _mm256_storeu_ps(dct + n, _mm256_fmadd_ps(gys, _mm256_loadu_ps(htd + n), _mm256_loadu_ps(dct + n)));
+                            _mm256_storeu_ps(rd + n, _mm256_mul_ps(es, gv));
+                        }
+                        float s_x = hsum256(sx), s_a = hsum256(sa);
+                        for (; n < N; ++n) {
+                            const float gv = ct[n] * gyv + rd[n];
+                            s_x += gv * bt[n];
+                            s_a += gv * hpd[n];
+                            if (dbt) dbt[n] += gv * xv;
+                            if (dct) dct[n] += gyv * htd[n];
+                            rd[n] = e * gv;
+                        }
+                        if (dx) grad_store1(dx + (size_t)bi * T * D + td, s_x + (dskip ? dskip[d] * gyv : 0.0f), acc);
+                        if (da) grad_store1(da + (size_t)bi * T * D + td, e * s_a, acc);
+                        if (ddp) ddp[d] += gyv * xv;
+                    }
+                }
+            }
+        }
+    }
+
+    if (ddskip) {
+        if (!acc) std::fill(ddskip, ddskip + D, 0.0f);
+        for (size_t s = 0; s < (size_t)Bt * nck; ++s) {
+            const float* p = dd_part.data() + s * D;
+            for (int d = 0; d < D; ++d) ddskip[d] += p[d];
+        }
+    }
+}
+void ssm_scan_bwd_impl_optimized(const float* x, const float* a, const float* b, const float* c,
+                                 const float* dskip, const float* hb, const float* gy,
+                                 float* dx, float* da, float* db, float* dc, float* ddskip,
+                                 int Bt, int T, int D, int N, int chunk) {
+    ssm_scan_bwd_kernel(x, a, b, c, dskip, hb, gy, dx, da, db, dc, ddskip, Bt, T, D, N, chunk, false);
+}
+void ssm_scan_bwd_acc_impl_optimized(const float* x, const float* a, const float* b, const float* c,
+                                     const float* dskip, const float* hb, const float* gy,
+                                     float* dx, float* da, float* db, float* dc, float* ddskip,
+                                     int Bt, int T, int D, int N, int chunk) {
+    ssm_scan_bwd_kernel(x, a, b, c, dskip, hb, gy, dx, da, db, dc, ddskip, Bt, T, D, N, chunk, true);
+}
+
+// ---------------- Mixture of Experts (top-k routing, grouped GEMM) ----------------
+// X: [T,D] tokens, Wg: [E,D] router, expert e is the FFN
+//   o = W2[e] @ act(W1[e] @ x + b1[e]) + b2[e]
+// with W1: [E,H,D], b1: [E,H], W2: [E,D,H], b2: [E,D] (biases nullable).
+// Each token picks its top-k experts; gates are the softmax over the k chosen
+// router logits. route[t*k+j] is the chosen expert e, or -(e+1) when expert
+// capacity (capacity > 0) was exhausted and the assignment was dropped. Assignments are
+// admitted slot by slot (all first choices, then all second choices, ...), and
+// inside an expert bucket rows keep that (slot, token) order, so the backward
+// rebuilds the exact permutation from `route` alone. Z1 [T*k, H] receives the
+// hidden pre-activation of every kept assignment in bucket order.
+
+// offsets[E+1] bucket starts; rows[r] = t*k + j of bucket row r; pos[t*k+j] = r or -1.
+static inline int moe_buckets(const float* route, int T, int k, int E,
+                              std::vector<int>& offsets, std::vector<int>& rows, std::vector<int>& pos) {
+    offsets.assign((size_t)E + 1, 0);
+    pos.assign((size_t)T * k, -1);
+    for (int a = 0; a < T * k; ++a) {
+        const int e = (int)route[a];
+        if (e >= 0) ++offsets[e + 1];
+    }
+    for (int e = 0; e < E; ++e) offsets[e + 1] += offsets[e];
+    rows.resize((size_t)offsets[E]);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int j = 0; j < k; ++j) {
+        for (int t = 0; t < T; ++t) {
+            const int e = (int)route[(size_t)t * k + j];
+            if (e < 0) continue;
+            const int r = fill[e]++;
+            rows[r] = t * k + j;
+            pos[(size_t)t * k + j] = r;
+        }
+    }
+    return offsets[E];
+}
+
+// Bucket rows of every expert in blocks of at most `rows`, one task each, so
+// small and large experts share threads.
+struct MoeTask { int e, r0, r1; };
+static std::vector<MoeTask> moe_row_tasks(const std::vector<int>& offsets, int E, int rows) {
+    std::vector<MoeTask> tasks;
+    for (int e = 0; e < E; ++e)
+        for (int r0 = offsets[e]; r0 < offsets[e + 1]; r0 += rows)
+            tasks.push_back({e, r0, std::min(offsets[e + 1], r0 + rows)});
+    return tasks;
+}
+
+// Y = act(X W[e]^T + b[e]) for every expert bucket as one task list over
+// (expert, MC-row block), so small and large experts share threads. Each task
+// is a single-threaded packed GEMM with the fused linear's epilogue.
+static void moe_grouped_linear(const float* X, const float* W, const float* b, float* Y, float* Z,
+                               const std::vector<int>& offsets, int E, int In, int Out, int act) {
+    if (Out <= 0) return;
+    GemmBlocking bk = gemm_blocking(LA_ROW_BLOCK, Out, In);
+    bk.threads = 1;
+    const std::vector<MoeTask> tasks = moe_row_tasks(offsets, E, bk.mc);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        const MoeTask& tk = tasks[i];
+        const int rows = tk.r1 - tk.r0;
+        float* y = Y + (size_t)tk.r0 * Out;
+        const LinearActEpilogue la{b ? b + (size_t)tk.e * Out : nullptr, Z, Out, act};
+        const GemmEpilogue ep{&linear_act_epilogue, &la, tk.r0, 0};
+        gemm_serial_alloc(rows, Out, In, X + (size_t)tk.r0 * In, In, 1, W + (size_t)tk.e * Out * In, 1, In,
+                          y, Out, false, bk, nullptr, &ep);
+    }
+}
+
+void moe_fwd_impl_optimized(const float* X, const float* Wg, const float* W1, const float* b1,
+                            const float* W2, const float* b2, float* Y,
+                            float* route, float* gate, float* Z1,
+                            int T, int D, int H, int E, int k, int capacity, int act) {
+    assert(X && Wg && W1 && W2 && Y && route && gate && Z1);
+    if (T <= 0 || D <= 0 || H <= 0 || E <= 0 || k <= 0) return;
+    k = std::min(k, E);
+
+    // 1) router logits and per-token top-k
+    std::vector<float> logits((size_t)T * E);
+    linear_act_fwd_impl_optimized(X, Wg, nullptr, logits.data(), nullptr, T, D, E, AG_ACT_NONE);
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < T; ++t) {
+        const float* l = logits.data() + (size_t)t * E;
+        float* rt = route + (size_t)t * k;
+        float* gt = gate + (size_t)t * k;
+        for (int j = 0; j < k; ++j) {
+            int best = -1;
+            for (int e = 0; e < E; ++e) {
+                bool taken = false;
+                for (int i = 0; i < j; ++i) taken |= ((int)rt[i] == e);
+                if (!taken && (best < 0 || l[e] > l[best])) best = e;
+            }
+            rt[j] = (float)best;
+            gt[j] = l[best];
+        }
+        const float mx = gt[0];   // first pick is the max
+        float sum = 0.0f;
+        for (int j = 0; j < k; ++j) { gt[j] = std::exp(gt[j] - mx); sum += gt[j]; }
+        for (int j = 0; j < k; ++j) gt[j] /= sum;
+    }
+
+    // 2) capacity: admit slot by slot, drop what overflows
+    if (capacity > 0) {
+        std::vector<int> load(E, 0);
+        for (int j = 0; j < k; ++j) {
+            for (int t = 0; t < T; ++t) {
+                float& e = route[(size_t)t * k + j];
+                if (load[(int)e] < capacity) ++load[(int)e];
+                else e = -1.0f - e;
+            }
+        }
+    }
+
+    // 3) permute tokens into contiguous per-expert buckets
+    std::vector<int> offsets, rows, pos;
+    const int A = moe_buckets(route, T, k, E, offsets, rows, pos);
+    std::vector<float> Xp((size_t)A * D), Hp((size_t)A * H), Op((size_t)A * D);
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < A; ++r) {
+        const float* src = X + (size_t)(rows[r] / k) * D;
+        std::copy(src, src + D, Xp.begin() + (size_t)r * D);
+    }
+
+    // 4) all experts as two grouped GEMMs
+    moe_grouped_linear(Xp.data(), W1, b1, Hp.data(), Z1, offsets, E, D, H, act);
+    moe_grouped_linear(Hp.data(), W2, b2, Op.data(), nullptr, offsets, E, H, D, AG_ACT_NONE);
+
+    // 5) scatter-combine weighted expert outputs back to token order
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < T; ++t) {
+        float* y = Y + (size_t)t * D;
+        std::fill(y, y + D, 0.0f);
+        for (int j = 0; j < k; ++j) {
+            const int r = pos[(size_t)t * k + j];
+            if (r < 0) continue;
+            const __m256 g = _mm256_set1_ps(gate[(size_t)t * k + j]);
+            const float* o = Op.data() + (size_t)r * D;
+            int d = 0;
+            for (; d + 8 <= D; d += 8)
+                _mm256_storeu_ps(y + d, _mm256_fmadd_ps(g, _mm256_loadu_ps(o + d), _mm256_loadu_ps(y + d)));
+            for (; d < D; ++d) y[d] += gate[(size_t)t * k + j] * o[d];
+        }
+    }
+}
+
+// Backward with the same routing. For bucket row r (token t, slot j, expert e):
+//   u = gy_t @ W2[e],  dgate = u . h + gy_t . b2[e],  dZ1 = act'(Z1) * gate * u
+// and the router gets the softmax-over-top-k gradient of dgate. Outputs are
+// overwritten (added to when acc) and may be null.
+static void moe_bwd_kernel(const float* X, const float* Wg, const float* W1, const float* b1,
+                           const float* W2, const float* b2,
+                           const float* route, const float* gate, const float* Z1, const float* gy,
+                           float* dX, float* dWg, float* dW1, float* db1, float* dW2, float* db2,
+                           int T, int D, int H, int E, int k, int act, bool acc) {
+    assert(X && Wg && W1 && W2 && route && gate && Z1 && gy);
+    if (T <= 0 || D <= 0 || H <= 0 || E <= 0 || k <= 0) return;
+    (void)b1;
+    k = std::min(k, E);
+
+    std::vector<int> offsets, rows, pos;
+    const int A = moe_buckets(route, T, k, E, offsets, rows, pos);
+
+    // gathered inputs, upstream grads, gates and hidden activations per bucket row
+    std::vector<float> Xp((size_t)A * D), Gp((size_t)A * D), Hp((size_t)A * H), gp(A);
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < A; ++r) {
+        const int t = rows[r] / k;
+        std::copy(X + (size_t)t * D, X + (size_t)(t + 1) * D, Xp.begin() + (size_t)r * D);
+        std::copy(gy + (size_t)t * D, gy + (size_t)(t + 1) * D, Gp.begin() + (size_t)r * D);
+        gp[r] = gate[rows[r]];
+        const float* z = Z1 + (size_t)r * H;
+        float* h = Hp.data() + (size_t)r * H;
+        int i = 0;
+        for (; i + 8 <= H; i += 8) _mm256_storeu_ps(h + i, act_fwd256(_mm256_loadu_ps(z + i), act));
+        if (i < H) {
+            alignas(32) float tmp[8] = {0};
+            std::copy(z + i, z + H, tmp);
+            _mm256_store_ps(tmp, act_fwd256(_mm256_load_ps(tmp), act));
+            std::copy(tmp, tmp + (H - i), h + i);
+        }
+    }
+
+    // U = gy @ W2[e] -> gate grads, then dZ1 in place of U. Grouped like the
+    // forward: (expert, MC-row block) tasks of single-threaded packed GEMMs.
+    GemmBlocking bk = gemm_blocking(LA_ROW_BLOCK, H, D);
+    bk.threads = 1;
+    const std::vector<MoeTask> u_tasks = moe_row_tasks(offsets, E, bk.mc);
+    std::vector<float> U((size_t)A * H), dgate((size_t)T * k, 0.0f);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < u_tasks.size(); ++i) {
+        const MoeTask& tk = u_tasks[i];
+        gemm_serial_alloc(tk.r1 - tk.r0, H, D, Gp.data() + (size_t)tk.r0 * D, D, 1,
+                          W2 + (size_t)tk.e * D * H, H, 1, U.data() + (size_t)tk.r0 * H, H, false, bk);
+        for (int r = tk.r0; r < tk.r1; ++r) {
+            float* ur = U.data() + (size_t)r * H;
+            const float* hr = Hp.data() + (size_t)r * H;
+            const float* zr = Z1 + (size_t)r * H;
+            float dg = 0.0f;
+            for (int c = 0; c < H; ++c) dg += ur[c] * hr[c];
+            if (b2) {
+                const float* bb = b2 + (size_t)tk.e * D;
+                const float* g = Gp.data() + (size_t)r * D;
+                for (int d = 0; d < D; ++d) dg += g[d] * bb[d];
+            }
+            dgate[rows[r]] = dg;
+            const __m256 gs = _mm256_set1_ps(gp[r]);
+            int c = 0;
+            for (; c + 8 <= H; c += 8)
+                _mm256_storeu_ps(ur + c, act_bwd256(_mm256_loadu_ps(zr + c), _mm256_mul_ps(gs, _mm256_loadu_ps(ur + c)), act));
+            for (; c < H; ++c) ur[c] = act_bwd1(zr[c], gp[r] * ur[c], act);
+        }
+    }
+    const float* dZ = U.data();
+
+    // Expert weight grads, one TN GEMM per expert over its bucket rows:
+    //   dW2[e] = (gate * gy)^T @ h,   dW1[e] = dZ1^T @ x,
+    // with db2 / db1 the row sums of the A operands, accumulated while they are
+    // packed. An empty bucket still zeroes its gradients (non-acc).
+    if (dW2 || db2 || dW1 || db1) {
+        // Gp rows become gate * gy; U above was its last plain use.
+        #pragma omp parallel for schedule(static)
+        for (int r = 0; r < A; ++r) {
+            float* g = Gp.data() + (size_t)r * D;
+            for (int d = 0; d < D; ++d) g[d] *= gp[r];
+        }
+        for (int e = 0; e < E; ++e) {
+            const int r0 = offsets[e], m = offsets[e + 1] - r0;
+            const float* gs = Gp.data() + (size_t)r0 * D;
+            const float* dz = dZ + (size_t)r0 * H;
+            float* db2e = db2 ? db2 + (size_t)e * D : nullptr;
+            float* db1e = db1 ? db1 + (size_t)e * H : nullptr;
+            if (db2e && !acc) std::fill(db2e, db2e + D, 0.0f);
+            if (db1e && !acc) std::fill(db1e, db1e + H, 0.0f);
+            if (dW2) gemm_strided(D, H, m, gs, 1, D, Hp.data() + (size_t)r0 * H, H, 1, dW2 + (size_t)e * D * H, H, acc, db2e);
+            else if (db2e) linear_db_kernel(gs, db2e, m, D, true);
+            if (dW1) gemm_strided(H, D, m, dz, 1, H, Xp.data() + (size_t)r0 * D, D, 1, dW1 + (size_t)e * H * D, D, acc, db1e);
+            else if (db1e) linear_db_kernel(dz, db1e, m, H, true);
+        }
+    }
+
+    // router: softmax over the k picked logits
+    std::vector<float> dlogits((size_t)T * E, 0.0f);
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < T; ++t) {
+        const float* g = gate + (size_t)t * k;
+        const float* dg = dgate.data() + (size_t)t * k;
+        float dot = 0.0f;
+        for (int j = 0; j < k; ++j) dot += g[j] * dg[j];
+        // dropped slots still took part in the gate softmax
+        for (int j = 0; j < k; ++j) {
+            const int re = (int)route[(size_t)t * k + j];
+            const int e = re >= 0 ? re : -1 - re;
+            dlogits[(size_t)t * E + e] = g[j] * (dg[j] - dot);
+        }
+    }
+    // dWg[E,D] = dlogits^T @ X
+    if (dWg) gemm_strided(E, D, T, dlogits.data(), 1, E, X, D, 1, dWg, D, acc);
+
+    if (dX) {
+        // dXp = dZ1 @ W1[e], then combine each token's k rows plus the router term
+        std::vector<float> dXp((size_t)A * D);
+        GemmBlocking bkx = gemm_blocking(LA_ROW_BLOCK, D, H);
+        bkx.threads = 1;
+        const std::vector<MoeTask> x_tasks = moe_row_tasks(offsets, E, bkx.mc);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < x_tasks.size(); ++i) {
+            const MoeTask& tk = x_tasks[i];
+            gemm_serial_alloc(tk.r1 - tk.r0, D, H, dZ + (size_t)tk.r0 * H, H, 1, W1 + (size_t)tk.e * H * D, D, 1,
+                              dXp.data() + (size_t)tk.r0 * D, D, false, bkx);
+        }
+        gemm_strided(T, D, E, dlogits.data(), E, 1, Wg, D, 1, dX, D, acc);
+        #pragma omp parallel for schedule(static)
+        for (int t = 0; t < T; ++t) {
+            float* dx = dX + (size_t)t * D;
+            for (int j = 0; j < k; ++j) {
+                const int r = pos[(size_t)t * k + j];
+                if (r < 0) continue;
+                const float* src = dXp.data() + (size_t)r * D;
+                for (int d = 0; d < D; ++d) dx[d] += src[d];
+            }
+        }
+    }
+}
+
+void moe_bwd_impl_optimized(const float* X, const float* Wg, const float* W1, const float* b1,
+                            const float* W2, const float* b2,
+                            const float* route, const float* gate, const float* Z1, const float* gy,
+                            float* dX, float* dWg, float* dW1, float* db1, float* dW2, float* db2,
+                            int T, int D, int H, int E, int k, int act) {
+    moe_bwd_kernel(X, Wg, W1, b1, W2, b2, route, gate, Z1, gy, dX, dWg, dW1, db1, dW2, db2, T, D, H, E, k, act, false);
+}
+void moe_bwd_acc_impl_optimized(const float* X, const float* Wg, const float* W1, const float* b1,
+                                const float* W2, const float* b2,
+                                const float* route, const float* gate, const float* Z1, const float* gy,
+                                float* dX, float* dWg, float* dW1, float* db1, float* dW2, float* db2,
+                                int T, int D, int H, int E, int k, int act) {
+    moe_bwd_kernel(X, Wg, W1, b1, W2, b2, route, gate, Z1, gy, dX, dWg, dW1, db1, dW2, db2, T, D, H, E, k, act, true);
+}
+
+// ---------------- Multi-head attention (batched heads, GQA / MQA) ----------------
+// Q: [B,T,H,D], K and V: [B,S,Hkv,D], O: [B,T,H,D], L: [B,H,T] (row logsumexp).
+// Query head h reads key/value head h / (H / Hkv): Hkv == H is plain MHA,
+// Hkv == 1 is MQA, anything in between is GQA. Keys are visited in tiles of
+// MHA_BK with an online softmax, so no [T,S] score matrix is materialized and
+// the backward recomputes probabilities from Q, K and L. Query t sits at key
+// position t + S - T; the optional ag_attn_mask restricts which keys it sees,
+// and query x key tiles the mask rules out entirely are never visited. ALiBi
+// slopes add -slope[h] * |p - j| to each score as it is computed, so the bias
+// never exists as a matrix.
+
+static constexpr int MHA_BQ = 32, MHA_BK = 64;
+
+static inline float mha_dot(const float* a, const float* b, int D) {
+    __m256 acc = _mm256_setzero_ps();
+    int d = 0;
+    for (; d + 8 <= D; d += 8) acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + d), _mm256_loadu_ps(b + d), acc);
+    float s = hsum256(acc);
+    for (; d < D; ++d) s += a[d] * b[d];
+    return s;
+}
+
+static inline void mha_axpy(float alpha, const float* x, float* y, int D) {
+    const __m256 va = _mm256_set1_ps(alpha);
+    int d = 0;
+    for (; d + 8 <= D; d += 8)
+        _mm256_storeu_ps(y + d, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + d), _mm256_loadu_ps(y + d)));
+    for (; d < D; ++d) y[d] += alpha * x[d];
+}
+
+// s[j] = exp(s[j] - m) for j < n; returns the sum.
+static inline float mha_exp_sub(float* s, int n, float m) {
+    const __m256 vm = _mm256_set1_ps(m);
+    __m256 acc = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 e = exp256_approx(_mm256_sub_ps(_mm256_loadu_ps(s + j), vm));
+        _mm256_storeu_ps(s + j, e);
+        acc = _mm256_add_ps(acc, e);
+    }
+    float sum = hsum256(acc);
+    for (; j < n; ++j) { s[j] = std::exp(s[j] - m); sum += s[j]; }
+    return sum;
+}
+
+// Tile geometry and visibility for one call. With a block-sparse layout the
+// tiles are the layout's blocks, so skipping a tile is a single lookup.
+struct MhaMask {
+    int T, S, off, causal, window, bq, bk, nbk;
+    const unsigned char* layout;
+    const float* alibi;
+
+    MhaMask(const ag_attn_mask* m, int T_, int S_) : T(T_), S(S_), off(S_ - T_) {
+        causal = m && m->causal;
+        window = m ? std::max(0, m->window) : 0;
+        layout = m && m->block > 0 ? m->layout : nullptr;
+        alibi = m ? m->alibi : nullptr;
+        bq = layout ? m->block : MHA_BQ;
+        bk = layout ? m->block : MHA_BK;
+        nbk = (S + bk - 1) / bk;
+    }
+    // Keys [lo(t), hi(t)) pass the causal and sliding-window conditions.
+    int lo(int t) const { return window > 0 ? std::max(0, t + off - window + 1) : 0; }
+    int hi(int t) const { return causal ? std::max(0, std::min(S, t + off + 1)) : S; }
+    bool tile(int qb, int kb) const { return !layout || layout[(size_t)qb * nbk + kb]; }
+    // Additive positional bias for head h, query t, key j.
+    float bias(int h, int t, int j) const { return alibi ? -alibi[h] * (float)std::abs(t + off - j) : 0.0f; }
+    // Query rows [tlo, thi) that can see some key in [j0, j1).
+    int tlo(int j0) const { return causal ? std::max(0, j0 - off) : 0; }
+    int thi(int j1) const { return window > 0 ? std::min(T, std::max(0, j1 - off + window - 1)) : T; }
+};
+
+// Shared body of the dense and the packed variable-length entry points.
+// Sequence b owns query rows [cu_q[b], cu_q[b+1]) of Q/O and key rows
+// [cu_k[b], cu_k[b+1]) of K/V, and its [H, T_b] logsumexp block starts at
+// L + H * cu_q[b]; with cu_q[b] = b*T and cu_k[b] = b*S this is exactly the
+// dense [B,T,H,D] / [B,H,T] layout. Work is split into (sequence, tile) tasks,
+// so short sequences cost only their own tiles.
+struct MhaTile { int b, tile; };
+
+static std::vector<MhaTile> mha_tiles(const int* cu, int B, int bsz) {
+    std::vector<MhaTile> tiles;
+    for (int b = 0; b < B; ++b)
+        for (int i = 0; i * bsz < cu[b + 1] - cu[b]; ++i) tiles.push_back({b, i});
+    return tiles;
+}
+
+static void mha_fwd_core(const float* Q, const float* K, const float* V, float* O, float* L,
+                         const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                         float scale, const ag_attn_mask* mask) {
+    const int group = H / Hkv;
+    const int64_t qs = (int64_t)H * D, ks = (int64_t)Hkv * D; // token strides
+    const int bq = MhaMask(mask, 0, 0).bq, bk = MhaMask(mask, 0, 0).bk;
+    const std::vector<MhaTile> tiles = mha_tiles(cu_q, B, bq);
+    const int ntiles = (int)tiles.size();
+
+    #pragma omp parallel
+    {
+        std::vector<float> acc((size_t)bq * D), m(bq), l(bq), s(bk);
+        // Masked-out tiles and ragged lengths make the work per task uneven, hence dynamic.
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int h = 0; h < H; ++h)
+        for (int it = 0; it < ntiles; ++it) {
+            const int b = tiles[it].b, qb = tiles[it].tile;
+            const int T = cu_q[b + 1] - cu_q[b], S = cu_k[b + 1] - cu_k[b];
+            const MhaMask mk(mask, T, S);
+            const int t0 = qb * bq, t1 = std::min(T, t0 + bq);
+            const float* Qb = Q + (int64_t)cu_q[b] * qs + (int64_t)h * D;
+            const float* Kb = K + (int64_t)cu_k[b] * ks + (int64_t)(h / group) * D;
+            const float* Vb = V + (int64_t)cu_k[b] * ks + (int64_t)(h / group) * D;
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            std::fill(m.begin(), m.end(), -INFINITY);
+            std::fill(l.begin(), l.end(), 0.0f);
+
+            // lo and hi only grow with t, so the tile's key span is [lo(t0), hi(t1-1)).
+            const int klo = mk.lo(t0), khi = mk.hi(t1 - 1);
+            for (int kb = klo / bk; kb * bk < khi; ++kb) {
+                if (!mk.tile(qb, kb)) continue;
+                const int j0 = kb * bk, j1 = std::min(khi, j0 + bk);
+                for (int t = t0; t < t1; ++t) {
+                    const int jb = std::max(j0, mk.lo(t)), je = std::min(j1, mk.hi(t));
+                    if (je <= jb) continue;
+                    const int r = t - t0;
+                    const float* q = Qb + t * qs;
+                    float mx = m[r];
+                    for (int j = jb; j < je; ++j) {
+                        s[j - jb] = scale * mha_dot(q, Kb + j * ks, D) + mk.bias(h, t, j);
+                        mx = std::max(mx, s[j - jb]);
+                    }
+                    // Rescale what has been accumulated so far to the new running max.
+                    float* a = acc.data() + (size_t)r * D;
+                    const float corr = std::exp(m[r] - mx);
+                    if (corr != 1.0f) for (int d = 0; d < D; ++d) a[d] *= corr;
+                    l[r] = l[r] * corr + mha_exp_sub(s.data(), je - jb, mx);
+                    m[r] = mx;
+                    for (int j = jb; j < je; ++j) mha_axpy(s[j - jb], Vb + j * ks, a, D);
+                }
+            }
+
+            for (int t = t0; t < t1; ++t) {
+                const int r = t - t0;
+                float* o = O + ((int64_t)cu_q[b] + t) * qs + (int64_t)h * D;
+                const float* a = acc.data() + (size_t)r * D;
+                float* lse = L + (int64_t)H * cu_q[b] + (int64_t)h * T + t;
+                if (l[r] > 0.0f) {
+                    const float inv = 1.0f / l[r];
+                    for (int d = 0; d < D; ++d) o[d] = a[d] * inv;
+                    *lse = m[r] + std::log(l[r]);
+                } else {
+                    // No visible key: zero output, and exp(score - L) == 0 in the backward.
+                    std::fill(o, o + D, 0.0f);
+                    *lse = INFINITY;
+                }
+            }
+        }
+    }
+}
+
+// Backward in two batched passes so that no gradient needs atomics:
+//   dQ: one task per (query head, sequence, query tile);
+//   dK, dV: one task per (kv head, sequence, key tile), looping over the query
+//   heads that share the kv head.
+// Both recompute P = exp(scale * q.k + bias - L) and dS = P * (dO.v - rowsum(dO * O))
+// and skip the same masked tiles as the forward. Any of dQ, dK, dV may be null;
+// with acc they are added to rather than zeroed first.
+static void mha_bwd_core(const float* Q, const float* K, const float* V, const float* O, const float* L,
+                         const float* dO, float* dQ, float* dK, float* dV,
+                         const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                         float scale, const ag_attn_mask* mask, bool acc) {
+    const int group = H / Hkv;
+    const int64_t qs = (int64_t)H * D, ks = (int64_t)Hkv * D;
+    const int bq = MhaMask(mask, 0, 0).bq, bk = MhaMask(mask, 0, 0).bk;
+    const std::vector<MhaTile> qtiles = mha_tiles(cu_q, B, bq);
+    const int nqt = (int)qtiles.size();
+
+    // delta shares L's layout.
+    std::vector<float> delta((size_t)H * cu_q[B]);
+    #pragma omp parallel for schedule(static)
+    for (int it = 0; it < nqt; ++it) {
+        const int b = qtiles[it].b, T = cu_q[b + 1] - cu_q[b];
+        const int t0 = qtiles[it].tile * bq, t1 = std::min(T, t0 + bq);
+        for (int t = t0; t < t1; ++t)
+            for (int h = 0; h < H; ++h) {
+                const int64_t off = ((int64_t)cu_q[b] + t) * qs + (int64_t)h * D;
+                delta[(size_t)H * cu_q[b] + (size_t)h * T + t] = mha_dot(dO + off, O + off, D);
+            }
+    }
+
+    if (dQ) {
+        #pragma omp parallel
+        {
+            std::vector<float> p(bk);
+            #pragma omp for collapse(2) schedule(dynamic)
+            for (int h = 0; h < H; ++h)
+            for (int it = 0; it < nqt; ++it) {
+                const int b = qtiles[it].b, qb = qtiles[it].tile;
+                const int T = cu_q[b + 1] - cu_q[b], S = cu_k[b + 1] - cu_k[b];
+                const MhaMask mk(mask, T, S);
+                const int t0 = qb * bq, t1 = std::min(T, t0 + bq);
+                const int64_t qbase = (int64_t)cu_q[b] * qs + (int64_t)h * D;
+                const float* Kb = K + (int64_t)cu_k[b] * ks + (int64_t)(h / group) * D;
+                const float* Vb = V + (int64_t)cu_k[b] * ks + (int64_t)(h / group) * D;
+                const float* Lb = L + (int64_t)H * cu_q[b] + (int64_t)h * T;
+                const float* Db = delta.data() + (size_t)H * cu_q[b] + (size_t)h * T;
+                for (int t = t0; t < t1 && !acc; ++t) std::fill(dQ + qbase + t * qs, dQ + qbase + t * qs + D, 0.0f);
+
+                const int klo = mk.lo(t0), khi = mk.hi(t1 - 1);
+                for (int kb = klo / bk; kb * bk < khi; ++kb) {
+                    if (!mk.tile(qb, kb)) continue;
+                    const int j0 = kb * bk, j1 = std::min(khi, j0 + bk);
+                    for (int t = t0; t < t1; ++t) {
+                        const int jb = std::max(j0, mk.lo(t)), je = std::min(j1, mk.hi(t));
+                        if (je <= jb) continue;
+                        const int64_t off = qbase + t * qs;
+                        for (int j = jb; j < je; ++j)
+                            p[j - jb] = scale * mha_dot(Q + off, Kb + j * ks, D) + mk.bias(h, t, j);
+                        mha_exp_sub(p.data(), je - jb, Lb[t]);
+                        for (int j = jb; j < je; ++j) {
+                            const float ds = p[j - jb] * (mha_dot(dO + off, Vb + j * ks, D) - Db[t]);
+                            mha_axpy(scale * ds, Kb + j * ks, dQ + off, D);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (dK || dV) {
+        const std::vector<MhaTile> ktiles = mha_tiles(cu_k, B, bk);
+        const int nkt = (int)ktiles.size();
+        #pragma omp parallel
+        {
+            std::vector<float> p(bk);
+            #pragma omp for collapse(2) schedule(dynamic)
+            for (int hk = 0; hk < Hkv; ++hk)
+            for (int it = 0; it < nkt; ++it) {
+                const int b = ktiles[it].b, kb = ktiles[it].tile;
+                const int T = cu_q[b + 1] - cu_q[b], S = cu_k[b + 1] - cu_k[b];
+                const MhaMask mk(mask, T, S);
+                const int j0 = kb * bk, j1 = std::min(S, j0 + bk);
+                const int64_t kbase = (int64_t)cu_k[b] * ks + (int64_t)hk * D;
+                for (int j = j0; j < j1 && !acc; ++j) {
+                    if (dK) std::fill(dK + kbase + j * ks, dK + kbase + j * ks + D, 0.0f);
+                    if (dV) std::fill(dV + kbase + j * ks, dV + kbase + j * ks + D, 0.0f);
+                }
+                const int tl = mk.tlo(j0), th = mk.thi(j1);
+                for (int h = hk * group; h < (hk + 1) * group; ++h) {
+                    const float* Lb = L + (int64_t)H * cu_q[b] + (int64_t)h * T;
+                    const float* Db = delta.data() + (size_t)H * cu_q[b] + (size_t)h * T;
+                    for (int qb = tl / bq; qb * bq < th; ++qb) {
+                        if (!mk.tile(qb, kb)) continue;
+                        const int t0 = std::max(tl, qb * bq), t1 = std::min(th, (qb + 1) * bq);
+                        for (int t = t0; t < t1; ++t) {
+                            const int jb = std::max(j0, mk.lo(t)), je = std::min(j1, mk.hi(t));
+                            if (je <= jb) continue;
+                            const int64_t off = ((int64_t)cu_q[b] + t) * qs + (int64_t)h * D;
+                            for (int j = jb; j < je; ++j)
+                                p[j - jb] = scale * mha_dot(Q + off, K + kbase + j * ks, D) + mk.bias(h, t, j);
+                            mha_exp_sub(p.data(), je - jb, Lb[t]);
+                            for (int j = jb; j < je; ++j) {
+                                const float pj = p[j - jb];
+                                if (dV) mha_axpy(pj, dO + off, dV + kbase + j * ks, D);
+                                if (dK) {
+                                    const float ds = pj * (mha_dot(dO + off, V + kbase + j * ks, D) - Db[t]);
+                                    mha_axpy(scale * ds, Q + off, dK + kbase + j * ks, D);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static std::vector<int> mha_dense_offsets(int B, int len) {
+    std::vector<int> cu(B + 1);
+    for (int b = 0; b <= B; ++b) cu[b] = b * len;
+    return cu;
+}
+
+void mha_fwd_impl_optimized(const float* Q, const float* K, const float* V, float* O, float* L,
+                            int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask) {
+    const std::vector<int> cu_q = mha_dense_offsets(B, T), cu_k = mha_dense_offsets(B, S);
+    mha_fwd_core(Q, K, V, O, L, cu_q.data(), cu_k.data(), B, H, Hkv, D, scale, mask);
+}
+
+void mha_bwd_impl_optimized(const float* Q, const float* K, const float* V, const float* O, const float* L,
+                            const float* dO, float* dQ, float* dK, float* dV,
+                            int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask) {
+    const std::vector<int> cu_q = mha_dense_offsets(B, T), cu_k = mha_dense_offsets(B, S);
+    mha_bwd_core(Q, K, V, O, L, dO, dQ, dK, dV, cu_q.data(), cu_k.data(), B, H, Hkv, D, scale, mask, false);
+}
+
+void mha_bwd_acc_impl_optimized(const float* Q, const float* K, const float* V, const float* O, const float* L,
+                                const float* dO, float* dQ, float* dK, float* dV,
+                                int B, int T, int S, int H, int Hkv, int D, float scale, const ag_attn_mask* mask) {
+    const std::vector<int> cu_q = mha_dense_offsets(B, T), cu_k = mha_dense_offsets(B, S);
+    mha_bwd_core(Q, K, V, O, L, dO, dQ, dK, dV, cu_q.data(), cu_k.data(), B, H, Hkv, D, scale, mask, true);
+}
+
+// Packed variable-length batches: block-sparse layouts are defined per [T,S]
+// grid, so only the causal, window and alibi fields of the mask apply.
+static ag_attn_mask mha_varlen_mask(const ag_attn_mask* mask) {
+    ag_attn_mask m{0, 0, 0, nullptr, nullptr};
+    if (mask) { m = *mask; m.block = 0; m.layout = nullptr; }
+    return m;
+}
+
+void mha_varlen_fwd_impl_optimized(const float* Q, const float* K, const float* V, float* O, float* L,
+                                   const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                                   float scale, const ag_attn_mask* mask) {
+    const ag_attn_mask m = mha_varlen_mask(mask);
+    mha_fwd_core(Q, K, V, O, L, cu_q, cu_k, B, H, Hkv, D, scale, &m);
+}
+
+void mha_varlen_bwd_impl_optimized(const float* Q, const float* K, const float* V, const float* O,
+                                   const float* L, const float* dO, float* dQ, float* dK, float* dV,
+                                   const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                                   float scale, const ag_attn_mask* mask) {
+    const ag_attn_mask m = mha_varlen_mask(mask);
+    mha_bwd_core(Q, K, V, O, L, dO, dQ, dK, dV, cu_q, cu_k, B, H, Hkv, D, scale, &m, false);
+}
+
+void mha_varlen_bwd_acc_impl_optimized(const float* Q, const float* K, const float* V, const float* O,
+                                       const float* L, const float* dO, float* dQ, float* dK, float* dV,
+                                       const int* cu_q, const int* cu_k, int B, int H, int Hkv, int D,
+                                       float scale, const ag_attn_mask* mask) {
+    const ag_attn_mask m = mha_varlen_mask(mask);
+    mha_bwd_core(Q, K, V, O, L, dO, dQ, dK, dV, cu_q, cu_k, B, H, Hkv, D, scale, &m, true);
+}
+
+// ---------------- Paged attention over a KV cache (decoding) ----------------
+// Keys and values live in a shared pool of fixed-size pages, Kc/Vc:
+// [num_blocks, block_size, Hkv, D]. Sequence b owns the pages listed in
+// block_tables[b * max_blocks ...] and has ctx_lens[b] cached tokens, the last
+// T of which are the queries in Q [B,T,H,D] (so T = 1 for plain decoding).
+// The key range is split into PAGED_SPLIT-token partitions that run as
+// separate tasks, so a single long sequence still uses every thread; partial
+// softmax states are merged by their logsumexp afterwards. The mask's causal,
+// window and alibi fields apply; block-sparse layouts are not used here.
+
+static constexpr int PAGED_SPLIT = 512;
+
+void paged_attn_fwd_impl_optimized(const float* Q, const float* Kc, const float* Vc,
+                                   const int* block_tables, const int* ctx_lens, float* O,
+                                   int B, int T, int H, int Hkv, int D, int block_size, int max_blocks,
+                                   float scale, const ag_attn_mask* mask) {
+    const ag_attn_mask m = mha_varlen_mask(mask);
+    const int group = H / Hkv;
+    const int64_t qs = (int64_t)H * D, ks = (int64_t)Hkv * D;
+    int max_ctx = 0;
+    for (int b = 0; b < B; ++b) max_ctx = std::max(max_ctx, ctx_lens[b]);
+    const int nsplit = std::max(1, (max_ctx + PAGED_SPLIT - 1) / PAGED_SPLIT);
+
+    // Per (b, h, t, split): running max, sum and unnormalized output.
+    const size_t rows = (size_t)B * H * T;
+    std::vector<float> pm(rows * nsplit, -INFINITY), pl(rows * nsplit, 0.0f), pacc(rows * nsplit * D, 0.0f);
+
+    #pragma omp parallel
+    {
+        std::vector<float> s(block_size);
+        #pragma omp for collapse(3) schedule(dynamic)
+        for (int b = 0; b < B; ++b)
+        for (int hk = 0; hk < Hkv; ++hk)
+        for (int sp = 0; sp < nsplit; ++sp) {
+            const int S = ctx_lens[b];
+            const int k0 = sp * PAGED_SPLIT, k1 = std::min(S, k0 + PAGED_SPLIT);
+            if (k0 >= k1) continue;
+            const MhaMask mk(&m, T, S);
+            const int* table = block_tables + (size_t)b * max_blocks;
+            // Query heads sharing this kv head reuse each page while it is hot.
+            for (int h = hk * group; h < (hk + 1) * group; ++h)
+            for (int t = 0; t < T; ++t) {
+                const int jb = std::max(k0, mk.lo(t)), je = std::min(k1, mk.hi(t));
+                if (je <= jb) continue;
+                const float* q = Q + ((int64_t)b * T + t) * qs + (int64_t)h * D;
+                const size_t row = ((size_t)b * H + h) * T + t;
+                float mx = -INFINITY, l = 0.0f;
+                float* acc = pacc.data() + (row * nsplit + sp) * D;
+                for (int p0 = jb; p0 < je; ) {
+                    // Keys [p0, p1) are contiguous inside one page.
+                    const int pbase = (p0 / block_size) * block_size;
+                    const int p1 = std::min(je, pbase + block_size);
+                    const int64_t page = table[p0 / block_size];
+                    const float* Kp = Kc + page * block_size * ks + (int64_t)hk * D;
+                    const float* Vp = Vc + page * block_size * ks + (int64_t)hk * D;
+                    float pmx = mx;
+                    for (int j = p0; j < p1; ++j) {
+                        s[j - p0] = scale * mha_dot(q, Kp + (j - pbase) * ks, D) + mk.bias(h, t, j);
+                        pmx = std::max(pmx, s[j - p0]);
+                    }
+                    const float corr = std::exp(mx - pmx);
+                    if (corr != 1.0f) for (int d = 0; d < D; ++d) acc[d] *= corr;
+                    l = l * corr + mha_exp_sub(s.data(), p1 - p0, pmx);
+                    mx = pmx;
+                    for (int j = p0; j < p1; ++j) mha_axpy(s[j - p0], Vp + (j - pbase) * ks, acc, D);
+                    p0 = p1;
+                }
+                pm[row * nsplit + sp] = mx;
+                pl[row * nsplit + sp] = l;
+            }
+        }
+
+        // Merge the partitions of each row.
+        #pragma omp for schedule(static)
+        for (int64_t row = 0; row < (int64_t)rows; ++row) {
+            const int t = (int)(row % T);
+            const int64_t bh = row / T, b = bh / H, h = bh % H;
+            float* o = O + ((int64_t)b * T + t) * qs + h * D;
+            float M = -INFINITY;
+            for (int sp = 0; sp < nsplit; ++sp) M = std::max(M, pm[row * nsplit + sp]);
+            std::fill(o, o + D, 0.0f);
+            if (M == -INFINITY) continue;
+            float L = 0.0f;
+            for (int sp = 0; sp < nsplit; ++sp) {
+                if (pl[row * nsplit + sp] == 0.0f) continue;
+                const float w = std::exp(pm[row * nsplit + sp] - M);
+                L += w * pl[row * nsplit + sp];
+                mha_axpy(w, pacc.data() + (row * nsplit + sp) * D, o, D);
+            }
+            const float inv = 1.0f / L;
+            for (int d = 0; d < D; ++d) o[d] *= inv;
+        }
+    }
+}
+
+// ---------------- Embedding lookup (gather, bag, row-sparse backward) ----------------
+// W: [V,D] table, idx: [N] row ids. Without offsets, Y: [N,D] with Y[i] =
+// W[idx[i]]. With offsets [B+1] it is an embedding bag, Y: [B,D] holds the sum
+// (or, with mean != 0, the mean) of rows idx[offsets[b] .. offsets[b+1]), so
+// the gathered rows are never materialized.
+void embedding_fwd_impl_optimized(const float* W, const int* idx, const int* offsets, float* Y,
+                                  int N, int B, int D, int mean) {
+    assert(W && idx && Y);
+    if (!offsets) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < N; ++i)
+            std::memcpy(Y + (size_t)i * D, W + (size_t)idx[i] * D, sizeof(float) * D);
+        return;
+    }
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < B; ++b) {
+        float* y = Y + (size_t)b * D;
+        std::fill(y, y + D, 0.0f);
+        const int n = offsets[b + 1] - offsets[b];
+        const float w = mean && n > 0 ? 1.0f / n : 1.0f;
+        for (int i = offsets[b]; i < offsets[b + 1]; ++i) mha_axpy(w, W + (size_t)idx[i] * D, y, D);
+    }
+}
+
+// Row-sparse gradient of the lookup: returns R, the number of distinct ids in
+// idx, with rows[0..R) the ids in ascending order and dW [R,D] their summed
+// gradients. rows and dW must have room for N entries. offsets and mean as in
+// the forward. Lookups are grouped by id first, so every output row is summed
+// by one thread and duplicates need no atomics.
+int embedding_bwd_impl_optimized(const int* idx, const int* offsets, const float* dY, int* rows, float* dW,
+                                 int N, int B, int D, int mean) {
+    assert(idx && dY && rows && dW);
+    if (N <= 0) return 0;
+
+    // Source row of dY and weight for each lookup.
+    std::vector<int> src(N);
+    std::vector<float> w(N, 1.0f);
+    if (offsets) {
+        for (int b = 0; b < B; ++b) {
+            const int n = offsets[b + 1] - offsets[b];
+            for (int i = offsets[b]; i < offsets[b + 1]; ++i) {
+                src[i] = b;
+                if (mean) w[i] = 1.0f / n;
+            }
+        }
+    } else {
+        for (int i = 0; i < N; ++i) src[i] = i;
+    }
+
+    std::vector<int> order(N);
+    for (int i = 0; i < N; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return idx[a] < idx[b] || (idx[a] == idx[b] && a < b); });
+    std::vector<int> start;
+    for (int i = 0; i < N; ++i)
+        if (i == 0 || idx[order[i]] != idx[order[i - 1]]) start.push_back(i);
+    const int R = (int)start.size();
+    start.push_back(N);
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int r = 0; r < R; ++r) {
+        float* g = dW + (size_t)r * D;
+        std::fill(g, g + D, 0.0f);
+        rows[r] = idx[order[start[r]]];
+        for (int i = start[r]; i < start[r + 1]; ++i) mha_axpy(w[order[i]], dY + (size_t)src[order[i]] * D, g, D);
+    }
+    return R;
+}
+
+// ---------------- ABI v2: descriptor kernels ----------------
+// Kernels over ag_tensor_desc operands. Dims are first coalesced (size-1 dims
+// dropped, neighbours merged where every operand steps through them
+// contiguously), then the innermost dim is walked in spans of V2_BLOCK. f32
+// spans with unit stride are used in place; anything else is gathered into a
+// float32 block on the stack, computed, and converted back on store.
+static constexpr int64_t V2_BLOCK = 1024;
+
+static inline float v2_f16_to_f32(uint16_t h) {
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F, man = h & 0x3FF, bits;
+    if (exp == 0x1F) bits = sign | 0x7F800000u | (man << 13);            // inf / nan
+    else if (exp != 0) bits = sign | ((exp + 112) << 23) | (man << 13);
+    else if (man == 0) bits = sign;
+    else {                                                                // subnormal
+        exp = 113;
+        while (!(man & 0x400)) { man <<= 1; --exp; }
+        bits = sign | (exp << 23) | ((man & 0x3FF) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+// Round to nearest even; overflow goes to inf, NaN stays a (quiet) NaN.
+static inline uint16_t v2_f32_to_f16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof x);
+    const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    const uint32_t ax = x & 0x7FFFFFFFu;
+    if (ax >= 0x7F800000u) return sign | 0x7C00 | (ax > 0x7F800000u ? 0x200 : 0);
+    if (ax >= 0x477FF000u) return sign | 0x7C00;                          // >= 65520 rounds to inf
+    if (ax < 0x38800000u) {                                               // below 2^-14: subnormal
+        float v;
+        std::memcpy(&v, &ax, sizeof v);
+        return sign | (uint16_t)std::nearbyint(v * 16777216.0f);
+    }
+    const uint32_t r = ax + 0xFFFu + ((ax >> 13) & 1) - (112u << 23);
+    return sign | (uint16_t)(r >> 13);
+}
+
+static inline float v2_bf16_to_f32(uint16_t h) {
+    const uint32_t bits = (uint32_t)h << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+static inline uint16_t v2_f32_to_bf16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof x);
+    if ((x & 0x7FFFFFFFu) > 0x7F800000u) return (uint16_t)((x >> 16) | 0x40);
+    return (uint16_t)((x + 0x7FFFu + ((x >> 16) & 1)) >> 16);
+}
+
+static inline int64_t v2_elem_bytes(int dtype) {
+    switch (dtype) {
+        case AG_DTYPE_F32:  return 4;
+        case AG_DTYPE_F16:
+        case AG_DTYPE_BF16: return 2;
+        default:            return 0;
+    }
+}
+
+// out[j] = float32 of element off + j * s, for j < n (offsets in elements).
+static void v2_load(int dtype, const void* base, int64_t off, int64_t s, int64_t n, float* out) {
+    if (dtype == AG_DTYPE_F32) {
+        const float* p = (const float*)base + off;
+        for (int64_t j = 0; j < n; ++j) out[j] = p[j * s];
+        return;
+    }
+    const uint16_t* p = (const uint16_t*)base + off;
+    if (dtype == AG_DTYPE_F16) for (int64_t j = 0; j < n; ++j) out[j] = v2_f16_to_f32(p[j * s]);
+    else                       for (int64_t j = 0; j < n; ++j) out[j] = v2_bf16_to_f32(p[j * s]);
+}
+
+// Element off + j * s = in[j] (+ its old value when accumulate).
+static void v2_store(int dtype, void* base, int64_t off, int64_t s, int64_t n, const float* in, bool accumulate) {
+    if (dtype == AG_DTYPE_F32) {
+        float* p = (float*)base + off;
+        for (int64_t j = 0; j < n; ++j) p[j * s] = accumulate ? p[j * s] + in[j] : in[j];
+        return;
+    }
+    uint16_t* p = (uint16_t*)base + off;
+    if (dtype == AG_DTYPE_F16) {
+        for (int64_t j = 0; j < n; ++j)
+            p[j * s] = v2_f32_to_f16(accumulate ? v2_f16_to_f32(p[j * s]) + in[j] : in[j]);
+    } else {
+        for (int64_t j = 0; j < n; ++j)
+            p[j * s] = v2_f32_to_bf16(accumulate ? v2_bf16_to_f32(p[j * s]) + in[j] : in[j]);
+    }
+}
+
+// Iteration space shared by up to three same-shape operands, output last.
+struct V2Iter {
+    int nd;                                // >= 1; dim nd - 1 is the innermost
+    int64_t shape[AG_DESC_MAX_DIMS];
+    int64_t strides[3][AG_DESC_MAX_DIMS];
+    int64_t outer;                         // product of shape[0 .. nd - 1)
+};
+
+static bool v2_iter(const ag_tensor_desc* const* ops, int nops, V2Iter& it) {
+    const ag_tensor_desc* ref = ops[nops - 1];
+    if (ref->ndim < 0 || ref->ndim > AG_DESC_MAX_DIMS) return false;
+    for (int k = 0; k < nops; ++k) {
+        if (!ops[k]->data || !v2_elem_bytes(ops[k]->dtype) || ops[k]->ndim != ref->ndim) return false;
+        for (int d = 0; d < ref->ndim; ++d)
+            if (ops[k]->shape[d] != ref->shape[d] || ref->shape[d] < 0) return false;
+    }
+    it.nd = 0;
+    for (int d = 0; d < ref->ndim; ++d) {
+        const int64_t n = ref->shape[d];
+        if (n == 1) continue;
+        bool merge = it.nd > 0;
+        for (int k = 0; k < nops && merge; ++k) merge = it.strides[k][it.nd - 1] == ops[k]->strides[d] * n;
+        if (merge) {
+            it.shape[it.nd - 1] *= n;
+            for (int k = 0; k < nops; ++k) it.strides[k][it.nd - 1] = ops[k]->strides[d];
+            continue;
+        }
+        it.shape[it.nd] = n;
+        for (int k = 0; k < nops; ++k) it.strides[k][it.nd] = ops[k]->strides[d];
+        ++it.nd;
+    }
+    if (it.nd == 0) {
+        it.nd = 1;
+        it.shape[0] = 1;
+        for (int k = 0; k < nops; ++k) it.strides[k][0] = 1;
+    }
+    it.outer = 1;
+    for (int d = 0; d + 1 < it.nd; ++d) it.outer *= it.shape[d];
+    return true;
+}
+
+// Calls body(off, n) for every span of at most V2_BLOCK innermost elements,
+// in parallel once the tensor is big enough; off[k] is operand k's element
+// offset of the span's first element.
+static void v2_for_spans(const V2Iter& it, int nops, const std::function<void(const int64_t*, int64_t)>& body) {
+    const int last = it.nd - 1;
+    const int64_t inner = it.shape[last];
+    const int64_t per_row = (inner + V2_BLOCK - 1) / V2_BLOCK;
+    const int64_t spans = it.outer * per_row;
+    #pragma omp parallel for if (it.outer * inner >= elem_parallel_min())
+    for (int64_t s = 0; s < spans; ++s) {
+        int64_t o = s / per_row;
+        const int64_t j0 = (s % per_row) * V2_BLOCK;
+        int64_t off[3] = {0, 0, 0};
+        for (int d = last - 1; d >= 0; --d) {
+            const int64_t i = o % it.shape[d];
+            o /= it.shape[d];
+            for (int k = 0; k < nops; ++k) off[k] += i * it.strides[k][d];
+        }
+        for (int k = 0; k < nops; ++k) off[k] += j0 * it.strides[k][last];
+        body(off, std::min(V2_BLOCK, inner - j0));
+    }
+}
+
+static inline __m256 v2_unary256(int op, __m256 x, __m256 alpha) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    switch (op) {
+        case AG_UNARY_RELU:      return act_fwd256(x, AG_ACT_RELU);
+        case AG_UNARY_LEAKYRELU:
+            return _mm256_blendv_ps(_mm256_mul_ps(x, alpha), x, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+        case AG_UNARY_GELU:      return act_fwd256(x, AG_ACT_GELU);
+        case AG_UNARY_SILU:      return act_fwd256(x, AG_ACT_SILU);
+        case AG_UNARY_SIGMOID:
+            return _mm256_div_ps(one, _mm256_add_ps(one, exp256_approx(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+        case AG_UNARY_TANH:      return act_tanh256(x);
+        case AG_UNARY_EXP:       return exp256_approx(x);
+        case AG_UNARY_SQRT:      return _mm256_sqrt_ps(x);
+        default:                 return x;
+    }
+}
+
+// y[0..n) = op(x[0..n)); the tail goes through a zero-padded vector so every
+// element sees the same arithmetic.
+static void v2_unary_span(int op, const float* x, float* y, int64_t n, float alpha) {
+    const __m256 al = _mm256_set1_ps(alpha);
+    int64_t j = 0;
+    for (; j + 8 <= n; j += 8) _mm256_storeu_ps(y + j, v2_unary256(op, _mm256_loadu_ps(x + j), al));
+    if (j < n) {
+        float t[8] = {0.0f};
+        std::memcpy(t, x + j, (size_t)(n - j) * sizeof(float));
+        _mm256_storeu_ps(t, v2_unary256(op, _mm256_loadu_ps(t), al));
+        std::memcpy(y + j, t, (size_t)(n - j) * sizeof(float));
+    }
+}
+
+int64_t unary_v2_impl_optimized(int op, const ag_tensor_desc* x, const ag_tensor_desc* y,
+                                float alpha, ag_workspace /*ws*/) {
+    if (!x || !y || op < AG_UNARY_COPY || op > AG_UNARY_SQRT) return AG_V2_UNSUPPORTED;
+    const ag_tensor_desc* ops[2] = {x, y};
+    V2Iter it;
+    if (!v2_iter(ops, 2, it)) return AG_V2_UNSUPPORTED;
+    if (it.outer * it.shape[it.nd - 1] == 0) return 0;
+    const int last = it.nd - 1;
+    const int64_t xs = it.strides[0][last], ys = it.strides[1][last];
+    const bool x_direct = x->dtype == AG_DTYPE_F32 && xs == 1;
+    const bool y_direct = y->dtype == AG_DTYPE_F32 && ys == 1;
+    v2_for_spans(it, 2, [&](const int64_t* off, int64_t n) {
+        float xb[V2_BLOCK], yb[V2_BLOCK];
+        const float* xp = x_direct ? (const float*)x->data + off[0] : xb;
+        if (!x_direct) v2_load(x->dtype, x->data, off[0], xs, n, xb);
+        float* yp = y_direct ? (float*)y->data + off[1] : yb;
+        if (op != AG_UNARY_COPY) v2_unary_span(op, xp, yp, n, alpha);
+        else if (y_direct) std::memmove(yp, xp, (size_t)n * sizeof(float));
+        else yp = const_cast<float*>(xp);
+        if (!y_direct) v2_store(y->dtype, y->data, off[1], ys, n, yp, false);
+    });
+    return 0;
+}
+
+int64_t binary_v2_impl_optimized(int op, const ag_tensor_desc* a, const ag_tensor_desc* b,
+                                 const ag_tensor_desc* c, int accumulate, ag_workspace /*ws*/) {
+    if (!a || !b || !c || op < AG_BIN_ADD || op > AG_BIN_DIV) return AG_V2_UNSUPPORTED;
+    const ag_tensor_desc* ops[3] = {a, b, c};
+    V2Iter it;
+    if (!v2_iter(ops, 3, it)) return AG_V2_UNSUPPORTED;
+    if (it.outer * it.shape[it.nd - 1] == 0) return 0;
+    const int last = it.nd - 1;
+    const int64_t as = it.strides[0][last], bs = it.strides[1][last], cs = it.strides[2][last];
+    const bool c_direct = c->dtype == AG_DTYPE_F32 && cs == 1;
+    // Stride 0 along the span is one broadcast value; f32 with unit stride is read in place.
+    auto span_in = [](const ag_tensor_desc* t, int64_t off, int64_t s, int64_t n, float* buf) {
+        if (t->dtype == AG_DTYPE_F32 && (s == 0 || s == 1)) return (const float*)t->data + off;
+        v2_load(t->dtype, t->data, off, s, s == 0 ? 1 : n, buf);
+        return (const float*)buf;
+    };
+    v2_for_spans(it, 3, [&](const int64_t* off, int64_t n) {
+        float ab[V2_BLOCK], bb[V2_BLOCK], cb[V2_BLOCK];
+        const float* ap = span_in(a, off[0], as, n, ab);
+        const float* bp = span_in(b, off[1], bs, n, bb);
+        if (c_direct) {
+            binary_span(op, ap, as != 0, bp, bs != 0, (float*)c->data + off[2], n, 1.0f, accumulate != 0);
+        } else {
+            binary_span(op, ap, as != 0, bp, bs != 0, cb, n, 1.0f, false);
+            v2_store(c->dtype, c->data, off[2], cs, n, cb, accumulate != 0);
+        }
+    });
+    return 0;
+}
+
+// f32 operands go to gemm_strided with their own strides, so transposed and
+// sliced views are packed straight from memory. 16-bit operands, and outputs
+// that are not f32 with unit column stride, use float32 copies in ws.
+int64_t gemm_v2_impl_optimized(const ag_tensor_desc* a, const ag_tensor_desc* b,
+                               const ag_tensor_desc* c, int accumulate, ag_workspace ws) {
+    if (!a || !b || !c || a->ndim != 2 || b->ndim != 2 || c->ndim != 2) return AG_V2_UNSUPPORTED;
+    for (const ag_tensor_desc* t : {a, b, c})
+        if (!t->data || !v2_elem_bytes(t->dtype)) return AG_V2_UNSUPPORTED;
+    const int64_t M = a->shape[0], K = a->shape[1], N = b->shape[1];
+    if (b->shape[0] != K || c->shape[0] != M || c->shape[1] != N) return AG_V2_UNSUPPORTED;
+    if (M < 0 || K < 0 || N < 0 || M > INT32_MAX || K > INT32_MAX || N > INT32_MAX) return AG_V2_UNSUPPORTED;
+
+    const bool a_copy = a->dtype != AG_DTYPE_F32, b_copy = b->dtype != AG_DTYPE_F32;
+    const bool c_copy = c->dtype != AG_DTYPE_F32 || (N > 1 && c->strides[1] != 1) || (M > 1 && c->strides[0] < N);
+    auto padded = [](int64_t floats) { return (floats * (int64_t)sizeof(float) + 63) & ~(int64_t)63; };
+    const int64_t need = (a_copy ? padded(M * K) : 0) + (b_copy ? padded(K * N) : 0) + (c_copy ? padded(M * N) : 0);
+    if (need > 0 && (!ws.ptr || ws.bytes < need)) return need;
+
+    char* w = (char*)ws.ptr;
+    // rows x cols of t into a contiguous float32 buffer taken from the workspace.
+    auto to_f32 = [&](const ag_tensor_desc* t, int64_t rows, int64_t cols) {
+        float* buf = (float*)w;
+        w += padded(rows * cols);
+        #pragma omp parallel for if (rows * cols >= elem_parallel_min())
+        for (int64_t i = 0; i < rows; ++i)
+            v2_load(t->dtype, t->data, i * t->strides[0], t->strides[1], cols, buf + i * cols);
+        return buf;
+    };
+    const float* A = a_copy ? to_f32(a, M, K) : (const float*)a->data;
+    const int64_t rsa = a_copy ? K : a->strides[0], csa = a_copy ? 1 : a->strides[1];
+    const float* B = b_copy ? to_f32(b, K, N) : (const float*)b->data;
+    const int64_t rsb = b_copy ? N : b->strides[0], csb = b_copy ? 1 : b->strides[1];
+    if (!c_copy) {
+        gemm_strided((int)M, (int)N, (int)K, A, rsa, csa, B, rsb, csb,
+                     (float*)c->data, M > 1 ? c->strides[0] : N, accumulate != 0);
+        return 0;
+    }
+    float* C = (float*)w;
+    gemm_strided((int)M, (int)N, (int)K, A, rsa, csa, B, rsb, csb, C, N, false);
+    #pragma omp parallel for if (M * N >= elem_parallel_min())
+    for (int64_t i = 0; i < M; ++i)
+        v2_store(c->dtype, c->data, i * c->strides[0], c->strides[1], N, C + i * N, accumulate != 0);
+    return 0;
+}
+
+// ---------------- required export ----------------
+// This part exports the new optimized functions. ISA builds fill the table
+// for the dispatcher instead of exporting the entry point themselves.
+#ifdef AG_CPU_ISA
+int fill_cpu_kernels(struct ag_cpu_v1* out){
+#else
+AG_EXPORT int ag_get_cpu_kernels_v1(struct ag_cpu_v1* out){
+#endif
+  if (!out) return -1;
+    tune_load();
+    out->abi_version = AG_KERNELS_ABI_V1;
+    out->add    = &add_impl_optimized;
+    out->sub    = &sub_impl_optimized;
+    out->mul    = &mul_impl_optimized;
+    out->div    = &div_impl_optimized;
     out->relu   = &relu_impl_optimized;
     out->matmul = &matmul_impl_optimized;
     // out->fmab = &gemm_impl_optimized;
@@ -1128,4 +4244,84 @@ AG_EXPORT int ag_get_cpu_kernels_v1(struct ag_cpu_v1* out){
   return 0;
 }
 
-} // extern "C"
\ No newline at end of file
+// v2 table: the descriptor kernels and every float32 kernel added after v1
+// was frozen. Only the fields that fit the caller's struct_size are written.
+#ifdef AG_CPU_ISA
+int fill_cpu_kernels_v2(struct ag_cpu_v2* out){
+#else
+AG_EXPORT int ag_get_cpu_kernels_v2(struct ag_cpu_v2* out){
+#endif
+    if (!out || out->struct_size < offsetof(ag_cpu_v2, unary)) return -1;
+    ag_cpu_v2 table{};
+    table.abi_version = AG_KERNELS_ABI_V2;
+    table.struct_size = (uint32_t)std::min<size_t>(out->struct_size, sizeof(table));
+    table.unary  = &unary_v2_impl_optimized;
+    table.binary = &binary_v2_impl_optimized;
+    table.gemm   = &gemm_v2_impl_optimized;
+    table.linear_xent_fwd = &linear_xent_fwd_impl_optimized;
+    table.linear_xent_bwd = &linear_xent_bwd_impl_optimized;
+    table.layernorm_fwd = &layernorm_fwd_impl_optimized;
+    table.layernorm_bwd = &layernorm_bwd_impl_optimized;
+    table.rmsnorm_fwd = &rmsnorm_fwd_impl_optimized;
+    table.rmsnorm_bwd = &rmsnorm_bwd_impl_optimized;
+    table.linear_act_fwd = &linear_act_fwd_impl_optimized;
+    table.linear_act_bwd = &linear_act_bwd_impl_optimized;
+    table.swiglu_fwd = &swiglu_fwd_impl_optimized;
+    table.swiglu_bwd = &swiglu_bwd_impl_optimized;
+    table.rope = &rope_impl_optimized;
+    table.embedding_fwd = &embedding_fwd_impl_optimized;
+    table.embedding_bwd = &embedding_bwd_impl_optimized;
+    table.relu_fwd_mask = &relu_fwd_mask_impl_optimized;
+    table.leakyrelu_fwd_mask = &leakyrelu_fwd_mask_impl_optimized;
+    table.relu_bwd_mask = &relu_bwd_mask_impl_optimized;
+    table.leakyrelu_bwd_mask = &leakyrelu_bwd_mask_impl_optimized;
+    table.gemm_f32 = &gemm_impl_optimized;
+    table.binary_bcast = &binary_bcast_impl_optimized;
+    table.binary_reduce = &binary_reduce_impl_optimized;
+    table.reduce = &reduce_impl_optimized;
+    table.ssm_scan_fwd = &ssm_scan_fwd_impl_optimized;
+    table.ssm_scan_bwd = &ssm_scan_bwd_impl_optimized;
+    table.moe_fwd = &moe_fwd_impl_optimized;
+    table.moe_bwd = &moe_bwd_impl_optimized;
+    table.mha_fwd = &mha_fwd_impl_optimized;
+    table.mha_bwd = &mha_bwd_impl_optimized;
+    table.mha_varlen_fwd = &mha_varlen_fwd_impl_optimized;
+    table.mha_varlen_bwd = &mha_varlen_bwd_impl_optimized;
+    table.paged_attn_fwd = &paged_attn_fwd_impl_optimized;
+    table.relu_bwd_acc = &relu_bwd_acc_impl_optimized;
+    table.leakyrelu_bwd_acc = &leakyrelu_bwd_acc_impl_optimized;
+    table.sigmoid_bwd_from_s_acc = &sigmoid_bwd_from_s_acc_impl_optimized;
+    table.tanh_bwd_from_t_acc = &tanh_bwd_from_t_acc_impl_optimized;
+    table.gelu_bwd_acc = &gelu_bwd_acc_impl_optimized;
+    table.softplus_bwd_acc = &softplus_bwd_acc_impl_optimized;
+    table.exp_bwd_from_y_acc = &exp_bwd_from_y_acc_impl_optimized;
+    table.log_bwd_acc = &log_bwd_acc_impl_optimized;
+    table.sqrt_bwd_from_y_acc = &sqrt_bwd_from_y_acc_impl_optimized;
+    table.relu_bwd_mask_acc = &relu_bwd_mask_acc_impl_optimized;
+    table.leakyrelu_bwd_mask_acc = &leakyrelu_bwd_mask_acc_impl_optimized;
+    table.matmul_bwd_dA_acc = &matmul_bwd_dA_acc_impl_optimized;
+    table.matmul_bwd_dB_acc = &matmul_bwd_dB_acc_impl_optimized;
+    table.linear_dW_acc = &linear_dW_acc_impl_optimized;
+    table.linear_dX_acc = &linear_dX_acc_impl_optimized;
+    table.linear_db_acc = &linear_db_acc_impl_optimized;
+    table.gemm_f32_acc = &gemm_acc_impl_optimized;
+    table.linear_xent_bwd_acc = &linear_xent_bwd_acc_impl_optimized;
+    table.layernorm_bwd_acc = &layernorm_bwd_acc_impl_optimized;
+    table.rmsnorm_bwd_acc = &rmsnorm_bwd_acc_impl_optimized;
+    table.linear_act_bwd_acc = &linear_act_bwd_acc_impl_optimized;
+    table.swiglu_bwd_acc = &swiglu_bwd_acc_impl_optimized;
+    table.ssm_scan_bwd_acc = &ssm_scan_bwd_acc_impl_optimized;
+    table.moe_bwd_acc = &moe_bwd_acc_impl_optimized;
+    table.mha_bwd_acc = &mha_bwd_acc_impl_optimized;
+    table.mha_varlen_bwd_acc = &mha_varlen_bwd_acc_impl_optimized;
+    table.linear_bwd = &linear_bwd_impl_optimized;
+    table.linear_bwd_acc = &linear_bwd_acc_impl_optimized;
+    std::memcpy(out, &table, table.struct_size);
+    return 0;
+}
+
+#ifdef AG_CPU_ISA
+} // namespace AG_CPU_ISA
+#else
+} // extern "C"
+#endif
\ No newline at end of file
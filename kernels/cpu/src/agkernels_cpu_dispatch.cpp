@@ -0,0 +1,93 @@
+// =============================================
+// kernels/cpu/src/agkernels_cpu_dispatch.cpp
+// =============================================
+//
+// Plugin entry point. agkernels_cpu.cpp is compiled once per ISA level; this
+// file is built with baseline flags so it runs on any x86-64 CPU, checks cpuid
+// and hands out the table of the best level the CPU supports. AG_CPU_ISA=
+// sse4|avx2|avx512 forces a level (clamped to what the CPU can run).
+
+#include "ad/ops/kernels_api.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace sse4   { int fill_cpu_kernels(struct ag_cpu_v1* out); int fill_cpu_kernels_v2(struct ag_cpu_v2* out); }
+namespace avx2   { int fill_cpu_kernels(struct ag_cpu_v1* out); int fill_cpu_kernels_v2(struct ag_cpu_v2* out); }
+namespace avx512 { int fill_cpu_kernels(struct ag_cpu_v1* out); int fill_cpu_kernels_v2(struct ag_cpu_v2* out); }
+
+namespace {
+
+enum IsaLevel { ISA_NONE = 0, ISA_SSE4 = 1, ISA_AVX2 = 2, ISA_AVX512 = 3 };
+
+const char* isa_name(int level) {
+    switch (level) {
+        case ISA_SSE4:   return "sse4";
+        case ISA_AVX2:   return "avx2";
+        case ISA_AVX512: return "avx512";
+        default:         return "none";
+    }
+}
+
+int detect_isa() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq"))
+        return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return ISA_SSE4;
+    return ISA_NONE;
+}
+
+int requested_isa() {
+    const char* env = std::getenv("AG_CPU_ISA");
+    if (!env || !*env) return ISA_NONE;
+    for (int level = ISA_SSE4; level <= ISA_AVX512; ++level)
+        if (std::strcmp(env, isa_name(level)) == 0) return level;
+    std::fprintf(stderr, "agkernels_cpu: unknown AG_CPU_ISA='%s' (expected sse4, avx2 or avx512), ignoring\n", env);
+    return ISA_NONE;
+}
+
+// Read per call, so a process can switch levels through AG_CPU_ISA between loads.
+int selected_isa() {
+    const int supported = detect_isa();
+    int level = supported;
+    if (const int forced = requested_isa()) {
+        level = forced;
+        if (forced > supported) {
+            std::fprintf(stderr, "agkernels_cpu: AG_CPU_ISA=%s is not supported by this CPU, using %s\n",
+                         isa_name(forced), isa_name(supported));
+            level = supported;
+        }
+    }
+    return level;
+}
+
+} // namespace
+
+extern "C" {
+
+AG_EXPORT int ag_get_cpu_kernels_v1(struct ag_cpu_v1* out) {
+    if (!out) return -1;
+    switch (selected_isa()) {
+        case ISA_AVX512: return avx512::fill_cpu_kernels(out);
+        case ISA_AVX2:   return avx2::fill_cpu_kernels(out);
+        case ISA_SSE4:   return sse4::fill_cpu_kernels(out);
+        default:
+            std::fprintf(stderr, "agkernels_cpu: CPU lacks SSE4.2, no kernels available\n");
+            return -2;
+    }
+}
+
+// The v2 table comes from the same level as v1, so both see one build.
+AG_EXPORT int ag_get_cpu_kernels_v2(struct ag_cpu_v2* out) {
+    if (!out) return -1;
+    switch (selected_isa()) {
+        case ISA_AVX512: return avx512::fill_cpu_kernels_v2(out);
+        case ISA_AVX2:   return avx2::fill_cpu_kernels_v2(out);
+        case ISA_SSE4:   return sse4::fill_cpu_kernels_v2(out);
+        default:         return -2;
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,123 @@
+// =============================================
+// kernels/cpu/src/simd_compat_sse.hpp
+// =============================================
+//
+// Lets the 8-wide kernels in agkernels_cpu.cpp build for the SSE4 variant of
+// the plugin. Each _mm256_* intrinsic the kernels use is redirected to an
+// agv_* function that does the same work on two 128-bit halves (or through
+// GCC vector extensions, which lower to SSE pairs). Only included when the
+// translation unit is compiled without AVX; build it with -Wno-psabi, since
+// 32-byte vector arguments change ABI without AVX (all of these inline away).
+#pragma once
+
+#include <immintrin.h>
+#include <cstdint>
+
+typedef float   agv_v8sf __attribute__((vector_size(32)));
+typedef int32_t agv_v8si __attribute__((vector_size(32)));
+typedef uint32_t agv_v8su __attribute__((vector_size(32)));
+typedef int32_t agv_v4si __attribute__((vector_size(16)));
+
+static inline __m128 agv_lo(__m256 v) { return __builtin_shufflevector(v, v, 0, 1, 2, 3); }
+static inline __m128 agv_hi(__m256 v) { return __builtin_shufflevector(v, v, 4, 5, 6, 7); }
+static inline __m256 agv_join(__m128 lo, __m128 hi) { return __builtin_shufflevector(lo, hi, 0, 1, 2, 3, 4, 5, 6, 7); }
+
+// ---- loads / stores / constants ----
+static inline __m256 agv_loadu_ps(const float* p) { __m256 v; __builtin_memcpy(&v, p, sizeof v); return v; }
+static inline void agv_storeu_ps(float* p, __m256 v) { __builtin_memcpy(p, &v, sizeof v); }
+static inline __m256 agv_set1_ps(float a) { return __m256{a, a, a, a, a, a, a, a}; }
+static inline __m256 agv_setzero_ps() { return agv_set1_ps(0.0f); }
+static inline __m256 agv_broadcast_ss(const float* p) { return agv_set1_ps(*p); }
+static inline __m256i agv_set1_epi32(int a) { return (__m256i)agv_v8si{a, a, a, a, a, a, a, a}; }
+static inline __m256i agv_setr_epi32(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return (__m256i)agv_v8si{a, b, c, d, e, f, g, h};
+}
+
+// ---- float arithmetic ----
+static inline __m256 agv_add_ps(__m256 a, __m256 b) { return a + b; }
+static inline __m256 agv_sub_ps(__m256 a, __m256 b) { return a - b; }
+static inline __m256 agv_mul_ps(__m256 a, __m256 b) { return a * b; }
+static inline __m256 agv_div_ps(__m256 a, __m256 b) { return a / b; }
+static inline __m256 agv_fmadd_ps(__m256 a, __m256 b, __m256 c) { return a * b + c; }
+static inline __m256 agv_fnmadd_ps(__m256 a, __m256 b, __m256 c) { return c - a * b; }
+static inline __m256 agv_max_ps(__m256 a, __m256 b) {
+    return agv_join(_mm_max_ps(agv_lo(a), agv_lo(b)), _mm_max_ps(agv_hi(a), agv_hi(b)));
+}
+static inline __m256 agv_min_ps(__m256 a, __m256 b) {
+    return agv_join(_mm_min_ps(agv_lo(a), agv_lo(b)), _mm_min_ps(agv_hi(a), agv_hi(b)));
+}
+static inline __m256 agv_sqrt_ps(__m256 a) { return agv_join(_mm_sqrt_ps(agv_lo(a)), _mm_sqrt_ps(agv_hi(a))); }
+
+// ---- compares and masks ----
+// Only the ordered predicates the kernels use; all of them are false on NaN,
+// which matches the vector-extension comparisons.
+static inline __m256 agv_cmp_ps(__m256 a, __m256 b, int pred) {
+    agv_v8si m;
+    switch (pred) {
+        case _CMP_GT_OS: case _CMP_GT_OQ: m = a > b;  break;
+        case _CMP_GE_OS: case _CMP_GE_OQ: m = a >= b; break;
+        case _CMP_LT_OS: case _CMP_LT_OQ: m = a < b;  break;
+        case _CMP_LE_OS: case _CMP_LE_OQ: m = a <= b; break;
+        default:                          m = a == b; break;
+    }
+    return (__m256)m;
+}
+static inline __m256 agv_blendv_ps(__m256 a, __m256 b, __m256 mask) {
+    return (((agv_v8si)mask) < 0) ? b : a;
+}
+static inline __m256 agv_and_ps(__m256 a, __m256 b) { return (__m256)((agv_v8si)a & (agv_v8si)b); }
+static inline int agv_movemask_ps(__m256 a) {
+    return _mm_movemask_ps(agv_lo(a)) | (_mm_movemask_ps(agv_hi(a)) << 4);
+}
+
+// ---- integer lanes and conversions ----
+static inline __m256 agv_castsi256_ps(__m256i a) { return (__m256)a; }
+static inline __m256i agv_castps_si256(__m256 a) { return (__m256i)a; }
+static inline __m128 agv_castps256_ps128(__m256 a) { return agv_lo(a); }
+static inline __m256i agv_and_si256(__m256i a, __m256i b) { return a & b; }
+static inline __m256i agv_add_epi32(__m256i a, __m256i b) { return (__m256i)((agv_v8si)a + (agv_v8si)b); }
+static inline __m256i agv_cmpeq_epi32(__m256i a, __m256i b) { return (__m256i)((agv_v8si)a == (agv_v8si)b); }
+static inline __m256i agv_slli_epi32(__m256i a, int n) { return (__m256i)((agv_v8su)a << n); }
+static inline __m256i agv_srli_epi32(__m256i a, int n) { return (__m256i)((agv_v8su)a >> n); }
+static inline __m256 agv_cvtepi32_ps(__m256i a) { return __builtin_convertvector((agv_v8si)a, agv_v8sf); }
+static inline __m256i agv_cvtps_epi32(__m256 a) {
+    const agv_v4si lo = (agv_v4si)_mm_cvtps_epi32(agv_lo(a));
+    const agv_v4si hi = (agv_v4si)_mm_cvtps_epi32(agv_hi(a));
+    return (__m256i)__builtin_shufflevector(lo, hi, 0, 1, 2, 3, 4, 5, 6, 7);
+}
+
+#define _mm256_loadu_ps      agv_loadu_ps
+#define _mm256_load_ps       agv_loadu_ps
+#define _mm256_storeu_ps     agv_storeu_ps
+#define _mm256_store_ps      agv_storeu_ps
+#define _mm256_set1_ps       agv_set1_ps
+#define _mm256_setzero_ps    agv_setzero_ps
+#define _mm256_broadcast_ss  agv_broadcast_ss
+#define _mm256_set1_epi32    agv_set1_epi32
+#define _mm256_setr_epi32    agv_setr_epi32
+#define _mm256_add_ps        agv_add_ps
+#define _mm256_sub_ps        agv_sub_ps
+#define _mm256_mul_ps        agv_mul_ps
+#define _mm256_div_ps        agv_div_ps
+#define _mm256_fmadd_ps      agv_fmadd_ps
+#define _mm256_fnmadd_ps     agv_fnmadd_ps
+#define _mm256_max_ps        agv_max_ps
+#define _mm256_min_ps        agv_min_ps
+#define _mm256_sqrt_ps       agv_sqrt_ps
+#define _mm256_cmp_ps        agv_cmp_ps
+#define _mm256_blendv_ps     agv_blendv_ps
+#define _mm256_and_ps        agv_and_ps
+#define _mm256_movemask_ps   agv_movemask_ps
+#define _mm256_castsi256_ps  agv_castsi256_ps
+#define _mm256_castps_si256  agv_castps_si256
+#define _mm256_castps256_ps128 agv_castps256_ps128
+#define _mm256_and_si256     agv_and_si256
+#define _mm256_add_epi32     agv_add_epi32
+#define _mm256_cmpeq_epi32   agv_cmpeq_epi32
+#define _mm256_slli_epi32    agv_slli_epi32
+#define _mm256_srli_epi32    agv_srli_epi32
+#define _mm256_cvtepi32_ps   agv_cvtepi32_ps
+#define _mm256_cvtps_epi32   agv_cvtps_epi32
+#define _mm256_extractf128_ps(v, i) ((i) ? agv_hi(v) : agv_lo(v))
+#define _mm256_round_ps(v, mode) \
+    agv_join(_mm_round_ps(agv_lo(v), (mode)), _mm_round_ps(agv_hi(v), (mode)))
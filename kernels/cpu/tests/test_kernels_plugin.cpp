@@ -0,0 +1,473 @@
+// =============================================
+// kernels/cpu/tests/test_kernels_plugin.cpp
+// =============================================
+//
+// Reference checks of the CPU plugin through its C tables alone, so they
+// build and run with the plugin (no tensor library or CUDA). References are
+// plain loops in double. CTest runs the binary once per AG_CPU_ISA level, so
+// every check covers each per-ISA build (sse4 through simd_compat_sse.hpp);
+// a level this CPU cannot run is reported as skipped.
+
+#include "ad/ops/kernels_api.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static ag_cpu_v1 K1;
+static ag_cpu_v2 K2;
+
+// Fetches both tables again. The plugin rereads its environment (AG_CPU_ISA,
+// AG_AUTOTUNE, AG_TUNE_CACHE) on every call.
+static void load_tables() {
+    K1 = ag_cpu_v1{};
+    K2 = ag_cpu_v2{};
+    K2.struct_size = sizeof(K2);
+    if (ag_get_cpu_kernels_v1(&K1) != 0 || ag_get_cpu_kernels_v2(&K2) != 0)
+        throw std::runtime_error("CPU plugin tables unavailable");
+}
+
+static std::vector<float> randn(size_t n) {
+    static std::mt19937 gen(42);
+    std::normal_distribution<float> dis;
+    std::vector<float> v(n);
+    for (auto& x : v) x = dis(gen);
+    return v;
+}
+
+static void check_close(const std::vector<float>& ref, const std::vector<float>& out,
+                        const std::string& label, float eps) {
+    if (ref.size() != out.size()) throw std::runtime_error(label + ": size mismatch");
+    for (size_t i = 0; i < ref.size(); ++i) {
+        if (!(std::abs(ref[i] - out[i]) <= eps)) {
+            std::cerr << "FAIL: " << label << " mismatch at index " << i << ": " << ref[i] << " vs " << out[i] << "\n";
+            throw std::runtime_error("Check failed for " + label);
+        }
+    }
+    std::cout << "PASS: " << label << "\n";
+}
+
+// op(A) [M,Kd] @ op(B) [Kd,N] with A stored [M,Kd] ([Kd,M] if ta) and B
+// stored [Kd,N] ([N,Kd] if tb).
+static std::vector<float> ref_gemm(const std::vector<float>& A, const std::vector<float>& B,
+                                   int M, int Kd, int N, bool ta, bool tb) {
+    std::vector<float> C((size_t)M * N);
+    for (int i = 0; i < M; ++i)
+        for (int j = 0; j < N; ++j) {
+            double s = 0.0;
+            for (int k = 0; k < Kd; ++k)
+                s += (double)(ta ? A[(size_t)k * M + i] : A[(size_t)i * Kd + k]) *
+                     (tb ? B[(size_t)j * Kd + k] : B[(size_t)k * N + j]);
+            C[(size_t)i * N + j] = (float)s;
+        }
+    return C;
+}
+
+// Runs gemm_f32, gemm_f32_acc on top of a random C, and (NN only) matmul.
+static void check_gemm(int M, int Kd, int N, bool ta, bool tb, const std::string& label, float eps) {
+    const std::vector<float> A = randn((size_t)M * Kd), B = randn((size_t)Kd * N), C0 = randn((size_t)M * N);
+    const std::vector<float> ref = ref_gemm(A, B, M, Kd, N, ta, tb);
+
+    std::vector<float> C((size_t)M * N);
+    K2.gemm_f32(A.data(), B.data(), C.data(), M, Kd, N, ta, tb);
+    check_close(ref, C, label, eps);
+
+    std::vector<float> acc = C0, ref_acc = ref;
+    for (size_t i = 0; i < ref_acc.size(); ++i) ref_acc[i] += C0[i];
+    K2.gemm_f32_acc(A.data(), B.data(), acc.data(), M, Kd, N, ta, tb);
+    check_close(ref_acc, acc, label + " acc", eps);
+
+    if (!ta && !tb) {
+        std::fill(C.begin(), C.end(), 0.0f);
+        K1.matmul(A.data(), B.data(), C.data(), M, Kd, N);
+        check_close(ref, C, label + " matmul", eps);
+    }
+}
+
+void test_gemm_packed() {
+    // One thread keeps every shape on the serial loop nest. 300 x 600 crosses
+    // every MC and KC the tuner can pick, N = 2100 the 2048-wide NC block, and
+    // the odd sizes leave partial micro-tiles and slivers on each edge.
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    check_gemm(300, 600, 37, false, false, "test_gemm_packed (300x600x37 NN)", 1e-3f);
+    check_gemm(300, 600, 37, true, true, "test_gemm_packed (300x600x37 TT)", 1e-3f);
+    check_gemm(7, 300, 2100, false, true, "test_gemm_packed (7x300x2100 NT)", 1e-3f);
+    check_gemm(7, 300, 2100, true, false, "test_gemm_packed (7x300x2100 TN)", 1e-3f);
+    check_gemm(1, 1, 1, false, false, "test_gemm_packed (1x1x1)", 1e-5f);
+    omp_set_num_threads(threads);
+}
+
+// Sets (or, with null, clears) an environment variable until the end of the
+// scope. The plugin reads its variables when the tables are fetched, so call
+// load_tables() again after the scope.
+struct ScopedEnv {
+    std::string name, old;
+    bool had;
+    ScopedEnv(const char* n, const char* v) : name(n) {
+        const char* o = std::getenv(n);
+        had = o != nullptr;
+        if (had) old = o;
+        if (v) setenv(n, v, 1); else unsetenv(n);
+    }
+    ~ScopedEnv() { if (had) setenv(name.c_str(), old.c_str(), 1); else unsetenv(name.c_str()); }
+};
+
+void test_gemm_partitions() {
+    // Untuned blocking (MC = 144) at 4 threads makes the partition a function
+    // of the shape alone: 600 rows are 5 row blocks (rows), 5 rows of 300
+    // columns leave one row block but >= 4 slivers (cols), and 20 x 24 with
+    // K = 1500 has neither, so K is split four ways (split-K). Each runs with
+    // and without accumulate, across more than one KC slab.
+    const int threads = omp_get_max_threads();
+    {
+        ScopedEnv no_tune("AG_AUTOTUNE", "0");
+        load_tables();
+        omp_set_num_threads(4);
+        check_gemm(13, 29, 37, false, false, "test_gemm_partitions (serial)", 1e-4f);
+        check_gemm(600, 300, 40, false, false, "test_gemm_partitions (rows)", 1e-3f);
+        check_gemm(600, 300, 40, true, true, "test_gemm_partitions (rows TT)", 1e-3f);
+        check_gemm(5, 600, 300, false, false, "test_gemm_partitions (cols)", 1e-3f);
+        check_gemm(5, 600, 300, true, false, "test_gemm_partitions (cols TN)", 1e-3f);
+        check_gemm(20, 1500, 24, false, false, "test_gemm_partitions (split-K)", 1e-3f);
+        check_gemm(20, 1500, 24, false, true, "test_gemm_partitions (split-K NT)", 1e-3f);
+    }
+    omp_set_num_threads(threads);
+    load_tables();
+}
+
+// Y = X @ W^T + b, W: [Out,In]. dX = dY @ W, dW = dY^T @ X, db = colsum(dY).
+static void ref_linear_bwd(const std::vector<float>& X, const std::vector<float>& W, const std::vector<float>& dY,
+                           std::vector<float>& dX, std::vector<float>& dW, std::vector<float>& db,
+                           int B, int In, int Out) {
+    dX = ref_gemm(dY, W, B, Out, In, false, false);
+    dW = ref_gemm(dY, X, Out, B, In, true, false);
+    db.assign(Out, 0.0f);
+    for (int o = 0; o < Out; ++o) {
+        double s = 0.0;
+        for (int r = 0; r < B; ++r) s += dY[(size_t)r * Out + o];
+        db[o] = (float)s;
+    }
+}
+
+void test_linear_bwd() {
+    // Gradients start out stale (7.0): the plain entry must overwrite them
+    // and the _acc entry add to them, for empty batches and In == 0 too.
+    struct Case { int B, In, Out; const char* name; };
+    for (const Case& c : {Case{13, 21, 37, "13x21x37"}, Case{300, 5, 300, "300x5x300"},
+                          Case{0, 6, 9, "B=0"}, Case{4, 0, 9, "In=0"}}) {
+        const std::vector<float> X = randn((size_t)c.B * c.In + 1), W = randn((size_t)c.Out * c.In + 1);
+        const std::vector<float> dY = randn((size_t)c.B * c.Out + 1);
+        std::vector<float> rdX, rdW, rdb;
+        ref_linear_bwd(X, W, dY, rdX, rdW, rdb, c.B, c.In, c.Out);
+        for (int acc = 0; acc < 2; ++acc) {
+            std::vector<float> dX((size_t)c.B * c.In, 7.0f), dW((size_t)c.Out * c.In, 7.0f), db(c.Out, 7.0f);
+            (acc ? K2.linear_bwd_acc : K2.linear_bwd)(X.data(), W.data(), dY.data(), dX.data(), dW.data(), db.data(),
+                                                      c.B, c.In, c.Out);
+            std::vector<float> eX = rdX, eW = rdW, eb = rdb;
+            if (acc) {
+                for (auto& v : eX) v += 7.0f;
+                for (auto& v : eW) v += 7.0f;
+                for (auto& v : eb) v += 7.0f;
+            }
+            const std::string label = std::string("test_linear_bwd (") + c.name + (acc ? ", acc" : "") + ")";
+            check_close(eX, dX, label + " dX", 1e-3f);
+            check_close(eW, dW, label + " dW", 1e-3f);
+            check_close(eb, db, label + " db", 1e-3f);
+        }
+    }
+}
+
+void test_linear_act_bwd() {
+    // Same as test_linear_bwd with dY first scaled by act'(S); ReLU and SiLU
+    // have exact derivatives to compare against.
+    struct Case { int B, In, Out; const char* name; };
+    for (int act : {(int)AG_ACT_RELU, (int)AG_ACT_SILU}) {
+        for (const Case& c : {Case{13, 21, 37, "13x21x37"}, Case{0, 6, 9, "B=0"}, Case{4, 0, 9, "In=0"}}) {
+            const std::vector<float> X = randn((size_t)c.B * c.In + 1), W = randn((size_t)c.Out * c.In + 1);
+            const std::vector<float> S = randn((size_t)c.B * c.Out + 1), dY = randn((size_t)c.B * c.Out + 1);
+            std::vector<float> dZ(dY.size());
+            for (size_t i = 0; i < dZ.size(); ++i) {
+                const double s = S[i], sg = 1.0 / (1.0 + std::exp(-s));
+                dZ[i] = (float)(act == AG_ACT_RELU ? (s > 0.0 ? dY[i] : 0.0) : dY[i] * sg * (1.0 + s * (1.0 - sg)));
+            }
+            std::vector<float> rdX, rdW, rdb;
+            ref_linear_bwd(X, W, dZ, rdX, rdW, rdb, c.B, c.In, c.Out);
+            for (int acc = 0; acc < 2; ++acc) {
+                std::vector<float> dX((size_t)c.B * c.In, 7.0f), dW((size_t)c.Out * c.In, 7.0f), db(c.Out, 7.0f);
+                (acc ? K2.linear_act_bwd_acc : K2.linear_act_bwd)(X.data(), W.data(), S.data(), dY.data(), dX.data(),
+                                                                  dW.data(), db.data(), c.B, c.In, c.Out, act);
+                std::vector<float> eX = rdX, eW = rdW, eb = rdb;
+                if (acc) {
+                    for (auto& v : eX) v += 7.0f;
+                    for (auto& v : eW) v += 7.0f;
+                    for (auto& v : eb) v += 7.0f;
+                }
+                const std::string label = std::string("test_linear_act_bwd (") + (act == AG_ACT_RELU ? "relu " : "silu ") +
+                                          c.name + (acc ? ", acc" : "") + ")";
+                check_close(eX, dX, label + " dX", 1e-3f);
+                check_close(eW, dW, label + " dW", 1e-3f);
+                check_close(eb, db, label + " db", 1e-3f);
+            }
+        }
+    }
+}
+
+void test_swiglu_bwd() {
+    // Y = silu(G) * U with G = X Wg^T + bg, U = X Wu^T + bu. Every gradient
+    // starts stale (7.0); the bias gradients do not depend on In.
+    struct Case { int B, In, H; const char* name; };
+    for (const Case& c : {Case{13, 21, 17, "13x21x17"}, Case{0, 6, 9, "B=0"}, Case{4, 0, 9, "In=0"}}) {
+        const std::vector<float> X = randn((size_t)c.B * c.In + 1);
+        const std::vector<float> Wg = randn((size_t)c.H * c.In + 1), Wu = randn((size_t)c.H * c.In + 1);
+        const std::vector<float> G = randn((size_t)c.B * c.H + 1), U = randn((size_t)c.B * c.H + 1);
+        const std::vector<float> dY = randn((size_t)c.B * c.H + 1);
+        std::vector<float> dg(dY.size()), du(dY.size());
+        for (size_t i = 0; i < dY.size(); ++i) {
+            const double g = G[i], sg = 1.0 / (1.0 + std::exp(-g));
+            du[i] = (float)(dY[i] * g * sg);
+            dg[i] = (float)(dY[i] * U[i] * sg * (1.0 + g * (1.0 - sg)));
+        }
+        std::vector<float> rdX, rdWg, rdbg, rdXu, rdWu, rdbu;
+        ref_linear_bwd(X, Wg, dg, rdX, rdWg, rdbg, c.B, c.In, c.H);
+        ref_linear_bwd(X, Wu, du, rdXu, rdWu, rdbu, c.B, c.In, c.H);
+        for (size_t i = 0; i < rdX.size(); ++i) rdX[i] += rdXu[i];
+        for (int acc = 0; acc < 2; ++acc) {
+            std::vector<float> dX((size_t)c.B * c.In, 7.0f), dWg((size_t)c.H * c.In, 7.0f), dWu = dWg;
+            std::vector<float> dbg(c.H, 7.0f), dbu(c.H, 7.0f);
+            (acc ? K2.swiglu_bwd_acc : K2.swiglu_bwd)(X.data(), Wg.data(), Wu.data(), G.data(), U.data(), dY.data(),
+                                                      dX.data(), dWg.data(), dbg.data(), dWu.data(), dbu.data(),
+                                                      c.B, c.In, c.H);
+            const std::string label = std::string("test_swiglu_bwd (") + c.name + (acc ? ", acc" : "") + ")";
+            auto expect = [&](std::vector<float> ref) {
+                if (acc) for (auto& v : ref) v += 7.0f;
+                return ref;
+            };
+            check_close(expect(rdX), dX, label + " dX", 1e-3f);
+            check_close(expect(rdWg), dWg, label + " dWg", 1e-3f);
+            check_close(expect(rdWu), dWu, label + " dWu", 1e-3f);
+            check_close(expect(rdbg), dbg, label + " dbg", 1e-3f);
+            check_close(expect(rdbu), dbu, label + " dbu", 1e-3f);
+        }
+    }
+}
+
+void test_moe() {
+    // Token by token in double, from the routing the forward picked: for slot
+    // j of token t on expert e, z = W1[e] x + b1[e], o = W2[e] silu(z) + b2[e],
+    // y += gate_j o. The backward follows the chain rule through o, z and the
+    // softmax over the picked router logits; dropped slots only take part in
+    // that softmax. 300 tokens over 4 experts give the grouped GEMMs several
+    // row blocks per expert; capacity 140 drops some second choices.
+    const int T = 300, D = 40, H = 72, E = 4, k = 2, capacity = 140;
+    const std::vector<float> X = randn((size_t)T * D), Wg = randn((size_t)E * D);
+    std::vector<float> W1 = randn((size_t)E * H * D), W2 = randn((size_t)E * D * H);
+    for (auto& v : W1) v *= 0.2f;
+    for (auto& v : W2) v *= 0.2f;
+    const std::vector<float> b1 = randn((size_t)E * H), b2 = randn((size_t)E * D), gy = randn((size_t)T * D);
+    std::vector<float> Y((size_t)T * D), route((size_t)T * k), gate((size_t)T * k), Z1((size_t)T * k * H);
+    K2.moe_fwd(X.data(), Wg.data(), W1.data(), b1.data(), W2.data(), b2.data(), Y.data(), route.data(), gate.data(),
+               Z1.data(), T, D, H, E, k, capacity, AG_ACT_SILU);
+
+    std::vector<double> y((size_t)T * D, 0.0), dx((size_t)T * D, 0.0), dwg((size_t)E * D, 0.0);
+    std::vector<double> dw1((size_t)E * H * D, 0.0), db1((size_t)E * H, 0.0), dw2((size_t)E * D * H, 0.0), db2((size_t)E * D, 0.0);
+    int dropped = 0;
+    for (int t = 0; t < T; ++t) {
+        const float* x = X.data() + (size_t)t * D;
+        const float* g = gy.data() + (size_t)t * D;
+        std::vector<double> dgate(k, 0.0);
+        for (int j = 0; j < k; ++j) {
+            const int e = (int)route[(size_t)t * k + j];
+            if (e < 0) { ++dropped; continue; }
+            const double gj = gate[(size_t)t * k + j];
+            std::vector<double> z(H), h(H), u(H, 0.0);
+            for (int c = 0; c < H; ++c) {
+                double s = b1[(size_t)e * H + c];
+                for (int d = 0; d < D; ++d) s += (double)W1[((size_t)e * H + c) * D + d] * x[d];
+                z[c] = s;
+                h[c] = s / (1.0 + std::exp(-s));
+            }
+            for (int d = 0; d < D; ++d) {
+                double o = b2[(size_t)e * D + d];
+                for (int c = 0; c < H; ++c) o += (double)W2[((size_t)e * D + d) * H + c] * h[c];
+                y[(size_t)t * D + d] += gj * o;
+                dgate[j] += g[d] * o;
+                db2[(size_t)e * D + d] += gj * g[d];
+                for (int c = 0; c < H; ++c) {
+                    u[c] += (double)W2[((size_t)e * D + d) * H + c] * g[d];
+                    dw2[((size_t)e * D + d) * H + c] += gj * g[d] * h[c];
+                }
+            }
+            for (int c = 0; c < H; ++c) {
+                const double sg = 1.0 / (1.0 + std::exp(-z[c]));
+                const double dz = gj * u[c] * sg * (1.0 + z[c] * (1.0 - sg));
+                db1[(size_t)e * H + c] += dz;
+                for (int d = 0; d < D; ++d) {
+                    dw1[((size_t)e * H + c) * D + d] += dz * x[d];
+                    dx[(size_t)t * D + d] += dz * W1[((size_t)e * H + c) * D + d];
+                }
+            }
+        }
+        double dot = 0.0;
+        for (int j = 0; j < k; ++j) dot += gate[(size_t)t * k + j] * dgate[j];
+        for (int j = 0; j < k; ++j) {
+            const int re = (int)route[(size_t)t * k + j], e = re >= 0 ? re : -1 - re;
+            const double dl = gate[(size_t)t * k + j] * (dgate[j] - dot);
+            for (int d = 0; d < D; ++d) {
+                dwg[(size_t)e * D + d] += dl * x[d];
+                dx[(size_t)t * D + d] += dl * Wg[(size_t)e * D + d];
+            }
+        }
+    }
+    if (dropped == 0) throw std::runtime_error("test_moe: capacity dropped nothing");
+    auto to_f = [](const std::vector<double>& v, float add) {
+        std::vector<float> f(v.size());
+        for (size_t i = 0; i < v.size(); ++i) f[i] = (float)v[i] + add;
+        return f;
+    };
+    check_close(to_f(y, 0.0f), Y, "test_moe (y)", 1e-3f);
+
+    for (int acc = 0; acc < 2; ++acc) {
+        std::vector<float> dX((size_t)T * D, 7.0f), dWg((size_t)E * D, 7.0f), dW1((size_t)E * H * D, 7.0f);
+        std::vector<float> dB1((size_t)E * H, 7.0f), dW2((size_t)E * D * H, 7.0f), dB2((size_t)E * D, 7.0f);
+        (acc ? K2.moe_bwd_acc : K2.moe_bwd)(X.data(), Wg.data(), W1.data(), b1.data(), W2.data(), b2.data(),
+                                            route.data(), gate.data(), Z1.data(), gy.data(), dX.data(), dWg.data(),
+                                            dW1.data(), dB1.data(), dW2.data(), dB2.data(), T, D, H, E, k, AG_ACT_SILU);
+        const float add = acc ? 7.0f : 0.0f;
+        const std::string label = std::string("test_moe") + (acc ? " acc" : "");
+        check_close(to_f(dx, add), dX, label + " (dX)", 2e-3f);
+        check_close(to_f(dwg, add), dWg, label + " (dWg)", 2e-3f);
+        check_close(to_f(dw1, add), dW1, label + " (dW1)", 2e-3f);
+        check_close(to_f(db1, add), dB1, label + " (db1)", 2e-3f);
+        check_close(to_f(dw2, add), dW2, label + " (dW2)", 2e-3f);
+        check_close(to_f(db2, add), dB2, label + " (db2)", 2e-3f);
+    }
+}
+
+// Same cpuid checks as agkernels_cpu_dispatch.cpp.
+static bool isa_supported(const std::string& level) {
+    __builtin_cpu_init();
+    if (level == "sse4") return __builtin_cpu_supports("sse4.2");
+    if (level == "avx2") return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (level == "avx512")
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+               __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+    return false;
+}
+
+void test_isa_dispatch() {
+    // Every level the CPU runs must hand out its own table, in v1 and v2.
+    const char* levels[] = {"sse4", "avx2", "avx512"};
+    std::vector<const void*> seen;
+    for (const char* level : levels) {
+        if (!isa_supported(level)) continue;
+        {
+            ScopedEnv isa("AG_CPU_ISA", level);
+            load_tables();
+        }
+        const void* fn = (const void*)K1.matmul;
+        if ((const void*)K2.gemm_f32 == nullptr || std::find(seen.begin(), seen.end(), fn) != seen.end())
+            throw std::runtime_error(std::string("test_isa_dispatch: ") + level + " did not get its own table");
+        seen.push_back(fn);
+    }
+    load_tables();
+    std::cout << "PASS: test_isa_dispatch (" << seen.size() << " levels)\n";
+
+    // Vector kernels of the active level, with odd widths for the tails.
+    const int rows = 37, cols = 301;
+    std::vector<float> x((size_t)rows * cols), g(cols), b(cols);
+    for (size_t i = 0; i < x.size(); ++i) x[i] = std::sin(0.37f * i) * 4.0f;
+    for (int j = 0; j < cols; ++j) { g[j] = 1.0f + 0.01f * j; b[j] = std::cos(0.3f * j); }
+
+    std::vector<float> y(x.size()), ref(x.size()), mean(rows), rstd(rows);
+    K1.relu(x.data(), y.data(), (int64_t)x.size());
+    for (size_t i = 0; i < x.size(); ++i) ref[i] = std::max(x[i], 0.0f);
+    check_close(ref, y, "test_isa_dispatch (relu)", 0.0f);
+    K1.sigmoid(x.data(), y.data(), (int64_t)x.size());
+    for (size_t i = 0; i < x.size(); ++i) ref[i] = (float)(1.0 / (1.0 + std::exp(-(double)x[i])));
+    check_close(ref, y, "test_isa_dispatch (sigmoid)", 1e-4f);
+    K2.layernorm_fwd(x.data(), g.data(), b.data(), y.data(), mean.data(), rstd.data(), rows, cols, 1e-5f);
+    for (int r = 0; r < rows; ++r) {
+        const float* xr = x.data() + (size_t)r * cols;
+        double mu = 0.0, var = 0.0;
+        for (int j = 0; j < cols; ++j) mu += xr[j];
+        mu /= cols;
+        for (int j = 0; j < cols; ++j) var += (xr[j] - mu) * (xr[j] - mu);
+        const double rs = 1.0 / std::sqrt(var / cols + 1e-5);
+        for (int j = 0; j < cols; ++j) ref[(size_t)r * cols + j] = (float)((xr[j] - mu) * rs * g[j] + b[j]);
+    }
+    check_close(ref, y, "test_isa_dispatch (layernorm)", 1e-4f);
+}
+
+void test_gemm_tuned() {
+    // The first GEMM of a shape class is timed and appended to the cache as
+    // "cpu \t isa \t gemm/m<c>n<c>k<c>t<threads> \t mc kc nc threads". Each
+    // case rewrites the values and refetches the tables, so the next GEMM of
+    // that class (100 x 700 x 300) runs with them. The pack buffers must hold
+    // whatever a cache file says: blocks off the MR/NR grid, blocks larger
+    // than the problem, a one-deep K slab, and 4 threads (rows) or fewer.
+    const char* isa = std::getenv("AG_CPU_ISA");
+    const std::string path = std::string("./agkernels_tune_test_") + (isa ? isa : "default") + ".txt";
+    const std::string key = "\tgemm/m1n2k2t4\t";
+    std::remove(path.c_str());
+    const int threads = omp_get_max_threads();
+    {
+        ScopedEnv cache("AG_TUNE_CACHE", path.c_str());
+        ScopedEnv tune("AG_AUTOTUNE", "1");
+        load_tables();
+        omp_set_num_threads(4);
+        check_gemm(100, 700, 300, false, false, "test_gemm_tuned (tuned here)", 1e-3f);
+
+        std::string line, prefix;
+        std::ifstream in(path);
+        while (std::getline(in, line))
+            if (line.find(key) != std::string::npos) prefix = line.substr(0, line.find(key) + key.size());
+        in.close();
+        if (prefix.empty()) throw std::runtime_error("test_gemm_tuned: no cache entry for gemm/m1n2k2t4");
+
+        for (const char* vals : {"30 100 80 4", "30 100 80 1", "4000 4000 4000 4", "7 1 5 2"}) {
+            std::ofstream(path, std::ios::trunc) << prefix << vals << "\n";
+            load_tables();
+            check_gemm(100, 700, 300, false, false, std::string("test_gemm_tuned (") + vals + ")", 1e-3f);
+            check_gemm(100, 700, 300, true, true, std::string("test_gemm_tuned (") + vals + " TT)", 1e-3f);
+        }
+    }
+    std::remove(path.c_str());
+    omp_set_num_threads(threads);
+    load_tables();
+}
+
+int main() {
+    const char* isa = std::getenv("AG_CPU_ISA");
+    std::cout << "=== Running CPU Plugin Tests (AG_CPU_ISA=" << (isa ? isa : "") << ") ===\n";
+    if (isa && *isa && !isa_supported(isa)) {
+        std::cout << "SKIP: " << isa << " is not supported by this CPU\n";
+        return 77;
+    }
+    try {
+        load_tables();
+
+        test_gemm_packed();
+        test_gemm_partitions();
+        test_gemm_tuned();
+        test_isa_dispatch();
+        test_linear_bwd();
+        test_linear_act_bwd();
+        test_swiglu_bwd();
+        test_moe();
+
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "\nAll CPU plugin tests passed successfully!\n";
+    return 0;
+}